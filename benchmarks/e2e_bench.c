@@ -0,0 +1,314 @@
+/*
+    File: benchmarks/e2e_bench.c
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference: None
+    Description:
+        Offline end-to-end benchmark of the net, SOCKS and HTTP layers.
+        Starts the mock proxy and origin in-process, points the client at
+        them with http_set_proxy() and runs a fixed set of scenarios
+        through the real blocking, multi and streaming APIs, printing
+        throughput and latency percentiles for each. Run it before and
+        after a change to spot regressions on any Linux box.
+
+        Usage: torilate_e2e_bench [--filter <substring>] [--scale <factor>]
+                                  [--socks-delay-ms <ms>] [--ttfb-ms <ms>]
+                                  [--bandwidth <bytes_per_sec>]
+                                  [--socket <profile[,opt=val]>]
+
+        --socket sets the client's socket tuning (see net_sockopts_parse),
+        so a profile or a single option can be compared against "os".
+*/
+
+#include "mock_server.h"
+#include "http/http.h"
+#include "http/http_multi.h"
+#include "http/http_proxy.h"
+#include "http/http_stream.h"
+#include "net/socket.h"
+#include "util/util.h"
+
+/* API a scenario drives */
+typedef enum {
+    DRIVE_BLOCKING,     // http_perform, one request at a time
+    DRIVE_MULTI,        // HttpMulti, closed loop at a fixed concurrency
+    DRIVE_STREAM,       // http_stream into a counting sink
+} DriveMode;
+
+typedef struct Scenario {
+    const char *name;
+    DriveMode mode;
+    const char *path;
+    bool follow;
+    int requests;
+    int concurrency;
+    int socks_delay_ms;         // per-scenario injected latency (added to the global one)
+} Scenario;
+
+static const Scenario scenarios[] = {
+    { "small/blocking",     DRIVE_BLOCKING, "/bytes/1024",      false, 300,  1,  0  },
+    { "small/multi",        DRIVE_MULTI,    "/bytes/1024",      false, 2000, 32, 0  },
+    { "chunked/multi",      DRIVE_MULTI,    "/chunked/262144",  false, 300,  16, 0  },
+    { "gzip/multi",         DRIVE_MULTI,    "/gzip/262144",     false, 300,  16, 0  },
+    { "redirect3/multi",    DRIVE_MULTI,    "/redirect/3",      true,  500,  16, 0  },
+    { "slow-circuit/multi", DRIVE_MULTI,    "/bytes/1024",      false, 400,  64, 25 },
+    { "large/stream",       DRIVE_STREAM,   "/bytes/16777216",  false, 8,    1,  0  },
+    { "large-chunked/stream", DRIVE_STREAM, "/chunked/16777216", false, 8,   1,  0  },
+};
+
+/* Results of one scenario */
+typedef struct ScenarioRun {
+    Histogram *latency;
+    uint64_t bytes;
+    uint64_t ok;
+    uint64_t failed;
+    size_t in_flight;
+    Error first_error;
+} ScenarioRun;
+
+/* Per-request state of the multi driver */
+typedef struct MultiSlot {
+    ScenarioRun *run;
+    uint64_t start_ns;
+    uint64_t bytes;
+} MultiSlot;
+
+/* Function Prototypes */
+static Error run_scenario(const Scenario *sc, double scale, ScenarioRun *run);
+static Error drive_blocking(const HttpRequest *req, int requests, ScenarioRun *run);
+static Error drive_multi(const HttpRequest *req, int requests, int concurrency, ScenarioRun *run);
+static Error drive_stream(const HttpRequest *req, int requests, ScenarioRun *run);
+static void multi_on_data(void *userdata, const char *chunk, size_t len);
+static void multi_on_done(void *userdata, Error err, const HttpResponse *response);
+static Error stream_count(void *ctx, const char *data, size_t len);
+static void record_result(ScenarioRun *run, Error err, int status, uint64_t start_ns, uint64_t bytes);
+
+int main(int argc, char *argv[]) {
+    const char *filter = NULL;
+    double scale = 1.0;
+    MockConfig config = {0};
+    MockServer *server = NULL;
+    const char *socket_spec = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--filter") == 0 && has_value) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "--scale") == 0 && has_value) {
+            scale = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--socks-delay-ms") == 0 && has_value) {
+            config.socks_delay_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--ttfb-ms") == 0 && has_value) {
+            config.ttfb_delay_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bandwidth") == 0 && has_value) {
+            config.bandwidth = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--socket") == 0 && has_value) {
+            socket_spec = argv[++i];
+        } else {
+            fprintf(stderr, "usage: %s [--filter <substring>] [--scale <factor>] [--socks-delay-ms <ms>] [--ttfb-ms <ms>] [--bandwidth <bytes_per_sec>] [--socket <profile[,opt=val]>]\n", argv[0]);
+            return ERR_INVALID_ARGS;
+        }
+    }
+
+    NetSockOpts sockopts;
+    Error err = net_sockopts_parse(socket_spec, &sockopts);
+    if (ERR_FAILED(err)) {
+        printf("%s\n", get_err_msg(&err, true));
+        return err.code;
+    }
+
+    net_init();
+    net_set_sockopts(&sockopts);
+    err = mock_start(&config, &server);
+    if (ERR_FAILED(err)) {
+        printf("%s\n", get_err_msg(&err, true));
+        net_cleanup();
+        return err.code;
+    }
+    http_set_proxy("127.0.0.1", mock_proxy_port(server));
+
+    printf("%-22s %8s %7s %10s %10s %10s %10s %10s\n", "scenario", "requests", "failed", "req/s", "MiB/s", "p50 ms", "p99 ms", "max ms");
+
+    int exit_code = SUCCESS;
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        const Scenario *sc = &scenarios[i];
+        if (filter && !strstr(sc->name, filter)) {
+            continue;
+        }
+
+        MockConfig sc_config = config;
+        sc_config.socks_delay_ms += sc->socks_delay_ms;
+        mock_configure(server, &sc_config);
+
+        ScenarioRun run = {0};
+        err = hist_create(&run.latency);
+        if (ERR_FAILED(err)) {
+            exit_code = err.code;
+            break;
+        }
+
+        uint64_t start = ut_now_ns();
+        err = run_scenario(sc, scale, &run);
+        double seconds = (double)(ut_now_ns() - start) / 1e9;
+
+        if (ERR_FAILED(err)) {
+            printf("%-22s %s\n", sc->name, get_err_msg(&err, true));
+            exit_code = err.code;
+        } else {
+            printf("%-22s %8llu %7llu %10.1f %10.2f %10.3f %10.3f %10.3f\n", sc->name,
+                   (unsigned long long)(run.ok + run.failed), (unsigned long long)run.failed,
+                   (double)run.ok / seconds,
+                   (double)run.bytes / (1024.0 * 1024.0) / seconds,
+                   (double)hist_percentile(run.latency, 50.0) / 1e6,
+                   (double)hist_percentile(run.latency, 99.0) / 1e6,
+                   (double)hist_max(run.latency) / 1e6);
+            if (run.failed > 0) {
+                printf("    first failure: %s\n", get_err_msg(&run.first_error, true));
+                exit_code = ERR_HTTP_REQUEST_FAILED;
+            }
+        }
+        fflush(stdout);
+        hist_destroy(run.latency);
+    }
+
+    char sockopts_desc[NET_SOCKOPTS_DESC_MAX];
+    net_sockopts_describe(sockopts_desc, sizeof(sockopts_desc));
+    printf("socket: %s\n", sockopts_desc);
+
+    http_set_proxy(NULL, 0);
+    mock_stop(server);
+    net_cleanup();
+    return exit_code;
+}
+
+/* Internal helper functions */
+
+static Error run_scenario(const Scenario *sc, double scale, ScenarioRun *run) {
+    char uri[256];
+    snprintf(uri, sizeof(uri), "http://origin.bench%s", sc->path);
+
+    int requests = (int)(sc->requests * scale);
+    if (requests < 1) {
+        requests = 1;
+    }
+
+    HttpRequest req = {
+        .method           = HTTP_METHOD_GET,
+        .uri              = uri,
+        .follow_redirects = sc->follow,
+        .max_redirects    = 10,
+    };
+
+    switch (sc->mode) {
+        case DRIVE_BLOCKING: return drive_blocking(&req, requests, run);
+        case DRIVE_MULTI:    return drive_multi(&req, requests, sc->concurrency, run);
+        case DRIVE_STREAM:   return drive_stream(&req, requests, run);
+    }
+    return ERR_NEW(ERR_INVALID_ARGS, "Unknown drive mode");
+}
+
+static Error drive_blocking(const HttpRequest *req, int requests, ScenarioRun *run) {
+    HttpResponse *response = malloc(sizeof(HttpResponse));
+    if (!response) {
+        return ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate response");
+    }
+
+    for (int i = 0; i < requests; i++) {
+        uint64_t start = ut_now_ns();
+        Error err = http_perform(req, response);
+        record_result(run, err, ERR_FAILED(err) ? 0 : (int)response->status_code, start, ERR_FAILED(err) ? 0 : response->bytes_received);
+    }
+
+    free(response);
+    return ERR_OK();
+}
+
+static Error drive_multi(const HttpRequest *req, int requests, int concurrency, ScenarioRun *run) {
+    HttpMulti *multi = NULL;
+    MultiSlot *slots = calloc((size_t)requests, sizeof(MultiSlot));
+    if (!slots) {
+        return ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate %d request slots", requests);
+    }
+
+    Error err = http_multi_create((size_t)concurrency, &multi);
+    if (ERR_FAILED(err)) {
+        free(slots);
+        return err;
+    }
+
+    int issued = 0;
+    while (issued < requests || run->in_flight > 0) {
+        while (issued < requests && run->in_flight < (size_t)concurrency) {
+            MultiSlot *slot = &slots[issued++];
+            slot->run = run;
+            slot->start_ns = ut_now_ns();
+            run->in_flight++;
+            Error add_err = http_multi_add(multi, req, multi_on_data, multi_on_done, slot);
+            if (ERR_FAILED(add_err)) {
+                multi_on_done(slot, add_err, NULL);
+            }
+        }
+
+        size_t running = 0;
+        err = http_multi_poll(multi, 1000, &running);
+        if (ERR_FAILED(err)) {
+            break;
+        }
+    }
+
+    http_multi_destroy(multi);
+    free(slots);
+    return err;
+}
+
+static Error drive_stream(const HttpRequest *req, int requests, ScenarioRun *run) {
+    for (int i = 0; i < requests; i++) {
+        uint64_t bytes = 0;
+        HttpResponse *head = malloc(sizeof(HttpResponse));
+        if (!head) {
+            return ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate response");
+        }
+
+        HttpStreamSink sink = { .write = stream_count, .ctx = &bytes };
+        uint64_t start = ut_now_ns();
+        Error err = http_stream(req, HTTP_STREAM_CONTENT, sink, head);
+        record_result(run, err, ERR_FAILED(err) ? 0 : (int)head->status_code, start, bytes);
+        free(head);
+    }
+    return ERR_OK();
+}
+
+static void multi_on_data(void *userdata, const char *chunk, size_t len) {
+    (void)chunk;
+    MultiSlot *slot = (MultiSlot *)userdata;
+    slot->bytes += len;
+}
+
+static void multi_on_done(void *userdata, Error err, const HttpResponse *response) {
+    MultiSlot *slot = (MultiSlot *)userdata;
+    slot->run->in_flight--;
+    record_result(slot->run, err, response ? (int)response->status_code : 0, slot->start_ns, slot->bytes);
+}
+
+static Error stream_count(void *ctx, const char *data, size_t len) {
+    (void)data;
+    *(uint64_t *)ctx += len;
+    return ERR_OK();
+}
+
+// Anything but a final 200 counts as a failure: the scenarios only produce 200s
+static void record_result(ScenarioRun *run, Error err, int status, uint64_t start_ns, uint64_t bytes) {
+    if (!ERR_FAILED(err) && status != HTTP_OK) {
+        err = ERR_NEW(ERR_BAD_RESPONSE, "Unexpected status %d", status);
+    }
+    if (ERR_FAILED(err)) {
+        if (run->failed == 0) {
+            run->first_error = err;
+        }
+        run->failed++;
+        return;
+    }
+    hist_record(run->latency, ut_now_ns() - start_ns);
+    run->ok++;
+    run->bytes += bytes;
+}
@@ -0,0 +1,306 @@
+/*
+    File: benchmarks/microbench.c
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference:
+        - GNU ld --wrap: https://sourceware.org/binutils/docs/ld/Options.html
+    Description:
+        Microbenchmarks for the parsing hot paths: parse_uri,
+        validate_header, parse_http_response, Location extraction and
+        get_err_msg. Each case runs over a fixed corpus of realistic and
+        adversarial inputs (huge header sections, ~1000 headers, long
+        URLs, binary bodies) and reports ns/op plus allocations and
+        bytes allocated per op. Allocations are counted by wrapping
+        malloc/calloc/realloc at link time (MICROBENCH_COUNT_ALLOCS);
+        without it the columns read "-".
+
+        Usage: torilate_microbench [--filter <substring>] [--time-ms <ms>]
+*/
+
+#include "http/http.h"
+#include "util/util.h"
+#include "error/error.h"
+
+/* Allocation counters (updated by the malloc wrappers) */
+static uint64_t alloc_count;
+static uint64_t alloc_bytes;
+
+#ifdef MICROBENCH_COUNT_ALLOCS
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    alloc_count++;
+    alloc_bytes += size;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    alloc_count++;
+    alloc_bytes += count * size;
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    alloc_count++;
+    alloc_bytes += size;
+    return __real_realloc(ptr, size);
+}
+#endif
+
+/* Inputs shared by the cases (built once, never modified by an op) */
+typedef struct Corpus {
+    HttpResponse small;             // typical small 200
+    HttpResponse huge_header;       // one ~7 KB header value
+    HttpResponse many_headers;      // ~1000 tiny headers
+    HttpResponse binary_body;       // body with NULs and high bytes
+    HttpResponse late_location;     // 302 with Location after ~7 KB of headers
+    char long_url[4200];
+    char long_host_url[320];
+    char long_header[4200];
+    Error err_plain;
+    Error err_chain;
+} Corpus;
+
+typedef struct BenchCase {
+    const char *name;
+    void (*op)(const void *input);
+    const void *input;
+} BenchCase;
+
+static Corpus corpus;
+static volatile size_t sink;        // keeps results observable
+
+/* Function Prototypes */
+static void corpus_build(Corpus *c);
+static void response_set(HttpResponse *r, const char *head, const char *body, size_t body_len);
+static void run_case(const BenchCase *bc, uint64_t budget_ns);
+static void op_parse_uri(const void *input);
+static void op_validate_header(const void *input);
+static void op_parse_formatted(const void *input);
+static void op_parse_raw(const void *input);
+static void op_parse_content(const void *input);
+static void op_find_location(const void *input);
+static void op_apply_redirect(const void *input);
+static void op_err_msg(const void *input);
+static void op_err_msg_verbose(const void *input);
+
+int main(int argc, char *argv[]) {
+    const char *filter = NULL;
+    uint64_t budget_ms = 200;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "--time-ms") == 0 && i + 1 < argc) {
+            budget_ms = strtoull(argv[++i], NULL, 10);
+        } else {
+            fprintf(stderr, "usage: %s [--filter <substring>] [--time-ms <ms>]\n", argv[0]);
+            return ERR_INVALID_ARGS;
+        }
+    }
+
+    corpus_build(&corpus);
+
+    const BenchCase cases[] = {
+        { "parse_uri/short",              op_parse_uri,        "example.com" },
+        { "parse_uri/typical",            op_parse_uri,        "http://www.example.com:8080/a/b/c?x=1&y=2" },
+        { "parse_uri/ipv4",               op_parse_uri,        "http://10.0.0.1/index.html" },
+        { "parse_uri/long_path",          op_parse_uri,        corpus.long_url },
+        { "parse_uri/long_host",          op_parse_uri,        corpus.long_host_url },
+        { "parse_uri/bad_port",           op_parse_uri,        "http://example.com:99999999/" },
+        { "validate_header/typical",      op_validate_header,  "Content-Type: application/json" },
+        { "validate_header/long_value",   op_validate_header,  corpus.long_header },
+        { "validate_header/no_colon",     op_validate_header,  "X-Broken-Header-Without-Separator" },
+        { "validate_header/ctl_in_key",   op_validate_header,  "X-Bad\x01Key: value" },
+        { "parse_response/small",         op_parse_formatted,  &corpus.small },
+        { "parse_response/huge_header",   op_parse_formatted,  &corpus.huge_header },
+        { "parse_response/many_headers",  op_parse_formatted,  &corpus.many_headers },
+        { "parse_response/binary_body",   op_parse_formatted,  &corpus.binary_body },
+        { "parse_response/raw",           op_parse_raw,        &corpus.many_headers },
+        { "parse_response/content_only",  op_parse_content,    &corpus.many_headers },
+        { "location/find_small",          op_find_location,    &corpus.small },
+        { "location/find_late",           op_find_location,    &corpus.late_location },
+        { "location/apply_redirect",      op_apply_redirect,   &corpus.late_location },
+        { "err_msg/plain",                op_err_msg,          &corpus.err_plain },
+        { "err_msg/chain",                op_err_msg,          &corpus.err_chain },
+        { "err_msg/chain_verbose",        op_err_msg_verbose,  &corpus.err_chain },
+    };
+
+    printf("%-32s %12s %12s %12s\n", "case", "ns/op", "allocs/op", "bytes/op");
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        if (filter && !strstr(cases[i].name, filter)) {
+            continue;
+        }
+        run_case(&cases[i], budget_ms * 1000000ULL);
+    }
+    return SUCCESS;
+}
+
+/* Internal helper functions */
+
+static void corpus_build(Corpus *c) {
+    char head[HTTP_MAX_RESPONSE];
+    char body[HTTP_MAX_RESPONSE];
+    size_t n;
+
+    response_set(&c->small, "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nContent-Length: 13\r\n"
+                            "Location: /next\r\n\r\n", "Hello, world!", 13);
+
+    n = (size_t)snprintf(head, sizeof(head), "HTTP/1.1 200 OK\r\nX-Huge: ");
+    memset(head + n, 'v', 7000);
+    n += 7000;
+    snprintf(head + n, sizeof(head) - n, "\r\nContent-Length: 64\r\n\r\n");
+    memset(body, 'b', 64);
+    response_set(&c->huge_header, head, body, 64);
+
+    n = (size_t)snprintf(head, sizeof(head), "HTTP/1.1 200 OK\r\n");
+    for (int i = 0; n + 32 < 8000; i++) {
+        n += (size_t)snprintf(head + n, sizeof(head) - n, "h%03x:1\r\n", i);
+    }
+    snprintf(head + n, sizeof(head) - n, "Content-Length: 4\r\n\r\n");
+    response_set(&c->many_headers, head, "body", 4);
+
+    for (size_t i = 0; i < 6000; i++) {
+        body[i] = (char)((i * 131 + 7) & 0xff); // includes NULs and bytes >= 0x80
+    }
+    response_set(&c->binary_body, "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\nContent-Length: 6000\r\n\r\n", body, 6000);
+
+    n = (size_t)snprintf(head, sizeof(head), "HTTP/1.1 302 Found\r\n");
+    for (int i = 0; n + 96 < 7600; i++) {
+        n += (size_t)snprintf(head + n, sizeof(head) - n, "X-Filler-%04d: some-value\r\n", i);
+    }
+    snprintf(head + n, sizeof(head) - n, "Location: http://other.example.com:8080/landing/page?from=redirect\r\nContent-Length: 0\r\n\r\n");
+    response_set(&c->late_location, head, "", 0);
+
+    n = (size_t)snprintf(c->long_url, sizeof(c->long_url), "http://example.com/");
+    while (n + 8 < sizeof(c->long_url) - 64) {
+        n += (size_t)snprintf(c->long_url + n, sizeof(c->long_url) - n, "segment/");
+    }
+    snprintf(c->long_url + n, sizeof(c->long_url) - n, "?q=1");
+
+    n = (size_t)snprintf(c->long_host_url, sizeof(c->long_host_url), "http://");
+    memset(c->long_host_url + n, 'h', 250);
+    snprintf(c->long_host_url + n + 250, sizeof(c->long_host_url) - n - 250, ".onion/");
+
+    n = (size_t)snprintf(c->long_header, sizeof(c->long_header), "X-Long: ");
+    memset(c->long_header + n, 'x', 4096);
+    c->long_header[n + 4096] = '\0';
+
+    c->err_plain = ERR_NEW(ERR_CONNECTION_FAILED, "Failed to connect to %s:%d", "127.0.0.1", 9050);
+    c->err_chain = c->err_plain;
+    for (int i = 0; i < 8; i++) {
+        c->err_chain = ERR_PROPAGATE(c->err_chain, "context level %d", i);
+    }
+}
+
+static void response_set(HttpResponse *r, const char *head, const char *body, size_t body_len) {
+    size_t head_len = strlen(head);
+    memset(r, 0, sizeof(HttpResponse));
+    memcpy(r->raw, head, head_len);
+    memcpy(r->raw + head_len, body, body_len);
+    r->bytes_received = head_len + body_len;
+    http_parse_status(r->raw, &r->status_code);
+}
+
+// Double the iteration count until the run takes a tenth of the budget, then fill the budget
+static void run_case(const BenchCase *bc, uint64_t budget_ns) {
+    uint64_t iters = 1;
+    uint64_t elapsed = 0;
+
+    for (;;) {
+        uint64_t start = ut_now_ns();
+        for (uint64_t i = 0; i < iters; i++) {
+            bc->op(bc->input);
+        }
+        elapsed = ut_now_ns() - start;
+        if (elapsed >= budget_ns / 10 || iters >= (UINT64_C(1) << 40)) {
+            break;
+        }
+        iters *= 2;
+    }
+    if (elapsed < budget_ns) {
+        iters = (uint64_t)((double)iters * (double)budget_ns / (double)(elapsed ? elapsed : 1));
+    }
+
+    uint64_t allocs_before = alloc_count;
+    uint64_t bytes_before = alloc_bytes;
+    uint64_t start = ut_now_ns();
+    for (uint64_t i = 0; i < iters; i++) {
+        bc->op(bc->input);
+    }
+    elapsed = ut_now_ns() - start;
+
+#ifdef MICROBENCH_COUNT_ALLOCS
+    printf("%-32s %12.1f %12.2f %12.1f\n", bc->name, (double)elapsed / (double)iters,
+           (double)(alloc_count - allocs_before) / (double)iters,
+           (double)(alloc_bytes - bytes_before) / (double)iters);
+#else
+    (void)allocs_before;
+    (void)bytes_before;
+    printf("%-32s %12.1f %12s %12s\n", bc->name, (double)elapsed / (double)iters, "-", "-");
+#endif
+}
+
+static void op_parse_uri(const void *input) {
+    URI uri = {0};
+    Error err = parse_uri((const char *)input, &uri);
+    sink += (size_t)err.code + (size_t)uri.port;
+    cleanup_uri(&uri);
+}
+
+static void op_validate_header(const void *input) {
+    Error err = validate_header((char *)input); // does not modify its input
+    sink += (size_t)err.code;
+}
+
+static void op_parse_formatted(const void *input) {
+    static char out[HTTP_MAX_RESPONSE];
+    size_t len = 0;
+    HttpResponse *r = (HttpResponse *)input; // parse_http_response only reads it
+    Error err = parse_http_response(r, out, sizeof(out), &len, false, false);
+    sink += len + (size_t)err.code;
+}
+
+static void op_parse_raw(const void *input) {
+    static char out[HTTP_MAX_RESPONSE];
+    size_t len = 0;
+    Error err = parse_http_response((HttpResponse *)input, out, sizeof(out), &len, true, false);
+    sink += len + (size_t)err.code;
+}
+
+static void op_parse_content(const void *input) {
+    static char out[HTTP_MAX_RESPONSE];
+    size_t len = 0;
+    Error err = parse_http_response((HttpResponse *)input, out, sizeof(out), &len, false, true);
+    sink += len + (size_t)err.code;
+}
+
+static void op_find_location(const void *input) {
+    const HttpResponse *r = (const HttpResponse *)input;
+    const char *value = NULL;
+    size_t len = 0;
+    sink += http_find_header(r->raw, "Location", &value, &len) ? len : 0;
+}
+
+// What a redirect hop costs: parse the current URI, then resolve Location against it
+static void op_apply_redirect(const void *input) {
+    URI uri = {0};
+    Error err = parse_uri("http://example.com/start/here", &uri);
+    if (!ERR_FAILED(err)) {
+        err = http_apply_redirect((const HttpResponse *)input, &uri);
+    }
+    sink += (size_t)err.code + (size_t)uri.port;
+    cleanup_uri(&uri);
+}
+
+static void op_err_msg(const void *input) {
+    Error err = *(const Error *)input;
+    sink += strlen(get_err_msg(&err, false));
+}
+
+static void op_err_msg_verbose(const void *input) {
+    Error err = *(const Error *)input;
+    sink += strlen(get_err_msg(&err, true));
+}
@@ -0,0 +1,594 @@
+/*
+    File: benchmarks/mock_server.c
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference:
+        - SOCKS4a: https://www.openssh.com/txt/socks4a.protocol
+        - SOCKS5 (RFC 1928): https://datatracker.ietf.org/doc/html/rfc1928
+        - DEFLATE stored blocks (RFC 1951, 3.2.4): https://datatracker.ietf.org/doc/html/rfc1951
+        - GZIP file format (RFC 1952): https://datatracker.ietf.org/doc/html/rfc1952
+    Description:
+        Implementation of the mock SOCKS proxy and HTTP origin.
+        Each side has an accept thread; every connection gets its own
+        detached thread, which keeps the server simple and lets slow
+        (delayed or throttled) connections overlap like real ones.
+        Bodies are generated on the fly, so large responses cost no
+        memory; gzip bodies use stored DEFLATE blocks, which are valid
+        without a compression library.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <poll.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "mock_server.h"
+#include "util/util.h"
+
+/* Size of generated body blocks */
+#define MOCK_BLOCK 65535
+
+typedef struct MockListener {
+    MockServer *server;
+    int fd;
+    void *(*handler)(void *);
+    pthread_t thread;
+} MockListener;
+
+struct MockServer {
+    MockListener proxy;
+    MockListener origin;
+    int proxy_port;
+    int origin_port;
+    pthread_mutex_t lock;       // guards config
+    MockConfig config;
+    atomic_bool stopping;
+    atomic_int connections;     // connection threads still running
+};
+
+/* One accepted connection */
+typedef struct MockConn {
+    MockServer *server;
+    int fd;
+    MockConfig config;          // snapshot taken at accept time
+    uint64_t send_start_ns;     // bandwidth accounting
+    uint64_t sent;
+} MockConn;
+
+/* CRC-32 (gzip trailer) lookup table */
+static uint32_t crc_table[256];
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+/* Function Prototypes */
+static Error mock_listen(MockServer *server, MockListener *listener, void *(*handler)(void *), int *port);
+static void *mock_accept_loop(void *arg);
+static void *mock_proxy_conn(void *arg);
+static void *mock_origin_conn(void *arg);
+static bool mock_read_full(int fd, void *buf, size_t len);
+static bool mock_read_string(int fd, char *out, size_t cap);
+static bool mock_write_full(int fd, const void *buf, size_t len);
+static bool mock_send(MockConn *conn, const void *buf, size_t len);
+static void mock_relay(int client, int origin);
+static bool mock_send_body(MockConn *conn, uint64_t size, bool chunked);
+static bool mock_send_gzip(MockConn *conn, uint64_t size);
+static void mock_fill(char *buf, size_t len, uint64_t offset);
+static void mock_crc32_init(void);
+static uint32_t mock_crc32(uint32_t crc, const unsigned char *data, size_t len);
+
+Error mock_start(const MockConfig *config, MockServer **out) {
+    MockServer *server = calloc(1, sizeof(MockServer));
+    if (!server) {
+        return ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate mock server");
+    }
+    server->config = *config;
+    server->proxy.fd = -1;
+    server->origin.fd = -1;
+    pthread_mutex_init(&server->lock, NULL);
+    atomic_init(&server->stopping, false);
+    atomic_init(&server->connections, 0);
+
+    Error err = mock_listen(server, &server->origin, mock_origin_conn, &server->origin_port);
+    if (ERR_FAILED(err)) {
+        pthread_mutex_destroy(&server->lock);
+        free(server);
+        return err;
+    }
+    err = mock_listen(server, &server->proxy, mock_proxy_conn, &server->proxy_port);
+    if (ERR_FAILED(err)) {
+        mock_stop(server);
+        return err;
+    }
+
+    *out = server;
+    return ERR_OK();
+}
+
+void mock_configure(MockServer *server, const MockConfig *config) {
+    pthread_mutex_lock(&server->lock);
+    server->config = *config;
+    pthread_mutex_unlock(&server->lock);
+}
+
+int mock_proxy_port(const MockServer *server) {
+    return server->proxy_port;
+}
+
+void mock_stop(MockServer *server) {
+    if (!server) {
+        return;
+    }
+    atomic_store(&server->stopping, true);
+
+    MockListener *listeners[] = { &server->proxy, &server->origin };
+    for (int i = 0; i < 2; i++) {
+        if (listeners[i]->fd >= 0) {
+            shutdown(listeners[i]->fd, SHUT_RDWR); // wakes accept()
+            pthread_join(listeners[i]->thread, NULL);
+            close(listeners[i]->fd);
+        }
+    }
+
+    while (atomic_load(&server->connections) > 0) {
+        ut_sleep_ns(1000000);
+    }
+    pthread_mutex_destroy(&server->lock);
+    free(server);
+}
+
+/* Internal helper functions */
+
+static Error mock_listen(MockServer *server, MockListener *listener, void *(*handler)(void *), int *port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return ERR_NEW(ERR_SOCKET_CREATION_FAILED, "Mock server: socket() failed with error %d", errno);
+    }
+
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    socklen_t addr_len = sizeof(addr);
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(fd, 512) != 0 ||
+        getsockname(fd, (struct sockaddr *)&addr, &addr_len) != 0) {
+        int e = errno;
+        close(fd);
+        return ERR_NEW(ERR_CONNECTION_FAILED, "Mock server: cannot listen on loopback (error %d)", e);
+    }
+
+    listener->server  = server;
+    listener->fd      = fd;
+    listener->handler = handler;
+    if (pthread_create(&listener->thread, NULL, mock_accept_loop, listener) != 0) {
+        close(fd);
+        listener->fd = -1;
+        return ERR_NEW(ERR_IO, "Mock server: failed to start accept thread");
+    }
+
+    *port = ntohs(addr.sin_port);
+    return ERR_OK();
+}
+
+static void *mock_accept_loop(void *arg) {
+    MockListener *listener = (MockListener *)arg;
+    MockServer *server = listener->server;
+
+    for (;;) {
+        int fd = accept(listener->fd, NULL, NULL);
+        if (fd < 0) {
+            if (atomic_load(&server->stopping)) {
+                break;
+            }
+            if (errno == EINTR || errno == ECONNABORTED || errno == EMFILE || errno == ENFILE) {
+                continue;
+            }
+            break;
+        }
+
+        MockConn *conn = calloc(1, sizeof(MockConn));
+        if (!conn) {
+            close(fd);
+            continue;
+        }
+        conn->server = server;
+        conn->fd = fd;
+        pthread_mutex_lock(&server->lock);
+        conn->config = server->config;
+        pthread_mutex_unlock(&server->lock);
+
+        pthread_attr_t attr;
+        pthread_t thread;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        atomic_fetch_add(&server->connections, 1);
+        if (pthread_create(&thread, &attr, listener->handler, conn) != 0) {
+            atomic_fetch_sub(&server->connections, 1);
+            close(fd);
+            free(conn);
+        }
+        pthread_attr_destroy(&attr);
+    }
+    return NULL;
+}
+
+// SOCKS4/4a or SOCKS5 handshake, then relay to the origin
+static void *mock_proxy_conn(void *arg) {
+    MockConn *conn = (MockConn *)arg;
+    MockServer *server = conn->server;
+    int origin = -1;
+    char host[256] = "";
+    unsigned char version = 0;
+
+    if (!mock_read_full(conn->fd, &version, 1)) {
+        goto exit_proxy;
+    }
+
+    if (version == 4) {
+        // CD, DSTPORT, DSTIP, USERID\0 [, HOST\0 when DSTIP is 0.0.0.x]
+        unsigned char head[7];
+        char userid[256];
+        if (!mock_read_full(conn->fd, head, sizeof(head)) || !mock_read_string(conn->fd, userid, sizeof(userid))) {
+            goto exit_proxy;
+        }
+        if (head[3] == 0 && head[4] == 0 && head[5] == 0 && head[6] != 0) {
+            if (!mock_read_string(conn->fd, host, sizeof(host))) {
+                goto exit_proxy;
+            }
+        }
+    } else if (version == 5) {
+        unsigned char n = 0;
+        unsigned char methods[255];
+        unsigned char request[4];
+        if (!mock_read_full(conn->fd, &n, 1) || !mock_read_full(conn->fd, methods, n) ||
+            !mock_write_full(conn->fd, "\x05\x00", 2) ||
+            !mock_read_full(conn->fd, request, sizeof(request))) {
+            goto exit_proxy;
+        }
+
+        unsigned char addr[256];
+        size_t addr_len = request[3] == 0x01 ? 4 : request[3] == 0x04 ? 16 : 0;
+        if (request[3] == 0x03) {
+            unsigned char len = 0;
+            if (!mock_read_full(conn->fd, &len, 1) || !mock_read_full(conn->fd, host, len)) {
+                goto exit_proxy;
+            }
+            host[len] = '\0';
+        } else if (addr_len == 0 || !mock_read_full(conn->fd, addr, addr_len)) {
+            goto exit_proxy;
+        }
+        unsigned char port[2];
+        if (!mock_read_full(conn->fd, port, sizeof(port))) {
+            goto exit_proxy;
+        }
+    } else {
+        goto exit_proxy;
+    }
+
+    if (conn->config.socks_delay_ms > 0) {
+        ut_sleep_ns((uint64_t)conn->config.socks_delay_ms * 1000000ULL);
+    }
+
+    bool granted = strncmp(host, "reject", 6) != 0;
+    if (granted) {
+        struct sockaddr_in addr = {0};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons((uint16_t)server->origin_port);
+        origin = socket(AF_INET, SOCK_STREAM, 0);
+        granted = origin >= 0 && connect(origin, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+    }
+
+    if (version == 4) {
+        unsigned char reply[8] = { 0x00, granted ? 0x5A : 0x5B, 0, 0, 0, 0, 0, 0 };
+        if (!mock_write_full(conn->fd, reply, sizeof(reply))) {
+            goto exit_proxy;
+        }
+    } else {
+        unsigned char reply[10] = { 0x05, granted ? 0x00 : 0x05, 0x00, 0x01, 0, 0, 0, 0, 0, 0 };
+        if (!mock_write_full(conn->fd, reply, sizeof(reply))) {
+            goto exit_proxy;
+        }
+    }
+
+    if (granted) {
+        mock_relay(conn->fd, origin);
+    }
+
+exit_proxy:
+    if (origin >= 0) {
+        close(origin);
+    }
+    close(conn->fd);
+    free(conn);
+    atomic_fetch_sub(&server->connections, 1);
+    return NULL;
+}
+
+// Read one request and answer it according to its path
+static void *mock_origin_conn(void *arg) {
+    MockConn *conn = (MockConn *)arg;
+    MockServer *server = conn->server;
+    char request[8192];
+    size_t len = 0;
+    char *header_end = NULL;
+
+    while (!header_end && len < sizeof(request) - 1) {
+        ssize_t n = recv(conn->fd, request + len, sizeof(request) - 1 - len, 0);
+        if (n <= 0) {
+            goto exit_origin;
+        }
+        len += (size_t)n;
+        request[len] = '\0';
+        header_end = strstr(request, "\r\n\r\n");
+    }
+    if (!header_end) {
+        goto exit_origin;
+    }
+
+    // Drain a request body so the client never sees a reset
+    const char *cl = strstr(request, "Content-Length:");
+    if (cl && cl < header_end) {
+        size_t body_len = strtoul(cl + 15, NULL, 10);
+        size_t have = len - (size_t)(header_end + 4 - request);
+        char sink[4096];
+        while (have < body_len) {
+            ssize_t n = recv(conn->fd, sink, sizeof(sink), 0);
+            if (n <= 0) {
+                break;
+            }
+            have += (size_t)n;
+        }
+    }
+
+    char path[1024] = "/";
+    sscanf(request, "%*s %1023s", path);
+
+    if (conn->config.ttfb_delay_ms > 0) {
+        ut_sleep_ns((uint64_t)conn->config.ttfb_delay_ms * 1000000ULL);
+    }
+
+    char head[512];
+    unsigned long long n = 0;
+    if (sscanf(path, "/bytes/%llu", &n) == 1) {
+        int head_len = snprintf(head, sizeof(head), "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\nContent-Length: %llu\r\nConnection: close\r\n\r\n", n);
+        if (mock_send(conn, head, (size_t)head_len)) {
+            mock_send_body(conn, n, false);
+        }
+    } else if (sscanf(path, "/chunked/%llu", &n) == 1) {
+        int head_len = snprintf(head, sizeof(head), "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\nTransfer-Encoding: chunked\r\nConnection: close\r\n\r\n");
+        if (mock_send(conn, head, (size_t)head_len)) {
+            mock_send_body(conn, n, true);
+        }
+    } else if (sscanf(path, "/gzip/%llu", &n) == 1) {
+        uint64_t blocks = n == 0 ? 1 : (n + MOCK_BLOCK - 1) / MOCK_BLOCK;
+        uint64_t size = 10 + blocks * 5 + n + 8;
+        int head_len = snprintf(head, sizeof(head), "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\nContent-Encoding: gzip\r\nContent-Length: %llu\r\nConnection: close\r\n\r\n", (unsigned long long)size);
+        if (mock_send(conn, head, (size_t)head_len)) {
+            mock_send_gzip(conn, n);
+        }
+    } else if (sscanf(path, "/redirect/%llu", &n) == 1) {
+        char location[64];
+        if (n > 1) {
+            snprintf(location, sizeof(location), "/redirect/%llu", n - 1);
+        } else {
+            snprintf(location, sizeof(location), "/bytes/64");
+        }
+        int head_len = snprintf(head, sizeof(head), "HTTP/1.1 302 Found\r\nLocation: %s\r\nContent-Length: 0\r\nConnection: close\r\n\r\n", location);
+        mock_send(conn, head, (size_t)head_len);
+    } else {
+        int head_len = snprintf(head, sizeof(head), "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        mock_send(conn, head, (size_t)head_len);
+    }
+
+exit_origin:
+    close(conn->fd);
+    free(conn);
+    atomic_fetch_sub(&server->connections, 1);
+    return NULL;
+}
+
+static bool mock_read_full(int fd, void *buf, size_t len) {
+    char *p = (char *)buf;
+    while (len > 0) {
+        ssize_t n = recv(fd, p, len, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static bool mock_read_string(int fd, char *out, size_t cap) {
+    for (size_t i = 0; i < cap; i++) {
+        if (!mock_read_full(fd, &out[i], 1)) {
+            return false;
+        }
+        if (out[i] == '\0') {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool mock_write_full(int fd, const void *buf, size_t len) {
+    const char *p = (const char *)buf;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+// Send with the configured bandwidth limit: slices of ~10 ms worth of data
+static bool mock_send(MockConn *conn, const void *buf, size_t len) {
+    uint64_t rate = conn->config.bandwidth;
+    if (rate == 0) {
+        return mock_write_full(conn->fd, buf, len);
+    }
+
+    if (conn->send_start_ns == 0) {
+        conn->send_start_ns = ut_now_ns();
+    }
+    size_t slice = rate / 100 > 1024 ? (size_t)(rate / 100) : 1024;
+    const char *p = (const char *)buf;
+
+    while (len > 0) {
+        size_t n = len < slice ? len : slice;
+        if (!mock_write_full(conn->fd, p, n)) {
+            return false;
+        }
+        conn->sent += n;
+        p += n;
+        len -= n;
+
+        uint64_t due = conn->send_start_ns + conn->sent * 1000000000ULL / rate;
+        uint64_t now = ut_now_ns();
+        if (due > now) {
+            ut_sleep_ns(due - now);
+        }
+    }
+    return true;
+}
+
+// Pump both directions until the origin closes
+static void mock_relay(int client, int origin) {
+    char buf[65536];
+    struct pollfd fds[2] = {
+        { .fd = client, .events = POLLIN },
+        { .fd = origin, .events = POLLIN },
+    };
+
+    for (;;) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        for (int i = 0; i < 2; i++) {
+            if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+                continue;
+            }
+            ssize_t n = recv(fds[i].fd, buf, sizeof(buf), 0);
+            if (n <= 0) {
+                if (i == 1) {
+                    return; // origin finished the response
+                }
+                shutdown(origin, SHUT_WR); // client done sending
+                fds[0].fd = -1;
+                continue;
+            }
+            if (!mock_write_full(i == 0 ? origin : client, buf, (size_t)n)) {
+                return;
+            }
+        }
+    }
+}
+
+static bool mock_send_body(MockConn *conn, uint64_t size, bool chunked) {
+    char block[MOCK_BLOCK + 32];
+    uint64_t offset = 0;
+
+    while (offset < size) {
+        size_t n = size - offset < MOCK_BLOCK ? (size_t)(size - offset) : MOCK_BLOCK;
+        if (chunked) {
+            // Small chunks so chunk framing is exercised, not just the happy path
+            n = n < 16384 ? n : 16384;
+            int prefix = snprintf(block, 16, "%zx\r\n", n);
+            mock_fill(block + prefix, n, offset);
+            memcpy(block + prefix + n, "\r\n", 2);
+            if (!mock_send(conn, block, (size_t)prefix + n + 2)) {
+                return false;
+            }
+        } else {
+            mock_fill(block, n, offset);
+            if (!mock_send(conn, block, n)) {
+                return false;
+            }
+        }
+        offset += n;
+    }
+    return chunked ? mock_send(conn, "0\r\n\r\n", 5) : true;
+}
+
+// gzip member made of stored DEFLATE blocks
+static bool mock_send_gzip(MockConn *conn, uint64_t size) {
+    static const unsigned char header[10] = { 0x1f, 0x8b, 0x08, 0, 0, 0, 0, 0, 0, 0xff };
+    char block[MOCK_BLOCK + 5];
+    uint32_t crc = 0;
+    uint64_t offset = 0;
+
+    if (!mock_send(conn, header, sizeof(header))) {
+        return false;
+    }
+    do {
+        size_t n = size - offset < MOCK_BLOCK ? (size_t)(size - offset) : MOCK_BLOCK;
+        bool last = offset + n == size;
+        block[0] = last ? 0x01 : 0x00;
+        block[1] = (char)(n & 0xff);
+        block[2] = (char)(n >> 8);
+        block[3] = (char)(~n & 0xff);
+        block[4] = (char)((~n >> 8) & 0xff);
+        mock_fill(block + 5, n, offset);
+        crc = mock_crc32(crc, (const unsigned char *)block + 5, n);
+        if (!mock_send(conn, block, n + 5)) {
+            return false;
+        }
+        offset += n;
+    } while (offset < size);
+
+    unsigned char trailer[8];
+    for (int i = 0; i < 4; i++) {
+        trailer[i] = (unsigned char)(crc >> (8 * i));
+        trailer[4 + i] = (unsigned char)((uint32_t)size >> (8 * i));
+    }
+    return mock_send(conn, trailer, sizeof(trailer));
+}
+
+// Deterministic body content: byte i of the body depends only on i
+static void mock_fill(char *buf, size_t len, uint64_t offset) {
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = (char)('a' + (offset + i) % 26);
+    }
+}
+
+static void mock_crc32_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        crc_table[i] = c;
+    }
+}
+
+static uint32_t mock_crc32(uint32_t crc, const unsigned char *data, size_t len) {
+    pthread_once(&crc_once, mock_crc32_init);
+
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc = crc_table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
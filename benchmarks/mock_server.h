@@ -0,0 +1,61 @@
+/*
+    File: benchmarks/mock_server.h
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference:
+        - SOCKS4a: https://www.openssh.com/txt/socks4a.protocol
+        - SOCKS5 (RFC 1928): https://datatracker.ietf.org/doc/html/rfc1928
+        - GZIP file format (RFC 1952): https://datatracker.ietf.org/doc/html/rfc1952
+    Description:
+        In-process stand-ins for the Tor SOCKS port and an HTTP origin,
+        used by the benchmark harness so the real client can be driven
+        end to end without a network.
+
+        The proxy accepts SOCKS4/4a and SOCKS5 (no authentication)
+        CONNECT requests, optionally waits to simulate circuit build
+        time, then relays the stream to the origin whatever the
+        requested host (hosts starting with "reject" are refused).
+
+        The origin serves, with an optional first-byte delay and send
+        bandwidth limit:
+            /bytes/N      N byte body with Content-Length
+            /chunked/N    N byte body, chunked transfer coding
+            /gzip/N       N byte body, Content-Encoding: gzip
+            /redirect/N   302 chain of N hops ending at /bytes/64
+*/
+
+#ifndef TORILATE_MOCK_SERVER_H
+#define TORILATE_MOCK_SERVER_H
+
+#include <stdint.h>
+#include "error/error.h"
+
+typedef struct MockConfig {
+    int socks_delay_ms;     // wait before the SOCKS reply (circuit build time)
+    int ttfb_delay_ms;      // origin wait before the response
+    uint64_t bandwidth;     // origin send rate in bytes/s (0 = unlimited)
+} MockConfig;
+
+typedef struct MockServer MockServer;
+
+
+/*
+ * Start the proxy and origin on ephemeral loopback ports.
+ *
+ *  @param config  injected latency and throttling (copied)
+ *  @param out     receives the running server
+ *
+ *  @return ERR_OK on success and an Error struct on failure
+ */
+Error mock_start(const MockConfig *config, MockServer **out);
+
+/* Replace the configuration; applies to connections accepted afterwards */
+void mock_configure(MockServer *server, const MockConfig *config);
+
+/* Loopback port of the SOCKS proxy */
+int mock_proxy_port(const MockServer *server);
+
+/* Stop accepting, wait for open connections to finish and free the server */
+void mock_stop(MockServer *server);
+
+#endif
@@ -0,0 +1,315 @@
+/*
+    File: src/batch/batch.c
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference: None
+    Description:
+        Implementation of the batch fetch mode. All requests are queued
+        on a single HttpMulti handle and driven from this thread; finished
+        responses are handed to a work-stealing thread pool for parsing
+        and output so the I/O loop never waits on CPU or disk.
+*/
+
+#include <stdatomic.h>
+#include "batch/batch.h"
+#include "http/http_multi.h"
+#include "http/http_dns.h"
+#include "util/util.h"
+
+/* Per-URL state shared with the multi callbacks */
+typedef struct BatchItem {
+    size_t index;
+    const char *url;
+    uint64_t body_bytes;
+    struct BatchContext *ctx;
+} BatchItem;
+
+typedef struct BatchContext {
+    const CliArgsInfo *args;
+    ThreadPool *pool;
+    atomic_size_t failed;
+} BatchContext;
+
+/* Completed response queued for post-processing on the pool */
+typedef struct BatchJob {
+    BatchItem *item;
+    HttpResponse response;
+} BatchJob;
+
+/* Function Prototypes */
+static size_t split_urls(char *text, char ***out);
+static Error batch_prefetch(char **urls, size_t count);
+static void print_dns_stats(void);
+static void batch_on_data(void *userdata, const char *chunk, size_t len);
+static void batch_on_done(void *userdata, Error err, const HttpResponse *response);
+static void batch_process(void *arg);
+static void batch_report_failure(BatchItem *item, Error err);
+
+Error batch_run(const CliArgsInfo *args) {
+    Error err = ERR_OK();
+    char *text = NULL;
+    char **urls = NULL;
+    BatchItem *items = NULL;
+    HttpMulti *multi = NULL;
+    CircuitPool *circuits = NULL;
+    BatchContext ctx = { .args = args, .pool = NULL };
+    const char *url_file = args->options[OPTION_URL_FILE];
+
+    err = read_from(url_file, &text, NULL);
+    if (ERR_FAILED(err)) {
+        err = ERR_PROPAGATE(err, "Failed to read URL list %s", url_file);
+        goto exit_batch;
+    }
+
+    size_t count = split_urls(text, &urls);
+    if (count == 0) {
+        err = ERR_NEW(ERR_INVALID_ARGS, "No URLs found in %s", url_file);
+        goto exit_batch;
+    }
+
+    items = ut_calloc(MEM_TAG_BATCH, count, sizeof(BatchItem));
+    if (!items) {
+        err = ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate %zu batch items", count);
+        goto exit_batch;
+    }
+
+    atomic_init(&ctx.failed, 0);
+    err = pool_create((size_t)args->values[VAL_WORKERS], &ctx.pool);
+    if (ERR_FAILED(err)) {
+        err = ERR_PROPAGATE(err, "Failed to start post-processing workers");
+        goto exit_batch;
+    }
+
+    err = http_multi_create((size_t)args->values[VAL_CONCURRENCY], &multi);
+    if (ERR_FAILED(err)) {
+        goto exit_batch;
+    }
+    if (args->flags[FLAG_ADAPTIVE]) {
+        err = http_multi_set_adaptive(multi, LIMITER_DEFAULT_INITIAL);
+        if (ERR_FAILED(err)) {
+            goto exit_batch;
+        }
+    }
+    http_multi_set_host_limit(multi, (size_t)args->values[VAL_PER_HOST]);
+    http_multi_set_hedging(multi, args->values[VAL_HEDGE]);
+    if (args->values[VAL_CIRCUITS] > 0) {
+        const char *probe = args->options[OPTION_PROBE_URL] ? args->options[OPTION_PROBE_URL] : urls[0];
+        err = circuit_pool_create((size_t)args->values[VAL_CIRCUITS], probe, &circuits);
+        if (ERR_FAILED(err)) {
+            goto exit_batch;
+        }
+        if (args->options[OPTION_CONTROL]) {
+            err = circuit_pool_control(circuits, args->options[OPTION_CONTROL], getenv("TORILATE_CONTROL_PASSWORD"));
+            if (ERR_FAILED(err)) {
+                goto exit_batch;
+            }
+        }
+        http_multi_set_circuits(multi, circuits);
+    }
+    if (args->values[VAL_DNS_TTL] > 0) {
+        err = http_dns_open((uint32_t)args->values[VAL_DNS_TTL], args->values[VAL_CONNECT_TIMEOUT]);
+        if (ERR_FAILED(err)) {
+            goto exit_batch;
+        }
+        err = batch_prefetch(urls, count);
+        if (ERR_FAILED(err)) {
+            goto exit_batch;
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        items[i].index = i;
+        items[i].url   = urls[i];
+        items[i].ctx   = &ctx;
+
+        HttpRequest req = {
+            .method           = HTTP_METHOD_GET,
+            .uri              = urls[i],
+            .headers          = args->multi_options[MULTI_OPTION_HEADERS].values,
+            .headers_count    = args->multi_options[MULTI_OPTION_HEADERS].count,
+            .follow_redirects = args->flags[FLAG_FOLLOW],
+            .max_redirects    = args->values[VAL_MAX_REDIRECTS],
+            .max_retries      = args->values[VAL_RETRIES],
+            .timeouts         = get_timeouts(args),
+        };
+
+        Error add_err = http_multi_add(multi, &req, batch_on_data, batch_on_done, &items[i]);
+        if (ERR_FAILED(add_err)) {
+            batch_on_done(&items[i], add_err, NULL);
+        }
+    }
+
+    size_t running = 0;
+    do {
+        err = http_multi_poll(multi, 1000, &running);
+        if (ERR_FAILED(err)) {
+            err = ERR_PROPAGATE(err, "Batch transfer loop failed");
+            goto exit_batch;
+        }
+    } while (running > 0);
+    pool_wait(ctx.pool);
+
+    size_t failed = atomic_load(&ctx.failed);
+    if (args->flags[FLAG_VERBOSE]) {
+        printf("\n%s: Batch completed: %zu succeeded, %zu failed (%zu workers)\n", PROG_NAME, count - failed, failed, pool_worker_count(ctx.pool));
+        http_multi_print_stats(multi);
+        if (circuits) {
+            print_circuit_stats(circuits);
+        }
+        if (http_dns_enabled()) {
+            print_dns_stats();
+        }
+    }
+
+    if (failed > 0) {
+        err = ERR_NEW(ERR_HTTP_REQUEST_FAILED, "%zu of %zu batch requests failed", failed, count);
+    }
+
+exit_batch:
+    http_dns_close();
+    http_multi_destroy(multi);
+    circuit_pool_destroy(circuits);
+    pool_destroy(ctx.pool);
+    ut_free(items);
+    ut_free(urls);
+    ut_free(text);
+
+    return err;
+}
+
+/* Internal helper functions */
+
+// Split text into trimmed, non-empty lines; lines starting with '#' are comments
+static size_t split_urls(char *text, char ***out) {
+    size_t cap = 0;
+    size_t count = 0;
+    char **urls = NULL;
+    char *line = text;
+
+    while (line && *line) {
+        char *next = strchr(line, '\n');
+        if (next) {
+            *next++ = '\0';
+        }
+
+        while (*line && isspace((unsigned char)*line)) line++;
+        char *end = line + strlen(line);
+        while (end > line && isspace((unsigned char)end[-1])) end--;
+        *end = '\0';
+
+        if (*line && *line != '#') {
+            if (count == cap) {
+                cap = cap ? cap * 2 : 64;
+                char **grown = ut_realloc(MEM_TAG_BATCH, urls, cap * sizeof(char *));
+                if (!grown) {
+                    break;
+                }
+                urls = grown;
+            }
+            urls[count++] = line;
+        }
+        line = next;
+    }
+
+    *out = urls;
+    return count;
+}
+
+// Queue the hostname of every URL for resolution; they resolve while the first requests go out by name
+static Error batch_prefetch(char **urls, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        URI uri = {0};
+        if (ERR_FAILED(parse_uri(urls[i], &uri))) {
+            continue;   // reported when the request is added
+        }
+        Error err = uri.addr_type == DOMAIN ? http_dns_prefetch(uri.host) : ERR_OK();
+        cleanup_uri(&uri);
+        if (ERR_FAILED(err)) {
+            return err;
+        }
+    }
+    return ERR_OK();
+}
+
+static void print_dns_stats(void) {
+    HttpDnsStats s;
+    http_dns_stats(&s);
+    printf("%s: DNS cache: %llu resolved, %llu failed, %llu unsafe; %llu connects by address, %llu by name, %llu addresses dropped\n", PROG_NAME,
+           (unsigned long long)s.resolved, (unsigned long long)s.failed, (unsigned long long)s.unsafe,
+           (unsigned long long)s.hits, (unsigned long long)s.misses, (unsigned long long)s.dropped);
+}
+
+static void batch_on_data(void *userdata, const char *chunk, size_t len) {
+    (void)chunk;
+    BatchItem *item = (BatchItem *)userdata;
+    item->body_bytes += len;
+}
+
+static void batch_on_done(void *userdata, Error err, const HttpResponse *response) {
+    BatchItem *item = (BatchItem *)userdata;
+    BatchContext *ctx = item->ctx;
+
+    if (ERR_FAILED(err)) {
+        batch_report_failure(item, ERR_PROPAGATE(err, "HTTP GET request to URL '%s' failed", item->url));
+        return;
+    }
+
+    // The response is only valid during the callback; the job takes a copy
+    BatchJob *job = ut_malloc(MEM_TAG_BATCH, sizeof(BatchJob));
+    if (!job) {
+        batch_report_failure(item, ERR_NEW(ERR_OUTOFMEMORY, "Failed to queue response of '%s'", item->url));
+        return;
+    }
+    job->item = item;
+    memcpy(&job->response, response, sizeof(HttpResponse));
+
+    err = pool_submit(ctx->pool, batch_process, job);
+    if (ERR_FAILED(err)) {
+        ut_free(job);
+        batch_report_failure(item, ERR_PROPAGATE(err, "Failed to queue response of '%s'", item->url));
+    }
+}
+
+// Runs on a pool worker: parse and store one response
+static void batch_process(void *arg) {
+    BatchJob *job = (BatchJob *)arg;
+    BatchItem *item = job->item;
+    const CliArgsInfo *args = item->ctx->args;
+    Error err = ERR_OK();
+
+    const char *output_dir = args->options[OPTION_OUTPUT_DIR];
+    if (output_dir) {
+        size_t resp_size = 0;
+        char parsed_response[HTTP_MAX_RESPONSE] = {0};
+
+        err = parse_http_response(&job->response, parsed_response, sizeof(parsed_response), &resp_size, args->flags[FLAG_RAW], args->flags[FLAG_CONTENT_ONLY]);
+        if (ERR_FAILED(err)) {
+            batch_report_failure(item, ERR_PROPAGATE(err, "Failed to parse HTTP response from '%s'", item->url));
+            goto exit_process;
+        }
+
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/%zu.out", output_dir, item->index);
+        err = write_to(path, parsed_response, resp_size);
+        if (ERR_FAILED(err)) {
+            batch_report_failure(item, ERR_PROPAGATE(err, "Failed to write response to file %s", path));
+            goto exit_process;
+        }
+    }
+
+    printf("%3d  %10llu  %s\n", job->response.status_code, (unsigned long long)item->body_bytes, item->url);
+    if (args->options[OPTION_WRITE_OUT]) {
+        char out[4096];
+        WriteOutInfo info = { .url = item->url, .response = &job->response, .size_download = item->body_bytes };
+        size_t len = format_write_out(args->options[OPTION_WRITE_OUT], &info, out, sizeof(out));
+        fwrite(out, 1, len, stdout);
+    }
+
+exit_process:
+    ut_free(job);
+}
+
+static void batch_report_failure(BatchItem *item, Error err) {
+    atomic_fetch_add(&item->ctx->failed, 1);
+    printf("ERR  %10s  %s\n     %s\n", "-", item->url, get_err_msg(&err, item->ctx->args->flags[FLAG_VERBOSE]));
+}
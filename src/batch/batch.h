@@ -0,0 +1,28 @@
+/*
+    File: src/batch/batch.h
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference: None
+    Description:
+        Batch fetch mode for Torilate.
+        Reads a list of URLs and fetches them concurrently through the
+        non-blocking multi-request HTTP client.
+*/
+
+#ifndef TORILATE_BATCH_H
+#define TORILATE_BATCH_H
+
+#include "cli/cli.h"
+#include "error/error.h"
+
+/*
+ * Run the 'batch' command.
+ *
+ *  @param args  parsed command-line arguments (cmd == CMD_BATCH)
+ *
+ *  @return ERR_OK if every request succeeded, ERR_HTTP_REQUEST_FAILED if
+ *          any request failed, or the error that prevented the batch from running
+ */
+Error batch_run(const CliArgsInfo *args);
+
+#endif
@@ -0,0 +1,437 @@
+/*
+    File: src/bench/bench.c
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference:
+        - Gil Tene, "How NOT to Measure Latency": https://www.infoq.com/presentations/latency-response-time/
+        - wrk2 (constant throughput load generator): https://github.com/giltene/wrk2
+    Description:
+        Implementation of the bench command. Requests are driven on one
+        HttpMulti handle. In closed-loop mode a new request is added as
+        soon as one finishes, keeping the concurrency constant. With a
+        target rate, request i is scheduled at start + i / rate and its
+        latency is measured from that scheduled time rather than from
+        when it was actually sent, so a stalled proxy shows up in the
+        tail instead of silently lowering the offered load
+        (coordinated omission).
+*/
+
+#include "bench/bench.h"
+#include "http/http_multi.h"
+#include "net/socket.h"
+#include "util/util.h"
+
+/* Latency phases reported for each exchange (one row each) */
+typedef enum {
+    PHASE_CONNECT,      // TCP connect to the Tor SOCKS port
+    PHASE_SOCKS,        // SOCKS request to reply: circuit and stream setup
+    PHASE_REQUEST,      // request write
+    PHASE_WAIT,         // request written to first byte
+    PHASE_TRANSFER,     // first to last byte
+    PHASE_TOTAL,        // scheduled start to completion, redirects included
+    PHASE_COUNT,
+} BenchPhase;
+
+static const char *phase_names[PHASE_COUNT] = {
+    "connect", "socks", "request", "wait", "transfer", "total",
+};
+
+/* Results of one group of requests (whole run or one isolation token) */
+typedef struct BenchStats {
+    Histogram *phases[PHASE_COUNT];
+    uint64_t ok;
+    uint64_t failed;
+    uint64_t bytes;
+} BenchStats;
+
+typedef struct BenchRun BenchRun;
+
+/* One issued request */
+typedef struct BenchSlot {
+    BenchRun *run;
+    uint64_t intended_ns;       // scheduled start (clock reading)
+    size_t token;
+    uint64_t bytes;
+} BenchSlot;
+
+struct BenchRun {
+    const CliArgsInfo *args;
+    BenchStats total;
+    BenchStats *per_token;      // one per isolation token (tokens > 0)
+    size_t tokens;
+    char (*token_ids)[48];
+    size_t in_flight;
+    Error first_error;          // kept to explain failures
+};
+
+/* Function Prototypes */
+static Error bench_stats_init(BenchStats *stats);
+static void bench_stats_free(BenchStats *stats);
+static Error bench_collect_urls(const CliArgsInfo *args, char **text, const char ***urls, size_t *count);
+static Error bench_issue(BenchRun *run, HttpMulti *multi, BenchSlot *slot, size_t index, const char *url, uint64_t intended_ns);
+static void bench_on_data(void *userdata, const char *chunk, size_t len);
+static void bench_on_done(void *userdata, Error err, const HttpResponse *response);
+static void bench_record(BenchStats *stats, const HttpResponse *response, uint64_t total_ns, uint64_t bytes);
+static void bench_report(const BenchRun *run, size_t requests, uint64_t elapsed_ns);
+
+Error bench_run(const CliArgsInfo *args) {
+    Error err = ERR_OK();
+    char *text = NULL;
+    const char **urls = NULL;
+    size_t url_count = 0;
+    BenchSlot *slots = NULL;
+    HttpMulti *multi = NULL;
+    CircuitPool *circuits = NULL;
+    BenchRun run = { .args = args };
+
+    size_t requests    = (size_t)args->values[VAL_REQUESTS];
+    size_t concurrency = (size_t)args->values[VAL_CONCURRENCY];
+    int rate           = args->values[VAL_RATE];
+
+    err = bench_collect_urls(args, &text, &urls, &url_count);
+    if (ERR_FAILED(err)) {
+        goto exit_bench;
+    }
+
+    slots = ut_calloc(MEM_TAG_BENCH, requests, sizeof(BenchSlot));
+    if (!slots) {
+        err = ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate %zu bench requests", requests);
+        goto exit_bench;
+    }
+
+    err = bench_stats_init(&run.total);
+    if (ERR_FAILED(err)) {
+        goto exit_bench;
+    }
+
+    run.tokens = (size_t)args->values[VAL_TOKENS];
+    if (run.tokens > 0) {
+        run.per_token = ut_calloc(MEM_TAG_BENCH, run.tokens, sizeof(BenchStats));
+        run.token_ids = ut_calloc(MEM_TAG_BENCH, run.tokens, sizeof(*run.token_ids));
+        if (!run.per_token || !run.token_ids) {
+            err = ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate %zu token stats", run.tokens);
+            goto exit_bench;
+        }
+        for (size_t i = 0; i < run.tokens; i++) {
+            snprintf(run.token_ids[i], sizeof(run.token_ids[i]), "%s-bench-%zu", PROG_NAME, i);
+            err = bench_stats_init(&run.per_token[i]);
+            if (ERR_FAILED(err)) {
+                goto exit_bench;
+            }
+        }
+    }
+
+    // Open loop: the multi handle queues arrivals beyond the concurrency limit,
+    // and that queueing time is part of the measured latency
+    err = http_multi_create(concurrency, &multi);
+    if (ERR_FAILED(err)) {
+        goto exit_bench;
+    }
+    if (args->flags[FLAG_ADAPTIVE]) {
+        err = http_multi_set_adaptive(multi, LIMITER_DEFAULT_INITIAL);
+        if (ERR_FAILED(err)) {
+            goto exit_bench;
+        }
+    }
+    http_multi_set_host_limit(multi, (size_t)args->values[VAL_PER_HOST]);
+    http_multi_set_hedging(multi, args->values[VAL_HEDGE]);
+    if (args->values[VAL_CIRCUITS] > 0) {
+        const char *probe = args->options[OPTION_PROBE_URL] ? args->options[OPTION_PROBE_URL] : urls[0];
+        err = circuit_pool_create((size_t)args->values[VAL_CIRCUITS], probe, &circuits);
+        if (ERR_FAILED(err)) {
+            goto exit_bench;
+        }
+        if (args->options[OPTION_CONTROL]) {
+            err = circuit_pool_control(circuits, args->options[OPTION_CONTROL], getenv("TORILATE_CONTROL_PASSWORD"));
+            if (ERR_FAILED(err)) {
+                goto exit_bench;
+            }
+        }
+        http_multi_set_circuits(multi, circuits);
+    }
+
+    if (rate > 0) {
+        printf("%s: bench: %zu requests at %d req/s (concurrency limit %zu, latency from scheduled start)\n", PROG_NAME, requests, rate, concurrency);
+    } else {
+        printf("%s: bench: %zu requests at concurrency %zu\n", PROG_NAME, requests, concurrency);
+    }
+    fflush(stdout);
+
+    uint64_t interval_ns = rate > 0 ? 1000000000ULL / (uint64_t)rate : 0;
+    uint64_t start_ns = ut_now_ns();
+    size_t issued = 0;
+
+    while (issued < requests || run.in_flight > 0) {
+        uint64_t now = ut_now_ns();
+        int timeout_ms = 1000;
+
+        if (rate > 0) {
+            while (issued < requests && start_ns + issued * interval_ns <= now) {
+                err = bench_issue(&run, multi, &slots[issued], issued, urls[issued % url_count], start_ns + issued * interval_ns);
+                if (ERR_FAILED(err)) {
+                    goto exit_bench;
+                }
+                issued++;
+            }
+            if (issued < requests) {
+                uint64_t next = start_ns + issued * interval_ns;
+                timeout_ms = next > now ? (int)((next - now) / 1000000) : 0;
+            }
+        } else {
+            while (issued < requests && run.in_flight < concurrency) {
+                err = bench_issue(&run, multi, &slots[issued], issued, urls[issued % url_count], now);
+                if (ERR_FAILED(err)) {
+                    goto exit_bench;
+                }
+                issued++;
+            }
+        }
+
+        if (run.in_flight == 0) {
+            // Nothing to drive until the next scheduled arrival
+            uint64_t next = start_ns + issued * interval_ns;
+            now = ut_now_ns();
+            if (next > now) {
+                ut_sleep_ns(next - now);
+            }
+            continue;
+        }
+
+        size_t running = 0;
+        err = http_multi_poll(multi, timeout_ms, &running);
+        if (ERR_FAILED(err)) {
+            err = ERR_PROPAGATE(err, "Bench transfer loop failed");
+            goto exit_bench;
+        }
+    }
+
+    bench_report(&run, requests, ut_now_ns() - start_ns);
+    http_multi_print_stats(multi);
+    if (circuits) {
+        print_circuit_stats(circuits);
+    }
+    print_memory_report();
+    if (run.total.failed > 0) {
+        printf("%s: first failure: %s\n", PROG_NAME, get_err_msg(&run.first_error, args->flags[FLAG_VERBOSE]));
+    }
+
+exit_bench:
+    http_multi_destroy(multi);
+    circuit_pool_destroy(circuits);
+    bench_stats_free(&run.total);
+    if (run.per_token) {
+        for (size_t i = 0; i < run.tokens; i++) {
+            bench_stats_free(&run.per_token[i]);
+        }
+    }
+    ut_free(run.per_token);
+    ut_free(run.token_ids);
+    ut_free(slots);
+    ut_free(urls);
+    ut_free(text);
+
+    return err;
+}
+
+/* Internal helper functions */
+
+static Error bench_stats_init(BenchStats *stats) {
+    memset(stats, 0, sizeof(BenchStats));
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        Error err = hist_create(&stats->phases[i]);
+        if (ERR_FAILED(err)) {
+            bench_stats_free(stats);
+            return err;
+        }
+    }
+    return ERR_OK();
+}
+
+static void bench_stats_free(BenchStats *stats) {
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        hist_destroy(stats->phases[i]);
+        stats->phases[i] = NULL;
+    }
+}
+
+// Targets: positional URLs followed by the lines of --input (blank lines and '#' comments skipped)
+static Error bench_collect_urls(const CliArgsInfo *args, char **text, const char ***urls, size_t *count) {
+    const MultiValueOption *given = &args->multi_options[MULTI_OPTION_URLS];
+    const char *url_file = args->options[OPTION_URL_FILE];
+    size_t cap = (size_t)given->count;
+    size_t n = 0;
+
+    if (url_file) {
+        Error err = read_from(url_file, text, NULL);
+        if (ERR_FAILED(err)) {
+            return ERR_PROPAGATE(err, "Failed to read URL list %s", url_file);
+        }
+        for (const char *c = *text; *c; c++) {
+            cap += (*c == '\n');
+        }
+        cap++;
+    }
+
+    const char **list = ut_calloc(MEM_TAG_BENCH, cap ? cap : 1, sizeof(char *));
+    if (!list) {
+        return ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate URL list");
+    }
+    for (int i = 0; i < given->count; i++) {
+        list[n++] = given->values[i];
+    }
+
+    for (char *line = url_file ? *text : NULL; line && *line;) {
+        char *next = strchr(line, '\n');
+        if (next) {
+            *next++ = '\0';
+        }
+        while (*line && isspace((unsigned char)*line)) line++;
+        char *end = line + strlen(line);
+        while (end > line && isspace((unsigned char)end[-1])) end--;
+        *end = '\0';
+
+        if (*line && *line != '#') {
+            list[n++] = line;
+        }
+        line = next;
+    }
+
+    if (n == 0) {
+        ut_free(list);
+        return ERR_NEW(ERR_INVALID_ARGS, "No URLs to benchmark");
+    }
+
+    *urls = list;
+    *count = n;
+    return ERR_OK();
+}
+
+static Error bench_issue(BenchRun *run, HttpMulti *multi, BenchSlot *slot, size_t index, const char *url, uint64_t intended_ns) {
+    const CliArgsInfo *args = run->args;
+
+    slot->run         = run;
+    slot->intended_ns = intended_ns;
+    slot->token       = run->tokens > 0 ? index % run->tokens : 0;
+
+    HttpRequest req = {
+        .method           = HTTP_METHOD_GET,
+        .uri              = url,
+        .headers          = args->multi_options[MULTI_OPTION_HEADERS].values,
+        .headers_count    = args->multi_options[MULTI_OPTION_HEADERS].count,
+        .follow_redirects = args->flags[FLAG_FOLLOW],
+        .max_redirects    = args->values[VAL_MAX_REDIRECTS],
+        .max_retries      = args->values[VAL_RETRIES],
+        .timeouts         = get_timeouts(args),
+        .isolation        = run->tokens > 0 ? run->token_ids[slot->token] : NULL,
+    };
+
+    run->in_flight++;
+    Error err = http_multi_add(multi, &req, bench_on_data, bench_on_done, slot);
+    if (ERR_FAILED(err)) {
+        if (err.code == ERR_OUTOFMEMORY) {
+            run->in_flight--;
+            return err;
+        }
+        bench_on_done(slot, err, NULL); // e.g. a malformed URL: count it and go on
+    }
+    return ERR_OK();
+}
+
+static void bench_on_data(void *userdata, const char *chunk, size_t len) {
+    (void)chunk;
+    BenchSlot *slot = (BenchSlot *)userdata;
+    slot->bytes += len;
+}
+
+static void bench_on_done(void *userdata, Error err, const HttpResponse *response) {
+    BenchSlot *slot = (BenchSlot *)userdata;
+    BenchRun *run = slot->run;
+    BenchStats *token = run->tokens > 0 ? &run->per_token[slot->token] : NULL;
+    run->in_flight--;
+
+    if (ERR_FAILED(err)) {
+        if (run->total.failed == 0) {
+            run->first_error = err;
+        }
+        run->total.failed++;
+        if (token) {
+            token->failed++;
+        }
+        return;
+    }
+
+    uint64_t total_ns = ut_now_ns() - slot->intended_ns;
+    bench_record(&run->total, response, total_ns, slot->bytes);
+    if (token) {
+        bench_record(token, response, total_ns, slot->bytes);
+    }
+}
+
+static void bench_record(BenchStats *stats, const HttpResponse *response, uint64_t total_ns, uint64_t bytes) {
+    int hops = response->hops < HTTP_MAX_TIMED_HOPS ? response->hops : HTTP_MAX_TIMED_HOPS;
+
+    for (int i = 0; i < hops; i++) {
+        const HttpTiming *t = &response->timing[i];
+        if (t->connect_ns) {
+            hist_record(stats->phases[PHASE_CONNECT], t->connect_ns);
+        }
+        if (t->socks_reply_ns > t->socks_sent_ns && t->socks_sent_ns) {
+            hist_record(stats->phases[PHASE_SOCKS], t->socks_reply_ns - t->socks_sent_ns);
+        }
+        if (t->request_sent_ns > t->socks_reply_ns && t->socks_reply_ns) {
+            hist_record(stats->phases[PHASE_REQUEST], t->request_sent_ns - t->socks_reply_ns);
+        }
+        if (t->first_byte_ns > t->request_sent_ns && t->request_sent_ns) {
+            hist_record(stats->phases[PHASE_WAIT], t->first_byte_ns - t->request_sent_ns);
+        }
+        if (t->last_byte_ns >= t->first_byte_ns && t->first_byte_ns) {
+            hist_record(stats->phases[PHASE_TRANSFER], t->last_byte_ns - t->first_byte_ns);
+        }
+    }
+    hist_record(stats->phases[PHASE_TOTAL], total_ns);
+    stats->ok++;
+    stats->bytes += bytes;
+}
+
+static void bench_report(const BenchRun *run, size_t requests, uint64_t elapsed_ns) {
+    double seconds = (double)elapsed_ns / 1e9;
+    const BenchStats *s = &run->total;
+
+    printf("%s: %zu requests in %.3f s: %llu ok, %llu failed\n", PROG_NAME, requests, seconds,
+           (unsigned long long)s->ok, (unsigned long long)s->failed);
+    printf("%s: throughput: %.2f req/s, %.2f KiB/s\n", PROG_NAME,
+           (double)s->ok / seconds, (double)s->bytes / 1024.0 / seconds);
+
+    char sockopts[NET_SOCKOPTS_DESC_MAX];
+    net_sockopts_describe(sockopts, sizeof(sockopts));
+    printf("%s: socket: %s\n", PROG_NAME, sockopts);
+
+    printf("\n  %-10s %8s %10s %10s %10s %10s %10s %10s   (ms)\n", "phase", "count", "mean", "p50", "p90", "p99", "p99.9", "max");
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        const Histogram *h = s->phases[i];
+        printf("  %-10s %8llu %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f\n", phase_names[i],
+               (unsigned long long)hist_count(h),
+               hist_mean(h) / 1e6,
+               (double)hist_percentile(h, 50.0) / 1e6,
+               (double)hist_percentile(h, 90.0) / 1e6,
+               (double)hist_percentile(h, 99.0) / 1e6,
+               (double)hist_percentile(h, 99.9) / 1e6,
+               (double)hist_max(h) / 1e6);
+    }
+
+    if (run->tokens == 0) {
+        return;
+    }
+
+    printf("\n  %-24s %8s %8s %10s %10s %10s %10s   (total, ms)\n", "token", "ok", "failed", "req/s", "p50", "p99", "max");
+    for (size_t i = 0; i < run->tokens; i++) {
+        const BenchStats *t = &run->per_token[i];
+        const Histogram *h = t->phases[PHASE_TOTAL];
+        printf("  %-24s %8llu %8llu %10.2f %10.3f %10.3f %10.3f\n", run->token_ids[i],
+               (unsigned long long)t->ok, (unsigned long long)t->failed,
+               (double)t->ok / seconds,
+               (double)hist_percentile(h, 50.0) / 1e6,
+               (double)hist_percentile(h, 99.0) / 1e6,
+               (double)hist_max(h) / 1e6);
+    }
+}
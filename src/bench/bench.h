@@ -0,0 +1,31 @@
+/*
+    File: src/bench/bench.h
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference:
+        - Gil Tene, "How NOT to Measure Latency": https://www.infoq.com/presentations/latency-response-time/
+    Description:
+        Built-in load generator for Torilate.
+        Issues a fixed number of requests against a set of URLs, either
+        closed-loop at a given concurrency or open-loop at a fixed
+        arrival rate, and reports per-phase latency percentiles and
+        throughput.
+*/
+
+#ifndef TORILATE_BENCH_H
+#define TORILATE_BENCH_H
+
+#include "cli/cli.h"
+#include "error/error.h"
+
+/*
+ * Run the 'bench' command.
+ *
+ *  @param args  parsed command-line arguments (cmd == CMD_BENCH)
+ *
+ *  @return ERR_OK when the run completed (individual request failures are
+ *          reported, not returned), or the error that stopped the run
+ */
+Error bench_run(const CliArgsInfo *args);
+
+#endif
@@ -8,8 +8,12 @@
         Implementation of command-line interface utilities for Torilate.
 */
 
+#include <limits.h>
 #include "cli/cli.h"
 #include "error/error.h"
+#include "http/http_retry.h"
+#include "http/http_proxy.h"
+#include "net/socket.h"
 
 // Represents a CLI subcommand with its handler and metadata
 typedef struct {
@@ -29,6 +33,15 @@ typedef struct {
     arg_lit_t *raw;
     arg_lit_t *content_only;
     arg_lit_t *verbose;
+    arg_lit_t *stream;
+    arg_str_t *cache_dir;
+    arg_str_t *write_out;
+    arg_int_t *retries;
+    arg_dbl_t *connect_timeout;
+    arg_dbl_t *idle_timeout;
+    arg_dbl_t *max_time;
+    arg_str_t *proxy;
+    arg_str_t *socket;
     arg_end_t *end;
 } CommonArgs;
 
@@ -44,30 +57,122 @@ typedef struct {
     arg_str_t *input_file;
 } PostArgTable;
 
+// Complete argument table for BATCH command (standalone, takes a URL list instead of a URL)
+typedef struct {
+    arg_rex_t *cmd;
+    arg_str_t *url_file;
+    arg_str_t *header;
+    arg_str_t *output_dir;
+    arg_int_t *jobs;
+    arg_int_t *workers;
+    arg_int_t *per_host;
+    arg_int_t *hedge;
+    arg_int_t *circuits;
+    arg_str_t *probe;
+    arg_str_t *control;
+    arg_int_t *dns_cache;
+    arg_int_t *retries;
+    arg_dbl_t *connect_timeout;
+    arg_dbl_t *idle_timeout;
+    arg_dbl_t *max_time;
+    arg_str_t *proxy;
+    arg_str_t *socket;
+    arg_int_t *max_redirs;
+    arg_lit_t *follow;
+    arg_lit_t *raw;
+    arg_lit_t *content_only;
+    arg_lit_t *verbose;
+    arg_lit_t *adaptive;
+    arg_str_t *cache_dir;
+    arg_str_t *write_out;
+    arg_end_t *end;
+} BatchArgTable;
+
+// Complete argument table for BENCH command (standalone, takes URLs and/or a URL list)
+typedef struct {
+    arg_rex_t *cmd;
+    arg_str_t *urls;
+    arg_str_t *url_file;
+    arg_str_t *header;
+    arg_int_t *requests;
+    arg_int_t *jobs;
+    arg_int_t *rate;
+    arg_int_t *tokens;
+    arg_int_t *per_host;
+    arg_int_t *hedge;
+    arg_int_t *circuits;
+    arg_str_t *probe;
+    arg_str_t *control;
+    arg_int_t *retries;
+    arg_dbl_t *connect_timeout;
+    arg_dbl_t *idle_timeout;
+    arg_dbl_t *max_time;
+    arg_str_t *proxy;
+    arg_str_t *socket;
+    arg_int_t *max_redirs;
+    arg_lit_t *follow;
+    arg_lit_t *verbose;
+    arg_lit_t *adaptive;
+    arg_end_t *end;
+} BenchArgTable;
+
 #define GET_ARGTABLE_ARRAY(args) (void*[]){ \
     args.common.cmd, args.common.uri, args.common.header, args.common.output_file, \
     args.common.max_redirs, args.common.follow, args.common.raw, \
-    args.common.content_only, args.common.verbose, args.common.end \
+    args.common.content_only, args.common.verbose, args.common.stream, \
+    args.common.cache_dir, args.common.write_out, args.common.retries, \
+    args.common.connect_timeout, args.common.idle_timeout, args.common.max_time, args.common.proxy, \
+    args.common.socket, args.common.end \
 }
 
 #define POST_ARGTABLE_ARRAY(args) (void*[]){ \
     args.common.cmd, args.common.uri, args.common.header, args.body, \
     args.input_file, args.common.output_file, args.common.max_redirs, \
     args.common.follow, args.common.raw, args.common.content_only, \
-    args.common.verbose, args.common.end \
+    args.common.verbose, args.common.stream, args.common.cache_dir, \
+    args.common.write_out, args.common.retries, args.common.connect_timeout, \
+    args.common.idle_timeout, args.common.max_time, args.common.proxy, args.common.socket, \
+    args.common.end \
+}
+
+#define BATCH_ARGTABLE_ARRAY(args) (void*[]){ \
+    args.cmd, args.url_file, args.header, args.output_dir, args.jobs, \
+    args.workers, args.per_host, args.hedge, args.circuits, args.probe, args.control, args.dns_cache, args.retries, args.connect_timeout, args.idle_timeout, \
+    args.max_time, args.proxy, args.socket, args.max_redirs, args.follow, args.raw, args.content_only, \
+    args.verbose, args.adaptive, args.cache_dir, args.write_out, args.end \
 }
 
-#define GET_ARGTABLE_COUNT 10
-#define POST_ARGTABLE_COUNT 12
+#define BENCH_ARGTABLE_ARRAY(args) (void*[]){ \
+    args.cmd, args.urls, args.url_file, args.header, args.requests, args.jobs, \
+    args.rate, args.tokens, args.per_host, args.hedge, args.circuits, args.probe, args.control, args.retries, args.connect_timeout, args.idle_timeout, \
+    args.max_time, args.proxy, args.socket, args.max_redirs, args.follow, args.verbose, \
+    args.adaptive, args.end \
+}
+
+#define GET_ARGTABLE_COUNT 19
+#define POST_ARGTABLE_COUNT 21
+#define BATCH_ARGTABLE_COUNT 27
+#define BENCH_ARGTABLE_COUNT 24
 
 // Function prototypes
 int validate_command(char *cmd);
 void cli_init(CliArgsInfo *args_info);
 int cmd_get_proc (int argc, char *argv[], arg_dstr_t res, void *ctx);
 int cmd_post_proc (int argc, char *argv[], arg_dstr_t res, void *ctx);
+int cmd_batch_proc (int argc, char *argv[], arg_dstr_t res, void *ctx);
+int cmd_bench_proc (int argc, char *argv[], arg_dstr_t res, void *ctx);
+int store_headers(arg_str_t *header, CliArgsInfo *args_info, arg_dstr_t res);
+int store_retries(arg_int_t *retries, CliArgsInfo *args_info, arg_dstr_t res);
+int store_circuits(arg_int_t *circuits, arg_str_t *probe, arg_str_t *control, CliArgsInfo *args_info, arg_dstr_t res);
+int store_timeouts(arg_dbl_t *connect_timeout, arg_dbl_t *idle_timeout, arg_dbl_t *max_time, CliArgsInfo *args_info, arg_dstr_t res);
+int store_strings(arg_str_t *arg, MultiOptionsIndex index, CliArgsInfo *args_info, arg_dstr_t res);
+int store_proxies(arg_str_t *proxy, CliArgsInfo *args_info, arg_dstr_t res);
+int store_socket(arg_str_t *socket, CliArgsInfo *args_info, arg_dstr_t res);
 void init_common_args(CommonArgs *args, const char *cmd_name, const char *cmd_description);
 GetArgTable get_args_table_get(void);
 PostArgTable get_args_table_post(void);
+BatchArgTable get_args_table_batch(void);
+BenchArgTable get_args_table_bench(void);
 void** get_common_args_help_table(int *count);
 void** get_command_specific_args_table(const char *cmd_name, int *count);
 void free_help_table(void **table, int count);
@@ -76,6 +181,8 @@ void free_help_table(void **table, int count);
 SubCommand sub_cmnds[] = {
     {"get", cmd_get_proc, "Send HTTP GET request"},
     {"post", cmd_post_proc, "Send HTTP POST request"},
+    {"batch", cmd_batch_proc, "Send concurrent HTTP GET requests for a list of URLs"},
+    {"bench", cmd_bench_proc, "Measure throughput and latency percentiles under load"},
 };
 int sub_cmnds_count = sizeof(sub_cmnds) / sizeof(SubCommand);
 
@@ -120,7 +227,10 @@ void get_help(void) {
     printf("Examples:\n");
     printf("  %s get example.com\n", PROG_NAME);
     printf("  %s get httpbin.org/redirect/3 -fl -v\n", PROG_NAME);
-    printf("  %s post example.com -t application/json -b '{\"key\":\"value\"}'\n\n", PROG_NAME);
+    printf("  %s post example.com -t application/json -b '{\"key\":\"value\"}'\n", PROG_NAME);
+    printf("  %s batch urls.txt -j 16 -o responses/\n", PROG_NAME);
+    printf("  %s get example.com -c --write-out '%%{json}\\n'\n", PROG_NAME);
+    printf("  %s bench example.com -n 500 --rate 20 --tokens 4\n\n", PROG_NAME);
 }
 
 // Parse command-line arguments and populate CliArgsInfo
@@ -191,6 +301,15 @@ void init_common_args(CommonArgs *args, const char *cmd_name, const char *cmd_de
     args->raw          = arg_lit0("r", "raw", "display raw HTTP response");
     args->content_only = arg_lit0("c", "content-only", "display only the content of the HTTP response");
     args->verbose      = arg_lit0("v", "verbose", "display verbose output");
+    args->stream       = arg_lit0("s", "stream", "stream the response to the output as it arrives (no size limit)");
+    args->cache_dir    = arg_str0(NULL, "cache", "<cache_dir>", "serve and revalidate GET responses from an on-disk cache");
+    args->write_out    = arg_str0(NULL, "write-out", "<template>", "print timing info after the request, e.g. '%{time_total}\\n' or '%{json}'");
+    args->retries      = arg_int0(NULL, "retries", "<retries>", "retry transient failures (SOCKS rejects, failed connects) up to this many times, each on a new circuit (default: 2)");
+    args->connect_timeout = arg_dbl0(NULL, "connect-timeout", "<seconds>", "seconds allowed for the connect to the Tor SOCKS port and for its SOCKS reply (default: 60)");
+    args->idle_timeout = arg_dbl0(NULL, "idle-timeout", "<seconds>", "seconds allowed for the first response byte and between later bytes (default: 60)");
+    args->max_time     = arg_dbl0(NULL, "max-time", "<seconds>", "seconds allowed for each attempt of a request, redirects included (default: no limit)");
+    args->proxy        = arg_strn(NULL, "proxy", "<[host:]port|unix:path>", 0, HTTP_PROXY_MAX, "Tor SOCKS endpoint, TCP or Unix socket; repeat to balance requests over several tor instances (default: 127.0.0.1:9050)");
+    args->socket       = arg_str0(NULL, "socket", "<profile[,opt=val]>", "socket tuning of the connections to Tor: os, interactive or bulk, optionally followed by overrides, e.g. bulk,rcvbuf=4m (default: os)");
     args->end          = arg_end(20);
 }
 
@@ -213,18 +332,83 @@ PostArgTable get_args_table_post(void) {
     return args;
 }
 
+// Create and initialize argument table for BATCH command
+BatchArgTable get_args_table_batch(void) {
+    BatchArgTable args;
+    args.cmd          = arg_rex1(NULL, NULL, "batch", NULL, ARG_REX_ICASE, "send concurrent HTTP GET requests");
+    args.url_file     = arg_str1(NULL, NULL, "<url_file>", "file listing one URL per line");
+    args.header       = arg_strn("H", "header", "<header>", 0, 50, "HTTP header to include in every request");
+    args.output_dir   = arg_str0("o", "output", "<output_dir>", "directory to store one response file per URL");
+    args.jobs         = arg_int0("j", "jobs", "<jobs>", "maximum number of requests in flight (default: 8)");
+    args.workers      = arg_int0("w", "workers", "<workers>", "threads for parsing and writing responses (default: core count)");
+    args.adaptive     = arg_lit0(NULL, "adaptive", "adapt the number of requests in flight to latency, up to --jobs");
+    args.per_host     = arg_int0(NULL, "per-host", "<streams>", "maximum requests in flight per host; hosts are served round-robin");
+    args.hedge        = arg_int0(NULL, "hedge", "<percentile>", "duplicate a GET over another circuit when its first byte is later than this TTFB percentile");
+    args.circuits     = arg_int0(NULL, "circuits", "<circuits>", "route requests over a pool of this many circuits, probed in the background; slow circuits are replaced");
+    args.probe        = arg_str0(NULL, "probe", "<url>", "URL the circuit prober fetches (default: the first URL)");
+    args.control      = arg_str0(NULL, "control", "<[host:]port|unix:path>", "Tor ControlPort for circuit state and NEWNYM (password from TORILATE_CONTROL_PASSWORD)");
+    args.dns_cache    = arg_int0(NULL, "dns-cache", "<ttl_seconds>", "resolve the hostnames through Tor ahead of the requests (SOCKS RESOLVE) and connect to the addresses for this long");
+    args.retries      = arg_int0(NULL, "retries", "<retries>", "retry transient failures (SOCKS rejects, failed connects) up to this many times, each on a new circuit (default: 2)");
+    args.connect_timeout = arg_dbl0(NULL, "connect-timeout", "<seconds>", "seconds allowed for the connect to the Tor SOCKS port and for its SOCKS reply (default: 60)");
+    args.idle_timeout = arg_dbl0(NULL, "idle-timeout", "<seconds>", "seconds allowed for the first response byte and between later bytes (default: 60)");
+    args.max_time     = arg_dbl0(NULL, "max-time", "<seconds>", "seconds allowed for each attempt of a request, redirects included (default: no limit)");
+    args.proxy        = arg_strn(NULL, "proxy", "<[host:]port|unix:path>", 0, HTTP_PROXY_MAX, "Tor SOCKS endpoint, TCP or Unix socket; repeat to balance requests over several tor instances (default: 127.0.0.1:9050)");
+    args.socket       = arg_str0(NULL, "socket", "<profile[,opt=val]>", "socket tuning of the connections to Tor: os, interactive or bulk, optionally followed by overrides, e.g. bulk,rcvbuf=4m (default: os)");
+    args.max_redirs   = arg_int0(NULL, "max-redirs", "<max_redirects>", "follow redirects up to the specified number of times");
+    args.follow       = arg_lit0("fl", "follow", "follow redirects");
+    args.raw          = arg_lit0("r", "raw", "store raw HTTP responses");
+    args.content_only = arg_lit0("c", "content-only", "store only the content of the HTTP responses");
+    args.verbose      = arg_lit0("v", "verbose", "display verbose output");
+    args.cache_dir    = arg_str0(NULL, "cache", "<cache_dir>", "serve and revalidate responses from an on-disk cache");
+    args.write_out    = arg_str0(NULL, "write-out", "<template>", "print timing info after each request, e.g. '%{json}'");
+    args.end          = arg_end(20);
+    return args;
+}
+
+// Create and initialize argument table for BENCH command
+BenchArgTable get_args_table_bench(void) {
+    BenchArgTable args;
+    args.cmd          = arg_rex1(NULL, NULL, "bench", NULL, ARG_REX_ICASE, "measure throughput and latency under load");
+    args.urls         = arg_strn(NULL, NULL, "<url>", 0, 64, "URL to request (requests cycle through all URLs)");
+    args.url_file     = arg_str0("i", "input", "<url_file>", "file listing more URLs, one per line");
+    args.header       = arg_strn("H", "header", "<header>", 0, 50, "HTTP header to include in every request");
+    args.requests     = arg_int0("n", "requests", "<requests>", "total number of requests (default: 100)");
+    args.jobs         = arg_int0("j", "jobs", "<jobs>", "maximum number of requests in flight (default: 8)");
+    args.rate         = arg_int0(NULL, "rate", "<req_per_sec>", "open loop: start requests at a fixed rate, latency measured from the scheduled start");
+    args.tokens       = arg_int0(NULL, "tokens", "<tokens>", "spread requests over this many circuit isolation tokens and report each");
+    args.adaptive     = arg_lit0(NULL, "adaptive", "adapt the number of requests in flight to latency, up to --jobs");
+    args.per_host     = arg_int0(NULL, "per-host", "<streams>", "maximum requests in flight per host; hosts are served round-robin");
+    args.hedge        = arg_int0(NULL, "hedge", "<percentile>", "duplicate a GET over another circuit when its first byte is later than this TTFB percentile");
+    args.circuits     = arg_int0(NULL, "circuits", "<circuits>", "route requests over a pool of this many circuits, probed in the background; slow circuits are replaced");
+    args.probe        = arg_str0(NULL, "probe", "<url>", "URL the circuit prober fetches (default: the first URL)");
+    args.control      = arg_str0(NULL, "control", "<[host:]port|unix:path>", "Tor ControlPort for circuit state and NEWNYM (password from TORILATE_CONTROL_PASSWORD)");
+    args.retries      = arg_int0(NULL, "retries", "<retries>", "retry transient failures (SOCKS rejects, failed connects) up to this many times, each on a new circuit (default: 2)");
+    args.connect_timeout = arg_dbl0(NULL, "connect-timeout", "<seconds>", "seconds allowed for the connect to the Tor SOCKS port and for its SOCKS reply (default: 60)");
+    args.idle_timeout = arg_dbl0(NULL, "idle-timeout", "<seconds>", "seconds allowed for the first response byte and between later bytes (default: 60)");
+    args.max_time     = arg_dbl0(NULL, "max-time", "<seconds>", "seconds allowed for each attempt of a request, redirects included (default: no limit)");
+    args.proxy        = arg_strn(NULL, "proxy", "<[host:]port|unix:path>", 0, HTTP_PROXY_MAX, "Tor SOCKS endpoint, TCP or Unix socket; repeat to balance requests over several tor instances (default: 127.0.0.1:9050)");
+    args.socket       = arg_str0(NULL, "socket", "<profile[,opt=val]>", "socket tuning of the connections to Tor: os, interactive or bulk, optionally followed by overrides, e.g. bulk,rcvbuf=4m (default: os)");
+    args.max_redirs   = arg_int0(NULL, "max-redirs", "<max_redirects>", "follow redirects up to the specified number of times");
+    args.follow       = arg_lit0("fl", "follow", "follow redirects");
+    args.verbose      = arg_lit0("v", "verbose", "display verbose output");
+    args.end          = arg_end(20);
+    return args;
+}
+
 // Create argtable for displaying common options in help
 void** get_common_args_help_table(int *count) {
     CommonArgs args;
     init_common_args(&args, "dummy", "dummy");
     
-    *count = 10;
-    void **table = malloc((10 + 1) * sizeof(void*));
+    *count = 19;
+    void **table = ut_malloc(MEM_TAG_CLI, (19 + 1) * sizeof(void*));
     if (!table) {
         void *temp_table[] = {args.cmd, args.uri, args.header, args.output_file,
                              args.max_redirs, args.follow, args.raw,
-                             args.content_only, args.verbose, args.end};
-        arg_freetable(temp_table, 10);
+                             args.content_only, args.verbose, args.stream,
+                             args.cache_dir, args.write_out, args.retries,
+                             args.connect_timeout, args.idle_timeout, args.max_time, args.proxy, args.socket, args.end};
+        arg_freetable(temp_table, 19);
         *count = 0;
         return NULL;
     }
@@ -238,9 +422,18 @@ void** get_common_args_help_table(int *count) {
     table[5] = args.raw;
     table[6] = args.content_only;
     table[7] = args.verbose;
-    table[8] = args.end;
-    table[9] = args.cmd;
-    table[10] = NULL;
+    table[8] = args.stream;
+    table[9] = args.cache_dir;
+    table[10] = args.write_out;
+    table[11] = args.retries;
+    table[12] = args.connect_timeout;
+    table[13] = args.idle_timeout;
+    table[14] = args.max_time;
+    table[15] = args.proxy;
+    table[16] = args.socket;
+    table[17] = args.end;
+    table[18] = args.cmd;
+    table[19] = NULL;
     
     return table;
 }
@@ -256,12 +449,15 @@ void** get_command_specific_args_table(const char *cmd_name, int *count) {
         PostArgTable args = get_args_table_post();
         
         *count = POST_ARGTABLE_COUNT;
-        void **table = malloc((POST_ARGTABLE_COUNT + 1) * sizeof(void*));
+        void **table = ut_malloc(MEM_TAG_CLI, (POST_ARGTABLE_COUNT + 1) * sizeof(void*));
         if (!table) {
             void *post_argtable[] = {args.common.cmd, args.common.uri, args.common.header,
                                      args.body, args.input_file, args.common.output_file,
                                      args.common.max_redirs, args.common.follow, args.common.raw,
-                                     args.common.content_only, args.common.verbose, args.common.end};
+                                     args.common.content_only, args.common.verbose, args.common.stream,
+                                     args.common.cache_dir, args.common.write_out, args.common.retries,
+                                     args.common.connect_timeout, args.common.idle_timeout, args.common.max_time, args.common.proxy,
+                                     args.common.socket, args.common.end};
             arg_freetable(post_argtable, POST_ARGTABLE_COUNT);
             *count = 0;
             return NULL;
@@ -279,11 +475,101 @@ void** get_command_specific_args_table(const char *cmd_name, int *count) {
         table[9] = args.common.raw;
         table[10] = args.common.content_only;
         table[11] = args.common.verbose;
-        table[12] = NULL;
+        table[12] = args.common.stream;
+        table[13] = args.common.cache_dir;
+        table[14] = args.common.write_out;
+        table[15] = args.common.retries;
+        table[16] = args.common.connect_timeout;
+        table[17] = args.common.idle_timeout;
+        table[18] = args.common.max_time;
+        table[19] = args.common.proxy;
+        table[20] = args.common.socket;
+        table[21] = NULL;
         
         return table;
-// Free argtable allocated for help display
     }
+    else if (strcmp(cmd_name, "batch") == 0) {
+        BatchArgTable args = get_args_table_batch();
+
+        *count = BATCH_ARGTABLE_COUNT;
+        void **table = ut_malloc(MEM_TAG_CLI, (BATCH_ARGTABLE_COUNT + 1) * sizeof(void*));
+        if (!table) {
+            arg_freetable(BATCH_ARGTABLE_ARRAY(args), BATCH_ARGTABLE_COUNT);
+            *count = 0;
+            return NULL;
+        }
+
+        table[0] = args.url_file;
+        table[1] = args.output_dir;
+        table[2] = args.jobs;
+        table[3] = args.workers;
+        table[4] = args.adaptive;
+        table[5] = args.per_host;
+        table[6] = args.hedge;
+        table[7] = args.circuits;
+        table[8] = args.probe;
+        table[9] = args.control;
+        table[10] = args.dns_cache;
+        table[11] = args.retries;
+        table[12] = args.connect_timeout;
+        table[13] = args.idle_timeout;
+        table[14] = args.max_time;
+        table[15] = args.end;
+        table[16] = args.cmd;
+        table[17] = args.header;
+        table[18] = args.max_redirs;
+        table[19] = args.follow;
+        table[20] = args.raw;
+        table[21] = args.content_only;
+        table[22] = args.verbose;
+        table[23] = args.cache_dir;
+        table[24] = args.write_out;
+        table[25] = args.proxy;
+        table[26] = args.socket;
+        table[27] = NULL;
+
+        return table;
+    }
+    else if (strcmp(cmd_name, "bench") == 0) {
+        BenchArgTable args = get_args_table_bench();
+
+        *count = BENCH_ARGTABLE_COUNT;
+        void **table = ut_malloc(MEM_TAG_CLI, (BENCH_ARGTABLE_COUNT + 1) * sizeof(void*));
+        if (!table) {
+            arg_freetable(BENCH_ARGTABLE_ARRAY(args), BENCH_ARGTABLE_COUNT);
+            *count = 0;
+            return NULL;
+        }
+
+        table[0] = args.urls;
+        table[1] = args.url_file;
+        table[2] = args.requests;
+        table[3] = args.jobs;
+        table[4] = args.rate;
+        table[5] = args.tokens;
+        table[6] = args.adaptive;
+        table[7] = args.per_host;
+        table[8] = args.hedge;
+        table[9] = args.circuits;
+        table[10] = args.probe;
+        table[11] = args.control;
+        table[12] = args.retries;
+        table[13] = args.connect_timeout;
+        table[14] = args.idle_timeout;
+        table[15] = args.max_time;
+        table[16] = args.end;
+        table[17] = args.cmd;
+        table[18] = args.header;
+        table[19] = args.max_redirs;
+        table[20] = args.follow;
+        table[21] = args.verbose;
+        table[22] = args.proxy;
+        table[23] = args.socket;
+        table[24] = NULL;
+
+        return table;
+    }
+// Free argtable allocated for help display
     
     return NULL;
 }
@@ -292,7 +578,7 @@ void free_help_table(void **table, int count) {
 // Process GET command arguments
     if (table) {
         arg_freetable(table, count);
-        free(table);
+        ut_free(table);
     }
 }
 
@@ -329,37 +615,32 @@ int cmd_get_proc (int argc, char *argv[], arg_dstr_t res, void *ctx) {
     if (args.common.output_file->count > 0) {
         args_info->options[OPTION_OUTPUT_FILE] = args.common.output_file->sval[0];
     }
+    if (args.common.cache_dir->count > 0) {
+        args_info->options[OPTION_CACHE_DIR] = args.common.cache_dir->sval[0];
+    }
+    if (args.common.write_out->count > 0) {
+        args_info->options[OPTION_WRITE_OUT] = args.common.write_out->sval[0];
+    }
     
-    if (args.common.header->count > 0) {
-        int count = args.common.header->count;
-        args_info->multi_options[MULTI_OPTION_HEADERS].count = 0;
-        args_info->multi_options[MULTI_OPTION_HEADERS].values = NULL;
-
-        char **values = malloc(sizeof(char*) * count);
-        if (!values) {
-            err = ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate memory for headers");
-            arg_dstr_catf(res, err.message);
-            exitcode = err.code;
-            goto exit_get;
-        }
-
-        for (int i = 0; i < count; i++) {
-            values[i] = ut_strdup(args.common.header->sval[i]);
-            if (!values[i]) {
-                // cleanup previously allocated strings
-                for (int j = 0; j < i; j++)
-                    free(values[j]);
-                free(values);
-
-                err = ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate memory for header value");
-                arg_dstr_catf(res, err.message);
-                exitcode = err.code;
-                goto exit_get;
-            }
-        }
-
-        args_info->multi_options[MULTI_OPTION_HEADERS].values = (const char **)values;
-        args_info->multi_options[MULTI_OPTION_HEADERS].count = count;
+    exitcode = store_headers(args.common.header, args_info, res);
+    if (exitcode != SUCCESS) {
+        goto exit_get;
+    }
+    exitcode = store_retries(args.common.retries, args_info, res);
+    if (exitcode != SUCCESS) {
+        goto exit_get;
+    }
+    exitcode = store_timeouts(args.common.connect_timeout, args.common.idle_timeout, args.common.max_time, args_info, res);
+    if (exitcode != SUCCESS) {
+        goto exit_get;
+    }
+    exitcode = store_proxies(args.common.proxy, args_info, res);
+    if (exitcode != SUCCESS) {
+        goto exit_get;
+    }
+    exitcode = store_socket(args.common.socket, args_info, res);
+    if (exitcode != SUCCESS) {
+        goto exit_get;
     }
     
     if (args.common.max_redirs->count > 0) {
@@ -380,6 +661,9 @@ int cmd_get_proc (int argc, char *argv[], arg_dstr_t res, void *ctx) {
     if (args.common.verbose->count > 0) {
         args_info->flags[FLAG_VERBOSE] = true;
     }
+    if (args.common.stream->count > 0) {
+        args_info->flags[FLAG_STREAM] = true;
+    }
 
 exit_get:
     arg_freetable(argtable, GET_ARGTABLE_COUNT);
@@ -427,37 +711,32 @@ int cmd_post_proc (int argc, char *argv[], arg_dstr_t res, void *ctx) {
     if (args.common.output_file->count > 0) {
         args_info->options[OPTION_OUTPUT_FILE] = args.common.output_file->sval[0];
     }
+    if (args.common.cache_dir->count > 0) {
+        args_info->options[OPTION_CACHE_DIR] = args.common.cache_dir->sval[0];
+    }
+    if (args.common.write_out->count > 0) {
+        args_info->options[OPTION_WRITE_OUT] = args.common.write_out->sval[0];
+    }
 
-    if (args.common.header->count > 0) {
-        int count = args.common.header->count;
-        args_info->multi_options[MULTI_OPTION_HEADERS].count = 0;
-        args_info->multi_options[MULTI_OPTION_HEADERS].values = NULL;
-
-        char **values = malloc(sizeof(char*) * count);
-        if (!values) {
-            err = ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate memory for headers");
-            arg_dstr_catf(res, err.message);
-            exitcode = err.code;
-            goto exit_post;
-        }
-
-        for (int i = 0; i < count; i++) {
-            values[i] = ut_strdup(args.common.header->sval[i]);
-            if (!values[i]) {
-                // cleanup previously allocated strings
-                for (int j = 0; j < i; j++)
-                    free(values[j]);
-                free(values);
-
-                err = ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate memory for header value");
-                arg_dstr_catf(res, err.message);
-                exitcode = err.code;
-                goto exit_post;
-            }
-        }
-
-        args_info->multi_options[MULTI_OPTION_HEADERS].values = (const char **)values;
-        args_info->multi_options[MULTI_OPTION_HEADERS].count = count;
+    exitcode = store_headers(args.common.header, args_info, res);
+    if (exitcode != SUCCESS) {
+        goto exit_post;
+    }
+    exitcode = store_retries(args.common.retries, args_info, res);
+    if (exitcode != SUCCESS) {
+        goto exit_post;
+    }
+    exitcode = store_timeouts(args.common.connect_timeout, args.common.idle_timeout, args.common.max_time, args_info, res);
+    if (exitcode != SUCCESS) {
+        goto exit_post;
+    }
+    exitcode = store_proxies(args.common.proxy, args_info, res);
+    if (exitcode != SUCCESS) {
+        goto exit_post;
+    }
+    exitcode = store_socket(args.common.socket, args_info, res);
+    if (exitcode != SUCCESS) {
+        goto exit_post;
     }
 
     if (args.common.max_redirs->count > 0) {
@@ -478,8 +757,455 @@ int cmd_post_proc (int argc, char *argv[], arg_dstr_t res, void *ctx) {
     if (args.common.verbose->count > 0) {
         args_info->flags[FLAG_VERBOSE] = true;
     }
+    if (args.common.stream->count > 0) {
+        args_info->flags[FLAG_STREAM] = true;
+    }
 
 exit_post:
     arg_freetable(argtable, POST_ARGTABLE_COUNT);
     return exitcode;
-}
\ No newline at end of file
+}
+
+// Process BATCH command arguments
+int cmd_batch_proc (int argc, char *argv[], arg_dstr_t res, void *ctx) {
+    BatchArgTable args = get_args_table_batch();
+
+    int exitcode = SUCCESS;
+    void **argtable = BATCH_ARGTABLE_ARRAY(args);
+
+    if (arg_nullcheck(argtable) != 0) {
+        arg_dstr_cat(res, "failed to allocate argtable");
+        exitcode = ERR_OUTOFMEMORY;
+        goto exit_batch;
+    }
+
+    int nerrors = arg_parse(argc, argv, argtable);
+    if (arg_make_syntax_err_help_msg(res, "batch", 0, nerrors, argtable, args.end, &exitcode)) {
+        arg_dstr_catf(res, "For more details, use '%s help <command>'", PROG_NAME);
+        goto exit_batch;
+    }
+
+    // Populate CliArgsInfo with parsed values
+    CliArgsInfo *args_info = (CliArgsInfo *)ctx;
+    args_info->cmd = CMD_BATCH;
+    args_info->options[OPTION_URL_FILE] = args.url_file->sval[0];
+
+    if (args.output_dir->count > 0) {
+        args_info->options[OPTION_OUTPUT_DIR] = args.output_dir->sval[0];
+    }
+    if (args.cache_dir->count > 0) {
+        args_info->options[OPTION_CACHE_DIR] = args.cache_dir->sval[0];
+    }
+    if (args.write_out->count > 0) {
+        args_info->options[OPTION_WRITE_OUT] = args.write_out->sval[0];
+    }
+
+    exitcode = store_headers(args.header, args_info, res);
+    if (exitcode != SUCCESS) {
+        goto exit_batch;
+    }
+
+    if (args.jobs->count > 0) {
+        if (args.jobs->ival[0] < 1) {
+            arg_dstr_catf(res, "--jobs must be at least 1");
+            exitcode = ERR_INVALID_ARGS;
+            goto exit_batch;
+        }
+        args_info->values[VAL_CONCURRENCY] = args.jobs->ival[0];
+    } else {
+        args_info->values[VAL_CONCURRENCY] = 8;
+    }
+
+    if (args.workers->count > 0) {
+        if (args.workers->ival[0] < 1) {
+            arg_dstr_catf(res, "--workers must be at least 1");
+            exitcode = ERR_INVALID_ARGS;
+            goto exit_batch;
+        }
+        args_info->values[VAL_WORKERS] = args.workers->ival[0];
+    }
+
+    if (args.per_host->count > 0) {
+        if (args.per_host->ival[0] < 1) {
+            arg_dstr_catf(res, "--per-host must be at least 1");
+            exitcode = ERR_INVALID_ARGS;
+            goto exit_batch;
+        }
+        args_info->values[VAL_PER_HOST] = args.per_host->ival[0];
+    }
+
+    if (args.hedge->count > 0) {
+        if (args.hedge->ival[0] < 1 || args.hedge->ival[0] > 99) {
+            arg_dstr_catf(res, "--hedge must be a percentile between 1 and 99");
+            exitcode = ERR_INVALID_ARGS;
+            goto exit_batch;
+        }
+        args_info->values[VAL_HEDGE] = args.hedge->ival[0];
+    }
+
+    exitcode = store_circuits(args.circuits, args.probe, args.control, args_info, res);
+    if (exitcode != SUCCESS) {
+        goto exit_batch;
+    }
+    if (args.dns_cache->count > 0) {
+        if (args.dns_cache->ival[0] < 1 || args.dns_cache->ival[0] > 86400) {
+            arg_dstr_catf(res, "--dns-cache must be between 1 and 86400 seconds");
+            exitcode = ERR_INVALID_ARGS;
+            goto exit_batch;
+        }
+        args_info->values[VAL_DNS_TTL] = args.dns_cache->ival[0];
+    }
+    exitcode = store_retries(args.retries, args_info, res);
+    if (exitcode != SUCCESS) {
+        goto exit_batch;
+    }
+    exitcode = store_timeouts(args.connect_timeout, args.idle_timeout, args.max_time, args_info, res);
+    if (exitcode != SUCCESS) {
+        goto exit_batch;
+    }
+    exitcode = store_proxies(args.proxy, args_info, res);
+    if (exitcode != SUCCESS) {
+        goto exit_batch;
+    }
+    exitcode = store_socket(args.socket, args_info, res);
+    if (exitcode != SUCCESS) {
+        goto exit_batch;
+    }
+
+    if (args.max_redirs->count > 0) {
+        args_info->values[VAL_MAX_REDIRECTS] = args.max_redirs->ival[0];
+    } else {
+        args_info->values[VAL_MAX_REDIRECTS] = 50;
+    }
+
+    if (args.follow->count > 0) {
+        args_info->flags[FLAG_FOLLOW] = true;
+    }
+    if (args.raw->count > 0) {
+        args_info->flags[FLAG_RAW] = true;
+    }
+    if (args.content_only->count > 0) {
+        args_info->flags[FLAG_CONTENT_ONLY] = true;
+    }
+    if (args.verbose->count > 0) {
+        args_info->flags[FLAG_VERBOSE] = true;
+    }
+    if (args.adaptive->count > 0) {
+        args_info->flags[FLAG_ADAPTIVE] = true;
+    }
+
+exit_batch:
+    arg_freetable(argtable, BATCH_ARGTABLE_COUNT);
+    return exitcode;
+}
+
+// Process BENCH command arguments
+int cmd_bench_proc (int argc, char *argv[], arg_dstr_t res, void *ctx) {
+    BenchArgTable args = get_args_table_bench();
+
+    int exitcode = SUCCESS;
+    void **argtable = BENCH_ARGTABLE_ARRAY(args);
+
+    if (arg_nullcheck(argtable) != 0) {
+        arg_dstr_cat(res, "failed to allocate argtable");
+        exitcode = ERR_OUTOFMEMORY;
+        goto exit_bench;
+    }
+
+    int nerrors = arg_parse(argc, argv, argtable);
+    if (arg_make_syntax_err_help_msg(res, "bench", 0, nerrors, argtable, args.end, &exitcode)) {
+        arg_dstr_catf(res, "For more details, use '%s help <command>'", PROG_NAME);
+        goto exit_bench;
+    }
+
+    if (args.urls->count == 0 && args.url_file->count == 0) {
+        arg_dstr_catf(res, "bench needs at least one <url> or --input <url_file>");
+        exitcode = ERR_INVALID_ARGS;
+        goto exit_bench;
+    }
+
+    // Populate CliArgsInfo with parsed values
+    CliArgsInfo *args_info = (CliArgsInfo *)ctx;
+    args_info->cmd = CMD_BENCH;
+
+    if (args.url_file->count > 0) {
+        args_info->options[OPTION_URL_FILE] = args.url_file->sval[0];
+    }
+
+    exitcode = store_headers(args.header, args_info, res);
+    if (exitcode != SUCCESS) {
+        goto exit_bench;
+    }
+    exitcode = store_strings(args.urls, MULTI_OPTION_URLS, args_info, res);
+    if (exitcode != SUCCESS) {
+        goto exit_bench;
+    }
+
+    args_info->values[VAL_REQUESTS] = args.requests->count > 0 ? args.requests->ival[0] : 100;
+    if (args_info->values[VAL_REQUESTS] < 1) {
+        arg_dstr_catf(res, "--requests must be at least 1");
+        exitcode = ERR_INVALID_ARGS;
+        goto exit_bench;
+    }
+
+    args_info->values[VAL_CONCURRENCY] = args.jobs->count > 0 ? args.jobs->ival[0] : 8;
+    if (args_info->values[VAL_CONCURRENCY] < 1) {
+        arg_dstr_catf(res, "--jobs must be at least 1");
+        exitcode = ERR_INVALID_ARGS;
+        goto exit_bench;
+    }
+
+    if (args.rate->count > 0) {
+        if (args.rate->ival[0] < 1) {
+            arg_dstr_catf(res, "--rate must be at least 1");
+            exitcode = ERR_INVALID_ARGS;
+            goto exit_bench;
+        }
+        args_info->values[VAL_RATE] = args.rate->ival[0];
+    }
+
+    if (args.tokens->count > 0) {
+        if (args.tokens->ival[0] < 1 || args.tokens->ival[0] > 1024) {
+            arg_dstr_catf(res, "--tokens must be between 1 and 1024");
+            exitcode = ERR_INVALID_ARGS;
+            goto exit_bench;
+        }
+        args_info->values[VAL_TOKENS] = args.tokens->ival[0];
+    }
+
+    if (args.per_host->count > 0) {
+        if (args.per_host->ival[0] < 1) {
+            arg_dstr_catf(res, "--per-host must be at least 1");
+            exitcode = ERR_INVALID_ARGS;
+            goto exit_bench;
+        }
+        args_info->values[VAL_PER_HOST] = args.per_host->ival[0];
+    }
+
+    if (args.hedge->count > 0) {
+        if (args.hedge->ival[0] < 1 || args.hedge->ival[0] > 99) {
+            arg_dstr_catf(res, "--hedge must be a percentile between 1 and 99");
+            exitcode = ERR_INVALID_ARGS;
+            goto exit_bench;
+        }
+        args_info->values[VAL_HEDGE] = args.hedge->ival[0];
+    }
+
+    exitcode = store_circuits(args.circuits, args.probe, args.control, args_info, res);
+    if (exitcode != SUCCESS) {
+        goto exit_bench;
+    }
+    if (args_info->values[VAL_TOKENS] > 0 && args_info->values[VAL_CIRCUITS] > 0) {
+        arg_dstr_catf(res, "--tokens and --circuits cannot be combined");
+        exitcode = ERR_INVALID_ARGS;
+        goto exit_bench;
+    }
+    exitcode = store_retries(args.retries, args_info, res);
+    if (exitcode != SUCCESS) {
+        goto exit_bench;
+    }
+    exitcode = store_timeouts(args.connect_timeout, args.idle_timeout, args.max_time, args_info, res);
+    if (exitcode != SUCCESS) {
+        goto exit_bench;
+    }
+    exitcode = store_proxies(args.proxy, args_info, res);
+    if (exitcode != SUCCESS) {
+        goto exit_bench;
+    }
+    exitcode = store_socket(args.socket, args_info, res);
+    if (exitcode != SUCCESS) {
+        goto exit_bench;
+    }
+
+    if (args.max_redirs->count > 0) {
+        args_info->values[VAL_MAX_REDIRECTS] = args.max_redirs->ival[0];
+    } else {
+        args_info->values[VAL_MAX_REDIRECTS] = 50;
+    }
+
+    if (args.follow->count > 0) {
+        args_info->flags[FLAG_FOLLOW] = true;
+    }
+    if (args.verbose->count > 0) {
+        args_info->flags[FLAG_VERBOSE] = true;
+    }
+    if (args.adaptive->count > 0) {
+        args_info->flags[FLAG_ADAPTIVE] = true;
+    }
+
+exit_bench:
+    arg_freetable(argtable, BENCH_ARGTABLE_COUNT);
+    return exitcode;
+}
+
+// Copy -H/--header values into CliArgsInfo (owned copies, released by cleanup_args)
+int store_headers(arg_str_t *header, CliArgsInfo *args_info, arg_dstr_t res) {
+    args_info->multi_options[MULTI_OPTION_HEADERS].count = 0;
+    args_info->multi_options[MULTI_OPTION_HEADERS].values = NULL;
+
+    if (header->count <= 0) {
+        return SUCCESS;
+    }
+
+    Error err;
+    int count = header->count;
+    char **values = ut_malloc(MEM_TAG_CLI, sizeof(char*) * count);
+    if (!values) {
+        err = ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate memory for headers");
+        arg_dstr_catf(res, err.message);
+        return err.code;
+    }
+
+    for (int i = 0; i < count; i++) {
+        values[i] = ut_strdup(header->sval[i]);
+        if (!values[i]) {
+            // cleanup previously allocated strings
+            for (int j = 0; j < i; j++)
+                ut_free(values[j]);
+            ut_free(values);
+
+            err = ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate memory for header value");
+            arg_dstr_catf(res, err.message);
+            return err.code;
+        }
+    }
+
+    args_info->multi_options[MULTI_OPTION_HEADERS].values = (const char **)values;
+    args_info->multi_options[MULTI_OPTION_HEADERS].count = count;
+    return SUCCESS;
+}
+
+// Store --retries, or the default when it is absent
+int store_retries(arg_int_t *retries, CliArgsInfo *args_info, arg_dstr_t res) {
+    if (retries->count == 0) {
+        args_info->values[VAL_RETRIES] = HTTP_RETRY_DEFAULT;
+        return SUCCESS;
+    }
+    if (retries->ival[0] < 0) {
+        arg_dstr_catf(res, "--retries must not be negative");
+        return ERR_INVALID_ARGS;
+    }
+    args_info->values[VAL_RETRIES] = retries->ival[0];
+    return SUCCESS;
+}
+
+// Store --circuits, --probe and --control (the last two only make sense with a pool)
+int store_circuits(arg_int_t *circuits, arg_str_t *probe, arg_str_t *control, CliArgsInfo *args_info, arg_dstr_t res) {
+    if (circuits->count > 0) {
+        if (circuits->ival[0] < 1 || circuits->ival[0] > CIRCUIT_MAX) {
+            arg_dstr_catf(res, "--circuits must be between 1 and %d", CIRCUIT_MAX);
+            return ERR_INVALID_ARGS;
+        }
+        args_info->values[VAL_CIRCUITS] = circuits->ival[0];
+    }
+    if (probe->count > 0) {
+        if (args_info->values[VAL_CIRCUITS] == 0) {
+            arg_dstr_catf(res, "--probe requires --circuits");
+            return ERR_INVALID_ARGS;
+        }
+        args_info->options[OPTION_PROBE_URL] = probe->sval[0];
+    }
+    if (control->count > 0) {
+        if (args_info->values[VAL_CIRCUITS] == 0) {
+            arg_dstr_catf(res, "--control requires --circuits");
+            return ERR_INVALID_ARGS;
+        }
+        args_info->options[OPTION_CONTROL] = control->sval[0];
+    }
+    return SUCCESS;
+}
+
+// Store --connect-timeout, --idle-timeout and --max-time in milliseconds, or their defaults
+int store_timeouts(arg_dbl_t *connect_timeout, arg_dbl_t *idle_timeout, arg_dbl_t *max_time, CliArgsInfo *args_info, arg_dstr_t res) {
+    struct { arg_dbl_t *arg; const char *name; ValuesIndex index; int fallback_ms; } timeouts[] = {
+        { connect_timeout, "--connect-timeout", VAL_CONNECT_TIMEOUT, HTTP_DEFAULT_CONNECT_TIMEOUT_MS },
+        { idle_timeout,    "--idle-timeout",    VAL_IDLE_TIMEOUT,    HTTP_DEFAULT_IDLE_TIMEOUT_MS },
+        { max_time,        "--max-time",        VAL_MAX_TIME,        0 },
+    };
+    for (size_t i = 0; i < sizeof(timeouts) / sizeof(timeouts[0]); i++) {
+        if (timeouts[i].arg->count == 0) {
+            args_info->values[timeouts[i].index] = timeouts[i].fallback_ms;
+            continue;
+        }
+        double seconds = timeouts[i].arg->dval[0];
+        if (!(seconds > 0) || seconds > INT_MAX / 1000) {
+            arg_dstr_catf(res, "%s must be a positive number of seconds", timeouts[i].name);
+            return ERR_INVALID_ARGS;
+        }
+        int ms = (int)(seconds * 1000);
+        args_info->values[timeouts[i].index] = ms > 0 ? ms : 1;
+    }
+    return SUCCESS;
+}
+
+HttpTimeouts get_timeouts(const CliArgsInfo *args_info) {
+    HttpTimeouts timeouts = {
+        .connect_ms   = (uint32_t)args_info->values[VAL_CONNECT_TIMEOUT],
+        .handshake_ms = (uint32_t)args_info->values[VAL_CONNECT_TIMEOUT],
+        .ttfb_ms      = (uint32_t)args_info->values[VAL_IDLE_TIMEOUT],
+        .idle_ms      = (uint32_t)args_info->values[VAL_IDLE_TIMEOUT],
+        .total_ms     = (uint32_t)args_info->values[VAL_MAX_TIME],
+    };
+    return timeouts;
+}
+
+// Copy the values of a multi-value option into CliArgsInfo (owned copies, released by cleanup_args)
+int store_strings(arg_str_t *arg, MultiOptionsIndex index, CliArgsInfo *args_info, arg_dstr_t res) {
+    args_info->multi_options[index].count = 0;
+    args_info->multi_options[index].values = NULL;
+
+    if (arg->count <= 0) {
+        return SUCCESS;
+    }
+
+    char **values = ut_calloc(MEM_TAG_CLI, (size_t)arg->count, sizeof(char*));
+    if (!values) {
+        arg_dstr_catf(res, "Failed to allocate memory for option values");
+        return ERR_OUTOFMEMORY;
+    }
+
+    for (int i = 0; i < arg->count; i++) {
+        values[i] = ut_strdup(arg->sval[i]);
+        if (!values[i]) {
+            for (int j = 0; j < i; j++)
+                ut_free(values[j]);
+            ut_free(values);
+
+            arg_dstr_catf(res, "Failed to allocate memory for option value");
+            return ERR_OUTOFMEMORY;
+        }
+    }
+
+    args_info->multi_options[index].values = (const char **)values;
+    args_info->multi_options[index].count = arg->count;
+    return SUCCESS;
+}
+
+// Check every --proxy endpoint, then keep them for http_set_proxies()
+int store_proxies(arg_str_t *proxy, CliArgsInfo *args_info, arg_dstr_t res) {
+    for (int i = 0; i < proxy->count; i++) {
+        char host[HTTP_PROXY_NAME_MAX];
+        uint16_t port = 0;
+        Error err = http_proxy_parse(proxy->sval[i], host, sizeof(host), &port);
+        if (ERR_FAILED(err)) {
+            arg_dstr_catf(res, "--proxy: %s", err.message);
+            return err.code;
+        }
+    }
+    return store_strings(proxy, MULTI_OPTION_PROXIES, args_info, res);
+}
+
+// Check --socket, then keep it for net_set_sockopts()
+int store_socket(arg_str_t *socket, CliArgsInfo *args_info, arg_dstr_t res) {
+    if (socket->count == 0) {
+        return SUCCESS;
+    }
+    NetSockOpts opts;
+    Error err = net_sockopts_parse(socket->sval[0], &opts);
+    if (ERR_FAILED(err)) {
+        arg_dstr_catf(res, "--socket: %s", err.message);
+        return err.code;
+    }
+    args_info->options[OPTION_SOCKET] = socket->sval[0];
+    return SUCCESS;
+}
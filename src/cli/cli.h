@@ -25,10 +25,10 @@
 #define MAX_FLAG_COUNT     6
 
 /** Maximum number of integer values in CliArgsInfo */
-#define MAX_VALUE_COUNT    6
+#define MAX_VALUE_COUNT    14
 
 /** Maximum number of string options in CliArgsInfo */
-#define MAX_OPTION_COUNT   8
+#define MAX_OPTION_COUNT   10
 
 /** Maximum number of multi-value options in CliArgsInfo */
 #define MAX_MULTI_OPTION_COUNT   6
@@ -45,6 +45,8 @@
 typedef enum {
     CMD_GET,   // HTTP GET request
     CMD_POST,  // HTTP POST request
+    CMD_BATCH, // Concurrent HTTP GET requests for a list of URLs
+    CMD_BENCH, // Load generation against a set of URLs
 } Command;
 
 /**
@@ -57,6 +59,13 @@ typedef enum {
     OPTION_BODY,         // POST request body content
     OPTION_INPUT_FILE,   // Input file path for POST body
     OPTION_OUTPUT_FILE,  // Output file path for response storage
+    OPTION_URL_FILE,     // File listing one URL per line (batch)
+    OPTION_OUTPUT_DIR,   // Directory for per-URL responses (batch)
+    OPTION_CACHE_DIR,    // Directory of the on-disk response cache
+    OPTION_WRITE_OUT,    // --write-out template printed after each request
+    OPTION_PROBE_URL,    // URL fetched by the circuit prober (batch, bench)
+    OPTION_CONTROL,      // Tor ControlPort "[host:]port" used by the circuit prober (batch, bench)
+    OPTION_SOCKET,       // Socket tuning "profile[,option=value...]" of the connections to Tor
 } OptionsIndex;
 
 /**
@@ -67,6 +76,19 @@ typedef enum {
  */
 typedef enum {
     VAL_MAX_REDIRECTS,  // Maximum number of HTTP redirects to follow
+    VAL_CONCURRENCY,    // Maximum number of requests in flight (batch)
+    VAL_WORKERS,        // Post-processing worker threads, 0 = core count (batch)
+    VAL_REQUESTS,       // Total number of requests to issue (bench)
+    VAL_RATE,           // Fixed arrival rate in requests/s, 0 = closed loop (bench)
+    VAL_TOKENS,         // Number of circuit isolation tokens to spread requests over (bench)
+    VAL_PER_HOST,       // Maximum requests in flight per destination, 0 = no limit (batch, bench)
+    VAL_HEDGE,          // TTFB percentile after which slow GETs are duplicated, 0 = off (batch, bench)
+    VAL_RETRIES,        // Retries of transient failures per request, each on a new circuit
+    VAL_CONNECT_TIMEOUT,// Milliseconds for the Tor SOCKS port connect and for the SOCKS reply
+    VAL_IDLE_TIMEOUT,   // Milliseconds until the first response byte and between later bytes
+    VAL_MAX_TIME,       // Milliseconds for each attempt of a request including redirects, 0 = no limit
+    VAL_CIRCUITS,       // Size of the probed circuit pool requests are routed over, 0 = off (batch, bench)
+    VAL_DNS_TTL,        // Seconds hostnames resolved ahead through Tor are connected to by address, 0 = off (batch)
 } ValuesIndex;
 
 /**
@@ -80,6 +102,8 @@ typedef enum {
     FLAG_FOLLOW,        // Follow HTTP redirect responses
     FLAG_VERBOSE,       // Display verbose diagnostic output
     FLAG_CONTENT_ONLY,  // Display only response body (no headers)
+    FLAG_STREAM,        // Stream the response instead of buffering it
+    FLAG_ADAPTIVE,      // Adapt the in-flight limit to observed latency (batch, bench)
 } FlagsIndex;
 
 /**
@@ -90,6 +114,8 @@ typedef enum {
  */
 typedef enum {
     MULTI_OPTION_HEADERS,  // HTTP headers to include in request
+    MULTI_OPTION_URLS,     // Target URLs (bench)
+    MULTI_OPTION_PROXIES,  // Tor SOCKS endpoints requests are balanced over (--proxy)
     MULTI_OPTION_COUNT,   // Number of multi-value options (for bounds checking)
 } MultiOptionsIndex;
 
@@ -199,4 +225,17 @@ void get_help();
  */
 Error parse_arguments(int argc, char *argv[], CliArgsInfo *args_info);
 
+/**
+ * get_timeouts - Per-phase timeouts of a request from the parsed options
+ *
+ * --connect-timeout bounds the Tor SOCKS port connect and the SOCKS reply,
+ * --idle-timeout the wait for the first response byte and every later gap,
+ * --max-time each attempt of the request across redirects.
+ *
+ * @param args_info   Parsed arguments (after parse_arguments succeeded)
+ *
+ * @return            Timeouts in milliseconds for HttpRequest.timeouts
+ */
+HttpTimeouts get_timeouts(const CliArgsInfo *args_info);
+
 #endif
\ No newline at end of file
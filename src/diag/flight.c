@@ -0,0 +1,311 @@
+/*
+    File: src/diag/flight.c
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference:
+        - signal-safety(7): https://man7.org/linux/man-pages/man7/signal-safety.7.html
+    Description:
+        Per-thread event rings of the flight recorder and their decoder.
+
+        A thread claims a ring on its first event: first a ring released
+        by a thread that has exited (POSIX thread-specific data destructor),
+        otherwise a new one pushed onto the global list with a CAS. Only
+        the owner writes a ring; the write index is published with a
+        release store, so the dumper reads whole events except for the
+        few being overwritten at that moment. Rings are never freed.
+
+        The dump formats into a stack buffer and writes it with write(2),
+        which keeps it usable from the SIGUSR1 handler.
+*/
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#endif
+
+#include <stdatomic.h>
+#include "diag/flight.h"
+#include "util/util.h"
+
+typedef struct FlightEvent {
+    uint64_t ts_ns;
+    uint64_t bytes;
+    int32_t fd;
+    int32_t code;
+    uint8_t phase;
+} FlightEvent;
+
+typedef struct FlightRing {
+    struct FlightRing *next;
+    atomic_bool in_use;         // false once the owning thread has exited
+    atomic_uint tid;
+    atomic_size_t head;         // events written; the slot is head % FLIGHT_RING_EVENTS
+    FlightEvent events[FLIGHT_RING_EVENTS];
+} FlightRing;
+
+/* How the dump labels the fields of each phase (NULL = not shown) */
+typedef struct FlightPhaseInfo {
+    const char *name;
+    const char *bytes_label;
+    const char *code_label;
+} FlightPhaseInfo;
+
+/* Line being formatted by the dump (no stdio: must stay signal-safe) */
+typedef struct FlightLine {
+    char buf[256];
+    size_t len;
+} FlightLine;
+
+static const FlightPhaseInfo phase_info[FLIGHT_PHASE_COUNT] = {
+    [FLIGHT_CONNECT]       = { "connect",       NULL,    "errno"  },
+    [FLIGHT_CONNECT_START] = { "connect_start", NULL,    NULL     },
+    [FLIGHT_SEND]          = { "send",          "bytes", NULL     },
+    [FLIGHT_RECV]          = { "recv",          "bytes", NULL     },
+    [FLIGHT_EOF]           = { "eof",           NULL,    NULL     },
+    [FLIGHT_CLOSE]         = { "close",         NULL,    NULL     },
+    [FLIGHT_SOCKS_REPLY]   = { "socks_reply",   "len",   "cd"     },
+    [FLIGHT_HOP]           = { "hop",           "hop",   NULL     },
+    [FLIGHT_STATUS]        = { "status",        NULL,    "status" },
+    [FLIGHT_REDIRECT]      = { "redirect",      "count", "status" },
+    [FLIGHT_ERROR]         = { "error",         NULL,    "code"   },
+    [FLIGHT_RETRY]         = { "retry",         "retry", "code"   },
+};
+
+static _Atomic(FlightRing *) flight_rings = NULL;
+static atomic_uint flight_next_tid = 1;
+static _Thread_local FlightRing *flight_local = NULL;
+
+#ifndef _WIN32
+static pthread_key_t flight_key;
+static pthread_once_t flight_key_once = PTHREAD_ONCE_INIT;
+#endif
+
+/* Function Prototypes */
+static FlightRing *flight_ring(void);
+static void flight_track_exit(FlightRing *ring);
+static void line_str(FlightLine *l, const char *s);
+static void line_uint(FlightLine *l, uint64_t v, int min_digits);
+static void line_int(FlightLine *l, int64_t v);
+static void line_flush(FlightLine *l);
+
+void flight_record(FlightPhase phase, int fd, uint64_t bytes, int code) {
+    FlightRing *ring = flight_ring();
+    if (!ring) {
+        return;
+    }
+
+    uint64_t now = ut_now_ns();
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    // A stream of sends or receives on one socket is a single event: keeps the ring for context
+    if ((phase == FLIGHT_SEND || phase == FLIGHT_RECV) && head > 0) {
+        FlightEvent *last = &ring->events[(head - 1) % FLIGHT_RING_EVENTS];
+        if (last->phase == phase && last->fd == fd) {
+            last->bytes += bytes;
+            last->ts_ns = now;
+            return;
+        }
+    }
+
+    FlightEvent *ev = &ring->events[head % FLIGHT_RING_EVENTS];
+    ev->ts_ns = now;
+    ev->bytes = bytes;
+    ev->fd = fd;
+    ev->code = code;
+    ev->phase = (uint8_t)phase;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+void flight_dump(void) {
+    FlightLine l = {0};
+    uint64_t now = ut_now_ns();
+
+    line_str(&l, PROG_NAME ": flight recorder (oldest first, ms before now)\n");
+    line_flush(&l);
+
+    for (FlightRing *ring = atomic_load(&flight_rings); ring; ring = ring->next) {
+        size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if (head == 0) {
+            continue;
+        }
+        size_t first = head > FLIGHT_RING_EVENTS ? head - FLIGHT_RING_EVENTS : 0;
+
+        line_str(&l, "  thread ");
+        line_uint(&l, atomic_load(&ring->tid), 1);
+        line_str(&l, atomic_load(&ring->in_use) ? "" : " (exited)");
+        if (first > 0) {
+            line_str(&l, ", ");
+            line_uint(&l, first, 1);
+            line_str(&l, " older events overwritten");
+        }
+        line_str(&l, "\n");
+        line_flush(&l);
+
+        for (size_t i = first; i < head; i++) {
+            FlightEvent ev = ring->events[i % FLIGHT_RING_EVENTS];
+            if (ev.phase >= FLIGHT_PHASE_COUNT) {
+                continue; // torn by a concurrent write
+            }
+            const FlightPhaseInfo *info = &phase_info[ev.phase];
+            uint64_t ago_us = now > ev.ts_ns ? (now - ev.ts_ns) / 1000 : 0;
+
+            line_str(&l, "    -");
+            line_uint(&l, ago_us / 1000, 1);
+            line_str(&l, ".");
+            line_uint(&l, ago_us % 1000, 3);
+            line_str(&l, "  ");
+            line_str(&l, info->name);
+            if (ev.fd >= 0) {
+                line_str(&l, " fd=");
+                line_int(&l, ev.fd);
+            }
+            if (info->bytes_label) {
+                line_str(&l, " ");
+                line_str(&l, info->bytes_label);
+                line_str(&l, "=");
+                line_uint(&l, ev.bytes, 1);
+            }
+            if (info->code_label) {
+                line_str(&l, " ");
+                line_str(&l, info->code_label);
+                line_str(&l, "=");
+                line_int(&l, ev.code);
+            }
+            if ((ev.phase == FLIGHT_ERROR || ev.phase == FLIGHT_RETRY) && ev.code >= 0 && ev.code < ERR_COUNT) {
+                line_str(&l, " (");
+                line_str(&l, err_get_base_message((ErrorCode)ev.code));
+                line_str(&l, ")");
+            }
+            line_str(&l, "\n");
+            line_flush(&l);
+        }
+    }
+}
+
+#ifdef SIGUSR1
+static void flight_on_signal(int sig) {
+    (void)sig;
+    int saved_errno = errno;
+    flight_dump();
+    errno = saved_errno;
+}
+
+void flight_install_signal(void) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = flight_on_signal;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &sa, NULL);
+}
+#else
+void flight_install_signal(void) {
+    /* no SIGUSR1 on this platform */
+}
+#endif
+
+/* Internal helper functions */
+
+static FlightRing *flight_ring(void) {
+    if (flight_local) {
+        return flight_local;
+    }
+
+    FlightRing *ring = NULL;
+    for (FlightRing *r = atomic_load(&flight_rings); r; r = r->next) {
+        bool expected = false;
+        if (atomic_compare_exchange_strong(&r->in_use, &expected, true)) {
+            ring = r;
+            atomic_store(&ring->head, 0);
+            break;
+        }
+    }
+
+    if (!ring) {
+        ring = malloc(sizeof(FlightRing));
+        if (!ring) {
+            return NULL;
+        }
+        atomic_init(&ring->in_use, true);
+        atomic_init(&ring->tid, 0);
+        atomic_init(&ring->head, 0);
+
+        ring->next = atomic_load(&flight_rings);
+        while (!atomic_compare_exchange_weak(&flight_rings, &ring->next, ring)) {
+            // ring->next now holds the current head: retry
+        }
+    }
+
+    atomic_store(&ring->tid, atomic_fetch_add(&flight_next_tid, 1));
+    flight_local = ring;
+    flight_track_exit(ring);
+    return ring;
+}
+
+#ifndef _WIN32
+static void flight_release(void *arg) {
+    atomic_store(&((FlightRing *)arg)->in_use, false);
+}
+
+static void flight_key_create(void) {
+    pthread_key_create(&flight_key, flight_release);
+}
+
+// Hand the ring back when the thread exits (the main thread's ring is never released)
+static void flight_track_exit(FlightRing *ring) {
+    pthread_once(&flight_key_once, flight_key_create);
+    pthread_setspecific(flight_key, ring);
+}
+#else
+static void flight_track_exit(FlightRing *ring) {
+    (void)ring; // no destructor hook without FLS: rings of exited threads are not reused
+}
+#endif
+
+static void line_str(FlightLine *l, const char *s) {
+    while (*s && l->len < sizeof(l->buf)) {
+        l->buf[l->len++] = *s++;
+    }
+}
+
+static void line_uint(FlightLine *l, uint64_t v, int min_digits) {
+    char digits[20];
+    int n = 0;
+    do {
+        digits[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v > 0);
+    while (n < min_digits) {
+        digits[n++] = '0';
+    }
+    while (n > 0 && l->len < sizeof(l->buf)) {
+        l->buf[l->len++] = digits[--n];
+    }
+}
+
+static void line_int(FlightLine *l, int64_t v) {
+    if (v < 0) {
+        line_str(l, "-");
+        line_uint(l, (uint64_t)0 - (uint64_t)v, 1);
+    } else {
+        line_uint(l, (uint64_t)v, 1);
+    }
+}
+
+static void line_flush(FlightLine *l) {
+#ifndef _WIN32
+    size_t off = 0;
+    while (off < l->len) {
+        ssize_t n = write(STDERR_FILENO, l->buf + off, l->len - off);
+        if (n <= 0) {
+            break;
+        }
+        off += (size_t)n;
+    }
+#else
+    fwrite(l->buf, 1, l->len, stderr);
+#endif
+    l->len = 0;
+}
@@ -0,0 +1,65 @@
+/*
+    File: src/diag/flight.h
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference: None
+    Description:
+        Always-on flight recorder. Every thread owns a small ring of
+        compact binary events (phase, fd, byte count, code, timestamp)
+        written without locks; the last FLIGHT_RING_EVENTS events per
+        thread survive, so when a request fails the steps that led to it
+        can be replayed even though get_err_msg() only has the message
+        chain.
+
+        err_create() records every new error, so SOCKS rejects, bad
+        responses and redirect loops show up next to the socket events
+        that preceded them. main() dumps the rings when an error reaches
+        it, and the long-running modes dump them on SIGUSR1.
+*/
+
+#ifndef TORILATE_FLIGHT_H
+#define TORILATE_FLIGHT_H
+
+#include <stdint.h>
+
+#define FLIGHT_RING_EVENTS  256     // per thread, power of two
+
+typedef enum {
+    FLIGHT_CONNECT,         // fd, code = errno (0 on success)
+    FLIGHT_CONNECT_START,   // fd of a non-blocking connect in progress
+    FLIGHT_SEND,            // fd, bytes (back-to-back sends on one fd are merged)
+    FLIGHT_RECV,            // fd, bytes (merged like sends)
+    FLIGHT_EOF,             // fd, peer closed the connection
+    FLIGHT_CLOSE,           // fd
+    FLIGHT_SOCKS_REPLY,     // bytes = reply length, code = reply code (90 granted, 91-93 rejected)
+    FLIGHT_HOP,             // bytes = hop number of the request
+    FLIGHT_STATUS,          // fd, code = HTTP status of a hop
+    FLIGHT_REDIRECT,        // bytes = redirects followed so far, code = redirect status
+    FLIGHT_ERROR,           // code = ErrorCode (recorded by err_create)
+    FLIGHT_RETRY,           // bytes = retry number of the request, code = ErrorCode of the failed attempt
+    FLIGHT_PHASE_COUNT
+} FlightPhase;
+
+
+/*
+ * Append an event to the calling thread's ring (allocated on first use;
+ * rings of exited threads are reused).
+ *
+ *  @param phase  what happened
+ *  @param fd     socket involved, or -1
+ *  @param bytes  byte count or ordinal, depending on the phase
+ *  @param code   errno, status or error code, depending on the phase
+ */
+void flight_record(FlightPhase phase, int fd, uint64_t bytes, int code);
+
+/*
+ * Decode every ring to stderr, oldest event first, timestamps relative
+ * to the dump. Uses no locks and no stdio on POSIX, so it may run in a
+ * signal handler; events being written concurrently may appear torn.
+ */
+void flight_dump(void);
+
+/* Dump the rings whenever SIGUSR1 arrives (no-op where SIGUSR1 does not exist) */
+void flight_install_signal(void);
+
+#endif
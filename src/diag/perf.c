@@ -0,0 +1,242 @@
+/*
+    File: src/diag/perf.c
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference:
+        - perf_event_open(2): https://man7.org/linux/man-pages/man2/perf_event_open.2.html
+    Description:
+        Per-thread perf_event counter groups and the per-phase summary.
+
+        Counters measure the calling thread only (pid 0, any CPU) in user
+        space, which is what perf_event_paranoid <= 2 allows an
+        unprivileged process. The events are one group led by the
+        task-clock software counter so a single read(2) returns
+        consistent values. Hardware counters the machine lacks (no PMU
+        in most VMs) are left out of the group and shown as "-", leaving
+        at least CPU time per phase. A thread's group is closed when the
+        thread exits.
+*/
+
+#ifdef __linux__
+#define _DEFAULT_SOURCE     // syscall()
+#endif
+
+#include "diag/perf.h"
+
+#ifdef __linux__
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "torilate.h"
+
+typedef enum { PERF_THREAD_NEW, PERF_THREAD_OPEN, PERF_THREAD_FAILED } PerfThreadState;
+
+typedef struct PerfThread {
+    PerfThreadState state;
+    int fds[PERF_COUNTER_COUNT];
+    int slot[PERF_COUNTER_COUNT];   // position in the group read, -1 if not opened
+    int opened;
+} PerfThread;
+
+static const struct { uint32_t type; uint64_t config; } counter_events[PERF_COUNTER_COUNT] = {
+    [PERF_TASK_CLOCK]    = { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+    [PERF_CYCLES]        = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    [PERF_INSTRUCTIONS]  = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    [PERF_CACHE_MISSES]  = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    [PERF_BRANCH_MISSES] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+};
+
+static const char *phase_names[PERF_PHASE_COUNT] = {
+    [PERF_PARSE]  = "parse",
+    [PERF_BUILD]  = "build",
+    [PERF_DECODE] = "decode",
+    [PERF_OUTPUT] = "output",
+};
+
+static atomic_bool perf_enabled = false;
+static atomic_int perf_open_errno = 0;                  // first failure to open a group
+static atomic_bool counter_seen[PERF_COUNTER_COUNT];    // opened by at least one thread
+static atomic_uint_fast64_t phase_calls[PERF_PHASE_COUNT];
+static atomic_uint_fast64_t phase_totals[PERF_PHASE_COUNT][PERF_COUNTER_COUNT];
+
+static _Thread_local PerfThread perf_thread;
+static pthread_key_t perf_key;
+static pthread_once_t perf_key_once = PTHREAD_ONCE_INIT;
+
+/* Function Prototypes */
+static PerfThread *perf_thread_open(void);
+static int perf_event_open(uint32_t type, uint64_t config, int group_fd);
+static bool perf_read(PerfThread *t, uint64_t values[PERF_COUNTER_COUNT]);
+static void perf_thread_close(void *arg);
+static void perf_key_create(void);
+static void perf_summary(void);
+
+void perf_init(void) {
+    const char *env = getenv("TORILATE_PERF");
+    if (!env || !env[0] || strcmp(env, "0") == 0) {
+        return;
+    }
+    atomic_store(&perf_enabled, true);
+    atexit(perf_summary);
+}
+
+void perf_begin(PerfMark *mark) {
+    mark->valid = false;
+    if (!atomic_load_explicit(&perf_enabled, memory_order_relaxed)) {
+        return;
+    }
+    PerfThread *t = perf_thread_open();
+    if (t) {
+        mark->valid = perf_read(t, mark->values);
+    }
+}
+
+void perf_end(PerfPhase phase, const PerfMark *mark) {
+    uint64_t now[PERF_COUNTER_COUNT];
+    if (!mark->valid || !perf_read(&perf_thread, now)) {
+        return;
+    }
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+        atomic_fetch_add_explicit(&phase_totals[phase][c], now[c] - mark->values[c], memory_order_relaxed);
+    }
+    atomic_fetch_add_explicit(&phase_calls[phase], 1, memory_order_relaxed);
+}
+
+/* Internal helper functions */
+
+static PerfThread *perf_thread_open(void) {
+    PerfThread *t = &perf_thread;
+    if (t->state == PERF_THREAD_OPEN) {
+        return t;
+    }
+    if (t->state == PERF_THREAD_FAILED) {
+        return NULL;
+    }
+
+    int leader = -1;
+    t->opened = 0;
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+        t->slot[c] = -1;
+        t->fds[c] = perf_event_open(counter_events[c].type, counter_events[c].config, leader);
+        if (t->fds[c] < 0) {
+            if (c == PERF_TASK_CLOCK) {
+                int expected = 0;
+                atomic_compare_exchange_strong(&perf_open_errno, &expected, errno);
+                t->state = PERF_THREAD_FAILED;
+                return NULL;
+            }
+            continue; // counter not supported: leave it out of the group
+        }
+        if (c == PERF_TASK_CLOCK) {
+            leader = t->fds[c];
+        }
+        t->slot[c] = t->opened++;
+        atomic_store(&counter_seen[c], true);
+    }
+
+    t->state = PERF_THREAD_OPEN;
+    pthread_once(&perf_key_once, perf_key_create);
+    pthread_setspecific(perf_key, t);
+    return t;
+}
+
+static int perf_event_open(uint32_t type, uint64_t config, int group_fd) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = type;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.read_format = PERF_FORMAT_GROUP;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC);
+}
+
+// One read of the group leader returns { nr, value[nr] } in the order the events were opened
+static bool perf_read(PerfThread *t, uint64_t values[PERF_COUNTER_COUNT]) {
+    uint64_t buf[1 + PERF_COUNTER_COUNT];
+    ssize_t n = read(t->fds[PERF_TASK_CLOCK], buf, sizeof(buf));
+    if (n < (ssize_t)sizeof(uint64_t) || buf[0] != (uint64_t)t->opened) {
+        return false;
+    }
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+        values[c] = t->slot[c] >= 0 ? buf[1 + t->slot[c]] : 0;
+    }
+    return true;
+}
+
+static void perf_thread_close(void *arg) {
+    PerfThread *t = (PerfThread *)arg;
+    for (int c = PERF_COUNTER_COUNT - 1; c >= 0; c--) {
+        if (t->slot[c] >= 0) {
+            close(t->fds[c]);
+        }
+    }
+    t->state = PERF_THREAD_NEW;
+}
+
+static void perf_key_create(void) {
+    pthread_key_create(&perf_key, perf_thread_close);
+}
+
+static void perf_summary(void) {
+    int open_errno = atomic_load(&perf_open_errno);
+    if (!atomic_load(&counter_seen[PERF_TASK_CLOCK])) {
+        if (open_errno != 0) {
+            fprintf(stderr, "%s: perf counters unavailable: perf_event_open failed (%s)\n", PROG_NAME, strerror(open_errno));
+        }
+        return;
+    }
+
+    fprintf(stderr, "\n%s: perf counters per phase (user space, all threads)\n", PROG_NAME);
+    fprintf(stderr, "  %-8s %10s %12s %16s %16s %6s %14s %14s\n", "phase", "calls", "cpu ms", "cycles", "instructions", "IPC", "cache-misses", "branch-misses");
+    for (int p = 0; p < PERF_PHASE_COUNT; p++) {
+        uint64_t v[PERF_COUNTER_COUNT];
+        for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+            v[c] = atomic_load(&phase_totals[p][c]);
+        }
+
+        char cells[PERF_COUNTER_COUNT][24];
+        for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+            if (atomic_load(&counter_seen[c])) {
+                snprintf(cells[c], sizeof(cells[c]), "%llu", (unsigned long long)v[c]);
+            } else {
+                snprintf(cells[c], sizeof(cells[c]), "-");
+            }
+        }
+        char ipc[16] = "-";
+        if (atomic_load(&counter_seen[PERF_INSTRUCTIONS]) && atomic_load(&counter_seen[PERF_CYCLES]) && v[PERF_CYCLES] > 0) {
+            snprintf(ipc, sizeof(ipc), "%.2f", (double)v[PERF_INSTRUCTIONS] / (double)v[PERF_CYCLES]);
+        }
+
+        fprintf(stderr, "  %-8s %10llu %12.3f %16s %16s %6s %14s %14s\n", phase_names[p],
+                (unsigned long long)atomic_load(&phase_calls[p]),
+                (double)v[PERF_TASK_CLOCK] / 1e6,
+                cells[PERF_CYCLES], cells[PERF_INSTRUCTIONS], ipc,
+                cells[PERF_CACHE_MISSES], cells[PERF_BRANCH_MISSES]);
+    }
+}
+
+#else
+
+void perf_init(void) {
+    /* perf_event_open is Linux-only */
+}
+
+void perf_begin(PerfMark *mark) {
+    mark->valid = false;
+}
+
+void perf_end(PerfPhase phase, const PerfMark *mark) {
+    (void)phase;
+    (void)mark;
+}
+
+#endif
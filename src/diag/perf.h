@@ -0,0 +1,60 @@
+/*
+    File: src/diag/perf.h
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference:
+        - perf_event_open(2): https://man7.org/linux/man-pages/man2/perf_event_open.2.html
+    Description:
+        Opt-in hardware performance counters attributed to the CPU-bound
+        phases of a request: response parsing, request building, body
+        decoding (de-chunking) and output. Set TORILATE_PERF=1 and each
+        thread opens a task-clock / cycles / instructions / cache-miss /
+        branch-miss counter group on its first phase; perf_end() adds the
+        deltas to process-wide totals, printed per phase to stderr at exit.
+
+        Linux only; elsewhere, when the variable is unset, or when the
+        kernel refuses the counters (perf_event_paranoid > 2)
+        perf_begin()/perf_end() return at once. Without a PMU (most VMs)
+        only CPU time is reported.
+*/
+
+#ifndef TORILATE_PERF_H
+#define TORILATE_PERF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+    PERF_PARSE,         // parse_http_response
+    PERF_BUILD,         // http_build_request
+    PERF_DECODE,        // streaming framer (header scan, de-chunking)
+    PERF_OUTPUT,        // writes to files, stdout and stream sinks
+    PERF_PHASE_COUNT
+} PerfPhase;
+
+typedef enum {
+    PERF_TASK_CLOCK,    // CPU time in ns (software counter: works without a PMU)
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_CACHE_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_COUNTER_COUNT
+} PerfCounter;
+
+/* Counter readings at the start of a phase */
+typedef struct PerfMark {
+    bool valid;
+    uint64_t values[PERF_COUNTER_COUNT];
+} PerfMark;
+
+
+/* Enable the counters if TORILATE_PERF is set, and print the summary at exit */
+void perf_init(void);
+
+/* Read the calling thread's counters into mark (mark->valid is false when disabled) */
+void perf_begin(PerfMark *mark);
+
+/* Charge the counts since perf_begin() to a phase */
+void perf_end(PerfPhase phase, const PerfMark *mark);
+
+#endif
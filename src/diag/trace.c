@@ -0,0 +1,192 @@
+/*
+    File: src/diag/trace.c
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference:
+        - Trace Event Format: https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU
+        - Intel SDM Vol. 3B, 17.17 (invariant TSC)
+    Description:
+        Per-thread trace buffers and the Chrome trace-event JSON writer.
+        Only built with TORILATE_TRACE.
+
+        Each thread allocates its buffer on its first event and pushes it
+        onto a global list with a CAS; after that, recording an event is
+        a timestamp read and a store into memory no other thread writes.
+        The event count is published with a release store so the exit
+        handler can read a consistent prefix even if a worker is still
+        running. Buffers are never freed: they live until the process
+        exits.
+
+        On x86-64 the timestamp is the TSC (a few cycles, no syscall or
+        vDSO call); it is mapped to nanoseconds at flush time using two
+        ut_now_ns() readings taken at trace_init() and at the flush.
+        Other targets read ut_now_ns() directly.
+*/
+
+#ifdef TORILATE_TRACE
+
+#include <stdatomic.h>
+#include "diag/trace.h"
+#include "util/util.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define TRACE_USE_TSC 1
+#endif
+
+enum { TRACE_OFF, TRACE_RECORDING, TRACE_FLUSHING };
+
+typedef struct TraceEvent {
+    uint64_t ticks;
+    const char *cat;
+    const char *name;
+    const char *key;
+    int64_t value;
+    char phase;
+} TraceEvent;
+
+typedef struct TraceBuffer {
+    struct TraceBuffer *next;
+    unsigned tid;
+    atomic_size_t count;        // published events
+    atomic_size_t dropped;      // events lost to a full buffer
+    TraceEvent events[TRACE_BUFFER_EVENTS];
+} TraceBuffer;
+
+static _Atomic(TraceBuffer *) trace_buffers = NULL;
+static atomic_uint trace_next_tid = 1;
+static atomic_int trace_state = TRACE_OFF;         // TRACE_OFF, TRACE_RECORDING or TRACE_FLUSHING
+static _Thread_local TraceBuffer *trace_local = NULL;
+
+/* Clock calibration points (ticks, ns) */
+static uint64_t base_ticks;
+static uint64_t base_ns;
+
+/* Function Prototypes */
+static uint64_t trace_ticks(void);
+static TraceBuffer *trace_buffer(void);
+static void trace_flush(void);
+
+void trace_init(void) {
+    static atomic_flag initialized = ATOMIC_FLAG_INIT;
+    if (atomic_flag_test_and_set(&initialized)) {
+        return;
+    }
+    base_ns = ut_now_ns();
+    base_ticks = trace_ticks();
+    atexit(trace_flush);
+    atomic_store(&trace_state, TRACE_RECORDING);
+}
+
+void trace_emit(char phase, const char *cat, const char *name, const char *key, int64_t value) {
+    // Nothing is recorded before trace_init() or once the exit handler runs
+    if (atomic_load_explicit(&trace_state, memory_order_relaxed) != TRACE_RECORDING) {
+        return;
+    }
+
+    TraceBuffer *buf = trace_buffer();
+    if (!buf) {
+        return;
+    }
+
+    size_t n = atomic_load_explicit(&buf->count, memory_order_relaxed);
+    if (n == TRACE_BUFFER_EVENTS) {
+        atomic_fetch_add_explicit(&buf->dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    TraceEvent *ev = &buf->events[n];
+    ev->ticks = trace_ticks();
+    ev->cat = cat;
+    ev->name = name;
+    ev->key = key;
+    ev->value = value;
+    ev->phase = phase;
+    atomic_store_explicit(&buf->count, n + 1, memory_order_release);
+}
+
+/* Internal helper functions */
+
+static uint64_t trace_ticks(void) {
+#ifdef TRACE_USE_TSC
+    return __builtin_ia32_rdtsc();
+#else
+    return ut_now_ns();
+#endif
+}
+
+static TraceBuffer *trace_buffer(void) {
+    if (trace_local) {
+        return trace_local;
+    }
+
+    TraceBuffer *buf = malloc(sizeof(TraceBuffer));
+    if (!buf) {
+        return NULL;
+    }
+    buf->tid = atomic_fetch_add(&trace_next_tid, 1);
+    atomic_init(&buf->count, 0);
+    atomic_init(&buf->dropped, 0);
+
+    buf->next = atomic_load(&trace_buffers);
+    while (!atomic_compare_exchange_weak(&trace_buffers, &buf->next, buf)) {
+        // buf->next now holds the current head: retry
+    }
+    trace_local = buf;
+    return buf;
+}
+
+static void trace_flush(void) {
+    atomic_store(&trace_state, TRACE_FLUSHING); // the writer below must not trace itself
+
+    uint64_t end_ns = ut_now_ns();
+    uint64_t end_ticks = trace_ticks();
+    double ns_per_tick = end_ticks > base_ticks ? (double)(end_ns - base_ns) / (double)(end_ticks - base_ticks) : 1.0;
+
+    const char *path = getenv("TORILATE_TRACE_FILE");
+    if (!path || !path[0]) {
+        path = TRACE_DEFAULT_FILE;
+    }
+
+    FILE *file = NULL;
+    Error err = open_for_write(path, &file);
+    if (ERR_FAILED(err)) {
+        fprintf(stderr, "%s\n", get_err_msg(&err, false));
+        return;
+    }
+
+    const char *sep = "";
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for (TraceBuffer *buf = atomic_load(&trace_buffers); buf; buf = buf->next) {
+        size_t count = atomic_load_explicit(&buf->count, memory_order_acquire);
+        size_t dropped = atomic_load_explicit(&buf->dropped, memory_order_relaxed);
+
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"thread %u\"}}",
+                sep, buf->tid, buf->tid);
+        sep = ",\n";
+
+        for (size_t i = 0; i < count; i++) {
+            const TraceEvent *ev = &buf->events[i];
+            double ts_us = (double)(int64_t)(ev->ticks - base_ticks) * ns_per_tick / 1000.0;
+            fprintf(file, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%u",
+                    sep, ev->name, ev->cat, ev->phase, ts_us, buf->tid);
+            if (ev->phase == 'i') {
+                fprintf(file, ",\"s\":\"t\"");
+            }
+            if (ev->key) {
+                fprintf(file, ",\"args\":{\"%s\":%lld}", ev->key, (long long)ev->value);
+            }
+            fprintf(file, "}");
+        }
+
+        if (dropped > 0) {
+            fprintf(stderr, "%s: trace buffer of thread %u full, dropped %zu events\n", PROG_NAME, buf->tid, dropped);
+        }
+    }
+    fprintf(file, "\n]}\n");
+
+    if (fclose(file) != 0) {
+        fprintf(stderr, "%s: failed to write trace file '%s'\n", PROG_NAME, path);
+    }
+}
+
+#endif
@@ -0,0 +1,56 @@
+/*
+    File: src/diag/trace.h
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference:
+        - Trace Event Format: https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU
+        - Perfetto UI: https://ui.perfetto.dev
+    Description:
+        Compile-time gated trace points. Configure with -DTORILATE_TRACE=ON
+        and every TRACE_* macro appends an event to a buffer owned by the
+        calling thread (no locks, no shared cache lines on the hot path);
+        trace_init() registers an exit handler that writes all buffers as
+        Chrome trace-event JSON, viewable in chrome://tracing or Perfetto.
+        Without the option the macros expand to nothing and their
+        arguments are never evaluated.
+
+        The output path is $TORILATE_TRACE_FILE, or torilate-trace.json.
+
+        Category, name and key arguments must be string literals: only
+        the pointers are stored, and they are written to JSON unescaped.
+*/
+
+#ifndef TORILATE_TRACE_H
+#define TORILATE_TRACE_H
+
+#include <stdint.h>
+
+#define TRACE_DEFAULT_FILE      "torilate-trace.json"
+#define TRACE_BUFFER_EVENTS     65536   // per thread; later events are counted as dropped
+
+#ifdef TORILATE_TRACE
+
+/*
+ * Start the trace clock and register the exit handler that writes the trace.
+ * Safe to call more than once; only the first call has an effect.
+ */
+void trace_init(void);
+
+/* Append one event to the calling thread's buffer (use the macros below) */
+void trace_emit(char phase, const char *cat, const char *name, const char *key, int64_t value);
+
+#define TRACE_INIT()                            trace_init()
+#define TRACE_BEGIN(cat, name, key, value)      trace_emit('B', cat, name, key, (int64_t)(value))
+#define TRACE_END(cat, name, key, value)        trace_emit('E', cat, name, key, (int64_t)(value))
+#define TRACE_INSTANT(cat, name, key, value)    trace_emit('i', cat, name, key, (int64_t)(value))
+
+#else
+
+#define TRACE_INIT()                            ((void)0)
+#define TRACE_BEGIN(cat, name, key, value)      ((void)0)
+#define TRACE_END(cat, name, key, value)        ((void)0)
+#define TRACE_INSTANT(cat, name, key, value)    ((void)0)
+
+#endif
+
+#endif
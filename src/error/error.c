@@ -12,6 +12,7 @@
 */
 
 #include "error/error.h"
+#include "diag/flight.h"
 #include <string.h>
 
 
@@ -31,6 +32,8 @@ static const char *err_messg_list[ERR_COUNT] = {
     [ERR_TOR_CONNECTION_FAILED]     = "Failed to connect to TOR proxy",
     [ERR_SOCKET_CREATION_FAILED]    = "Failed to create socket",
     [ERR_ADDRESS_RESOLUTION_FAILED] = "Failed to resolve address",
+    [ERR_TIMEOUT]                   = "Operation timed out",
+    [ERR_TOR_CONTROL_FAILED]        = "Tor ControlPort command failed",
     
     [ERR_INVALID_URI]               = "Invalid URL",
     [ERR_BAD_RESPONSE]              = "Bad or malformed response",
@@ -64,7 +67,7 @@ const char *err_get_base_message(ErrorCode code) {
  * If no separator found, returns the full message.
  */
 static const char *extract_top_level_error(const char *message) {
-    static char buffer[512];
+    static _Thread_local char buffer[512]; // per-thread: errors are formatted on pool workers too
     const char *first_separator = strstr(message, ": ");
     
     // If we found a separator, copy everything before it
@@ -106,6 +109,7 @@ const char *get_err_msg(Error *err, bool verbose) {
 Error err_create(ErrorCode code, const char *fmt, ...) {
     Error err;
     err.code = code;
+    flight_record(FLIGHT_ERROR, -1, 0, (int)code);
     
     if (fmt) {
         va_list args;
@@ -41,6 +41,8 @@ typedef enum {
     ERR_TOR_CONNECTION_FAILED,
     ERR_SOCKET_CREATION_FAILED,
     ERR_ADDRESS_RESOLUTION_FAILED,
+    ERR_TIMEOUT,
+    ERR_TOR_CONTROL_FAILED,
 
     /* HTTP errors */
     ERR_INVALID_URI,
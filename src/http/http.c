@@ -1,4 +1,4 @@
-/* 
+/*
     File: src/http/http.c
     Author: Trident Apollo
     Date: 23-01-2026
@@ -13,459 +13,577 @@
 #ifndef _WIN32
 #include <strings.h>
 #endif
+#include <time.h>
+#include <ctype.h>
 #include "http/http.h"
+#include "http/http_cache.h"
+#include "http/http_retry.h"
+#include "http/http_proxy.h"
 #include "util/util.h"
-
+#include "diag/trace.h"
+#include "diag/flight.h"
+#include "diag/perf.h"
 
 /* Function Prototypes*/
-static Error http_send(NetSocket *sock, const char *request);
-static Error http_recv_response(NetSocket *sock, HttpResponse *out);
-static Error http_get_once(NetSocket *sock, const char *host, const char *path, int port, NetAddrType addr_type, const char **headers, int headers_count, HttpResponse *out);
-static Error http_post_once(NetSocket *sock, const char *host, const char *path, int port, NetAddrType addr_type, const char *body, const char **headers, int headers_count, HttpResponse *out);
+static Error http_send(NetSocket *sock, const char *request, size_t len, int timeout_ms);
+static Error http_recv_response(NetSocket *sock, const HttpTimeouts *timeouts, uint64_t deadline_ns, bool follow_redirects, HttpResponse *out, HttpTiming *timing);
+static Error http_request_once(NetSocket *sock, HttpMethod method, const URI *uri, const HttpRequest *req, uint64_t deadline_ns, HttpResponse *out, HttpTiming *timing);
+static Error http_exchange(const HttpRequest *req, HttpResponse *response);
+static Error http_exchange_retrying(const HttpRequest *req, HttpResponse *response);
 
 /* Public API */
 Error http_get(const char *uri, const char **headers, int headers_count, bool follow_redirects, int max_redirects, HttpResponse *response) {
-    URI parsed_uri = {0};
-    NetSocket sock = {0};
-    Error err = ERR_OK();
-    HttpResponse current_response = {0};
+    HttpRequest req = {
+        .method           = HTTP_METHOD_GET,
+        .uri              = uri,
+        .headers          = headers,
+        .headers_count    = headers_count,
+        .follow_redirects = follow_redirects,
+        .max_redirects    = max_redirects,
+    };
+    return http_perform(&req, response);
+}
 
-    err = parse_uri(uri, &parsed_uri);
-    if (ERR_FAILED(err)) {
-        err = ERR_PROPAGATE(err, "Failed to parse URI: %s", uri);
-        goto exit_get;
-    }
+Error http_post(const char *uri, const char *body, const char **headers, int headers_count, bool follow_redirects, int max_redirects, HttpResponse *response) {
+    HttpRequest req = {
+        .method           = HTTP_METHOD_POST,
+        .uri              = uri,
+        .body             = body,
+        .headers          = headers,
+        .headers_count    = headers_count,
+        .follow_redirects = follow_redirects,
+        .max_redirects    = max_redirects,
+    };
+    return http_perform(&req, response);
+}
 
-    err = net_connect(&sock, TOR_IP, TOR_PORT); 
-    if (ERR_FAILED(err)) {
-        err = ERR_PROPAGATE(err, "Cannot connect to TOR at %s:%d", TOR_IP, TOR_PORT);
-        goto exit_get;
+Error http_perform(const HttpRequest *req, HttpResponse *response) {
+    if (req->method != HTTP_METHOD_GET || !http_cache_enabled()) {
+        return http_exchange_retrying(req, response);
     }
 
-    err = http_get_once(&sock, parsed_uri.host, parsed_uri.path, parsed_uri.port, parsed_uri.addr_type, headers, headers_count, &current_response);
-    if (ERR_FAILED(err)) {
-        err = ERR_PROPAGATE(err, "Failed to get HTTP response from %s:%d", parsed_uri.host, parsed_uri.port);
-        goto exit_get;
-    }
-        
-    if (follow_redirects) {
-        int redirects_followed = 0;
-        while (current_response.status_code >= 300 && current_response.status_code < 400) {
-            if (redirects_followed >= max_redirects) {
-                err = ERR_NEW(ERR_HTTP_REDIRECT_LIMIT, "Exceeded maximum redirect limit of %d", max_redirects);
-                goto exit_get;
-            }
-            redirects_followed++;
-
-            // Extract Location header
-            size_t url_len = 0;
-            char *url = NULL;
-            char *headers_redir = strstr(current_response.raw, "\r\n");
-
-            while (headers_redir) {
-                headers_redir += 2;
-                if (strncasecmp(headers_redir, "Location:", 9) == 0) {
-                    url = headers_redir + 9;
-                    while (*url == ' ') url++;
-                    char *end = strstr(url, "\r\n");
-                    if (!end) {
-                        err = ERR_NEW(ERR_HTTP_REDIRECT_FAILED, "Failed to extract Location header");
-                        goto exit_get;
-                    }
-                    url_len = end - url;
-                    break;
-                }
-                headers_redir = strstr(headers_redir, "\r\n");
-            }
+    HttpCacheEntry entry;
+    HttpRequest conditional = *req;
+    const char **headers = NULL;
+    Error err = ERR_OK();
 
-            if (!url) {
-                err = ERR_NEW(ERR_HTTP_REDIRECT_FAILED, "Redirect missing Location header");
-                goto exit_get;
-            }
+    switch (http_cache_lookup(req, &entry)) {
+        case HTTP_CACHE_FRESH:
+            memcpy(response, &entry.response, sizeof(HttpResponse));
+            return ERR_OK();
 
-            // Initialize new socket connection for redirect
-            net_close(&sock);
-            err = net_connect(&sock, TOR_IP, TOR_PORT); 
+        case HTTP_CACHE_STALE:
+            err = http_cache_conditional_headers(req, &entry, &headers, &conditional.headers_count);
             if (ERR_FAILED(err)) {
-                err = ERR_PROPAGATE(err, "Cannot connect to TOR at %s:%d", TOR_IP, TOR_PORT);
-                goto exit_get;
-            }
-
-            // Check if ulr is absolute or relative
-            if (url[0] == '/') {
-                char new_path[1024];
-                memcpy(new_path, url, url_len);
-                new_path[url_len] = '\0';
-
-                err = http_get_once(&sock, parsed_uri.host, new_path, parsed_uri.port, parsed_uri.addr_type, headers, headers_count, &current_response);
-                if (ERR_FAILED(err))
-                    goto exit_get;
-            } else {
-                char new_url[1536];
-                memcpy(new_url, url, url_len);
-                new_url[url_len] = '\0';
-
-                err = parse_uri(new_url, &parsed_uri);
-                if (ERR_FAILED(err)){
-                    err = ERR_PROPAGATE(err, "Failed to parse redirect URL: %s", new_url);
-                    goto exit_get;
-                }
-                    
-                err = http_get_once(&sock, parsed_uri.host, parsed_uri.path, parsed_uri.port, parsed_uri.addr_type, headers, headers_count, &current_response);
-                if (ERR_FAILED(err)) {    
-                    err = ERR_PROPAGATE(err, "HTTP redirect failed to %s:%d", parsed_uri.host, parsed_uri.port);
-                    goto exit_get;
-                }
+                return err;
             }
+            conditional.headers = headers;
+            break;
 
-        } 
+        default:
+            break;
     }
 
-    memcpy(response, &current_response, sizeof(HttpResponse));
-exit_get:
-    net_close(&sock);
-    cleanup_uri(&parsed_uri);
+    err = http_exchange_retrying(&conditional, response);
+    ut_free(headers);
+    if (ERR_FAILED(err)) {
+        return err;
+    }
 
-    return err;
+    http_cache_update(req, &entry, response);
+    return ERR_OK();
 }
 
-Error http_post(const char *uri, const char *body, const char **headers, int headers_count, bool follow_redirects, int max_redirects, HttpResponse *response) {
-    bool use_post = true;
-    URI parsed_uri = {0};
-    NetSocket sock = {0};
+/* Request/response helpers */
+Error http_build_request(HttpMethod method, const char *host, const char *path, int port, const char *body, const char **headers, int headers_count, char **out, size_t *out_len) {
     Error err = ERR_OK();
-    HttpResponse current_response = {0};
+    char port_part[16] = "";
+    char *headers_str = NULL;
+    size_t body_len = (method == HTTP_METHOD_POST && body) ? strlen(body) : 0;
 
-    err = parse_uri(uri, &parsed_uri);
-    if (ERR_FAILED(err)) {
-        err = ERR_PROPAGATE(err, "Failed to parse URI: %s", uri);
-        goto exit_post;
+    if (port != 80) {
+        snprintf(port_part, sizeof(port_part), ":%d", port);
     }
 
-    err = net_connect(&sock, TOR_IP, TOR_PORT); 
-    if (ERR_FAILED(err)) {
-        err = ERR_PROPAGATE(err, "Cannot connect to TOR at %s:%d", TOR_IP, TOR_PORT);
-        goto exit_post;
+    // Validate and format headers
+    size_t total_len = 0;
+    for (int i = 0; i < headers_count; i++) {
+        total_len += strlen(headers[i]) + 2; // +2 for \r\n
     }
-
-    err = http_post_once(&sock, parsed_uri.host, parsed_uri.path, parsed_uri.port, parsed_uri.addr_type, body, headers, headers_count, &current_response);
-    if (ERR_FAILED(err)) {
-        err = ERR_PROPAGATE(err, "Failed to POST to %s:%d", parsed_uri.host, parsed_uri.port);
-        goto exit_post;
+    headers_str = (char *)ut_malloc(MEM_TAG_HTTP, total_len + 1);
+    if (!headers_str) {
+        return ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate memory for headers");
     }
 
-    if (follow_redirects) {
-        int redirects_followed = 0;
+    char *pos = headers_str;
+    for (int i = 0; i < headers_count; i++) {
+        const char *header_value = headers[i];
+        err = validate_header((char *)header_value);
+        if (ERR_FAILED(err)) {
+            ut_free(headers_str);
+            return ERR_PROPAGATE(err, "Invalid header: %s", header_value);
+        }
 
-        while (current_response.status_code >= 300 && current_response.status_code < 400) {
-            if (redirects_followed >= max_redirects) {
-                err = ERR_NEW(ERR_HTTP_REDIRECT_LIMIT, "Exceeded maximum redirect limit of %d", max_redirects);
-                goto exit_post;
-            }
-            redirects_followed++;
+        // Trim and copy the header
+        const char *start = header_value;
+        const char *end = header_value + strlen(header_value) - 1;
 
-            /* Extract Location header */
-            size_t url_len = 0;
-            char *url = NULL;
-            char *headers_redir = strstr(current_response.raw, "\r\n");
+        // Trim leading whitespace
+        while (*start && isspace((unsigned char)*start)) {
+            start++;
+        }
 
-            while (headers_redir) {
-                headers_redir += 2;
+        // Trim trailing whitespace and CRLF
+        while (end > start && (isspace((unsigned char)*end) || *end == '\r' || *end == '\n')) {
+            end--;
+        }
 
-                if (strncasecmp(headers_redir, "Location:", 9) == 0) {
-                    url = headers_redir + 9;
-                    while (*url == ' ') url++;
+        size_t header_len = end - start + 1;
+        memcpy(pos, start, header_len);
+        pos += header_len;
+        memcpy(pos, "\r\n", 2);
+        pos += 2;
+    }
+    *pos = '\0';
 
-                    char *end = strstr(url, "\r\n");
-                    if (!end) {
-                        err = ERR_NEW(ERR_HTTP_REDIRECT_FAILED, "Failed to extract Location header");
-                        goto exit_post;
-                    }
+    const char *fmt = (method == HTTP_METHOD_POST) ?
+             "POST %s HTTP/1.1\r\n"
+             "Host: %s%s\r\n"
+             "User-Agent: Torilate\r\n"
+             "%s"
+             "Content-Length: %zu\r\n"
+             "Connection: close\r\n"
+             "\r\n" :
+             "GET %s HTTP/1.1\r\n"
+             "Host: %s%s\r\n"
+             "User-Agent: Torilate\r\n"
+             "%s"
+             "Connection: close\r\n"
+             "\r\n";
 
-                    url_len = end - url;
-                    break;
-                }
+    int head_len = snprintf(NULL, 0, fmt, path, host, port_part, headers_str, body_len);
+    if (head_len < 0) {
+        ut_free(headers_str);
+        return ERR_NEW(ERR_HTTP_REQUEST_FAILED, "Failed to format HTTP request line");
+    }
 
-                headers_redir = strstr(headers_redir, "\r\n");
-            }
+    char *request = (char *)ut_malloc(MEM_TAG_HTTP, (size_t)head_len + body_len + 1);
+    if (!request) {
+        ut_free(headers_str);
+        return ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate %zu bytes for HTTP request", (size_t)head_len + body_len + 1);
+    }
+    snprintf(request, (size_t)head_len + 1, fmt, path, host, port_part, headers_str, body_len);
+    if (body_len > 0) {
+        memcpy(request + head_len, body, body_len);
+    }
+    request[head_len + body_len] = '\0';
+    ut_free(headers_str);
 
-            if (!url) {
-                err = ERR_NEW(ERR_HTTP_REDIRECT_FAILED, "Redirect missing Location header");
-                goto exit_post;
-            }
+    *out = request;
+    if (out_len) {
+        *out_len = (size_t)head_len + body_len;
+    }
+    return ERR_OK();
+}
 
-            // Initialize new socket connection for redirect
-            net_close(&sock);
-            err = net_connect(&sock, TOR_IP, TOR_PORT); 
-            if (ERR_FAILED(err)) {
-                err = ERR_PROPAGATE(err, "Cannot connect to TOR at %s:%d", TOR_IP, TOR_PORT);
-                goto exit_post;
-            }
+Error http_parse_status(const char *raw, HttpStatusCode *out) {
+    int code;
+    const char *status = raw;
+    while (*status == ' ' || *status == '\r' || *status == '\n')
+        status++;
 
-            /* Method conversion logic */
-            int code = current_response.status_code;
+    if (sscanf(status, "HTTP/%*d.%*d %d", &code) != 1 || code < 100 || code > 599) {
+        return ERR_NEW(ERR_BAD_RESPONSE, "Malformed HTTP header: Unable to parse status code");
+    }
 
-            if (code == 301 || code == 302 || code == 303) {
-                use_post = false;  // Convert to GET
-            }
+    *out = (HttpStatusCode)code;
+    return ERR_OK();
+}
 
-            /* Resolve new target */
-            if (url[0] == '/') {
-                char new_path[1024];
-                memcpy(new_path, url, url_len);
-                new_path[url_len] = '\0';
-
-                if (use_post) {
-                    err = http_post_once(&sock, parsed_uri.host, new_path, parsed_uri.port, parsed_uri.addr_type, body, headers, headers_count, &current_response);
-                } else {
-                    err = http_get_once(&sock, parsed_uri.host, new_path, parsed_uri.port, parsed_uri.addr_type, headers, headers_count, &current_response);
-                }
-            } else {
-                char new_url[1536];
-                memcpy(new_url, url, url_len);
-                new_url[url_len] = '\0';
-
-                cleanup_uri(&parsed_uri);
-
-                err = parse_uri(new_url, &parsed_uri);
-                if (ERR_FAILED(err)) {
-                    err = ERR_PROPAGATE(err,
-                                        "Failed to parse redirect URL: %s",
-                                        new_url);
-                    goto exit_post;
-                }
-
-                if (use_post) {
-                    err = http_post_once(&sock, parsed_uri.host, parsed_uri.path, parsed_uri.port, parsed_uri.addr_type, body, headers, headers_count, &current_response);
-                } else {
-                    err = http_get_once(&sock, parsed_uri.host, parsed_uri.path, parsed_uri.port, parsed_uri.addr_type, headers, headers_count, &current_response);
-                }
-            }
+bool http_find_header(const char *raw, const char *name, const char **value, size_t *value_len) {
+    size_t name_len = strlen(name);
+    const char *line = strstr(raw, "\r\n");
 
-            if (ERR_FAILED(err))
-                goto exit_post;
+    while (line) {
+        line += 2;
+        if (line[0] == '\r' && line[1] == '\n') {
+            break; // end of header section
         }
-    }
 
-    memcpy(response, &current_response, sizeof(HttpResponse));
+        if (strncasecmp(line, name, name_len) == 0 && line[name_len] == ':') {
+            const char *v = line + name_len + 1;
+            while (*v == ' ' || *v == '\t') v++;
 
-exit_post:
-    net_close(&sock);
-    cleanup_uri(&parsed_uri);
+            const char *end = strstr(v, "\r\n");
+            if (!end) {
+                return false;
+            }
+            *value = v;
+            *value_len = (size_t)(end - v);
+            return true;
+        }
+        line = strstr(line, "\r\n");
+    }
 
-    return err;
+    return false;
 }
 
-/* Internal helper functions */
-static Error http_get_once(NetSocket *sock, const char *host, const char *path, int port, NetAddrType addr_type, const char **headers, int headers_count, HttpResponse *out) {
-    // Establish SOCKS4 connection
-    Error err;
-    err = socks4_connect(sock, host, (uint16_t)port, PROG_NAME, addr_type);
-    if (ERR_FAILED(err)) {
-        err = ERR_PROPAGATE(err, "SOCKS4 connection to %s:%d failed", host, port);
-        return err;
+// IMF-fixdate: "Sun, 06 Nov 1994 08:49:37 GMT"
+bool http_parse_date(const char *s, int64_t *out) {
+    static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    int day, year, hour, minute, second;
+    char mon[4] = {0};
+
+    if (sscanf(s, "%*[^,], %d %3s %d %d:%d:%d", &day, mon, &year, &hour, &minute, &second) != 6) {
+        return false;
     }
+    const char *m = strstr(months, mon);
+    if (!m || strlen(mon) != 3 || (m - months) % 3 != 0) {
+        return false;
+    }
+    int month = (int)(m - months) / 3 + 1;
+
+    // days_from_civil
+    int64_t y = year - (month <= 2);
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    int64_t days = era * 146097 + doe - 719468;
+
+    *out = days * 86400 + hour * 3600 + minute * 60 + second;
+    return true;
+}
 
-    // Construct HTTP GET request
-    char request[2048];
-    char port_part[16] = "";
-    char *headers_str = NULL;
-    
-    if (port != 80) {
-        snprintf(port_part, sizeof(port_part), ":%d", port);
+bool http_retry_after(const HttpResponse *response, uint64_t *delay_ms) {
+    if (response->status_code != HTTP_TOO_MANY_REQUESTS && response->status_code != HTTP_SERVICE_UNAVAILABLE) {
+        return false;
     }
 
-    // Validate and format headers
-    if (headers_count > 0) {   
-        // Calculate total length of headers
-        size_t total_len = 0;
-        for (int i = 0; i < headers_count; i++) {
-            total_len += strlen(headers[i]) + 2; // +2 for \r\n
-        }
-        headers_str = (char *)malloc(total_len + 1);
-        if (!headers_str) {
-            return ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate memory for headers");
+    const char *v = NULL;
+    size_t v_len = 0;
+    if (!http_find_header(response->raw, "Retry-After", &v, &v_len) || v_len == 0 || v_len >= 64) {
+        return false;
+    }
+    char value[64];
+    memcpy(value, v, v_len);
+    value[v_len] = '\0';
+
+    if (isdigit((unsigned char)value[0])) {
+        char *end = NULL;
+        unsigned long long seconds = strtoull(value, &end, 10);
+        if (*end != '\0' && !isspace((unsigned char)*end)) {
+            return false;
         }
-        headers_str[0] = '\0'; // Initialize empty string
+        *delay_ms = seconds > UINT64_MAX / 1000 ? UINT64_MAX : (uint64_t)seconds * 1000;
+        return true;
+    }
 
-        char *pos = headers_str;
-        for (int i = 0; i < headers_count; i++) {
-            const char *header_value = headers[i];
-            err = validate_header((char *)header_value);
-            if (ERR_FAILED(err)) {
-                free(headers_str);
-                return ERR_PROPAGATE(err, "Invalid header: %s", header_value);
-            }
+    int64_t at = 0;
+    if (!http_parse_date(value, &at)) {
+        return false;
+    }
+    int64_t now = (int64_t)time(NULL);
+    *delay_ms = at > now ? (uint64_t)(at - now) * 1000 : 0;
+    return true;
+}
 
-            // Trim and copy the header
-            const char *start = header_value;
-            const char *end = header_value + strlen(header_value) - 1;
+bool http_is_redirect(HttpStatusCode code) {
+    switch (code) {
+        case HTTP_MOVED_PERMANENTLY:
+        case HTTP_FOUND:
+        case HTTP_SEE_OTHER:
+        case HTTP_TEMPORARY_REDIRECT:
+        case HTTP_PERMANENT_REDIRECT:
+            return true;
+        default:
+            return false;
+    }
+}
 
-            // Trim leading whitespace
-            while (*start && isspace((unsigned char)*start)) {
-                start++;
-            }
+HttpMethod http_redirect_method(HttpMethod method, HttpStatusCode code) {
+    if (code == HTTP_MOVED_PERMANENTLY || code == HTTP_FOUND || code == HTTP_SEE_OTHER) {
+        return HTTP_METHOD_GET;  // Convert to GET
+    }
+    return method;
+}
 
-            // Trim trailing whitespace and CRLF
-            while (end > start && (isspace((unsigned char)*end) || *end == '\r' || *end == '\n')) {
-                end--;
-            }
+Error http_apply_redirect(const HttpResponse *response, URI *uri) {
+    const char *url = NULL;
+    size_t url_len = 0;
+
+    if (!http_find_header(response->raw, "Location", &url, &url_len)) {
+        return ERR_NEW(ERR_HTTP_REDIRECT_FAILED, "Redirect missing Location header");
+    }
 
-            size_t header_len = end - start + 1;
-            memcpy(pos, start, header_len);
-            pos += header_len;
-            memcpy(pos, "\r\n", 2);
-            pos += 2;
+    // Check if url is absolute or relative
+    if (url[0] == '/') {
+        char *new_path = ut_strndup(url, url_len);
+        if (!new_path) {
+            return ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate redirect path");
         }
-        *pos = '\0';
-    } else {
-        headers_str = "";
+        ut_free((void *)uri->path);
+        uri->path = new_path;
+        return ERR_OK();
     }
 
-    snprintf(request, sizeof(request),
-             "GET %s HTTP/1.1\r\n"
-             "Host: %s%s\r\n"
-             "User-Agent: Torilate\r\n"
-             "%s"
-             "Connection: close\r\n"
-             "\r\n",
-             path, host, port_part, headers_str);
-    
-    if (headers_count > 0 && headers_str) {
-        free(headers_str);
+    char new_url[1536];
+    if (url_len >= sizeof(new_url)) {
+        return ERR_NEW(ERR_HTTP_REDIRECT_FAILED, "Redirect URL exceeds %zu bytes", sizeof(new_url) - 1);
     }
+    memcpy(new_url, url, url_len);
+    new_url[url_len] = '\0';
 
-    err = http_send(sock, request);
+    Error err = parse_uri(new_url, uri);
     if (ERR_FAILED(err)) {
-        return err;
+        return ERR_PROPAGATE(err, "Failed to parse redirect URL: %s", new_url);
+    }
+    return ERR_OK();
+}
+
+uint64_t http_deadline(const HttpTimeouts *timeouts) {
+    return timeouts->total_ms > 0 ? ut_now_ns() + (uint64_t)timeouts->total_ms * 1000000 : 0;
+}
+
+int http_timeout_ms(uint32_t phase_ms, uint64_t deadline_ns) {
+    int64_t ms = phase_ms > 0 ? (int64_t)phase_ms : -1;
+    if (deadline_ns > 0) {
+        uint64_t now = ut_now_ns();
+        int64_t left = deadline_ns > now ? (int64_t)((deadline_ns - now + 999999) / 1000000) : 0;
+        if (ms < 0 || left < ms) {
+            ms = left;
+        }
     }
+    return ms > INT32_MAX ? INT32_MAX : (int)ms;
+}
 
-    return http_recv_response(sock, out);
+HttpTiming *http_timing_begin(HttpResponse *response) {
+    int slot = response->hops < HTTP_MAX_TIMED_HOPS ? response->hops : HTTP_MAX_TIMED_HOPS - 1;
+    HttpTiming *timing = &response->timing[slot];
+
+    memset(timing, 0, sizeof(HttpTiming));
+    timing->start_ns = ut_now_ns();
+    response->hops++;
+    return timing;
 }
 
-static Error http_post_once(NetSocket *sock, const char *host, const char *path, int port, NetAddrType addr_type, const char *body, const char **headers, int headers_count, HttpResponse *out) {
-    // Establish SOCKS4 connection
+Error http_send_request(NetSocket *sock, HttpMethod method, const URI *uri, const HttpRequest *req, uint64_t deadline_ns, HttpTiming *timing) {
+    // Establish SOCKS4 connection (send and reply timed separately: the reply waits for the circuit)
     Error err;
-    err = socks4_connect(sock, host, (uint16_t)port, PROG_NAME, addr_type);
+    uint8_t socks_request[512];
+    uint8_t socks_reply[SOCKS4_REPLY_LEN];
+    size_t socks_len = 0;
+    uint32_t handshake_ms = req->timeouts.handshake_ms;
+
+    TRACE_BEGIN("socks", "handshake", "port", uri->port);
+    err = socks4_build_connect(socks_request, sizeof(socks_request), uri->host, (uint16_t)uri->port, req->isolation ? req->isolation : PROG_NAME, uri->addr_type, &socks_len);
+    if (!ERR_FAILED(err)) {
+        err = net_send_all_timed(sock, socks_request, socks_len, http_timeout_ms(handshake_ms, deadline_ns));
+    }
+    if (!ERR_FAILED(err)) {
+        HTTP_TIMING_MARK(timing, socks_sent_ns);
+        socks_len = 0;
+        while (socks_len < sizeof(socks_reply)) {
+            size_t n = 0;
+            err = net_recv_timed(sock, socks_reply + socks_len, sizeof(socks_reply) - socks_len, &n, http_timeout_ms(handshake_ms, deadline_ns));
+            if (ERR_FAILED(err) || n == 0) {
+                break;
+            }
+            socks_len += n;
+        }
+    }
+    if (!ERR_FAILED(err)) {
+        err = socks4_parse_reply(socks_reply, socks_len, uri->host, (uint16_t)uri->port);
+    }
+    TRACE_END("socks", "handshake", "error", err.code);
+    if (ERR_FAILED(err)) {
+        err = ERR_PROPAGATE(err, "SOCKS4 connection to %s:%d failed", uri->host, uri->port);
+        return err;
+    }
+    HTTP_TIMING_MARK(timing, socks_reply_ns);
+
+    // Construct HTTP request
+    char *request = NULL;
+    size_t request_len = 0;
+    PerfMark mark;
+    perf_begin(&mark);
+    err = http_build_request(method, uri->host, uri->path, uri->port, req->body, req->headers, req->headers_count, &request, &request_len);
+    perf_end(PERF_BUILD, &mark);
     if (ERR_FAILED(err)) {
-        err = ERR_PROPAGATE(err, "SOCKS4 connection to %s:%d failed", host, port);
         return err;
     }
 
-    // Construct HTTP POST request
-    char request[4096];
-    char port_part[16] = "";
-    char *headers_str = NULL;
-    size_t body_len = body ? strlen(body) : 0;
-    
-    if (port != 80) {
-        snprintf(port_part, sizeof(port_part), ":%d", port);
+    err = http_send(sock, request, request_len, http_timeout_ms(req->timeouts.idle_ms, deadline_ns));
+    ut_free(request);
+    if (!ERR_FAILED(err)) {
+        HTTP_TIMING_MARK(timing, request_sent_ns);
     }
-        
-    if (headers_count > 0) {   
-        // Calculate total length of headers
-        size_t total_len = 0;
-        for (int i = 0; i < headers_count; i++) {
-            total_len += strlen(headers[i]) + 2; // +2 for \r\n
-        }
-        headers_str = (char *)malloc(total_len + 1);
-        if (!headers_str) {
-            return ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate memory for headers");
-        }
-        headers_str[0] = '\0'; // Initialize empty string
+    return err;
+}
 
-        char *pos = headers_str;
-        for (int i = 0; i < headers_count; i++) {
-            const char *header_value = headers[i];
-            err = validate_header((char *)header_value);
-            if (ERR_FAILED(err)) {
-                free(headers_str);
-                return ERR_PROPAGATE(err, "Invalid header: %s", header_value);
-            }
+/* Internal helper functions */
+// Perform the exchange over the network, following redirects
+static Error http_exchange(const HttpRequest *req, HttpResponse *response) {
+    URI parsed_uri = {0};
+    NetSocket sock = INVALID_SOCKET;
+    int proxy = -1;     // SOCKS endpoint of the current hop
+    Error err = ERR_OK();
+    HttpMethod method = req->method;
+    HttpResponse current_response = {0};
+    int redirects_followed = 0;
+    uint64_t deadline_ns = http_deadline(&req->timeouts);   // spans every hop
+
+    TRACE_BEGIN("http", "exchange", "method", method);
+    err = parse_uri(req->uri, &parsed_uri);
+    if (ERR_FAILED(err)) {
+        err = ERR_PROPAGATE(err, "Failed to parse URI: %s", req->uri);
+        goto exit_exchange;
+    }
 
-            // Trim and copy the header
-            const char *start = header_value;
-            const char *end = header_value + strlen(header_value) - 1;
+    for (;;) {
+        HttpTiming *timing = http_timing_begin(&current_response);
+        TRACE_BEGIN("http", "hop", "hop", current_response.hops);
+        flight_record(FLIGHT_HOP, -1, (uint64_t)current_response.hops, 0);
+        err = http_proxy_connect(&sock, http_timeout_ms(req->timeouts.connect_ms, deadline_ns), &proxy);
+        if (ERR_FAILED(err)) {
+            goto exit_exchange;
+        }
+        HTTP_TIMING_MARK(timing, connect_ns);
 
-            // Trim leading whitespace
-            while (*start && isspace((unsigned char)*start)) {
-                start++;
+        err = http_request_once(&sock, method, &parsed_uri, req, deadline_ns, &current_response, timing);
+        if (ERR_FAILED(err)) {
+            if (redirects_followed == 0) {
+                err = ERR_PROPAGATE(err, "Failed to get HTTP response from %s:%d", parsed_uri.host, parsed_uri.port);
+            } else {
+                err = ERR_PROPAGATE(err, "HTTP redirect failed to %s:%d", parsed_uri.host, parsed_uri.port);
             }
+            TRACE_END("http", "hop", "error", err.code);
+            goto exit_exchange;
+        }
+        net_close(&sock);
+        http_proxy_release(proxy, false);
+        proxy = -1;
+        TRACE_END("http", "hop", "status", current_response.status_code);
 
-            // Trim trailing whitespace and CRLF
-            while (end > start && (isspace((unsigned char)*end) || *end == '\r' || *end == '\n')) {
-                end--;
-            }
+        if (!req->follow_redirects || !http_is_redirect(current_response.status_code)) {
+            break;
+        }
 
-            size_t header_len = end - start + 1;
-            memcpy(pos, start, header_len);
-            pos += header_len;
-            memcpy(pos, "\r\n", 2);
-            pos += 2;
+        if (redirects_followed >= req->max_redirects) {
+            err = ERR_NEW(ERR_HTTP_REDIRECT_LIMIT, "Exceeded maximum redirect limit of %d", req->max_redirects);
+            goto exit_exchange;
+        }
+        redirects_followed++;
+        TRACE_INSTANT("http", "redirect", "status", current_response.status_code);
+        flight_record(FLIGHT_REDIRECT, -1, (uint64_t)redirects_followed, current_response.status_code);
+
+        method = http_redirect_method(method, current_response.status_code);
+        err = http_apply_redirect(&current_response, &parsed_uri);
+        if (ERR_FAILED(err)) {
+            goto exit_exchange;
         }
-        *pos = '\0';
-    } else {
-        headers_str = "";
     }
 
-    snprintf(request, sizeof(request),
-             "POST %s HTTP/1.1\r\n"
-             "Host: %s%s\r\n"
-             "User-Agent: Torilate\r\n"
-             "%s"
-             "Content-Length: %zu\r\n"
-             "Connection: close\r\n"
-             "\r\n%s",
-             path, host, port_part, headers_str, body_len, body ? body : "");
-    
-    if (headers_count > 0 && headers_str) {
-        free(headers_str);
+    memcpy(response, &current_response, sizeof(HttpResponse));
+exit_exchange:
+    net_close(&sock);
+    http_proxy_release(proxy, false);
+    cleanup_uri(&parsed_uri);
+    TRACE_END("http", "exchange", "error", err.code);
+
+    return err;
+}
+
+// Run the exchange, sending it again over a new circuit while it fails transiently
+static Error http_exchange_retrying(const HttpRequest *req, HttpResponse *response) {
+    HttpRequest attempt = *req;
+    char isolation[HTTP_RETRY_ISOLATION_MAX];
+    int retries = 0;
+
+    http_retry_begin();
+    for (;;) {
+        Error err = http_exchange(&attempt, response);
+        if (!http_retry_should(req, err, retries)) {
+            if (ERR_FAILED(err) && retries > 0) {
+                err = ERR_PROPAGATE(err, "Giving up after %d attempts", retries + 1);
+            }
+            return err;
+        }
+
+        retries++;
+        flight_record(FLIGHT_RETRY, -1, (uint64_t)retries, err.code);
+        ut_sleep_ns(http_retry_backoff_ns(retries));
+        http_retry_isolation(req, isolation, sizeof(isolation));
+        attempt.isolation = isolation;
     }
+}
 
-    err = http_send(sock, request);
+static Error http_request_once(NetSocket *sock, HttpMethod method, const URI *uri, const HttpRequest *req, uint64_t deadline_ns, HttpResponse *out, HttpTiming *timing) {
+    Error err = http_send_request(sock, method, uri, req, deadline_ns, timing);
     if (ERR_FAILED(err)) {
         return err;
     }
-    
+
     // Receive response
-    return http_recv_response(sock, out);
+    return http_recv_response(sock, &req->timeouts, deadline_ns, req->follow_redirects, out, timing);
 }
 
-static Error http_send(NetSocket *sock, const char *request) {
-    size_t len = strlen(request);
-    return net_send_all(sock, request, len);
+static Error http_send(NetSocket *sock, const char *request, size_t len, int timeout_ms) {
+    return net_send_all_timed(sock, request, len, timeout_ms);
 }
 
-static Error http_recv_response(NetSocket *sock, HttpResponse *out) {
+// Read the response until the peer closes; a redirect that will be followed ends with
+// its header section, since its body is dropped anyway: the next hop's tunnel is then
+// opened at once instead of after the old body has trickled in
+static Error http_recv_response(NetSocket *sock, const HttpTimeouts *timeouts, uint64_t deadline_ns, bool follow_redirects, HttpResponse *out, HttpTiming *timing) {
     int total = 0;
+    bool head_seen = false;
     out->bytes_received = 0;
 
+    TRACE_BEGIN("http", "recv_response", "fd", sock->handle);
+
     while (total < HTTP_MAX_RESPONSE - 1) {
         size_t bytes_received = 0;
-        Error err = net_recv(sock, out->raw + total, HTTP_MAX_RESPONSE - 1 - total, &bytes_received);
+        // Until the first byte the origin is still working: ttfb applies, then idle
+        uint32_t phase_ms = total == 0 ? timeouts->ttfb_ms : timeouts->idle_ms;
+        Error err = net_recv_timed(sock, out->raw + total, HTTP_MAX_RESPONSE - 1 - total, &bytes_received, http_timeout_ms(phase_ms, deadline_ns));
 
-        if (ERR_FAILED(err))
-            return ERR_PROPAGATE(err, "Failed to receive HTTP response");
+        if (ERR_FAILED(err)) {
+            TRACE_END("http", "recv_response", "error", err.code);
+            return ERR_PROPAGATE(err, "Failed to receive HTTP response after %d bytes", total);
+        }
         if (bytes_received == 0)
             break;
 
+        if (total == 0) {
+            HTTP_TIMING_MARK(timing, first_byte_ns);
+        }
         total += bytes_received;
+
+        if (follow_redirects && !head_seen) {
+            int from = total - (int)bytes_received > 3 ? total - (int)bytes_received - 3 : 0;
+            out->raw[total] = '\0';
+            head_seen = strstr(out->raw + from, "\r\n\r\n") != NULL;
+            HttpStatusCode code;
+            if (head_seen && !ERR_FAILED(http_parse_status(out->raw, &code)) && http_is_redirect(code)) {
+                TRACE_INSTANT("http", "redirect_head", "bytes", total);
+                break;
+            }
+        }
     }
+    HTTP_TIMING_MARK(timing, last_byte_ns);
+    TRACE_END("http", "recv_response", "bytes", total);
 
     out->raw[total] = '\0';
 
     /* Parse status code */
-    int code;
-    char *status = out->raw;
-    while (*status == ' ' || *status == '\r' || *status == '\n')
-        status++;
-
-    if (sscanf(status, "HTTP/%*d.%*d %d", &code) != 1 || code < 100 || code > 599) {
-        return ERR_NEW(ERR_BAD_RESPONSE, "Malformed HTTP header: Unable to parse status code");
+    Error err = http_parse_status(out->raw, &out->status_code);
+    if (ERR_FAILED(err)) {
+        return err;
     }
+    flight_record(FLIGHT_STATUS, (int)sock->handle, 0, out->status_code);
 
-    out->status_code = (HttpStatusCode)code;
     out->bytes_received = total;
 
     return ERR_OK();
-}
\ No newline at end of file
+}
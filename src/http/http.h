@@ -96,12 +96,74 @@ typedef enum {
     HTTP_NETWORK_AUTHENTICATION_REQUIRED = 511
 } HttpStatusCode;
 
+typedef enum {
+    HTTP_METHOD_GET,
+    HTTP_METHOD_POST,
+} HttpMethod;
+
+/* Number of hops whose timings are kept; later hops reuse the last entry */
+#define HTTP_MAX_TIMED_HOPS 8
+
+/*
+ * Phase boundaries of one exchange (one redirect hop), in nanoseconds since
+ * start_ns on the monotonic clock (ut_now_ns). 0 means the phase was not reached.
+ */
+typedef struct HttpTiming {
+    uint64_t start_ns;          // hop started (clock reading)
+    uint64_t connect_ns;        // TCP connection to the Tor SOCKS port established
+    uint64_t socks_sent_ns;     // SOCKS CONNECT request written
+    uint64_t socks_reply_ns;    // SOCKS reply received (circuit ready, stream attached)
+    uint64_t request_sent_ns;   // HTTP request written
+    uint64_t first_byte_ns;     // first response byte received
+    uint64_t last_byte_ns;      // response complete
+} HttpTiming;
+
 typedef struct HttpResponse {
     uint64_t bytes_received;
     HttpStatusCode status_code;
     char raw[HTTP_MAX_RESPONSE];
+    HttpTiming timing[HTTP_MAX_TIMED_HOPS];  // per hop, in order (0 hops for cache hits)
+    int hops;                                 // exchanges made, including redirects
 } HttpResponse;
 
+/*
+ * Time limits of an exchange in milliseconds, 0 = no limit. The phase limits
+ * bound each wait of that phase; total_ms bounds the whole exchange, redirect
+ * hops included (every retry starts a new total).
+ */
+typedef struct HttpTimeouts {
+    uint32_t connect_ms;        // TCP connect to the Tor SOCKS port
+    uint32_t handshake_ms;      // SOCKS reply: circuit built and stream attached
+    uint32_t ttfb_ms;           // request written -> first response byte
+    uint32_t idle_ms;           // between response bytes (and request writes)
+    uint32_t total_ms;          // whole exchange
+} HttpTimeouts;
+
+/* Command-line defaults: Tor gives up on a stream after about two minutes on its own */
+#define HTTP_DEFAULT_CONNECT_TIMEOUT_MS 60000
+#define HTTP_DEFAULT_IDLE_TIMEOUT_MS    60000
+
+/*
+ * Description of a single HTTP exchange.
+ * Shared by the blocking API (http_perform) and the multi API (http_multi.h).
+ */
+typedef struct HttpRequest {
+    HttpMethod method;          // request method
+    const char *uri;            // target URI
+    const char *body;           // POST body (NUL-terminated, may be NULL)
+    const char **headers;       // additional "Key: Value" headers
+    int headers_count;          // number of entries in headers
+    bool follow_redirects;      // follow 3xx responses carrying a Location header
+    int max_redirects;          // redirect limit when follow_redirects is set
+    const char *isolation;      // SOCKS userid; Tor keeps streams with different ids on
+                                // separate circuits (NULL = PROG_NAME)
+    int max_retries;            // retries of transient failures, each on a new circuit (http_retry.h)
+    HttpTimeouts timeouts;      // zeroed = wait forever
+} HttpRequest;
+
+// Forward declarations
+typedef struct URI URI;
+
 
 /*
  * Perform an HTTP GET request.
@@ -142,4 +204,124 @@ Error http_post(const char *uri,
                 int max_redirects,
                 HttpResponse *response);
 
+/*
+ * Perform a blocking HTTP exchange described by an HttpRequest.
+ *
+ *  @param request   request description
+ *  @param response  HttpResponse structure to store the final response
+ *
+ *  @return ERR_OK on success and an Error struct on failure
+ */
+Error http_perform(const HttpRequest *request, HttpResponse *response);
+
+/*
+ * Open the SOCKS tunnel and send a request over a socket connected to Tor.
+ * The response is left unread on the socket.
+ *
+ *  @param sock         non-blocking socket connected to the Tor SOCKS port
+ *  @param method       request method for this hop
+ *  @param uri          target of this hop
+ *  @param request      request description (body, headers and timeouts)
+ *  @param deadline_ns  end of the exchange (ut_now_ns clock), 0 = none
+ *  @param timing       receives the SOCKS and request-write boundaries (may be NULL)
+ *
+ *  @return ERR_OK on success and an Error struct on failure (ERR_TIMEOUT on expiry)
+ */
+Error http_send_request(NetSocket *sock, HttpMethod method, const URI *uri, const HttpRequest *request, uint64_t deadline_ns, HttpTiming *timing);
+
+/* End of an exchange starting now under timeouts->total_ms (ut_now_ns clock), 0 = none */
+uint64_t http_deadline(const HttpTimeouts *timeouts);
+
+/*
+ * Timeout for one wait of a phase: phase_ms capped by what is left until
+ * deadline_ns, for the net_*_timed() calls (-1 = no limit, 0 = expired).
+ */
+int http_timeout_ms(uint32_t phase_ms, uint64_t deadline_ns);
+
+/*
+ * Start timing a new hop of a response: returns its zeroed timing entry with
+ * start_ns set (the last entry is reused past HTTP_MAX_TIMED_HOPS).
+ */
+HttpTiming *http_timing_begin(HttpResponse *response);
+
+/* Mark a phase boundary of a hop (timing may be NULL): phase = time since the hop started */
+#define HTTP_TIMING_MARK(timing, phase) \
+    do { if (timing) { (timing)->phase = ut_now_ns() - (timing)->start_ns; } } while (0)
+
+/* ============================================================================
+ * Request/response helpers
+ * ============================================================================
+ * Building blocks shared by the blocking and the non-blocking clients.
+ */
+
+/*
+ * Build a complete HTTP/1.1 request message.
+ *
+ *  @param method         request method
+ *  @param host           value of the Host header (without port)
+ *  @param path           request target
+ *  @param port           destination port (omitted from Host when 80)
+ *  @param body           POST body (ignored for GET, may be NULL)
+ *  @param headers        additional headers (validated and trimmed)
+ *  @param headers_count  number of additional headers
+ *  @param out            receives a heap-allocated, NUL-terminated request (caller frees)
+ *  @param out_len        receives the request length (may be NULL)
+ *
+ *  @return ERR_OK on success and an Error struct on failure
+ */
+Error http_build_request(HttpMethod method,
+                         const char *host,
+                         const char *path,
+                         int port,
+                         const char *body,
+                         const char **headers,
+                         int headers_count,
+                         char **out,
+                         size_t *out_len);
+
+/*
+ * Parse the status code from the status line of a raw response.
+ *
+ *  @return ERR_OK on success, ERR_BAD_RESPONSE if the status line is malformed
+ */
+Error http_parse_status(const char *raw, HttpStatusCode *out);
+
+/*
+ * Locate a header field in the header section of a raw response.
+ * The search stops at the end of the header section.
+ *
+ *  @param raw        raw response (NUL-terminated)
+ *  @param name       header name without colon, matched case-insensitively
+ *  @param value      receives a pointer to the value (leading spaces skipped)
+ *  @param value_len  receives the value length (excluding CRLF)
+ *
+ *  @return true if the header was found
+ */
+bool http_find_header(const char *raw, const char *name, const char **value, size_t *value_len);
+
+/* Parse an IMF-fixdate ("Sun, 06 Nov 1994 08:49:37 GMT") into seconds since the epoch */
+bool http_parse_date(const char *s, int64_t *out);
+
+/*
+ * Delay requested by a 429 or 503 response through Retry-After
+ * (delta-seconds or an HTTP-date; a date in the past gives 0).
+ *
+ *  @return false for other statuses or a missing/invalid header
+ */
+bool http_retry_after(const HttpResponse *response, uint64_t *delay_ms);
+
+/* Whether a status code is a redirect that carries a Location header */
+bool http_is_redirect(HttpStatusCode code);
+
+/* Method to use after a redirect (301/302/303 turn POST into GET) */
+HttpMethod http_redirect_method(HttpMethod method, HttpStatusCode code);
+
+/*
+ * Update a parsed URI with the Location header of a redirect response.
+ * Absolute paths keep the current host and port; anything else is parsed as a new URI.
+ *
+ *  @return ERR_OK on success, ERR_HTTP_REDIRECT_FAILED if Location is missing or invalid
+ */
+Error http_apply_redirect(const HttpResponse *response, URI *uri);
+
 #endif
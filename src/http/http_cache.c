@@ -0,0 +1,510 @@
+/*
+    File: src/http/http_cache.c
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference:
+        - HTTP Caching (RFC 9111): https://datatracker.ietf.org/doc/html/rfc9111
+        - FNV hash: http://www.isthe.com/chongo/tech/comp/fnv/
+        - Howard Hinnant, "chrono-Compatible Low-Level Date Algorithms" (days_from_civil)
+    Description:
+        Implementation of the disk-backed response cache.
+
+            <dir>/index               fixed-size slot table, memory-mapped
+            <dir>/<key hash>.resp     stored response bytes
+
+        A key is the FNV-1a hash of the normalized request target; its slot
+        is found by linear probing from hash % HTTP_CACHE_SLOTS, so lookups
+        touch one or two index pages and never scan the directory. Content
+        files are written to a temporary name and renamed into place before
+        the slot is updated, so a crash never leaves a slot pointing at a
+        half-written response. On Windows the index is read into memory and
+        written back on close instead of being mapped.
+*/
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <direct.h>
+#endif
+
+#include <time.h>
+#include <errno.h>
+#include <ctype.h>
+#include <strings.h>
+#include "http/http_cache.h"
+#include "util/util.h"
+
+#define CACHE_MAGIC       0x31484354u   // "TCH1"
+#define CACHE_VERSION     1
+#define CACHE_MAX_PROBES  16
+
+typedef struct CacheSlot {
+    uint64_t key_hash;          // 0 = empty
+    uint64_t vary_hash;         // request values of the headers named in vary
+    int64_t stored_at;          // unix time of the last store or revalidation
+    int64_t expires_at;         // fresh until this unix time
+    uint32_t size;              // bytes in the content file
+    uint32_t reserved;
+    char etag[80];
+    char last_modified[40];
+    char vary[96];              // lower-cased Vary header value
+} CacheSlot;
+
+typedef struct CacheIndex {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slot_count;
+    uint32_t reserved;
+    CacheSlot slots[HTTP_CACHE_SLOTS];
+} CacheIndex;
+
+/* Process-wide cache state */
+static struct {
+    char dir[512];
+    CacheIndex *index;
+} cache;
+
+/* Function Prototypes */
+static uint64_t fnv1a(uint64_t hash, const char *data, size_t len);
+static bool cache_key(const HttpRequest *req, uint64_t *out);
+static CacheSlot *cache_find(uint64_t key, bool for_insert);
+static uint64_t cache_vary_hash(const HttpRequest *req, const char *vary);
+static bool request_header(const HttpRequest *req, const char *name, size_t name_len, const char **value, size_t *value_len);
+static bool copy_header(const char *raw, const char *name, char *out, size_t cap);
+static bool is_cacheable_status(HttpStatusCode code);
+static bool cache_freshness(const HttpResponse *response, int64_t now, int64_t *expires_at, bool *no_store);
+static void cache_store(const HttpRequest *req, uint64_t key, const HttpResponse *response);
+static void cache_body_path(uint64_t key, const char *suffix, char *out, size_t cap);
+
+Error http_cache_open(const char *dir) {
+    if (strlen(dir) >= sizeof(cache.dir) - 32) {
+        return ERR_NEW(ERR_INVALID_ARGS, "Cache directory path is too long: %s", dir);
+    }
+    http_cache_close();
+
+    char path[sizeof(cache.dir) + 16];
+    snprintf(path, sizeof(path), "%s/index", dir);
+
+#ifndef _WIN32
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        return ERR_NEW(ERR_IO, "Failed to create cache directory %s", dir);
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return ERR_NEW(ERR_IO, "Failed to open cache index %s", path);
+    }
+
+    struct stat st;
+    bool fresh_file = fstat(fd, &st) != 0 || (size_t)st.st_size != sizeof(CacheIndex);
+    if (fresh_file && ftruncate(fd, (off_t)sizeof(CacheIndex)) != 0) {
+        close(fd);
+        return ERR_NEW(ERR_IO, "Failed to size cache index %s", path);
+    }
+
+    void *map = mmap(NULL, sizeof(CacheIndex), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); // the mapping keeps the file open
+    if (map == MAP_FAILED) {
+        return ERR_NEW(ERR_IO, "Failed to map cache index %s", path);
+    }
+    cache.index = (CacheIndex *)map;
+#else
+    if (_mkdir(dir) != 0 && errno != EEXIST) {
+        return ERR_NEW(ERR_IO, "Failed to create cache directory %s", dir);
+    }
+
+    cache.index = ut_calloc(MEM_TAG_CACHE, 1, sizeof(CacheIndex));
+    if (!cache.index) {
+        return ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate cache index");
+    }
+    FILE *file = fopen(path, "rb");
+    if (file) {
+        if (fread(cache.index, 1, sizeof(CacheIndex), file) != sizeof(CacheIndex)) {
+            memset(cache.index, 0, sizeof(CacheIndex));
+        }
+        fclose(file);
+    }
+#endif
+
+    // Unknown or older layouts are discarded rather than migrated
+    if (cache.index->magic != CACHE_MAGIC || cache.index->version != CACHE_VERSION || cache.index->slot_count != HTTP_CACHE_SLOTS) {
+        memset(cache.index, 0, sizeof(CacheIndex));
+        cache.index->magic = CACHE_MAGIC;
+        cache.index->version = CACHE_VERSION;
+        cache.index->slot_count = HTTP_CACHE_SLOTS;
+    }
+
+    snprintf(cache.dir, sizeof(cache.dir), "%s", dir);
+    return ERR_OK();
+}
+
+void http_cache_close(void) {
+    if (!cache.index) {
+        return;
+    }
+#ifndef _WIN32
+    munmap(cache.index, sizeof(CacheIndex));
+#else
+    char path[sizeof(cache.dir) + 16];
+    snprintf(path, sizeof(path), "%s/index", cache.dir);
+    write_to(path, (const char *)cache.index, sizeof(CacheIndex));
+    ut_free(cache.index);
+#endif
+    cache.index = NULL;
+    cache.dir[0] = '\0';
+}
+
+bool http_cache_enabled(void) {
+    return cache.index != NULL;
+}
+
+HttpCacheStatus http_cache_lookup(const HttpRequest *req, HttpCacheEntry *entry) {
+    uint64_t key = 0;
+    entry->status = HTTP_CACHE_MISS;
+    entry->if_none_match[0] = '\0';
+    entry->if_modified_since[0] = '\0';
+
+    if (!cache.index || req->method != HTTP_METHOD_GET || !cache_key(req, &key)) {
+        return HTTP_CACHE_MISS;
+    }
+
+    CacheSlot *slot = cache_find(key, false);
+    if (!slot || slot->vary_hash != cache_vary_hash(req, slot->vary)) {
+        return HTTP_CACHE_MISS;
+    }
+
+    char path[sizeof(cache.dir) + 32];
+    char *data = NULL;
+    size_t len = 0;
+    cache_body_path(key, "resp", path, sizeof(path));
+    Error err = read_from(path, &data, &len);
+    if (ERR_FAILED(err) || len != slot->size || len >= HTTP_MAX_RESPONSE) {
+        ut_free(data);
+        return HTTP_CACHE_MISS;
+    }
+
+    memcpy(entry->response.raw, data, len);
+    entry->response.raw[len] = '\0';
+    entry->response.bytes_received = len;
+    entry->response.hops = 0; // served without a network exchange
+    ut_free(data);
+    if (ERR_FAILED(http_parse_status(entry->response.raw, &entry->response.status_code))) {
+        return HTTP_CACHE_MISS;
+    }
+
+    if (slot->etag[0]) {
+        snprintf(entry->if_none_match, sizeof(entry->if_none_match), "If-None-Match: %s", slot->etag);
+    }
+    if (slot->last_modified[0]) {
+        snprintf(entry->if_modified_since, sizeof(entry->if_modified_since), "If-Modified-Since: %s", slot->last_modified);
+    }
+
+    if ((int64_t)time(NULL) < slot->expires_at) {
+        entry->status = HTTP_CACHE_FRESH;
+    } else if (entry->if_none_match[0] || entry->if_modified_since[0]) {
+        entry->status = HTTP_CACHE_STALE;
+    }
+    return entry->status;
+}
+
+Error http_cache_conditional_headers(const HttpRequest *req, const HttpCacheEntry *entry, const char ***headers, int *count) {
+    const char **list = ut_malloc(MEM_TAG_CACHE, ((size_t)req->headers_count + 2) * sizeof(char *));
+    if (!list) {
+        return ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate conditional request headers");
+    }
+
+    int n = 0;
+    for (int i = 0; i < req->headers_count; i++) {
+        list[n++] = req->headers[i];
+    }
+    if (entry->if_none_match[0]) {
+        list[n++] = entry->if_none_match;
+    }
+    if (entry->if_modified_since[0]) {
+        list[n++] = entry->if_modified_since;
+    }
+
+    *headers = list;
+    *count = n;
+    return ERR_OK();
+}
+
+void http_cache_update(const HttpRequest *req, const HttpCacheEntry *entry, HttpResponse *response) {
+    uint64_t key = 0;
+    if (!cache.index || req->method != HTTP_METHOD_GET || !cache_key(req, &key)) {
+        return;
+    }
+
+    if (entry && entry->status == HTTP_CACHE_STALE && response->status_code == HTTP_NOT_MODIFIED) {
+        CacheSlot *slot = cache_find(key, false);
+        int64_t now = (int64_t)time(NULL);
+        int64_t expires_at = 0;
+        bool no_store = false;
+
+        if (slot) {
+            // Keep the previous lifetime unless the 304 carries its own
+            if (!cache_freshness(response, now, &expires_at, &no_store)) {
+                expires_at = now + (slot->expires_at - slot->stored_at);
+            }
+            slot->stored_at = now;
+            slot->expires_at = expires_at;
+            copy_header(response->raw, "ETag", slot->etag, sizeof(slot->etag));
+        }
+        // Keep the timings of the revalidation exchange
+        memcpy(response->raw, entry->response.raw, sizeof(response->raw));
+        response->bytes_received = entry->response.bytes_received;
+        response->status_code = entry->response.status_code;
+        return;
+    }
+
+    cache_store(req, key, response);
+}
+
+/* Internal helper functions */
+static uint64_t fnv1a(uint64_t hash, const char *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// Key = hash of the normalized target: lower-case host, explicit port, path, redirect mode
+static bool cache_key(const HttpRequest *req, uint64_t *out) {
+    URI uri = {0};
+    if (ERR_FAILED(parse_uri(req->uri, &uri))) {
+        return false;
+    }
+
+    char host[256];
+    size_t host_len = strlen(uri.host);
+    if (host_len >= sizeof(host)) {
+        cleanup_uri(&uri);
+        return false;
+    }
+    for (size_t i = 0; i <= host_len; i++) {
+        host[i] = (char)tolower((unsigned char)uri.host[i]);
+    }
+
+    char normalized[2048];
+    int n = snprintf(normalized, sizeof(normalized), "GET %d://%s:%d%s%s", (int)uri.schema, host, uri.port, uri.path, req->follow_redirects ? " follow" : "");
+    cleanup_uri(&uri);
+    if (n < 0 || (size_t)n >= sizeof(normalized)) {
+        return false;
+    }
+
+    uint64_t hash = fnv1a(0xcbf29ce484222325ULL, normalized, (size_t)n);
+    *out = hash ? hash : 1; // 0 marks an empty slot
+    return true;
+}
+
+// Find the slot holding key; for inserts fall back to an empty or the oldest probed slot
+static CacheSlot *cache_find(uint64_t key, bool for_insert) {
+    CacheSlot *victim = NULL;
+
+    for (size_t i = 0; i < CACHE_MAX_PROBES; i++) {
+        CacheSlot *slot = &cache.index->slots[(key + i) % HTTP_CACHE_SLOTS];
+        if (slot->key_hash == key) {
+            return slot;
+        }
+        if (!for_insert) {
+            if (slot->key_hash == 0) {
+                return NULL;
+            }
+            continue;
+        }
+        if (slot->key_hash == 0) {
+            return slot;
+        }
+        if (!victim || slot->stored_at < victim->stored_at) {
+            victim = slot;
+        }
+    }
+    return victim;
+}
+
+static uint64_t cache_vary_hash(const HttpRequest *req, const char *vary) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    while (*vary) {
+        while (*vary == ' ' || *vary == ',') vary++;
+        const char *end = vary;
+        while (*end && *end != ',' && *end != ' ') end++;
+        if (end == vary) {
+            break;
+        }
+
+        const char *value = "";
+        size_t value_len = 0;
+        request_header(req, vary, (size_t)(end - vary), &value, &value_len);
+        hash = fnv1a(hash, vary, (size_t)(end - vary));
+        hash = fnv1a(hash, "=", 1);
+        hash = fnv1a(hash, value, value_len);
+        hash = fnv1a(hash, "\n", 1);
+        vary = end;
+    }
+    return hash;
+}
+
+static bool request_header(const HttpRequest *req, const char *name, size_t name_len, const char **value, size_t *value_len) {
+    for (int i = 0; i < req->headers_count; i++) {
+        const char *h = req->headers[i];
+        if (strncasecmp(h, name, name_len) == 0 && h[name_len] == ':') {
+            const char *v = h + name_len + 1;
+            while (*v == ' ' || *v == '\t') v++;
+            *value = v;
+            *value_len = strlen(v);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Copy a response header value; false if absent or too long
+static bool copy_header(const char *raw, const char *name, char *out, size_t cap) {
+    const char *value = NULL;
+    size_t len = 0;
+    if (!http_find_header(raw, name, &value, &len) || len >= cap) {
+        return false;
+    }
+    memcpy(out, value, len);
+    out[len] = '\0';
+    return true;
+}
+
+static bool is_cacheable_status(HttpStatusCode code) {
+    switch (code) {
+        case HTTP_OK:
+        case HTTP_NON_AUTHORITATIVE_INFORMATION:
+        case HTTP_NO_CONTENT:
+        case HTTP_MULTIPLE_CHOICES:
+        case HTTP_MOVED_PERMANENTLY:
+        case HTTP_PERMANENT_REDIRECT:
+        case HTTP_NOT_FOUND:
+        case HTTP_METHOD_NOT_ALLOWED:
+        case HTTP_GONE:
+        case HTTP_URI_TOO_LONG:
+        case HTTP_NOT_IMPLEMENTED:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Compute the expiry from Cache-Control max-age (minus Age) or Expires; false if neither is present
+static bool cache_freshness(const HttpResponse *response, int64_t now, int64_t *expires_at, bool *no_store) {
+    char cc[256] = {0};
+    char value[64];
+
+    *no_store = false;
+    if (copy_header(response->raw, "Cache-Control", cc, sizeof(cc))) {
+        for (char *c = cc; *c; c++) {
+            *c = (char)tolower((unsigned char)*c);
+        }
+        if (strstr(cc, "no-store")) {
+            *no_store = true;
+            return false;
+        }
+        if (strstr(cc, "no-cache")) {
+            *expires_at = now; // store, but revalidate on every use
+            return true;
+        }
+
+        const char *max_age = strstr(cc, "max-age=");
+        if (max_age) {
+            int64_t age = 0;
+            if (copy_header(response->raw, "Age", value, sizeof(value))) {
+                age = strtoll(value, NULL, 10);
+            }
+            *expires_at = now + strtoll(max_age + 8, NULL, 10) - age;
+            return true;
+        }
+    }
+
+    if (copy_header(response->raw, "Expires", value, sizeof(value))) {
+        // An invalid date (e.g. "0") means already expired
+        if (!http_parse_date(value, expires_at)) {
+            *expires_at = now;
+        }
+        return true;
+    }
+    return false;
+}
+
+static void cache_store(const HttpRequest *req, uint64_t key, const HttpResponse *response) {
+    int64_t now = (int64_t)time(NULL);
+    int64_t expires_at = now;
+    bool no_store = false;
+    char etag[80] = {0};
+    char last_modified[40] = {0};
+    char vary[96] = {0};
+
+    if (!is_cacheable_status(response->status_code)) {
+        return;
+    }
+    // A full buffer means the response was truncated (see HTTP_MAX_RESPONSE)
+    if (response->bytes_received >= HTTP_MAX_RESPONSE - 1 || !strstr(response->raw, "\r\n\r\n")) {
+        return;
+    }
+
+    bool has_lifetime = cache_freshness(response, now, &expires_at, &no_store);
+    bool has_validator = copy_header(response->raw, "ETag", etag, sizeof(etag)) |
+                         copy_header(response->raw, "Last-Modified", last_modified, sizeof(last_modified));
+    if (no_store || (!has_lifetime && !has_validator)) {
+        return;
+    }
+
+    const char *v = NULL;
+    size_t v_len = 0;
+    if (http_find_header(response->raw, "Vary", &v, &v_len)) {
+        if (v_len >= sizeof(vary) || memchr(v, '*', v_len)) {
+            return;
+        }
+        for (size_t i = 0; i < v_len; i++) {
+            vary[i] = (char)tolower((unsigned char)v[i]);
+        }
+    }
+
+    // Content first, atomically; the slot only ever names a complete file
+    char tmp[sizeof(cache.dir) + 32];
+    char path[sizeof(cache.dir) + 32];
+    cache_body_path(key, "tmp", tmp, sizeof(tmp));
+    cache_body_path(key, "resp", path, sizeof(path));
+    if (ERR_FAILED(write_to(tmp, response->raw, (size_t)response->bytes_received))) {
+        return;
+    }
+#ifdef _WIN32
+    remove(path); // rename() does not replace on Windows
+#endif
+    if (rename(tmp, path) != 0) {
+        remove(tmp);
+        return;
+    }
+
+    CacheSlot *slot = cache_find(key, true);
+    if (!slot) {
+        return;
+    }
+    if (slot->key_hash != 0 && slot->key_hash != key) {
+        char evicted[sizeof(cache.dir) + 32];
+        cache_body_path(slot->key_hash, "resp", evicted, sizeof(evicted));
+        remove(evicted);
+    }
+    memset(slot, 0, sizeof(CacheSlot));
+    slot->key_hash = key;
+    slot->vary_hash = cache_vary_hash(req, vary);
+    slot->stored_at = now;
+    slot->expires_at = expires_at;
+    slot->size = (uint32_t)response->bytes_received;
+    memcpy(slot->etag, etag, sizeof(etag));
+    memcpy(slot->last_modified, last_modified, sizeof(last_modified));
+    memcpy(slot->vary, vary, sizeof(vary));
+}
+
+static void cache_body_path(uint64_t key, const char *suffix, char *out, size_t cap) {
+    snprintf(out, cap, "%s/%016llx.%s", cache.dir, (unsigned long long)key, suffix);
+}
@@ -0,0 +1,91 @@
+/*
+    File: src/http/http_cache.h
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference:
+        - HTTP Caching (RFC 9111): https://datatracker.ietf.org/doc/html/rfc9111
+        - Conditional Requests (RFC 9110, 13): https://datatracker.ietf.org/doc/html/rfc9110#section-13
+    Description:
+        Disk-backed private HTTP response cache for Torilate.
+        GET responses are stored per normalized URI (one variant, checked
+        against the request headers named by Vary). Fresh entries are
+        served without touching the network; stale ones are revalidated
+        with If-None-Match / If-Modified-Since so a 304 only costs headers.
+        The cache is process-wide: open it once and every GET made with
+        http_perform() or an HttpMulti handle consults it.
+        Not thread-safe: use it from the thread that drives the requests.
+*/
+
+#ifndef TORILATE_HTTP_CACHE_H
+#define TORILATE_HTTP_CACHE_H
+
+#include <stdbool.h>
+#include "http/http.h"
+#include "error/error.h"
+
+/* Number of entries in the index (open addressing) */
+#define HTTP_CACHE_SLOTS 4096
+
+typedef enum {
+    HTTP_CACHE_MISS,        // nothing usable stored
+    HTTP_CACHE_FRESH,       // stored response may be used as is
+    HTTP_CACHE_STALE,       // stored response needs revalidation
+} HttpCacheStatus;
+
+/* Result of a lookup; carries the stored response and its validators */
+typedef struct HttpCacheEntry {
+    HttpCacheStatus status;
+    HttpResponse response;          // stored response (FRESH and STALE only)
+    char if_none_match[96];         // "If-None-Match: ..." or empty
+    char if_modified_since[64];     // "If-Modified-Since: ..." or empty
+} HttpCacheEntry;
+
+
+/*
+ * Open (or create) the cache in a directory and enable it process-wide.
+ *
+ *  @param dir  cache directory; created if missing
+ *
+ *  @return ERR_OK on success and an Error struct on failure
+ */
+Error http_cache_open(const char *dir);
+
+/* Flush and disable the cache */
+void http_cache_close(void);
+
+/* True while a cache is open */
+bool http_cache_enabled(void);
+
+/*
+ * Look up the response for a GET request.
+ *
+ *  @param request  request about to be sent
+ *  @param entry    receives the stored response and validators
+ *
+ *  @return lookup status (also stored in entry->status)
+ */
+HttpCacheStatus http_cache_lookup(const HttpRequest *request, HttpCacheEntry *entry);
+
+/*
+ * Build the header list for revalidating a stale entry: the request headers
+ * followed by the entry's validators. The array is heap-allocated (ut_free() it);
+ * the strings are borrowed from the request and the entry.
+ *
+ *  @return ERR_OK on success, ERR_OUTOFMEMORY on allocation failure
+ */
+Error http_cache_conditional_headers(const HttpRequest *request, const HttpCacheEntry *entry, const char ***headers, int *count);
+
+/*
+ * Feed a network response back into the cache.
+ * A 304 answering a revalidation refreshes the entry and replaces the content of
+ * *response with the stored one (its timings are kept); any other cacheable
+ * response is stored. Cache write failures
+ * are not fatal to the request and are ignored.
+ *
+ *  @param request   the original (unconditional) request
+ *  @param entry     lookup result for the request (may be NULL)
+ *  @param response  response received; may be replaced by the stored response
+ */
+void http_cache_update(const HttpRequest *request, const HttpCacheEntry *entry, HttpResponse *response);
+
+#endif
@@ -0,0 +1,273 @@
+/*
+    File: src/http/http_dns.c
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference:
+        - Tor SOCKS extensions (RESOLVE): https://spec.torproject.org/socks-extensions.html
+        - Special-purpose IPv4 addresses (RFC 6890): https://datatracker.ietf.org/doc/html/rfc6890
+        - FNV hash: http://www.isthe.com/chongo/tech/comp/fnv/
+    Description:
+        Implementation of the Tor-resolved hostname cache. Entries sit
+        in a fixed slot table (FNV-1a of the lowercased name, linear
+        probing; slots are never emptied, so probe chains stay intact).
+        Prefetches run on a small thread pool, each one a blocking
+        connect to a SOCKS endpoint followed by a RESOLVE on its own
+        isolation token, so the lookups share no circuit with the
+        requests. One mutex guards the table; it is only held for the
+        table access, never across network I/O.
+*/
+
+#include <ctype.h>
+#include <strings.h>
+#include <stdatomic.h>
+#include "http/http_dns.h"
+#include "http/http_proxy.h"
+#include "socks/socks4.h"
+#include "util/util.h"
+#include "diag/trace.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+static pthread_mutex_t dns_lock = PTHREAD_MUTEX_INITIALIZER;
+#define DNS_LOCK()      pthread_mutex_lock(&dns_lock)
+#define DNS_UNLOCK()    pthread_mutex_unlock(&dns_lock)
+#else
+#define DNS_LOCK()      ((void)0)       // the pool runs resolves inline
+#define DNS_UNLOCK()    ((void)0)
+#endif
+
+#define DNS_ISOLATION   PROG_NAME "-resolve"
+
+typedef enum {
+    DNS_EMPTY,
+    DNS_PENDING,        // queued or being resolved
+    DNS_RESOLVED,       // addr usable until expires_ns
+    DNS_FAILED,         // not resolved, unsafe or dropped: go by name
+} DnsState;
+
+typedef struct DnsSlot {
+    char host[HTTP_DNS_HOST_MAX];
+    uint32_t addr;          // network byte order
+    uint64_t expires_ns;
+    DnsState state;
+} DnsSlot;
+
+static struct {
+    bool enabled;
+    uint64_t ttl_ns;
+    int timeout_ms;
+    DnsSlot *slots;
+    ThreadPool *pool;
+    atomic_bool closing;
+    HttpDnsStats stats;
+} dns;
+
+/* Function Prototypes */
+static DnsSlot *dns_find(const char *host, bool insert);
+static bool dns_cacheable(const char *host);
+static bool dns_public(uint32_t addr);
+static void dns_resolve_task(void *arg);
+
+Error http_dns_open(uint32_t ttl_s, int timeout_ms) {
+    http_dns_close();
+
+    dns.slots = ut_calloc(MEM_TAG_HTTP, HTTP_DNS_SLOTS, sizeof(DnsSlot));
+    if (!dns.slots) {
+        return ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate %d DNS cache slots", HTTP_DNS_SLOTS);
+    }
+    Error err = pool_create(HTTP_DNS_PARALLEL, &dns.pool);
+    if (ERR_FAILED(err)) {
+        ut_free(dns.slots);
+        dns.slots = NULL;
+        return ERR_PROPAGATE(err, "Failed to start DNS prefetch threads");
+    }
+
+    dns.ttl_ns = (uint64_t)ttl_s * 1000000000ULL;
+    dns.timeout_ms = timeout_ms;
+    memset(&dns.stats, 0, sizeof(dns.stats));
+    atomic_store(&dns.closing, false);
+    dns.enabled = true;
+    return ERR_OK();
+}
+
+void http_dns_close(void) {
+    if (!dns.enabled) {
+        return;
+    }
+    atomic_store(&dns.closing, true);
+    pool_wait(dns.pool);
+    pool_destroy(dns.pool);
+    dns.pool = NULL;
+    ut_free(dns.slots);
+    dns.slots = NULL;
+    dns.enabled = false;
+}
+
+bool http_dns_enabled(void) {
+    return dns.enabled;
+}
+
+Error http_dns_prefetch(const char *host) {
+    if (!dns.enabled || !dns_cacheable(host)) {
+        return ERR_OK();
+    }
+
+    DNS_LOCK();
+    DnsSlot *slot = dns_find(host, true);
+    bool queue = slot && (slot->state == DNS_EMPTY ||
+                          (slot->state == DNS_RESOLVED && slot->expires_ns <= ut_now_ns()));
+    if (queue) {
+        slot->state = DNS_PENDING;
+    }
+    DNS_UNLOCK();
+    if (!queue) {
+        return ERR_OK();    // cached, queued, failed before or the table is full
+    }
+
+    Error err = pool_submit(dns.pool, dns_resolve_task, slot);
+    if (ERR_FAILED(err)) {
+        DNS_LOCK();
+        slot->state = DNS_FAILED;
+        DNS_UNLOCK();
+        return ERR_PROPAGATE(err, "Failed to queue the resolution of %s", host);
+    }
+    return ERR_OK();
+}
+
+bool http_dns_lookup(const char *host, char *ip, size_t cap) {
+    if (!dns.enabled) {
+        return false;
+    }
+
+    DNS_LOCK();
+    DnsSlot *slot = dns_find(host, false);
+    bool hit = slot && slot->state == DNS_RESOLVED && slot->expires_ns > ut_now_ns();
+    uint32_t addr = hit ? slot->addr : 0;
+    if (hit) {
+        dns.stats.hits++;
+    } else {
+        dns.stats.misses++;
+    }
+    DNS_UNLOCK();
+
+    if (hit) {
+        const uint8_t *b = (const uint8_t *)&addr;
+        snprintf(ip, cap, "%u.%u.%u.%u", b[0], b[1], b[2], b[3]);
+    }
+    return hit;
+}
+
+void http_dns_forget(const char *host) {
+    if (!dns.enabled) {
+        return;
+    }
+
+    DNS_LOCK();
+    DnsSlot *slot = dns_find(host, false);
+    if (slot && slot->state == DNS_RESOLVED) {
+        slot->state = DNS_FAILED;
+        dns.stats.dropped++;
+    }
+    DNS_UNLOCK();
+}
+
+void http_dns_stats(HttpDnsStats *out) {
+    DNS_LOCK();
+    *out = dns.stats;
+    DNS_UNLOCK();
+}
+
+/* Internal helper functions */
+
+// Slot of host, or the empty slot that ends its probe chain when insert is set
+static DnsSlot *dns_find(const char *host, bool insert) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const char *p = host; *p; p++) {
+        hash ^= (uint8_t)tolower((unsigned char)*p);
+        hash *= 0x100000001b3ULL;
+    }
+
+    for (size_t i = 0; i < HTTP_DNS_SLOTS; i++) {
+        DnsSlot *slot = &dns.slots[(hash + i) % HTTP_DNS_SLOTS];
+        if (slot->state == DNS_EMPTY) {
+            if (!insert) {
+                return NULL;
+            }
+            snprintf(slot->host, sizeof(slot->host), "%s", host);
+            return slot;
+        }
+        if (strcasecmp(slot->host, host) == 0) {
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+// Names worth a RESOLVE: not an address already, not an onion service
+static bool dns_cacheable(const char *host) {
+    size_t len = strlen(host);
+    if (len == 0 || len >= HTTP_DNS_HOST_MAX || net_get_addr_type(host) != DOMAIN) {
+        return false;
+    }
+    static const char *suffixes[] = { ".onion", ".exit" };
+    for (size_t i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]); i++) {
+        size_t n = strlen(suffixes[i]);
+        if (len >= n && strcasecmp(host + len - n, suffixes[i]) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Globally routable unicast IPv4 (RFC 6890), addr in network byte order
+static bool dns_public(uint32_t addr) {
+    const uint8_t *b = (const uint8_t *)&addr;
+    return !(b[0] == 0 ||                                   // this network
+             b[0] == 10 ||                                  // private
+             b[0] == 127 ||                                 // loopback
+             (b[0] == 100 && (b[1] & 0xC0) == 64) ||        // shared address space
+             (b[0] == 169 && b[1] == 254) ||                // link local
+             (b[0] == 172 && (b[1] & 0xF0) == 16) ||        // private
+             (b[0] == 192 && b[1] == 0 && b[2] == 0) ||     // protocol assignments
+             (b[0] == 192 && b[1] == 168) ||                // private
+             (b[0] == 198 && (b[1] & 0xFE) == 18) ||        // benchmarking
+             b[0] >= 224);                                  // multicast, reserved, broadcast
+}
+
+// Pool task: RESOLVE one slot's name through Tor
+static void dns_resolve_task(void *arg) {
+    DnsSlot *slot = arg;
+    if (atomic_load(&dns.closing)) {
+        DNS_LOCK();
+        slot->state = DNS_FAILED;
+        DNS_UNLOCK();
+        return;
+    }
+
+    NetSocket sock = INVALID_SOCKET;
+    int proxy = -1;
+    uint32_t addr = 0;
+    TRACE_BEGIN("http", "dns_resolve", "slot", (int)(slot - dns.slots));
+    Error err = http_proxy_connect(&sock, dns.timeout_ms, &proxy);
+    if (!ERR_FAILED(err)) {
+        err = socks4_resolve(&sock, slot->host, DNS_ISOLATION, dns.timeout_ms, &addr);
+    }
+    net_close(&sock);
+    http_proxy_release(proxy, false);
+    TRACE_END("http", "dns_resolve", "error", err.code);
+
+    DNS_LOCK();
+    if (ERR_FAILED(err)) {
+        slot->state = DNS_FAILED;
+        dns.stats.failed++;
+    } else if (!dns_public(addr)) {
+        slot->state = DNS_FAILED;
+        dns.stats.unsafe++;
+    } else {
+        slot->addr = addr;
+        slot->expires_ns = ut_now_ns() + dns.ttl_ns;
+        slot->state = DNS_RESOLVED;
+        dns.stats.resolved++;
+    }
+    DNS_UNLOCK();
+}
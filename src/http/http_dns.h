@@ -0,0 +1,86 @@
+/*
+    File: src/http/http_dns.h
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference:
+        - Tor SOCKS extensions (RESOLVE): https://spec.torproject.org/socks-extensions.html
+    Description:
+        Hostname cache filled through Tor. Every SOCKS4a CONNECT by name
+        makes the exit resolve the name again before it opens the
+        stream; for a batch that hits the same few domains many times,
+        the names are resolved once with Tor's RESOLVE extension, in
+        parallel and ahead of the queue, and HttpMulti transfers then
+        connect to the cached address, which saves the exit a DNS round
+        trip on every stream.
+
+        Tor does not pass the DNS TTL on to SOCKS clients, so entries
+        live for a fixed time. An address is only used when it is safe
+        to: a public IPv4 address (never private, loopback or multicast,
+        which exits refuse anyway and which would point the request at
+        the wrong host) for a name that is not an onion service. A
+        CONNECT by address that Tor rejects drops the entry, so the
+        retry goes by name.
+
+        Process-wide and opt-in: nothing is resolved or looked up until
+        http_dns_open(). Lookups are thread-safe.
+*/
+
+#ifndef TORILATE_HTTP_DNS_H
+#define TORILATE_HTTP_DNS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "error/error.h"
+
+#define HTTP_DNS_SLOTS          1024    // hostnames kept (open addressing)
+#define HTTP_DNS_HOST_MAX       256     // longest hostname cached
+#define HTTP_DNS_PARALLEL       8       // RESOLVE requests in flight during a prefetch
+#define HTTP_DNS_DEFAULT_TTL_S  300     // lifetime of an entry
+
+typedef struct HttpDnsStats {
+    uint64_t resolved;      // names Tor resolved to a usable address
+    uint64_t failed;        // names Tor could not resolve (or timed out)
+    uint64_t unsafe;        // names resolved to an address not used (private, loopback, ...)
+    uint64_t hits;          // connects made to a cached address
+    uint64_t misses;        // connects by name while the cache was on
+    uint64_t dropped;       // entries dropped after a rejected connect
+} HttpDnsStats;
+
+
+/*
+ * Enable the cache process-wide.
+ *
+ *  @param ttl_s       seconds an address is used after it was resolved
+ *  @param timeout_ms  longest wait for one RESOLVE, connect included
+ */
+Error http_dns_open(uint32_t ttl_s, int timeout_ms);
+
+/* Wait for the resolves in flight (queued ones are skipped) and disable the cache */
+void http_dns_close(void);
+
+/* True while the cache is open */
+bool http_dns_enabled(void);
+
+/*
+ * Queue a hostname for resolution in the background; a name already cached
+ * or queued, an IP literal and an onion address are ignored. Returns at once
+ * (on Windows, where there are no resolver threads, after the RESOLVE).
+ */
+Error http_dns_prefetch(const char *host);
+
+/*
+ * Cached address of host, if it is fresh and safe to connect to.
+ *
+ *  @param ip   receives the dotted-decimal address
+ *  @return true when a CONNECT may go to ip instead of host
+ */
+bool http_dns_lookup(const char *host, char *ip, size_t cap);
+
+/* Drop the address of host after a CONNECT to it was rejected */
+void http_dns_forget(const char *host);
+
+/* Counters since http_dns_open() */
+void http_dns_stats(HttpDnsStats *out);
+
+#endif
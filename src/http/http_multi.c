@@ -0,0 +1,1408 @@
+/*
+    File: src/http/http_multi.c
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference:
+        - HTTP/1.1 (RFC 7230): https://datatracker.ietf.org/doc/html/rfc7230
+        - SOCKS4a Extension: https://www.openssh.org/txt/socks4a.protocol
+    Description:
+        Implementation of the non-blocking multi-request HTTP client.
+        Each transfer walks through the states below, resuming wherever
+        the socket would block:
+
+            QUEUED -> CONNECTING -> SOCKS_SEND -> SOCKS_RECV
+                   -> REQUEST_SEND -> RESPONSE_RECV -> DONE
+
+        A followed redirect sends the transfer back to QUEUED with the
+        new target as soon as its header section is in, so every hop
+        reuses the same machinery; the redirect's body is never read, and
+        the next hop connects without waiting for the old peer to close. When the
+        response cache is open, a fresh GET completes on promotion without
+        connecting and a stale one is sent with its validators.
+
+        Queued transfers wait in one FIFO per destination (host:port).
+        Free slots are handed to the destinations in round-robin order,
+        skipping any that has reached the per-host limit or is paused,
+        so one slow host cannot take every slot while others starve. A
+        429 or 503 with Retry-After pauses its destination for the
+        requested delay and puts the transfer back at the head of that
+        queue (up to MULTI_RETRY_AFTER_ATTEMPTS times). A transfer stays
+        charged to the destination it was queued for across redirects.
+
+        With hedging on, a GET that has not seen its first byte after the
+        chosen percentile of recent time-to-first-byte gets a twin sent
+        with a different SOCKS isolation token, so Tor builds it another
+        circuit. Whichever twin sees a first byte first wins; the other
+        is cancelled before it can report anything. A twin that fails
+        while the other is still running is dropped silently.
+
+        A transfer that fails transiently (see http_retry.h) before any
+        of its body was reported keeps its slot in BACKOFF and reconnects
+        from multi_start() once the backoff has run out, with a new
+        isolation token, so the retry is built on a fresh circuit.
+
+        Timeouts are timers, not signals: each started transfer carries the
+        deadline of its current phase (connect, SOCKS reply, first byte,
+        idle gap) and of its whole exchange. http_multi_perform() fails the
+        transfers whose deadline has passed with ERR_TIMEOUT, and the
+        earliest deadline bounds the poll timeout.
+
+        Each hop connects to the least loaded SOCKS endpoint (see
+        http_proxy.h); a connect that fails moves on to the next endpoint
+        within the same hop.
+*/
+
+#include "http/http_multi.h"
+#include "http/http_cache.h"
+#include "http/http_retry.h"
+#include "http/http_proxy.h"
+#include "http/http_dns.h"
+#include "util/util.h"
+#include "diag/trace.h"
+#include "diag/flight.h"
+#include "diag/perf.h"
+
+#define MULTI_RECV_CHUNK 16384
+#define MULTI_HOST_BUCKETS 256              // hash buckets of the destination table
+#define MULTI_HOST_KEY 272                  // "host:port" with a 255-byte host name
+#define MULTI_RETRY_AFTER_ATTEMPTS 3        // requeues per transfer on 429/503 + Retry-After
+#define MULTI_RETRY_AFTER_MAX_MS 120000     // longer delays pause the host but fail the transfer
+#define MULTI_TTFB_SAMPLES 256              // recent time-to-first-byte samples kept for hedging
+#define MULTI_TTFB_MIN_SAMPLES 20           // no hedging before this many samples
+#define MULTI_TTFB_REFRESH 16               // recompute the hedge delay every 16 samples
+
+typedef enum {
+    XFER_QUEUED,          // waiting for a connection slot (or next redirect hop)
+    XFER_CONNECTING,      // non-blocking connect to the Tor SOCKS port
+    XFER_SOCKS_SEND,      // writing the SOCKS4a CONNECT request
+    XFER_SOCKS_RECV,      // reading the 8-byte SOCKS4 reply
+    XFER_REQUEST_SEND,    // writing the HTTP request
+    XFER_RESPONSE_RECV,   // reading the response until the peer closes
+    XFER_DEFERRED,        // told to come back later (Retry-After): requeue
+    XFER_BACKOFF,         // failed transiently: reconnects once retry_at_ns has passed
+    XFER_CANCELLED,       // lost a hedge race: freed without callbacks
+    XFER_DONE
+} TransferState;
+
+/* Queued transfers of one destination */
+typedef struct HostQueue {
+    char key[MULTI_HOST_KEY];    // "host:port"
+    struct HttpTransfer *head;      // FIFO of transfers not yet started
+    struct HttpTransfer *tail;
+    size_t active;                  // started transfers queued for this host
+    uint64_t paused_until_ns;       // Retry-After: no new transfers before this
+    struct HostQueue *hash_next;
+} HostQueue;
+
+typedef struct HttpTransfer {
+    TransferState state;
+    HttpRequest req;            // deep copy owned by the transfer
+    HttpMethod method;          // current method (may change on redirect)
+    URI uri;                    // current target
+    int redirects;              // redirects followed so far
+    NetSocket sock;
+    size_t active_index;        // position in HttpMulti.active
+
+    uint8_t socks_buf[512];     // SOCKS request, then reply
+    size_t socks_len;
+    size_t socks_off;
+
+    char *request;              // HTTP request message
+    size_t request_len;
+    size_t request_off;
+
+    HttpResponse response;
+    HttpTiming *timing;         // phase timings of the current hop (inside response)
+    size_t header_len;          // 0 until the end of the header section is seen
+    HttpCacheEntry *cache;      // cache lookup result (NULL when no cache is open)
+    uint64_t hop_start_ns;      // connect start of the current hop (limiter sample)
+    HostQueue *host;            // destination the transfer was queued for
+    int deferrals;              // Retry-After requeues so far
+    struct HttpTransfer *twin;  // hedge pair partner until one of them wins
+    bool is_hedge;              // launched as the duplicate of a slow transfer
+    bool hedged;                // a duplicate has been launched for this one
+    int retries;                // transient failures retried so far
+    uint64_t retry_at_ns;       // end of the current backoff
+    bool delivered;             // body bytes were reported: no more retries
+    char retry_isolation[HTTP_RETRY_ISOLATION_MAX];  // isolation token of the latest retry
+    uint64_t phase_deadline_ns; // current phase must progress by then, 0 = no limit
+    uint64_t deadline_ns;       // end of the exchange over all hops, 0 = no limit
+    CircuitLease lease;         // pooled circuit of the first attempt (lease.pool NULL if none)
+    int proxy;                  // SOCKS endpoint of the current hop, -1 when not connected
+    uint32_t dialed;            // endpoints tried for the current hop (bit per endpoint)
+    bool by_address;            // the CONNECT of this hop went to uri.host's cached address (http_dns)
+
+    HttpDataCallback on_data;
+    HttpDoneCallback on_done;
+    void *userdata;
+    struct HttpTransfer *next;  // host queue link
+} HttpTransfer;
+
+struct HttpMulti {
+    size_t max_in_flight;
+    ConcLimiter *limiter;           // adaptive limit, NULL for a fixed max_in_flight
+    CircuitPool *circuits;          // routes requests without an isolation token, may be NULL
+
+    double hedge_percentile;        // 0 = hedging off
+    uint64_t hedge_delay_ns;        // current TTFB percentile, 0 until enough samples
+    uint64_t ttfb[MULTI_TTFB_SAMPLES];
+    size_t ttfb_count;              // samples recorded (the ring keeps the last MULTI_TTFB_SAMPLES)
+    HttpHedgeStats hedge_stats;
+
+    size_t max_per_host;            // 0 = no per-host limit
+
+    HostQueue *buckets[MULTI_HOST_BUCKETS];
+    HostQueue **hosts;              // every destination seen, in round-robin order
+    size_t host_count;
+    size_t host_cap;
+    size_t rr_next;                 // host to offer the next free slot to
+    size_t pending_count;           // queued transfers over all hosts
+
+    HttpTransfer **active;          // started transfers
+    size_t active_count;
+    size_t active_cap;
+
+    HttpTransfer **by_fd;           // socket handle -> active transfer
+    size_t by_fd_cap;
+
+    NetPollFd *poll_fds;            // scratch array for http_multi_poll()
+    size_t poll_cap;
+};
+
+/* Function Prototypes */
+static Error request_copy(HttpRequest *dst, const HttpRequest *src);
+static void request_free(HttpRequest *req);
+static void transfer_free(HttpTransfer *x);
+static Error multi_track_fd(HttpMulti *m, HttpTransfer *x);
+static void multi_untrack_fd(HttpMulti *m, HttpTransfer *x);
+static void transfer_disconnect(HttpMulti *m, HttpTransfer *x);
+static Error transfer_dial(HttpMulti *m, HttpTransfer *x, Error err, bool *in_progress);
+static void multi_finish(HttpMulti *m, HttpTransfer *x, Error err);
+static Error multi_start(HttpMulti *m);
+static Error transfer_connect(HttpMulti *m, HttpTransfer *x);
+static Error transfer_advance(HttpMulti *m, HttpTransfer *x, int revents);
+static Error transfer_on_data(HttpMulti *m, HttpTransfer *x, const char *chunk, size_t len);
+static Error transfer_on_eof(HttpMulti *m, HttpTransfer *x);
+static Error transfer_redirect(HttpMulti *m, HttpTransfer *x);
+static Error transfer_use_cache(HttpTransfer *x);
+static void transfer_emit_body(HttpTransfer *x);
+static size_t multi_limit(const HttpMulti *m);
+static bool is_overload(Error err);
+static bool multi_settle(HttpMulti *m, HttpTransfer *x, Error err);
+static void multi_defer(HttpMulti *m, HttpTransfer *x);
+static bool multi_retry(HttpMulti *m, HttpTransfer *x, Error err);
+static void transfer_arm(HttpTransfer *x, uint32_t phase_ms);
+static bool transfer_on_wire(const HttpTransfer *x);
+static void multi_expire(HttpMulti *m);
+static Error multi_host(HttpMulti *m, const URI *uri, HostQueue **out);
+static HttpTransfer *multi_next_pending(HttpMulti *m, uint64_t now);
+static void host_push(HostQueue *h, HttpTransfer *x, bool front);
+static int64_t multi_wakeup_ms(const HttpMulti *m);
+static void multi_record_ttfb(HttpMulti *m, uint64_t ttfb_ns);
+static bool hedge_eligible(const HttpMulti *m, const HttpTransfer *x);
+static Error multi_hedge(HttpMulti *m);
+static void multi_reap_cancelled(HttpMulti *m);
+static void transfer_first_byte(HttpMulti *m, HttpTransfer *x);
+static void transfer_cancel(HttpMulti *m, HttpTransfer *x);
+
+/* Public API */
+Error http_multi_create(size_t max_in_flight, HttpMulti **out) {
+    HttpMulti *m = ut_calloc(MEM_TAG_MULTI, 1, sizeof(HttpMulti));
+    if (!m) {
+        return ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate multi handle");
+    }
+    m->max_in_flight = max_in_flight;
+    *out = m;
+    return ERR_OK();
+}
+
+void http_multi_destroy(HttpMulti *multi) {
+    if (!multi) {
+        return;
+    }
+
+    for (size_t i = 0; i < multi->active_count; i++) {
+        transfer_free(multi->active[i]);
+    }
+
+    for (size_t i = 0; i < multi->host_count; i++) {
+        HttpTransfer *x = multi->hosts[i]->head;
+        while (x) {
+            HttpTransfer *next = x->next;
+            transfer_free(x);
+            x = next;
+        }
+        ut_free(multi->hosts[i]);
+    }
+
+    ut_free(multi->hosts);
+    ut_free(multi->active);
+    ut_free(multi->by_fd);
+    ut_free(multi->poll_fds);
+    limiter_destroy(multi->limiter);
+    ut_free(multi);
+}
+
+Error http_multi_set_adaptive(HttpMulti *multi, size_t initial) {
+    size_t max = multi->max_in_flight > 0 ? multi->max_in_flight : LIMITER_DEFAULT_MAX;
+    limiter_destroy(multi->limiter);
+    multi->limiter = NULL;
+    return limiter_create(initial, max, &multi->limiter);
+}
+
+void http_multi_set_host_limit(HttpMulti *multi, size_t max_per_host) {
+    multi->max_per_host = max_per_host;
+}
+
+int http_multi_timeout(const HttpMulti *multi) {
+    int64_t ms = multi_wakeup_ms(multi);
+    return ms > INT32_MAX ? INT32_MAX : (int)ms;
+}
+
+void http_multi_set_circuits(HttpMulti *multi, CircuitPool *pool) {
+    multi->circuits = pool;
+}
+
+void http_multi_set_hedging(HttpMulti *multi, double percentile) {
+    multi->hedge_percentile = percentile;
+}
+
+bool http_multi_hedge_stats(const HttpMulti *multi, HttpHedgeStats *out) {
+    if (multi->hedge_percentile <= 0) {
+        return false;
+    }
+    *out = multi->hedge_stats;
+    out->delay_ns = multi->hedge_delay_ns;
+    return true;
+}
+
+void http_multi_print_stats(const HttpMulti *multi) {
+    LimiterStats limits;
+    if (http_multi_limiter_stats(multi, &limits)) {
+        print_limiter_stats(&limits);
+    }
+
+    HttpHedgeStats hedges;
+    if (http_multi_hedge_stats(multi, &hedges)) {
+        printf("%s: hedging at p%.0f TTFB (%.3f ms): %llu fired, %llu won by the duplicate, %llu by the original\n",
+               PROG_NAME, multi->hedge_percentile, (double)hedges.delay_ns / 1e6,
+               (unsigned long long)hedges.fired, (unsigned long long)hedges.won, (unsigned long long)hedges.lost);
+    }
+
+    HttpProxyStats proxies[HTTP_PROXY_MAX];
+    int proxy_count = http_proxy_stats(proxies, HTTP_PROXY_MAX);
+    if (proxy_count > 1) {
+        printf("%s: SOCKS endpoints:\n", PROG_NAME);
+        printf("  %-40s %10s %10s\n", "endpoint", "connects", "failed");
+        for (int i = 0; i < proxy_count; i++) {
+            printf("  %-40s %10llu %10llu%s\n", proxies[i].name, (unsigned long long)proxies[i].connects,
+                   (unsigned long long)proxies[i].failures, proxies[i].down ? "  (down)" : "");
+        }
+    }
+
+    HttpRetryStats retries;
+    http_retry_stats(&retries);
+    if (retries.retries > 0 || retries.denied > 0) {
+        printf("%s: retries: %llu over %llu requests, %llu refused by the retry budget\n", PROG_NAME,
+               (unsigned long long)retries.retries, (unsigned long long)retries.requests, (unsigned long long)retries.denied);
+    }
+}
+
+bool http_multi_limiter_stats(const HttpMulti *multi, LimiterStats *out) {
+    if (!multi->limiter) {
+        return false;
+    }
+    limiter_stats(multi->limiter, out);
+    return true;
+}
+
+Error http_multi_add(HttpMulti *multi, const HttpRequest *request, HttpDataCallback on_data, HttpDoneCallback on_done, void *userdata) {
+    HttpTransfer *x = ut_calloc(MEM_TAG_MULTI, 1, sizeof(HttpTransfer));
+    if (!x) {
+        return ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate transfer for %s", request->uri);
+    }
+    x->sock = INVALID_SOCKET;
+    x->proxy = -1;
+
+    Error err = request_copy(&x->req, request);
+    if (ERR_FAILED(err)) {
+        ut_free(x);
+        return err;
+    }
+
+    err = parse_uri(x->req.uri, &x->uri);
+    if (ERR_FAILED(err)) {
+        transfer_free(x);
+        return ERR_PROPAGATE(err, "Failed to parse URI: %s", request->uri);
+    }
+
+    err = transfer_use_cache(x);
+    if (ERR_FAILED(err)) {
+        transfer_free(x);
+        return err;
+    }
+
+    err = multi_host(multi, &x->uri, &x->host);
+    if (ERR_FAILED(err)) {
+        transfer_free(x);
+        return err;
+    }
+
+    x->state    = XFER_QUEUED;
+    x->method   = request->method;
+    x->on_data  = on_data;
+    x->on_done  = on_done;
+    x->userdata = userdata;
+
+    host_push(x->host, x, false);
+    multi->pending_count++;
+    http_retry_begin();
+
+    return ERR_OK();
+}
+
+size_t http_multi_fds(HttpMulti *multi, NetPollFd *fds, size_t cap) {
+    size_t n = 0;
+
+    for (size_t i = 0; i < multi->active_count; i++) {
+        HttpTransfer *x = multi->active[i];
+        int events;
+
+        switch (x->state) {
+            case XFER_CONNECTING:
+            case XFER_SOCKS_SEND:
+            case XFER_REQUEST_SEND:
+                events = NET_POLL_OUT;
+                break;
+            case XFER_SOCKS_RECV:
+            case XFER_RESPONSE_RECV:
+                events = NET_POLL_IN;
+                break;
+            default:
+                continue;
+        }
+
+        if (n < cap) {
+            fds[n].sock    = x->sock;
+            fds[n].events  = events;
+            fds[n].revents = 0;
+        }
+        n++;
+    }
+
+    return n;
+}
+
+Error http_multi_perform(HttpMulti *multi, const NetPollFd *fds, size_t count, size_t *running) {
+    Error err = multi_start(multi);
+    if (ERR_FAILED(err)) {
+        return err;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (fds[i].revents == 0) {
+            continue;
+        }
+
+        int handle = fds[i].sock.handle;
+        if (handle < 0 || (size_t)handle >= multi->by_fd_cap) {
+            continue;
+        }
+
+        HttpTransfer *x = multi->by_fd[handle];
+        if (!x) {
+            continue;
+        }
+
+        multi_settle(multi, x, transfer_advance(multi, x, fds[i].revents));
+    }
+    multi_expire(multi);
+
+    // Start follow-up hops and newly freed slots only after the ready set has been
+    // consumed, so that a reused socket handle is never matched with stale readiness.
+    err = multi_start(multi);
+    if (ERR_FAILED(err)) {
+        return err;
+    }
+    err = multi_hedge(multi);
+    if (ERR_FAILED(err)) {
+        return err;
+    }
+    multi_reap_cancelled(multi);
+
+    if (running) {
+        *running = multi->active_count + multi->pending_count;
+    }
+    return ERR_OK();
+}
+
+Error http_multi_poll(HttpMulti *multi, int timeout_ms, size_t *running) {
+    size_t remaining = 0;
+    Error err = http_multi_perform(multi, NULL, 0, &remaining);
+    if (ERR_FAILED(err) || remaining == 0) {
+        if (running) {
+            *running = remaining;
+        }
+        return err;
+    }
+
+    // Wake up in time for a destination whose Retry-After runs out
+    int wakeup_ms = http_multi_timeout(multi);
+    if (wakeup_ms >= 0 && (timeout_ms < 0 || wakeup_ms < timeout_ms)) {
+        timeout_ms = wakeup_ms;
+    }
+
+    size_t n = http_multi_fds(multi, multi->poll_fds, multi->poll_cap);
+    if (n == 0) {
+        // Everything left waits for a paused destination
+        if (timeout_ms > 0) {
+            ut_sleep_ns((uint64_t)timeout_ms * 1000000);
+        }
+        return http_multi_perform(multi, NULL, 0, running);
+    }
+    if (n > multi->poll_cap) {
+        NetPollFd *grown = ut_realloc(MEM_TAG_MULTI, multi->poll_fds, n * sizeof(NetPollFd));
+        if (!grown) {
+            return ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate %zu poll entries", n);
+        }
+        multi->poll_fds = grown;
+        multi->poll_cap = n;
+        n = http_multi_fds(multi, multi->poll_fds, multi->poll_cap);
+    }
+
+    int ready = 0;
+    err = net_poll(multi->poll_fds, n, timeout_ms, &ready);
+    if (ERR_FAILED(err)) {
+        return ERR_PROPAGATE(err, "Failed to poll %zu transfers", n);
+    }
+
+    return http_multi_perform(multi, ready > 0 ? multi->poll_fds : NULL, ready > 0 ? n : 0, running);
+}
+
+/* Internal helper functions */
+static Error request_copy(HttpRequest *dst, const HttpRequest *src) {
+    *dst = *src;
+    dst->uri = NULL;
+    dst->body = NULL;
+    dst->headers = NULL;
+    dst->headers_count = 0;
+    dst->isolation = NULL;
+
+    dst->uri = ut_strdup(src->uri);
+    if (!dst->uri) {
+        goto oom;
+    }
+
+    if (src->body) {
+        dst->body = ut_strdup(src->body);
+        if (!dst->body) {
+            goto oom;
+        }
+    }
+
+    if (src->isolation) {
+        dst->isolation = ut_strdup(src->isolation);
+        if (!dst->isolation) {
+            goto oom;
+        }
+    }
+
+    if (src->headers_count > 0) {
+        dst->headers = ut_calloc(MEM_TAG_MULTI, (size_t)src->headers_count, sizeof(char *));
+        if (!dst->headers) {
+            goto oom;
+        }
+        for (int i = 0; i < src->headers_count; i++) {
+            dst->headers[i] = ut_strdup(src->headers[i]);
+            if (!dst->headers[i]) {
+                goto oom;
+            }
+            dst->headers_count++;
+        }
+    }
+    return ERR_OK();
+
+oom:
+    request_free(dst);
+    return ERR_NEW(ERR_OUTOFMEMORY, "Failed to copy request for %s", src->uri);
+}
+
+static void request_free(HttpRequest *req) {
+    for (int i = 0; i < req->headers_count; i++) {
+        ut_free((void *)req->headers[i]);
+    }
+    ut_free((void *)req->headers);
+    ut_free((void *)req->body);
+    ut_free((void *)req->uri);
+    ut_free((void *)req->isolation);
+    memset(req, 0, sizeof(HttpRequest));
+}
+
+static void transfer_free(HttpTransfer *x) {
+    circuit_pool_release(&x->lease, false);
+    net_close(&x->sock);
+    http_proxy_release(x->proxy, false);
+    ut_free(x->request);
+    ut_free(x->cache);
+    cleanup_uri(&x->uri);
+    request_free(&x->req);
+    ut_free(x);
+}
+
+static Error multi_track_fd(HttpMulti *m, HttpTransfer *x) {
+    size_t handle = (size_t)x->sock.handle;
+    if (handle >= m->by_fd_cap) {
+        size_t cap = m->by_fd_cap ? m->by_fd_cap : 64;
+        while (cap <= handle) {
+            cap *= 2;
+        }
+        HttpTransfer **grown = ut_realloc(MEM_TAG_MULTI, m->by_fd, cap * sizeof(HttpTransfer *));
+        if (!grown) {
+            return ERR_NEW(ERR_OUTOFMEMORY, "Failed to grow socket table to %zu entries", cap);
+        }
+        memset(grown + m->by_fd_cap, 0, (cap - m->by_fd_cap) * sizeof(HttpTransfer *));
+        m->by_fd = grown;
+        m->by_fd_cap = cap;
+    }
+
+    m->by_fd[handle] = x;
+    return ERR_OK();
+}
+
+static void multi_untrack_fd(HttpMulti *m, HttpTransfer *x) {
+    if (is_valid_socket(&x->sock) && (size_t)x->sock.handle < m->by_fd_cap) {
+        m->by_fd[x->sock.handle] = NULL;
+    }
+}
+
+// Close the connection of the current hop and hand its SOCKS endpoint back
+static void transfer_disconnect(HttpMulti *m, HttpTransfer *x) {
+    multi_untrack_fd(m, x);
+    net_close(&x->sock);
+    http_proxy_release(x->proxy, false);
+    x->proxy = -1;
+}
+
+static void multi_finish(HttpMulti *m, HttpTransfer *x, Error err) {
+    TRACE_INSTANT("http", "transfer_done", "error", err.code);
+    transfer_disconnect(m, x);
+
+    // Remove from the active set (swap with last)
+    size_t idx = x->active_index;
+    m->active[idx] = m->active[m->active_count - 1];
+    m->active[idx]->active_index = idx;
+    m->active_count--;
+    x->host->active--;
+
+    if (x->twin) {
+        HttpTransfer *twin = x->twin;
+        x->twin = NULL;
+        twin->twin = NULL;
+        if (ERR_FAILED(err)) {
+            // The other copy is still racing and reports for both
+            transfer_free(x);
+            return;
+        }
+        transfer_cancel(m, twin);
+    }
+
+    if (x->on_done) {
+        x->on_done(x->userdata, err, ERR_FAILED(err) ? NULL : &x->response);
+    }
+    transfer_free(x);
+}
+
+static Error multi_start(HttpMulti *m) {
+    // Reconnect transfers whose redirect hop is waiting or whose backoff has run out
+    size_t i = 0;
+    uint64_t now = ut_now_ns();
+    while (i < m->active_count) {
+        HttpTransfer *x = m->active[i];
+        if (x->state != XFER_QUEUED && !(x->state == XFER_BACKOFF && now >= x->retry_at_ns)) {
+            i++;
+            continue;
+        }
+
+        if (!multi_settle(m, x, transfer_connect(m, x))) {
+            i++;    // otherwise slot i now holds a different transfer
+        }
+    }
+
+    // Promote pending transfers while there are free slots
+    size_t limit = multi_limit(m);
+    while (m->pending_count > 0 && (limit == 0 || m->active_count < limit)) {
+        if (m->active_count == m->active_cap) {
+            size_t cap = m->active_cap ? m->active_cap * 2 : 64;
+            HttpTransfer **grown = ut_realloc(MEM_TAG_MULTI, m->active, cap * sizeof(HttpTransfer *));
+            if (!grown) {
+                return ERR_NEW(ERR_OUTOFMEMORY, "Failed to grow active transfer list to %zu entries", cap);
+            }
+            m->active = grown;
+            m->active_cap = cap;
+        }
+
+        HttpTransfer *x = multi_next_pending(m, now);
+        if (!x) {
+            break;  // every destination with work is paused or at its limit
+        }
+
+        x->active_index = m->active_count;
+        m->active[m->active_count++] = x;
+        x->host->active++;
+
+        if (x->cache && x->cache->status == HTTP_CACHE_FRESH) {
+            TRACE_INSTANT("http", "cache_hit", "status", x->cache->response.status_code);
+            memcpy(&x->response, &x->cache->response, sizeof(HttpResponse));
+            transfer_emit_body(x);
+            multi_finish(m, x, ERR_OK());
+            continue;
+        }
+
+        multi_settle(m, x, transfer_connect(m, x));
+    }
+
+    return ERR_OK();
+}
+
+static Error transfer_connect(HttpMulti *m, HttpTransfer *x) {
+    bool in_progress = false;
+
+    x->timing = http_timing_begin(&x->response);
+    x->hop_start_ns = ut_now_ns();
+    if (x->deadline_ns == 0 && x->req.timeouts.total_ms > 0) {
+        x->deadline_ns = http_deadline(&x->req.timeouts);
+    }
+    transfer_arm(x, x->req.timeouts.connect_ms);
+    TRACE_INSTANT("http", "hop_start", "hop", x->response.hops);
+    flight_record(FLIGHT_HOP, -1, (uint64_t)x->response.hops, 0);
+    x->dialed = 0;
+    Error err = transfer_dial(m, x, ERR_OK(), &in_progress);
+    if (ERR_FAILED(err)) {
+        return err;
+    }
+
+    if (m->circuits && !x->req.isolation && x->retries == 0 && !x->lease.pool) {
+        circuit_pool_acquire(m->circuits, &x->lease);
+    }
+    const char *isolation = x->retries > 0 ? x->retry_isolation
+                          : x->lease.pool ? x->lease.token
+                          : x->req.isolation ? x->req.isolation : PROG_NAME;
+    // Connect by the address resolved ahead of time, if any: the exit skips its DNS lookup
+    char addr[16];
+    x->by_address = x->uri.addr_type == DOMAIN && http_dns_lookup(x->uri.host, addr, sizeof(addr));
+    err = socks4_build_connect(x->socks_buf, sizeof(x->socks_buf), x->by_address ? addr : x->uri.host, (uint16_t)x->uri.port,
+                               isolation, x->by_address ? IPV4 : x->uri.addr_type, &x->socks_len);
+    if (x->uri.addr_type == DOMAIN && !x->by_address && http_dns_enabled()) {
+        (void)http_dns_prefetch(x->uri.host);     // e.g. a redirect target or an expired entry: later streams hit
+    }
+    if (ERR_FAILED(err)) {
+        return ERR_PROPAGATE(err, "SOCKS4 connection to %s:%d failed", x->uri.host, x->uri.port);
+    }
+    x->socks_off = 0;
+
+    x->state = in_progress ? XFER_CONNECTING : XFER_SOCKS_SEND;
+    if (!in_progress) {
+        http_proxy_connected(x->proxy);
+        HTTP_TIMING_MARK(x->timing, connect_ns);
+        transfer_arm(x, x->req.timeouts.handshake_ms);
+        // Loopback connects usually complete at once; start writing right away
+        return transfer_advance(m, x, NET_POLL_OUT);
+    }
+    return ERR_OK();
+}
+
+// Connect to the least loaded SOCKS endpoint not yet tried for this hop, moving
+// on while connects are refused at once; err is why the previous endpoint
+// failed, returned when none is left
+static Error transfer_dial(HttpMulti *m, HttpTransfer *x, Error err, bool *in_progress) {
+    while ((x->proxy = http_proxy_acquire(x->dialed)) >= 0) {
+        x->dialed |= 1u << x->proxy;
+        err = http_proxy_connect_start(x->proxy, &x->sock, in_progress);
+        if (!ERR_FAILED(err)) {
+            return multi_track_fd(m, x);
+        }
+        err = ERR_PROPAGATE(err, "Cannot connect to TOR at %s", http_proxy_name(x->proxy));
+        http_proxy_release(x->proxy, true);
+        x->proxy = -1;
+    }
+    return err;
+}
+
+static Error transfer_advance(HttpMulti *m, HttpTransfer *x, int revents) {
+    Error err = ERR_OK();
+    size_t n = 0;
+    bool would_block = false;
+    char chunk[MULTI_RECV_CHUNK];
+    PerfMark mark;
+
+    for (;;) {
+        switch (x->state) {
+            case XFER_CONNECTING:
+                if (!(revents & (NET_POLL_OUT | NET_POLL_ERR))) {
+                    return ERR_OK();
+                }
+                err = net_connect_finish(&x->sock);
+                if (ERR_FAILED(err)) {
+                    err = ERR_PROPAGATE(err, "Cannot connect to TOR at %s", http_proxy_name(x->proxy));
+                    multi_untrack_fd(m, x);
+                    net_close(&x->sock);
+                    http_proxy_release(x->proxy, true);
+                    x->proxy = -1;
+
+                    // Fail over to the next endpoint within this hop
+                    bool in_progress = false;
+                    err = transfer_dial(m, x, err, &in_progress);
+                    if (ERR_FAILED(err) || in_progress) {
+                        return err;
+                    }
+                }
+                http_proxy_connected(x->proxy);
+                HTTP_TIMING_MARK(x->timing, connect_ns);
+                transfer_arm(x, x->req.timeouts.handshake_ms);
+                x->state = XFER_SOCKS_SEND;
+                break;
+
+            case XFER_SOCKS_SEND:
+                err = net_send_some(&x->sock, x->socks_buf + x->socks_off, x->socks_len - x->socks_off, &n);
+                if (ERR_FAILED(err)) {
+                    return ERR_PROPAGATE(err, "Failed to send SOCKS4 CONNECT request (%zu bytes)", x->socks_len);
+                }
+                if (n == 0) {
+                    return ERR_OK();
+                }
+                x->socks_off += n;
+                if (x->socks_off == x->socks_len) {
+                    HTTP_TIMING_MARK(x->timing, socks_sent_ns);
+                    x->socks_off = 0;
+                    x->state = XFER_SOCKS_RECV;
+                }
+                break;
+
+            case XFER_SOCKS_RECV:
+                err = net_recv_some(&x->sock, x->socks_buf + x->socks_off, SOCKS4_REPLY_LEN - x->socks_off, &n, &would_block);
+                if (ERR_FAILED(err)) {
+                    return ERR_PROPAGATE(err, "Failed to receive SOCKS4 response");
+                }
+                if (would_block) {
+                    return ERR_OK();
+                }
+                if (n == 0) {
+                    err = socks4_parse_reply(x->socks_buf, x->socks_off, x->uri.host, (uint16_t)x->uri.port);
+                    if (x->by_address) {
+                        http_dns_forget(x->uri.host);
+                    }
+                    return ERR_PROPAGATE(err, "SOCKS4 connection to %s:%d failed", x->uri.host, x->uri.port);
+                }
+                x->socks_off += n;
+                if (x->socks_off < SOCKS4_REPLY_LEN) {
+                    break;
+                }
+
+                err = socks4_parse_reply(x->socks_buf, x->socks_off, x->uri.host, (uint16_t)x->uri.port);
+                if (ERR_FAILED(err)) {
+                    if (x->by_address) {
+                        http_dns_forget(x->uri.host);   // stale address or SafeSocks: the retry goes by name
+                    }
+                    return ERR_PROPAGATE(err, "SOCKS4 connection to %s:%d failed", x->uri.host, x->uri.port);
+                }
+                HTTP_TIMING_MARK(x->timing, socks_reply_ns);
+
+                ut_free(x->request);
+                x->request = NULL;
+                perf_begin(&mark);
+                err = http_build_request(x->method, x->uri.host, x->uri.path, x->uri.port, x->req.body, x->req.headers, x->req.headers_count, &x->request, &x->request_len);
+                perf_end(PERF_BUILD, &mark);
+                if (ERR_FAILED(err)) {
+                    return err;
+                }
+                x->request_off = 0;
+                transfer_arm(x, x->req.timeouts.idle_ms);
+                x->state = XFER_REQUEST_SEND;
+                break;
+
+            case XFER_REQUEST_SEND:
+                err = net_send_some(&x->sock, x->request + x->request_off, x->request_len - x->request_off, &n);
+                if (ERR_FAILED(err)) {
+                    return err;
+                }
+                if (n == 0) {
+                    return ERR_OK();
+                }
+                x->request_off += n;
+                transfer_arm(x, x->req.timeouts.idle_ms);
+                if (x->request_off == x->request_len) {
+                    HTTP_TIMING_MARK(x->timing, request_sent_ns);
+                    TRACE_INSTANT("http", "request_sent", "bytes", x->request_len);
+                    x->response.bytes_received = 0;
+                    x->response.status_code = 0;
+                    x->response.raw[0] = '\0';
+                    x->header_len = 0;
+                    transfer_arm(x, x->req.timeouts.ttfb_ms);
+                    x->state = XFER_RESPONSE_RECV;
+                }
+                break;
+
+            case XFER_RESPONSE_RECV:
+                err = net_recv_some(&x->sock, chunk, sizeof(chunk), &n, &would_block);
+                if (ERR_FAILED(err)) {
+                    return ERR_PROPAGATE(err, "Failed to receive HTTP response");
+                }
+                if (would_block) {
+                    return ERR_OK();
+                }
+                if (n == 0) {
+                    return transfer_on_eof(m, x);
+                }
+                transfer_arm(x, x->req.timeouts.idle_ms);
+                err = transfer_on_data(m, x, chunk, n);
+                if (ERR_FAILED(err)) {
+                    return err;
+                }
+                break;
+
+            default:
+                return ERR_OK();
+        }
+    }
+}
+
+static Error transfer_on_data(HttpMulti *m, HttpTransfer *x, const char *chunk, size_t len) {
+    HttpResponse *r = &x->response;
+    size_t before = (size_t)r->bytes_received;
+    size_t room = HTTP_MAX_RESPONSE - 1 - before;
+    size_t keep = len < room ? len : room;
+
+    if (before == 0 && x->header_len == 0) {
+        HTTP_TIMING_MARK(x->timing, first_byte_ns);
+        TRACE_INSTANT("http", "first_byte", "fd", x->sock.handle);
+        transfer_first_byte(m, x);
+    }
+    // Keep the head of the response for status/header parsing, like http_perform
+    memcpy(r->raw + before, chunk, keep);
+    r->bytes_received = before + keep;
+    r->raw[r->bytes_received] = '\0';
+
+    if (x->header_len == 0) {
+        size_t from = before > 3 ? before - 3 : 0;
+        const char *end = strstr(r->raw + from, "\r\n\r\n");
+        if (!end) {
+            if (r->bytes_received == HTTP_MAX_RESPONSE - 1) {
+                return ERR_NEW(ERR_BAD_RESPONSE, "HTTP header section exceeds %d bytes", HTTP_MAX_RESPONSE - 1);
+            }
+            return ERR_OK();
+        }
+        x->header_len = (size_t)(end - r->raw) + 4;
+
+        Error err = http_parse_status(r->raw, &r->status_code);
+        if (ERR_FAILED(err)) {
+            return err;
+        }
+        flight_record(FLIGHT_STATUS, (int)x->sock.handle, 0, r->status_code);
+        if (x->req.follow_redirects && http_is_redirect(r->status_code)) {
+            return transfer_redirect(m, x);
+        }
+
+        // Body bytes that arrived together with the end of the headers
+        size_t skip = x->header_len - before;
+        chunk += skip;
+        len -= skip;
+    }
+
+    if (len > 0 && x->on_data) {
+        x->delivered = true;
+        x->on_data(x->userdata, chunk, len);
+    }
+    return ERR_OK();
+}
+
+static Error transfer_on_eof(HttpMulti *m, HttpTransfer *x) {
+    HTTP_TIMING_MARK(x->timing, last_byte_ns);
+    if (m->limiter) {
+        limiter_sample(m->limiter, ut_now_ns() - x->hop_start_ns, false, m->active_count);
+    }
+    Error err = http_parse_status(x->response.raw, &x->response.status_code);
+    if (ERR_FAILED(err)) {
+        return err;
+    }
+
+    uint64_t delay_ms = 0;
+    if (http_retry_after(&x->response, &delay_ms)) {
+        // Hold back the whole destination, and retry this request once it may
+        uint64_t until = ut_now_ns() + (delay_ms < MULTI_RETRY_AFTER_MAX_MS ? delay_ms : MULTI_RETRY_AFTER_MAX_MS) * 1000000;
+        if (until > x->host->paused_until_ns) {
+            x->host->paused_until_ns = until;
+        }
+        TRACE_INSTANT("http", "retry_after", "ms", delay_ms);
+        if (delay_ms <= MULTI_RETRY_AFTER_MAX_MS && x->deferrals < MULTI_RETRY_AFTER_ATTEMPTS) {
+            x->deferrals++;
+            x->state = XFER_DEFERRED;
+            return ERR_OK();
+        }
+    }
+
+    if (x->cache) {
+        // A 304 is swapped for the stored response, whose body was never streamed
+        bool revalidated = x->cache->status == HTTP_CACHE_STALE && x->response.status_code == HTTP_NOT_MODIFIED;
+        http_cache_update(&x->req, x->cache, &x->response);
+        if (revalidated) {
+            transfer_emit_body(x);
+        }
+    }
+    x->state = XFER_DONE;
+    return ERR_OK();
+}
+
+// The header section of a redirect to follow is in: drop the tunnel with the body
+// still unread and queue the next hop, which multi_start() connects right away
+static Error transfer_redirect(HttpMulti *m, HttpTransfer *x) {
+    HTTP_TIMING_MARK(x->timing, last_byte_ns);
+    if (m->limiter) {
+        limiter_sample(m->limiter, ut_now_ns() - x->hop_start_ns, false, m->active_count);
+    }
+
+    if (x->redirects >= x->req.max_redirects) {
+        return ERR_NEW(ERR_HTTP_REDIRECT_LIMIT, "Exceeded maximum redirect limit of %d", x->req.max_redirects);
+    }
+    x->redirects++;
+    TRACE_INSTANT("http", "redirect", "status", x->response.status_code);
+    flight_record(FLIGHT_REDIRECT, (int)x->sock.handle, (uint64_t)x->redirects, x->response.status_code);
+
+    x->method = http_redirect_method(x->method, x->response.status_code);
+    Error err = http_apply_redirect(&x->response, &x->uri);
+    if (ERR_FAILED(err)) {
+        return err;
+    }
+
+    // Next hop reconnects from multi_start()
+    transfer_disconnect(m, x);
+    x->state = XFER_QUEUED;
+    return ERR_OK();
+}
+
+// Consult the response cache; a stale entry adds its validators to the request copy
+static Error transfer_use_cache(HttpTransfer *x) {
+    if (x->req.method != HTTP_METHOD_GET || !http_cache_enabled()) {
+        return ERR_OK();
+    }
+
+    x->cache = ut_malloc(MEM_TAG_MULTI, sizeof(HttpCacheEntry));
+    if (!x->cache) {
+        return ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate cache entry for %s", x->req.uri);
+    }
+    if (http_cache_lookup(&x->req, x->cache) != HTTP_CACHE_STALE) {
+        return ERR_OK();
+    }
+
+    const char **grown = ut_realloc(MEM_TAG_MULTI, (void *)x->req.headers, ((size_t)x->req.headers_count + 2) * sizeof(char *));
+    if (!grown) {
+        return ERR_NEW(ERR_OUTOFMEMORY, "Failed to add validators for %s", x->req.uri);
+    }
+    x->req.headers = grown;
+
+    const char *validators[] = { x->cache->if_none_match, x->cache->if_modified_since };
+    for (size_t i = 0; i < 2; i++) {
+        if (!validators[i][0]) {
+            continue;
+        }
+        char *copy = ut_strdup(validators[i]);
+        if (!copy) {
+            return ERR_NEW(ERR_OUTOFMEMORY, "Failed to add validators for %s", x->req.uri);
+        }
+        x->req.headers[x->req.headers_count++] = copy;
+    }
+    return ERR_OK();
+}
+
+// Report the body of a response that did not arrive over the socket
+static void transfer_emit_body(HttpTransfer *x) {
+    const char *end = strstr(x->response.raw, "\r\n\r\n");
+    if (!end || !x->on_data) {
+        return;
+    }
+    size_t header_len = (size_t)(end - x->response.raw) + 4;
+    if (x->response.bytes_received > header_len) {
+        x->on_data(x->userdata, end + 4, (size_t)x->response.bytes_received - header_len);
+    }
+}
+
+static size_t multi_limit(const HttpMulti *m) {
+    return m->limiter ? limiter_limit(m->limiter) : m->max_in_flight;
+}
+
+// Failures that mean the proxy or the circuits are saturated rather than a bad request
+static bool is_overload(Error err) {
+    return err.code == ERR_CONNECTION_FAILED || err.code == ERR_TOR_CONNECTION_FAILED || err.code == ERR_TIMEOUT;
+}
+
+// Finish or requeue a transfer that failed, completed or was deferred; true if it left the active set
+static bool multi_settle(HttpMulti *m, HttpTransfer *x, Error err) {
+    if (ERR_FAILED(err) && m->limiter && is_overload(err)) {
+        limiter_sample(m->limiter, ut_now_ns() - x->hop_start_ns, true, m->active_count);
+    }
+
+    if (ERR_FAILED(err) || x->state == XFER_DONE) {
+        // Errors a retry could fix are the circuit's fault (or the proxy's)
+        circuit_pool_release(&x->lease, ERR_FAILED(err) && http_retry_classify(err) != HTTP_RETRY_NEVER);
+    }
+
+    if (ERR_FAILED(err)) {
+        if (multi_retry(m, x, err)) {
+            return false;   // keeps its slot while backing off
+        }
+        if (x->retries > 0) {
+            err = ERR_PROPAGATE(err, "Giving up after %d attempts", x->retries + 1);
+        }
+        multi_finish(m, x, err);
+    } else if (x->state == XFER_DONE) {
+        multi_finish(m, x, ERR_OK());
+    } else if (x->state == XFER_DEFERRED) {
+        multi_defer(m, x);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Put a transfer back at the head of its destination's queue (Retry-After)
+// A twin still racing the other copy is dropped instead
+static void multi_defer(HttpMulti *m, HttpTransfer *x) {
+    transfer_disconnect(m, x);
+
+    size_t idx = x->active_index;
+    m->active[idx] = m->active[m->active_count - 1];
+    m->active[idx]->active_index = idx;
+    m->active_count--;
+    x->host->active--;
+
+    if (x->twin) {
+        // Still racing its twin: leave the request to the copy that is not throttled
+        x->twin->twin = NULL;
+        transfer_free(x);
+        return;
+    }
+
+    x->state = XFER_QUEUED;
+    x->deadline_ns = 0;
+    host_push(x->host, x, true);
+    m->pending_count++;
+}
+
+// Back off a transiently failed transfer and have it reconnect on a new circuit
+// A twin still racing the other copy is not retried: the other copy reports for both
+static bool multi_retry(HttpMulti *m, HttpTransfer *x, Error err) {
+    if (x->twin || x->delivered || !http_retry_should(&x->req, err, x->retries)) {
+        return false;
+    }
+
+    transfer_disconnect(m, x);
+
+    x->retries++;
+    x->deadline_ns = 0;     // the next attempt gets a full total
+    flight_record(FLIGHT_RETRY, -1, (uint64_t)x->retries, err.code);
+    http_retry_isolation(&x->req, x->retry_isolation, sizeof(x->retry_isolation));
+    x->retry_at_ns = ut_now_ns() + http_retry_backoff_ns(x->retries);
+    x->state = XFER_BACKOFF;
+    return true;
+}
+
+// Start the clock of a transfer's next phase (0 = no limit for the phase; the total still applies)
+static void transfer_arm(HttpTransfer *x, uint32_t phase_ms) {
+    x->phase_deadline_ns = phase_ms > 0 ? ut_now_ns() + (uint64_t)phase_ms * 1000000 : 0;
+}
+
+// Between the connect and the last response byte, where the timeouts apply
+static bool transfer_on_wire(const HttpTransfer *x) {
+    return x->state >= XFER_CONNECTING && x->state <= XFER_RESPONSE_RECV;
+}
+
+// Fail every transfer on the wire whose phase or exchange deadline has passed
+static void multi_expire(HttpMulti *m) {
+    static const char *phases[] = {
+        [XFER_CONNECTING]    = "connect to the Tor SOCKS port",
+        [XFER_SOCKS_SEND]    = "SOCKS request",
+        [XFER_SOCKS_RECV]    = "SOCKS reply",
+        [XFER_REQUEST_SEND]  = "request write",
+        [XFER_RESPONSE_RECV] = "response",
+    };
+    uint64_t now = ut_now_ns();
+    size_t i = 0;
+    while (i < m->active_count) {
+        HttpTransfer *x = m->active[i];
+        bool on_wire = transfer_on_wire(x);
+        bool phase_over = x->phase_deadline_ns != 0 && now >= x->phase_deadline_ns;
+        bool total_over = x->deadline_ns != 0 && now >= x->deadline_ns;
+        if (!on_wire || (!phase_over && !total_over)) {
+            i++;
+            continue;
+        }
+
+        if (x->state == XFER_CONNECTING) {
+            // The endpoint did not accept in time: count it against the endpoint
+            http_proxy_release(x->proxy, true);
+            x->proxy = -1;
+        }
+
+        Error err;
+        if (total_over) {
+            err = ERR_NEW(ERR_TIMEOUT, "Exchange with %s:%d exceeded %u ms (during %s)", x->uri.host, x->uri.port,
+                          x->req.timeouts.total_ms, phases[x->state]);
+        } else if (x->state == XFER_RESPONSE_RECV && x->response.bytes_received == 0) {
+            err = ERR_NEW(ERR_TIMEOUT, "No response from %s:%d within %u ms", x->uri.host, x->uri.port, x->req.timeouts.ttfb_ms);
+        } else {
+            err = ERR_NEW(ERR_TIMEOUT, "Timed out during %s for %s:%d", phases[x->state], x->uri.host, x->uri.port);
+        }
+        if (!multi_settle(m, x, err)) {
+            i++;    // backing off for a retry: still in slot i
+        }
+    }
+}
+
+// Find or create the queue of the destination of uri
+static Error multi_host(HttpMulti *m, const URI *uri, HostQueue **out) {
+    char key[MULTI_HOST_KEY];
+    int len = snprintf(key, sizeof(key), "%s:%d", uri->host, uri->port);
+    if (len < 0 || (size_t)len >= sizeof(key)) {
+        return ERR_NEW(ERR_INVALID_URI, "Host name too long: %s", uri->host);
+    }
+    for (int i = 0; i < len; i++) {
+        key[i] = (char)tolower((unsigned char)key[i]);
+    }
+
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < len; i++) {
+        hash = (hash ^ (uint8_t)key[i]) * 16777619u;
+    }
+    HostQueue **bucket = &m->buckets[hash % MULTI_HOST_BUCKETS];
+    for (HostQueue *h = *bucket; h; h = h->hash_next) {
+        if (strcmp(h->key, key) == 0) {
+            *out = h;
+            return ERR_OK();
+        }
+    }
+
+    if (m->host_count == m->host_cap) {
+        size_t cap = m->host_cap ? m->host_cap * 2 : 16;
+        HostQueue **grown = ut_realloc(MEM_TAG_MULTI, m->hosts, cap * sizeof(HostQueue *));
+        if (!grown) {
+            return ERR_NEW(ERR_OUTOFMEMORY, "Failed to grow host table to %zu entries", cap);
+        }
+        m->hosts = grown;
+        m->host_cap = cap;
+    }
+    HostQueue *h = ut_calloc(MEM_TAG_MULTI, 1, sizeof(HostQueue));
+    if (!h) {
+        return ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate queue for %s", key);
+    }
+    memcpy(h->key, key, (size_t)len + 1);
+    h->hash_next = *bucket;
+    *bucket = h;
+    m->hosts[m->host_count++] = h;
+    *out = h;
+    return ERR_OK();
+}
+
+// Pop the next transfer in round-robin order over the destinations that may start one
+static HttpTransfer *multi_next_pending(HttpMulti *m, uint64_t now) {
+    for (size_t n = 0; n < m->host_count; n++) {
+        size_t i = (m->rr_next + n) % m->host_count;
+        HostQueue *h = m->hosts[i];
+        if (!h->head || now < h->paused_until_ns || (m->max_per_host > 0 && h->active >= m->max_per_host)) {
+            continue;
+        }
+
+        HttpTransfer *x = h->head;
+        h->head = x->next;
+        if (!h->head) {
+            h->tail = NULL;
+        }
+        x->next = NULL;
+        m->pending_count--;
+        m->rr_next = (i + 1) % m->host_count;
+        return x;
+    }
+    return NULL;
+}
+
+static void host_push(HostQueue *h, HttpTransfer *x, bool front) {
+    if (front) {
+        x->next = h->head;
+        h->head = x;
+        if (!h->tail) {
+            h->tail = x;
+        }
+        return;
+    }
+    x->next = NULL;
+    if (h->tail) {
+        h->tail->next = x;
+    } else {
+        h->head = x;
+    }
+    h->tail = x;
+}
+
+// Milliseconds until a paused destination may start again or a transfer is due a hedge, a retry or a timeout, -1 if none is
+static int64_t multi_wakeup_ms(const HttpMulti *m) {
+    uint64_t now = ut_now_ns();
+    uint64_t earliest = 0;
+    for (size_t i = 0; i < m->host_count; i++) {
+        const HostQueue *h = m->hosts[i];
+        if (h->head && h->paused_until_ns > now && (earliest == 0 || h->paused_until_ns < earliest)) {
+            earliest = h->paused_until_ns;
+        }
+    }
+    for (size_t i = 0; i < m->active_count; i++) {
+        const HttpTransfer *x = m->active[i];
+        uint64_t at = 0;
+        if (x->state == XFER_BACKOFF) {
+            at = x->retry_at_ns;
+        } else if (hedge_eligible(m, x)) {
+            at = x->hop_start_ns + m->hedge_delay_ns;
+        }
+        bool on_wire = transfer_on_wire(x);
+        uint64_t deadlines[] = { at, on_wire ? x->phase_deadline_ns : 0, on_wire ? x->deadline_ns : 0 };
+        for (size_t d = 0; d < sizeof(deadlines) / sizeof(deadlines[0]); d++) {
+            if (deadlines[d] != 0 && (earliest == 0 || deadlines[d] < earliest)) {
+                earliest = deadlines[d];
+            }
+        }
+    }
+    if (earliest == 0) {
+        return -1;
+    }
+    return earliest > now ? (int64_t)((earliest - now + 999999) / 1000000) : 0;
+}
+
+static void multi_record_ttfb(HttpMulti *m, uint64_t ttfb_ns) {
+    m->ttfb[m->ttfb_count % MULTI_TTFB_SAMPLES] = ttfb_ns;
+    m->ttfb_count++;
+    if (m->ttfb_count < MULTI_TTFB_MIN_SAMPLES || m->ttfb_count % MULTI_TTFB_REFRESH != 0) {
+        return;
+    }
+
+    size_t n = m->ttfb_count < MULTI_TTFB_SAMPLES ? m->ttfb_count : MULTI_TTFB_SAMPLES;
+    Histogram *h = NULL;
+    if (ERR_FAILED(hist_create(&h))) {
+        return; // keep the previous delay
+    }
+    for (size_t i = 0; i < n; i++) {
+        hist_record(h, m->ttfb[i]);
+    }
+    m->hedge_delay_ns = hist_percentile(h, m->hedge_percentile);
+    hist_destroy(h);
+}
+
+// A first-hop GET still waiting for its first byte, not yet paired
+static bool hedge_eligible(const HttpMulti *m, const HttpTransfer *x) {
+    if (m->hedge_delay_ns == 0 || x->hedged || x->is_hedge || x->redirects > 0 || x->method != HTTP_METHOD_GET) {
+        return false;
+    }
+    if (x->cache && x->cache->status == HTTP_CACHE_STALE) {
+        return false; // the request carries validators for an entry the twin has not looked up
+    }
+    return x->state >= XFER_CONNECTING && x->state <= XFER_RESPONSE_RECV && x->response.bytes_received == 0;
+}
+
+// Launch twins for transfers whose first byte is later than the hedge delay
+static Error multi_hedge(HttpMulti *m) {
+    uint64_t now = ut_now_ns();
+    size_t count = m->active_count;   // twins are appended: do not visit them
+
+    for (size_t i = 0; i < count && i < m->active_count; i++) {
+        HttpTransfer *x = m->active[i];
+        if (!hedge_eligible(m, x) || now - x->hop_start_ns < m->hedge_delay_ns) {
+            continue;
+        }
+        x->hedged = true;
+
+        if (m->active_count == m->active_cap) {
+            size_t cap = m->active_cap ? m->active_cap * 2 : 64;
+            HttpTransfer **grown = ut_realloc(MEM_TAG_MULTI, m->active, cap * sizeof(HttpTransfer *));
+            if (!grown) {
+                return ERR_NEW(ERR_OUTOFMEMORY, "Failed to grow active transfer list to %zu entries", cap);
+            }
+            m->active = grown;
+            m->active_cap = cap;
+        }
+
+        HttpTransfer *h = ut_calloc(MEM_TAG_MULTI, 1, sizeof(HttpTransfer));
+        if (!h) {
+            continue; // hedging is best effort
+        }
+        h->sock = INVALID_SOCKET;
+        h->proxy = -1;
+        char token[160];
+        snprintf(token, sizeof(token), "%s-hedge-%llu", x->req.isolation ? x->req.isolation : PROG_NAME,
+                 (unsigned long long)m->hedge_stats.fired);
+
+        HttpRequest req = x->req;
+        req.isolation = token;
+        if (ERR_FAILED(request_copy(&h->req, &req)) ||
+            ERR_FAILED(parse_uri(h->req.uri, &h->uri)) ||
+            ERR_FAILED(transfer_use_cache(h))) {
+            transfer_free(h);
+            continue;
+        }
+
+        h->method   = x->method;
+        h->on_data  = x->on_data;
+        h->on_done  = x->on_done;
+        h->userdata = x->userdata;
+        h->host     = x->host;
+        h->is_hedge = true;
+        h->twin     = x;
+        x->twin     = h;
+
+        h->active_index = m->active_count;
+        m->active[m->active_count++] = h;
+        h->host->active++;
+        m->hedge_stats.fired++;
+        TRACE_INSTANT("http", "hedge", "after_ms", (now - x->hop_start_ns) / 1000000);
+
+        multi_settle(m, h, transfer_connect(m, h));
+    }
+    return ERR_OK();
+}
+
+// First response byte of a hop: feeds the hedge delay and decides a hedge race
+static void transfer_first_byte(HttpMulti *m, HttpTransfer *x) {
+    if (m->hedge_percentile <= 0) {
+        return;
+    }
+    multi_record_ttfb(m, ut_now_ns() - x->hop_start_ns);
+
+    if (x->twin) {
+        HttpTransfer *loser = x->twin;
+        x->twin = NULL;
+        loser->twin = NULL;
+        transfer_cancel(m, loser);
+        if (x->is_hedge) {
+            m->hedge_stats.won++;
+        } else {
+            m->hedge_stats.lost++;
+        }
+    }
+}
+
+// Stop a transfer now; it leaves the active set in multi_reap_cancelled()
+static void transfer_cancel(HttpMulti *m, HttpTransfer *x) {
+    TRACE_INSTANT("http", "hedge_cancel", "hedge", x->is_hedge);
+    transfer_disconnect(m, x);
+    x->state = XFER_CANCELLED;
+}
+
+static void multi_reap_cancelled(HttpMulti *m) {
+    size_t i = 0;
+    while (i < m->active_count) {
+        HttpTransfer *x = m->active[i];
+        if (x->state != XFER_CANCELLED) {
+            i++;
+            continue;
+        }
+        m->active[i] = m->active[m->active_count - 1];
+        m->active[i]->active_index = i;
+        m->active_count--;
+        x->host->active--;
+        transfer_free(x);
+    }
+}
@@ -0,0 +1,206 @@
+/*
+    File: src/http/http_multi.h
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference:
+        - HTTP/1.1 (RFC 7230): https://datatracker.ietf.org/doc/html/rfc7230
+        - libcurl multi interface: https://curl.se/libcurl/c/libcurl-multi.html
+    Description:
+        Non-blocking multi-request HTTP client for Torilate.
+        Many requests can be queued on one HttpMulti handle and driven
+        from a single thread, either by http_multi_poll() or by an
+        external event loop using http_multi_fds() / http_multi_perform().
+        The proxy connect, SOCKS4a handshake, request write, response
+        read and redirect following of every transfer are resumable
+        state machines that never block.
+*/
+
+#ifndef TORILATE_HTTP_MULTI_H
+#define TORILATE_HTTP_MULTI_H
+
+#include <stddef.h>
+#include "http/http.h"
+#include "net/socket.h"
+#include "error/error.h"
+#include "util/util.h"
+
+/* Adaptive limit: starting point, and upper bound on a handle created without one */
+#define LIMITER_DEFAULT_INITIAL 4
+#define LIMITER_DEFAULT_MAX     256
+
+/* Hedged request counters (see http_multi_set_hedging) */
+typedef struct HttpHedgeStats {
+    uint64_t fired;         // duplicates launched
+    uint64_t won;           // duplicate saw its first byte before the original
+    uint64_t lost;          // original saw its first byte first
+    uint64_t delay_ns;      // current hedge delay (TTFB percentile), 0 until known
+} HttpHedgeStats;
+
+/* Opaque multi handle */
+typedef struct HttpMulti HttpMulti;
+
+/*
+ * Body data callback.
+ * Called with each chunk of the final response body as it arrives
+ * (headers and the bodies of followed redirects are not reported).
+ */
+typedef void (*HttpDataCallback)(void *userdata, const char *chunk, size_t len);
+
+/*
+ * Completion callback.
+ * Called exactly once per request. On success err is ERR_OK and response holds
+ * the final response (capped at HTTP_MAX_RESPONSE like http_perform). The response
+ * is only valid for the duration of the callback.
+ * The callback may add new requests to the multi handle.
+ */
+typedef void (*HttpDoneCallback)(void *userdata, Error err, const HttpResponse *response);
+
+
+/*
+ * Create a multi handle.
+ *
+ *  @param max_in_flight  maximum number of concurrently active transfers (0 = unlimited)
+ *  @param out            receives the new handle
+ *
+ *  @return ERR_OK on success, ERR_OUTOFMEMORY on allocation failure
+ */
+Error http_multi_create(size_t max_in_flight, HttpMulti **out);
+
+/*
+ * Replace the fixed in-flight limit by an adaptive one (see src/util/limit.c).
+ * The limit starts at initial and moves between 1 and the max_in_flight given
+ * to http_multi_create() (LIMITER_DEFAULT_MAX when that was 0), driven by the
+ * latency of every hop and by SOCKS rejects and failed proxy connects.
+ * Call before the first http_multi_perform().
+ *
+ *  @param multi    multi handle
+ *  @param initial  starting limit
+ *
+ *  @return ERR_OK on success, ERR_OUTOFMEMORY on allocation failure
+ */
+Error http_multi_set_adaptive(HttpMulti *multi, size_t initial);
+
+/*
+ * Cap the number of concurrently active transfers per destination (host:port).
+ * Free slots are offered to destinations round-robin, so one slow host cannot
+ * take them all. A transfer counts against the destination it was queued for,
+ * also while it follows redirects elsewhere.
+ *
+ *  @param multi         multi handle
+ *  @param max_per_host  per-destination limit (0 = only the global limit applies)
+ */
+void http_multi_set_host_limit(HttpMulti *multi, size_t max_per_host);
+
+/*
+ * Time until a destination paused by Retry-After (429/503) may start
+ * transfers again. External event loops should not wait longer than this.
+ *
+ *  @return milliseconds, or -1 when no queued transfer is waiting on a pause
+ */
+int http_multi_timeout(const HttpMulti *multi);
+
+/*
+ * Hedge slow GETs. Once a GET has waited longer than the given percentile of
+ * recent time-to-first-byte (TTFB, from connect start) without a response
+ * byte, a duplicate is sent with a different SOCKS isolation token, i.e. over
+ * another circuit. The first of the two to receive a byte wins; the other is
+ * cancelled and never reports. Duplicates start at once, outside the
+ * in-flight limit. Only the first hop of a request is hedged.
+ *
+ *  @param multi       multi handle
+ *  @param percentile  TTFB percentile in (0, 100) to wait for, 0 = off
+ */
+void http_multi_set_hedging(HttpMulti *multi, double percentile);
+
+/*
+ * Route requests over a circuit pool (see src/util/circuit.c): the first
+ * attempt of every request without an isolation token leases the pool's
+ * fastest, least loaded circuit and keeps it across redirects. Failures a
+ * retry could fix count against the circuit; retries use their own token.
+ * The pool must outlive the multi handle.
+ *
+ *  @param multi  multi handle
+ *  @param pool   circuit pool, NULL = off
+ */
+void http_multi_set_circuits(HttpMulti *multi, CircuitPool *pool);
+
+/*
+ * Hedge counters.
+ *
+ *  @return false (out untouched) when hedging is off
+ */
+bool http_multi_hedge_stats(const HttpMulti *multi, HttpHedgeStats *out);
+
+/* Print the adaptive limit and hedge counters to stdout (nothing when both are off) */
+void http_multi_print_stats(const HttpMulti *multi);
+
+/*
+ * Snapshot of the adaptive limiter.
+ *
+ *  @return false (out untouched) when the handle uses a fixed limit
+ */
+bool http_multi_limiter_stats(const HttpMulti *multi, LimiterStats *out);
+
+/*
+ * Destroy a multi handle.
+ * Unfinished transfers are aborted without invoking their callbacks.
+ */
+void http_multi_destroy(HttpMulti *multi);
+
+/*
+ * Queue a request. The request (URI, body, headers) is copied, so the caller's
+ * storage does not need to outlive this call.
+ *
+ *  @param multi     multi handle
+ *  @param request   request description
+ *  @param on_data   body chunk callback (may be NULL)
+ *  @param on_done   completion callback (may be NULL)
+ *  @param userdata  opaque pointer passed to both callbacks
+ *
+ *  @return ERR_OK on success and an Error struct on failure
+ */
+Error http_multi_add(HttpMulti *multi,
+                     const HttpRequest *request,
+                     HttpDataCallback on_data,
+                     HttpDoneCallback on_done,
+                     void *userdata);
+
+/*
+ * Fill fds with the sockets the multi handle is waiting on.
+ * Intended for callers running their own event loop.
+ *
+ *  @param multi  multi handle
+ *  @param fds    output array
+ *  @param cap    capacity of fds
+ *
+ *  @return the number of sockets with pending interest (may exceed cap)
+ */
+size_t http_multi_fds(HttpMulti *multi, NetPollFd *fds, size_t cap);
+
+/*
+ * Advance all transfers that the ready set allows, start queued transfers,
+ * and invoke callbacks of completed ones. Never blocks.
+ *
+ *  @param multi    multi handle
+ *  @param fds      poll results (entries with revents == 0 are ignored; may be NULL)
+ *  @param count    number of entries in fds
+ *  @param running  receives the number of queued and active transfers (may be NULL)
+ *
+ *  @return ERR_OK unless the multi handle itself failed; per-request
+ *          failures are reported through the completion callback
+ */
+Error http_multi_perform(HttpMulti *multi, const NetPollFd *fds, size_t count, size_t *running);
+
+/*
+ * Wait up to timeout_ms for socket readiness and advance transfers.
+ * Convenience wrapper around http_multi_fds(), net_poll() and http_multi_perform().
+ *
+ *  @param multi       multi handle
+ *  @param timeout_ms  maximum time to wait (-1 = no limit)
+ *  @param running     receives the number of queued and active transfers (may be NULL)
+ *
+ *  @return ERR_OK unless the multi handle itself failed
+ */
+Error http_multi_poll(HttpMulti *multi, int timeout_ms, size_t *running);
+
+#endif
@@ -0,0 +1,283 @@
+/*
+    File: src/http/http_proxy.c
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference:
+        - Tor manual, SocksPort: https://2019.www.torproject.org/docs/tor-manual.html.en#SocksPort
+    Description:
+        Endpoint list, least-outstanding selection and health tracking
+        for the Tor SOCKS endpoints. Counters and pause deadlines are
+        atomics, so stream threads and bench workers share the list
+        without a lock; the list itself only changes before requests
+        are issued.
+*/
+
+#include <stdatomic.h>
+#include "http/http_proxy.h"
+#include "util/util.h"
+#include "diag/trace.h"
+
+typedef struct HttpProxy {
+    char host[HTTP_PROXY_NAME_MAX];
+    uint16_t port;
+    char name[HTTP_PROXY_NAME_MAX];
+    atomic_uint_fast32_t outstanding;   // connections in use
+    atomic_uint_fast32_t fail_streak;   // failed connects in a row
+    atomic_uint_fast64_t down_until_ns; // skipped until then, 0 = healthy
+    atomic_uint_fast64_t connects;
+    atomic_uint_fast64_t failures;
+} HttpProxy;
+
+#define PROXY_STR(x)    #x
+#define PROXY_XSTR(x)   PROXY_STR(x)
+#define PROXY_TRIAL     UINT64_MAX      // down_until_ns while the trial connect after a pause is out
+
+static HttpProxy proxies[HTTP_PROXY_MAX] = {
+    { .host = TOR_IP, .port = TOR_PORT, .name = TOR_IP ":" PROXY_XSTR(TOR_PORT) },
+};
+static int proxy_count = 1;
+
+/* Function Prototypes */
+static void proxy_init(HttpProxy *p, const char *host, uint16_t port);
+static uint64_t proxy_pause_ns(uint32_t streak);
+
+Error http_proxy_parse(const char *spec, char *host, size_t host_cap, uint16_t *port) {
+    snprintf(host, host_cap, "%s", TOR_IP);
+    *port = TOR_PORT;
+    if (!spec || !spec[0]) {
+        return ERR_OK();
+    }
+
+    if (strncmp(spec, NET_UNIX_PREFIX, strlen(NET_UNIX_PREFIX)) == 0) {
+        // Unix domain socket: the whole spec is the address, no port
+        if (!spec[strlen(NET_UNIX_PREFIX)] || strlen(spec) >= host_cap) {
+            return ERR_NEW(ERR_INVALID_ADDRESS, "Invalid Unix socket endpoint '%s'", spec);
+        }
+        snprintf(host, host_cap, "%s", spec);
+        *port = 0;
+        return ERR_OK();
+    }
+
+    const char *colon = strrchr(spec, ':');
+    const char *port_str = colon ? colon + 1 : spec;
+    if (!colon && strspn(spec, "0123456789") != strlen(spec)) {
+        snprintf(host, host_cap, "%s", spec);   // host only
+        return ERR_OK();
+    }
+    if (colon) {
+        size_t host_len = (size_t)(colon - spec);
+        if (host_len >= host_cap) {
+            return ERR_NEW(ERR_INVALID_ADDRESS, "SOCKS endpoint host too long: %s", spec);
+        }
+        if (host_len > 0) {
+            memcpy(host, spec, host_len);
+            host[host_len] = '\0';
+        }
+    }
+
+    char *end = NULL;
+    long value = strtol(port_str, &end, 10);
+    if (end == port_str || *end != '\0' || value < 1 || value > 65535) {
+        return ERR_NEW(ERR_INVALID_ADDRESS, "Invalid SOCKS port in '%s'", spec);
+    }
+    *port = (uint16_t)value;
+    return ERR_OK();
+}
+
+Error http_set_proxies(const char *const *specs, int count) {
+    if (count < 1 || count > HTTP_PROXY_MAX) {
+        return ERR_NEW(ERR_INVALID_ARGS, "Between 1 and %d SOCKS endpoints can be configured, got %d", HTTP_PROXY_MAX, count);
+    }
+
+    HttpProxy parsed[HTTP_PROXY_MAX];
+    for (int i = 0; i < count; i++) {
+        char host[HTTP_PROXY_NAME_MAX];
+        uint16_t port = 0;
+        Error err = http_proxy_parse(specs[i], host, sizeof(host), &port);
+        if (ERR_FAILED(err)) {
+            return err;
+        }
+        proxy_init(&parsed[i], host, port);
+    }
+
+    for (int i = 0; i < count; i++) {
+        proxy_init(&proxies[i], parsed[i].host, parsed[i].port);
+    }
+    proxy_count = count;
+    return ERR_OK();
+}
+
+void http_set_proxy(const char *ip, int port) {
+    if (!ip) {
+        ip = TOR_IP;
+        port = TOR_PORT;
+    }
+    proxy_init(&proxies[0], ip, (uint16_t)port);
+    proxy_count = 1;
+}
+
+int http_proxy_count(void) {
+    return proxy_count;
+}
+
+const char *http_proxy_name(int index) {
+    if (index < 0 || index >= proxy_count) {
+        return "(none)";
+    }
+    return proxies[index].name;
+}
+
+int http_proxy_acquire(uint32_t skip) {
+    uint64_t now = ut_now_ns();
+    int best = -1;
+    uint_fast32_t best_load = 0;
+    int soonest = -1;
+    uint64_t soonest_ns = 0;
+
+    for (int i = 0; i < proxy_count; i++) {
+        if (skip & (1u << i)) {
+            continue;
+        }
+        uint64_t until = atomic_load_explicit(&proxies[i].down_until_ns, memory_order_relaxed);
+        if (until > now) {
+            if (soonest < 0 || until < soonest_ns) {
+                soonest = i;
+                soonest_ns = until;
+            }
+            continue;
+        }
+        uint_fast32_t load = atomic_load_explicit(&proxies[i].outstanding, memory_order_relaxed);
+        if (best < 0 || load < best_load) {
+            best = i;
+            best_load = load;
+        }
+    }
+
+    if (best < 0) {
+        best = soonest;     // every endpoint is paused: try the one due back first
+        if (best < 0) {
+            return -1;
+        }
+    } else if (atomic_load_explicit(&proxies[best].fail_streak, memory_order_relaxed) > 0) {
+        // Pause over: this connect is the trial, keep the others off it until it reports
+        uint64_t until = atomic_load_explicit(&proxies[best].down_until_ns, memory_order_relaxed);
+        atomic_compare_exchange_strong_explicit(&proxies[best].down_until_ns, &until, PROXY_TRIAL,
+                                                memory_order_relaxed, memory_order_relaxed);
+    }
+
+    atomic_fetch_add_explicit(&proxies[best].outstanding, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&proxies[best].connects, 1, memory_order_relaxed);
+    return best;
+}
+
+Error http_proxy_connect_start(int index, NetSocket *sock, bool *in_progress) {
+    return net_connect_start(sock, proxies[index].host, proxies[index].port, in_progress);
+}
+
+void http_proxy_connected(int index) {
+    HttpProxy *p = &proxies[index];
+    if (atomic_load_explicit(&p->fail_streak, memory_order_relaxed) > 0) {
+        atomic_store_explicit(&p->fail_streak, 0, memory_order_relaxed);
+        atomic_store_explicit(&p->down_until_ns, 0, memory_order_relaxed);
+        TRACE_INSTANT("http", "proxy_up", "proxy", index);
+    }
+}
+
+void http_proxy_release(int index, bool failed) {
+    if (index < 0 || index >= proxy_count) {
+        return;
+    }
+    HttpProxy *p = &proxies[index];
+    atomic_fetch_sub_explicit(&p->outstanding, 1, memory_order_relaxed);
+
+    uint64_t now = ut_now_ns();
+    uint64_t until = atomic_load_explicit(&p->down_until_ns, memory_order_relaxed);
+    if (!failed) {
+        if (until == PROXY_TRIAL) {
+            // The trial ended before its connect did: let the next connect try again
+            atomic_compare_exchange_strong_explicit(&p->down_until_ns, &until, now, memory_order_relaxed, memory_order_relaxed);
+        }
+        return;
+    }
+
+    atomic_fetch_add_explicit(&p->failures, 1, memory_order_relaxed);
+    if (until > now && until != PROXY_TRIAL) {
+        return;     // already paused: the connects in flight fail with the same outage
+    }
+    uint32_t streak = (uint32_t)atomic_fetch_add_explicit(&p->fail_streak, 1, memory_order_relaxed) + 1;
+    atomic_store_explicit(&p->down_until_ns, now + proxy_pause_ns(streak), memory_order_relaxed);
+    TRACE_INSTANT("http", "proxy_down", "proxy", index);
+}
+
+Error http_proxy_connect(NetSocket *sock, int timeout_ms, int *index) {
+    Error err = ERR_OK();
+    uint32_t tried = 0;
+    int i;
+    *index = -1;
+    while ((i = http_proxy_acquire(tried)) >= 0) {
+        tried |= 1u << i;
+        err = net_connect_timed(sock, proxies[i].host, proxies[i].port, timeout_ms);
+        if (!ERR_FAILED(err)) {
+            http_proxy_connected(i);
+            *index = i;
+            return ERR_OK();
+        }
+        http_proxy_release(i, true);
+        err = ERR_PROPAGATE(err, "Cannot connect to TOR at %s", http_proxy_name(i));
+    }
+    return err;
+}
+
+void http_proxy_check(void) {
+    for (int i = 0; i < proxy_count; i++) {
+        NetSocket sock = INVALID_SOCKET;
+        atomic_fetch_add_explicit(&proxies[i].outstanding, 1, memory_order_relaxed);
+        Error err = net_connect_timed(&sock, proxies[i].host, proxies[i].port, HTTP_PROXY_CHECK_TIMEOUT_MS);
+        net_close(&sock);
+        if (!ERR_FAILED(err)) {
+            http_proxy_connected(i);
+        }
+        http_proxy_release(i, ERR_FAILED(err));
+    }
+}
+
+int http_proxy_stats(HttpProxyStats *out, int cap) {
+    uint64_t now = ut_now_ns();
+    for (int i = 0; i < proxy_count && i < cap; i++) {
+        snprintf(out[i].name, sizeof(out[i].name), "%s", http_proxy_name(i));
+        out[i].connects    = atomic_load(&proxies[i].connects);
+        out[i].failures    = atomic_load(&proxies[i].failures);
+        out[i].outstanding = (uint32_t)atomic_load(&proxies[i].outstanding);
+        out[i].down        = atomic_load(&proxies[i].down_until_ns) > now;   // a trial in flight counts as down
+    }
+    return proxy_count;
+}
+
+/* Internal helper functions */
+
+static void proxy_init(HttpProxy *p, const char *host, uint16_t port) {
+    snprintf(p->host, sizeof(p->host), "%s", host);
+    p->port = port;
+    if (port == 0) {
+        snprintf(p->name, sizeof(p->name), "%s", host);    // unix:/path
+    } else {
+        snprintf(p->name, sizeof(p->name), "%s:%u", host, (unsigned)port);
+    }
+    atomic_init(&p->outstanding, 0);
+    atomic_init(&p->fail_streak, 0);
+    atomic_init(&p->down_until_ns, 0);
+    atomic_init(&p->connects, 0);
+    atomic_init(&p->failures, 0);
+}
+
+// Pause of an endpoint after streak failed connects in a row
+static uint64_t proxy_pause_ns(uint32_t streak) {
+    uint64_t ms = HTTP_PROXY_DOWN_MS;
+    for (uint32_t i = 1; i < streak && ms < HTTP_PROXY_DOWN_MAX_MS; i++) {
+        ms *= 2;
+    }
+    if (ms > HTTP_PROXY_DOWN_MAX_MS) {
+        ms = HTTP_PROXY_DOWN_MAX_MS;
+    }
+    return ms * 1000000;
+}
@@ -0,0 +1,114 @@
+/*
+    File: src/http/http_proxy.h
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference:
+        - Tor manual, SocksPort: https://2019.www.torproject.org/docs/tor-manual.html.en#SocksPort
+    Description:
+        The Tor SOCKS endpoints requests are sent through. One tor
+        process does most of its relay crypto on one thread, so at high
+        request rates several instances (e.g. on 9050, 9052 and 9054)
+        are configured and every connect goes to the endpoint with the
+        fewest connections in use.
+
+        An endpoint may also be a Unix domain socket ("unix:/path", Tor's
+        "SocksPort unix:/path"), which saves the loopback TCP handshake
+        and teardown on every connection.
+
+        An endpoint whose connect fails is skipped for a while (doubling
+        with each failure in a row); once the pause is over a single
+        connect is let through as a trial, and success puts it back in
+        rotation. A failed connect is retried at once on another
+        endpoint, so a dead tor process costs no request.
+
+        The list is set once before requests are issued; acquiring and
+        releasing endpoints is thread-safe.
+*/
+
+#ifndef TORILATE_HTTP_PROXY_H
+#define TORILATE_HTTP_PROXY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "net/socket.h"
+#include "error/error.h"
+
+#define HTTP_PROXY_MAX              16      // endpoints in the list
+#define HTTP_PROXY_NAME_MAX         128     // "host:port" of an endpoint
+#define HTTP_PROXY_DOWN_MS          1000    // pause after a first failed connect
+#define HTTP_PROXY_DOWN_MAX_MS      30000   // longest pause after failures in a row
+#define HTTP_PROXY_CHECK_TIMEOUT_MS 1000    // connect timeout of http_proxy_check()
+
+typedef struct HttpProxyStats {
+    char name[HTTP_PROXY_NAME_MAX];
+    uint64_t connects;      // connects attempted
+    uint64_t failures;      // connects that failed
+    uint32_t outstanding;   // connections in use now
+    bool down;              // skipped until its pause is over
+} HttpProxyStats;
+
+
+/*
+ * Parse an endpoint: "host:port", "port" or "host" (defaults TOR_IP and TOR_PORT),
+ * or "unix:/path" for a Unix domain SocksPort (*port set to 0).
+ *
+ *  @return ERR_INVALID_ADDRESS when the port is not a number in 1..65535
+ */
+Error http_proxy_parse(const char *spec, char *host, size_t host_cap, uint16_t *port);
+
+/*
+ * Replace the endpoint list (see http_proxy_parse for the syntax).
+ * Not thread-safe: call before issuing requests.
+ */
+Error http_set_proxies(const char *const *specs, int count);
+
+/*
+ * Route every request (http_perform, HttpMulti, http_stream) through a single
+ * SOCKS proxy, e.g. a local mock for benchmarks. NULL restores TOR_IP:TOR_PORT.
+ * Not thread-safe: call before issuing requests.
+ */
+void http_set_proxy(const char *ip, int port);
+
+/* Number of endpoints */
+int http_proxy_count(void);
+
+/* "host:port" of an endpoint, for messages */
+const char *http_proxy_name(int index);
+
+/*
+ * Take the endpoint with the fewest connections in use; a paused one only
+ * when all are, the one due back first.
+ *
+ *  @param skip  endpoints not to take (bit i = endpoint i), e.g. those already tried
+ *  @return the endpoint, or -1 when skip covers them all
+ */
+int http_proxy_acquire(uint32_t skip);
+
+/* Start a non-blocking connect to an acquired endpoint (see net_connect_start) */
+Error http_proxy_connect_start(int index, NetSocket *sock, bool *in_progress);
+
+/* Report a completed connect to an endpoint: ends its pause */
+void http_proxy_connected(int index);
+
+/*
+ * Hand an endpoint back when its connection is closed.
+ *
+ *  @param index   endpoint from http_proxy_acquire (-1 is ignored)
+ *  @param failed  the connect to it failed: pause the endpoint
+ */
+void http_proxy_release(int index, bool failed);
+
+/*
+ * Acquire an endpoint and connect to it within timeout_ms, moving on to the
+ * next endpoint while connects fail. On success *index holds the endpoint,
+ * to be released with http_proxy_release once the socket is closed.
+ */
+Error http_proxy_connect(NetSocket *sock, int timeout_ms, int *index);
+
+/* Connect to every endpoint once and pause those that do not answer */
+void http_proxy_check(void);
+
+/* Copy per-endpoint counters into out (up to cap entries); returns the endpoint count */
+int http_proxy_stats(HttpProxyStats *out, int cap);
+
+#endif
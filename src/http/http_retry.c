@@ -0,0 +1,121 @@
+/*
+    File: src/http/http_retry.c
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference:
+        - Exponential Backoff And Jitter: https://aws.amazon.com/blogs/architecture/exponential-backoff-and-jitter/
+    Description:
+        Retry classification, backoff and the process-wide retry budget.
+
+        The budget allows HTTP_RETRY_BUDGET_RESERVE retries plus
+        HTTP_RETRY_BUDGET_PERCENT of the requests started so far; a retry
+        is granted with a CAS on the retry counter, so concurrent clients
+        (stream threads, bench workers) never overdraw it. Jitter comes
+        from a per-thread xorshift generator seeded from the clock.
+*/
+
+#include <stdatomic.h>
+#include "http/http_retry.h"
+#include "util/util.h"
+#include "diag/trace.h"
+
+static atomic_uint_fast64_t retry_requests = 0;
+static atomic_uint_fast64_t retry_granted = 0;
+static atomic_uint_fast64_t retry_denied = 0;
+static atomic_uint_fast64_t retry_sequence = 0;    // isolation tokens handed out
+static _Thread_local uint64_t jitter_state = 0;
+
+/* Function Prototypes */
+static bool budget_take(void);
+static uint64_t jitter_next(void);
+
+HttpRetryClass http_retry_classify(Error err) {
+    switch (err.code) {
+        case ERR_CONNECTION_FAILED:       // SOCKS reject or proxy connect refused
+        case ERR_TOR_CONNECTION_FAILED:
+            return HTTP_RETRY_ALWAYS;
+        case ERR_NETWORK_IO:              // reset or failed send/recv, possibly after the request went out
+        case ERR_NET_RECV_FAILED:
+        case ERR_TIMEOUT:                 // dead circuit, or an origin too slow for this attempt
+            return HTTP_RETRY_IDEMPOTENT;
+        default:
+            return HTTP_RETRY_NEVER;
+    }
+}
+
+void http_retry_begin(void) {
+    atomic_fetch_add_explicit(&retry_requests, 1, memory_order_relaxed);
+}
+
+bool http_retry_should(const HttpRequest *req, Error err, int retries) {
+    if (!ERR_FAILED(err) || retries >= req->max_retries) {
+        return false;
+    }
+
+    HttpRetryClass cls = http_retry_classify(err);
+    if (cls == HTTP_RETRY_NEVER || (cls == HTTP_RETRY_IDEMPOTENT && req->method != HTTP_METHOD_GET)) {
+        return false;
+    }
+
+    if (!budget_take()) {
+        atomic_fetch_add_explicit(&retry_denied, 1, memory_order_relaxed);
+        TRACE_INSTANT("http", "retry_denied", "error", err.code);
+        return false;
+    }
+    TRACE_INSTANT("http", "retry", "error", err.code);
+    return true;
+}
+
+uint64_t http_retry_backoff_ns(int retry) {
+    uint64_t ceiling_ms = HTTP_RETRY_BASE_MS;
+    for (int i = 1; i < retry && ceiling_ms < HTTP_RETRY_MAX_MS; i++) {
+        ceiling_ms *= 2;
+    }
+    if (ceiling_ms > HTTP_RETRY_MAX_MS) {
+        ceiling_ms = HTTP_RETRY_MAX_MS;
+    }
+
+    // Half fixed, half random: spreads retries of a burst of failures apart
+    // while still backing off at least half of the ceiling
+    uint64_t ceiling_ns = ceiling_ms * 1000000;
+    return ceiling_ns / 2 + jitter_next() % (ceiling_ns / 2 + 1);
+}
+
+void http_retry_isolation(const HttpRequest *req, char *out, size_t cap) {
+    uint64_t seq = atomic_fetch_add_explicit(&retry_sequence, 1, memory_order_relaxed) + 1;
+    snprintf(out, cap, "%s-retry-%llu", req->isolation ? req->isolation : PROG_NAME, (unsigned long long)seq);
+}
+
+void http_retry_stats(HttpRetryStats *out) {
+    out->requests = atomic_load(&retry_requests);
+    out->retries  = atomic_load(&retry_granted);
+    out->denied   = atomic_load(&retry_denied);
+}
+
+/* Internal helper functions */
+
+static bool budget_take(void) {
+    uint64_t granted = atomic_load_explicit(&retry_granted, memory_order_relaxed);
+    for (;;) {
+        uint64_t allowed = HTTP_RETRY_BUDGET_RESERVE + atomic_load_explicit(&retry_requests, memory_order_relaxed) * HTTP_RETRY_BUDGET_PERCENT / 100;
+        if (granted >= allowed) {
+            return false;
+        }
+        if (atomic_compare_exchange_weak_explicit(&retry_granted, &granted, granted + 1, memory_order_relaxed, memory_order_relaxed)) {
+            return true;
+        }
+    }
+}
+
+static uint64_t jitter_next(void) {
+    uint64_t x = jitter_state;
+    if (x == 0) {
+        x = ut_now_ns() ^ (uint64_t)(uintptr_t)&jitter_state;
+        x = x ? x : 0x9E3779B97F4A7C15ULL;
+    }
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    jitter_state = x;
+    return x;
+}
@@ -0,0 +1,75 @@
+/*
+    File: src/http/http_retry.h
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference:
+        - Exponential Backoff And Jitter: https://aws.amazon.com/blogs/architecture/exponential-backoff-and-jitter/
+    Description:
+        Retry policy shared by the blocking, streaming and multi clients.
+        A failed attempt is retried when its error is transient: a SOCKS
+        reject or a failed connect may be retried for any method (the
+        request never reached the origin), an I/O error after the request
+        was written only for GET. Each retry waits an exponentially
+        growing, jittered delay and carries a new SOCKS isolation token,
+        so Tor attaches it to a fresh circuit instead of the broken one.
+
+        Retries draw on a process-wide budget: a small reserve plus a
+        share of the requests made, so a dead proxy or an unreachable
+        destination cannot multiply the load on Tor.
+*/
+
+#ifndef TORILATE_HTTP_RETRY_H
+#define TORILATE_HTTP_RETRY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "http/http.h"
+#include "error/error.h"
+
+#define HTTP_RETRY_DEFAULT          2       // retries per request unless configured otherwise
+#define HTTP_RETRY_BASE_MS          250     // backoff ceiling of the first retry
+#define HTTP_RETRY_MAX_MS           8000    // backoff ceiling of later retries
+#define HTTP_RETRY_BUDGET_RESERVE   10      // retries always allowed
+#define HTTP_RETRY_BUDGET_PERCENT   20      // plus this share of the requests made
+#define HTTP_RETRY_ISOLATION_MAX    160     // longest isolation token of a retry
+
+typedef enum {
+    HTTP_RETRY_NEVER,       // the request itself is at fault, or may have had effects
+    HTTP_RETRY_IDEMPOTENT,  // the request may have reached the origin: safe for GET only
+    HTTP_RETRY_ALWAYS,      // the request never left the client or the proxy
+} HttpRetryClass;
+
+typedef struct HttpRetryStats {
+    uint64_t requests;      // requests started (each earns budget)
+    uint64_t retries;       // retries granted
+    uint64_t denied;        // retries refused because the budget was spent
+} HttpRetryStats;
+
+
+/* Classify a failed attempt */
+HttpRetryClass http_retry_classify(Error err);
+
+/* Count a new request against the retry budget; call once per request, not per attempt */
+void http_retry_begin(void);
+
+/*
+ * Decide whether to retry a failed attempt, taking one retry from the budget if so.
+ *
+ *  @param request  request description (method and max_retries)
+ *  @param err      error of the attempt
+ *  @param retries  retries already made for this request
+ *
+ *  @return true if the request should be sent again
+ */
+bool http_retry_should(const HttpRequest *request, Error err, int retries);
+
+/* Backoff before retry number retry (1-based): a random delay in [ceiling/2, ceiling] */
+uint64_t http_retry_backoff_ns(int retry);
+
+/* Write a new isolation token for a retry of request into out (a process-wide sequence keeps every token distinct) */
+void http_retry_isolation(const HttpRequest *request, char *out, size_t cap);
+
+/* Snapshot of the process-wide retry counters */
+void http_retry_stats(HttpRetryStats *out);
+
+#endif
@@ -0,0 +1,626 @@
+/*
+    File: src/http/http_stream.c
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference:
+        - HTTP/1.1 message framing and chunked coding (RFC 7230, 3.3 and 4.1)
+    Description:
+        Implementation of the streaming download pipeline.
+
+            socket --> [reader] --wire ring--> [framer] --output ring--> [writer] --> sink
+
+        The calling thread opens the tunnel and sends the request, then
+        runs the three stages on their own threads until the response ends.
+        The framer parses the header section, removes chunked framing and
+        stops at the end of the message; a redirect is detected at the end
+        of its header section, the rest of it is dropped unread and the
+        controller loops with the next hop. Every stage only ever
+        talks to its neighbours through a single-producer/single-consumer
+        ring, so a slow disk backs up into the socket buffer instead of
+        into memory. The reader receives straight into the wire ring, and
+        because ring spans are linear the framer parses status, header and
+        chunk-size lines in place even when they straddle the ring's end.
+*/
+
+#include <strings.h>
+#include "http/http_stream.h"
+#include "http/http_retry.h"
+#include "http/http_proxy.h"
+#include "util/util.h"
+#include "diag/trace.h"
+#include "diag/flight.h"
+#include "diag/perf.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+#else
+#include <windows.h>
+#endif
+
+/* Longest chunk-size or trailer line accepted */
+#define FRAME_MAX_LINE 1024
+
+typedef enum {
+    FRAME_HEAD,             // waiting for the complete header section
+    FRAME_IDENTITY,         // body delimited by Content-Length or EOF
+    FRAME_CHUNK_SIZE,       // chunk-size line
+    FRAME_CHUNK_DATA,       // chunk payload
+    FRAME_CHUNK_CRLF,       // CRLF closing a chunk payload
+    FRAME_TRAILER,          // trailer section after the last chunk
+    FRAME_DISCARD,          // message complete (or redirect): drop the rest
+} FrameState;
+
+typedef struct Framer {
+    FrameState state;
+    size_t head_len;            // bytes of the header section in head->raw
+    bool length_known;
+    uint64_t remaining;         // bytes left in the body or current chunk
+    size_t scanned;             // header bytes already searched for the blank line
+} Framer;
+
+typedef struct StreamPipeline {
+    NetSocket *sock;
+    ByteRing *wire;             // reader -> framer
+    ByteRing *output;           // framer -> writer
+    HttpStreamMode mode;
+    bool follow_redirects;
+    HttpStreamSink sink;
+    HttpResponse *head;
+    HttpTiming *timing;         // current hop
+    HttpTimeouts timeouts;
+    uint64_t deadline_ns;       // end of the exchange, 0 = none
+
+    bool redirect;              // set by the framer
+    bool delivered;             // the sink has accepted output: the request can no longer be retried
+    Error reader_err;
+    Error framer_err;
+    Error writer_err;
+} StreamPipeline;
+
+typedef struct StreamStage {
+    void (*run)(StreamPipeline *p);
+    StreamPipeline *pipeline;
+#ifndef _WIN32
+    pthread_t thread;
+#else
+    HANDLE thread;
+#endif
+} StreamStage;
+
+/* Function Prototypes */
+static Error stream_exchange(const HttpRequest *req, StreamPipeline *p);
+static Error stream_run_pipeline(StreamPipeline *p);
+static void stage_reader(StreamPipeline *p);
+static void stage_framer(StreamPipeline *p);
+static void stage_writer(StreamPipeline *p);
+static Error framer_feed(StreamPipeline *p, Framer *f, const char *data, size_t len, size_t *used);
+static Error framer_finish(Framer *f);
+static Error framer_on_head(StreamPipeline *p, Framer *f);
+static Error framer_on_chunk_size(Framer *f, const char *line, size_t len);
+static const char *find_header_end(const char *data, size_t len, size_t from);
+static bool stage_start(StreamStage *stage);
+static void stage_join(StreamStage *stage);
+
+Error http_stream(const HttpRequest *req, HttpStreamMode mode, HttpStreamSink sink, HttpResponse *head) {
+    StreamPipeline p = {
+        .mode             = mode,
+        .follow_redirects = req->follow_redirects,
+        .sink             = sink,
+        .head             = head,
+        .timeouts         = req->timeouts,
+    };
+    HttpRequest attempt = *req;
+    char isolation[HTTP_RETRY_ISOLATION_MAX];
+    int retries = 0;
+
+    http_retry_begin();
+    for (;;) {
+        Error err = stream_exchange(&attempt, &p);
+        // Output already handed to the sink cannot be taken back
+        if (p.delivered || !http_retry_should(req, err, retries)) {
+            if (ERR_FAILED(err) && retries > 0) {
+                err = ERR_PROPAGATE(err, "Giving up after %d attempts", retries + 1);
+            }
+            return err;
+        }
+
+        retries++;
+        flight_record(FLIGHT_RETRY, -1, (uint64_t)retries, err.code);
+        ut_sleep_ns(http_retry_backoff_ns(retries));
+        http_retry_isolation(req, isolation, sizeof(isolation));
+        attempt.isolation = isolation;
+    }
+}
+
+/* Internal helper functions */
+
+// One attempt: every hop of the exchange, streaming the final response
+static Error stream_exchange(const HttpRequest *req, StreamPipeline *p) {
+    URI parsed_uri = {0};
+    NetSocket sock = INVALID_SOCKET;
+    int proxy = -1;     // SOCKS endpoint of the current hop
+    Error err = ERR_OK();
+    HttpMethod method = req->method;
+    int redirects_followed = 0;
+    HttpResponse *head = p->head;
+
+    p->sock = &sock;
+    p->deadline_ns = http_deadline(&req->timeouts);  // spans every hop
+
+    err = parse_uri(req->uri, &parsed_uri);
+    if (ERR_FAILED(err)) {
+        err = ERR_PROPAGATE(err, "Failed to parse URI: %s", req->uri);
+        goto exit_exchange;
+    }
+
+    head->hops = 0;
+    for (;;) {
+        p->timing = http_timing_begin(head);
+        flight_record(FLIGHT_HOP, -1, (uint64_t)head->hops, 0);
+        err = http_proxy_connect(&sock, http_timeout_ms(p->timeouts.connect_ms, p->deadline_ns), &proxy);
+        if (ERR_FAILED(err)) {
+            goto exit_exchange;
+        }
+        HTTP_TIMING_MARK(p->timing, connect_ns);
+
+        err = http_send_request(&sock, method, &parsed_uri, req, p->deadline_ns, p->timing);
+        if (!ERR_FAILED(err)) {
+            err = stream_run_pipeline(p);
+        }
+        if (ERR_FAILED(err)) {
+            if (redirects_followed == 0) {
+                err = ERR_PROPAGATE(err, "Failed to stream HTTP response from %s:%d", parsed_uri.host, parsed_uri.port);
+            } else {
+                err = ERR_PROPAGATE(err, "HTTP redirect failed to %s:%d", parsed_uri.host, parsed_uri.port);
+            }
+            goto exit_exchange;
+        }
+        net_close(&sock);
+        http_proxy_release(proxy, false);
+        proxy = -1;
+
+        if (!p->redirect) {
+            break;
+        }
+
+        if (redirects_followed >= req->max_redirects) {
+            err = ERR_NEW(ERR_HTTP_REDIRECT_LIMIT, "Exceeded maximum redirect limit of %d", req->max_redirects);
+            goto exit_exchange;
+        }
+        redirects_followed++;
+        flight_record(FLIGHT_REDIRECT, -1, (uint64_t)redirects_followed, head->status_code);
+
+        method = http_redirect_method(method, head->status_code);
+        err = http_apply_redirect(head, &parsed_uri);
+        if (ERR_FAILED(err)) {
+            goto exit_exchange;
+        }
+    }
+
+exit_exchange:
+    net_close(&sock);
+    http_proxy_release(proxy, false);
+    cleanup_uri(&parsed_uri);
+
+    return err;
+}
+
+// Run reader, framer and writer over one response; returns the first stage error
+static Error stream_run_pipeline(StreamPipeline *p) {
+    Error err = ERR_OK();
+
+    p->redirect   = false;
+    p->reader_err = ERR_OK();
+    p->framer_err = ERR_OK();
+    p->writer_err = ERR_OK();
+    p->head->bytes_received = 0;
+    p->head->raw[0] = '\0';
+
+    err = ring_create(HTTP_STREAM_RING_SIZE, &p->wire);
+    if (ERR_FAILED(err)) {
+        goto exit_pipeline;
+    }
+    err = ring_create(HTTP_STREAM_RING_SIZE, &p->output);
+    if (ERR_FAILED(err)) {
+        goto exit_pipeline;
+    }
+
+    StreamStage stages[] = {
+        { .run = stage_reader, .pipeline = p },
+        { .run = stage_framer, .pipeline = p },
+        { .run = stage_writer, .pipeline = p },
+    };
+    size_t started = 0;
+    for (; started < sizeof(stages) / sizeof(stages[0]); started++) {
+        if (!stage_start(&stages[started])) {
+            break;
+        }
+    }
+
+    if (started < sizeof(stages) / sizeof(stages[0])) {
+        // Unblock whatever did start: no producer will come, no consumer will drain
+        ring_close(p->wire);
+        ring_abort(p->wire);
+        ring_close(p->output);
+        ring_abort(p->output);
+        err = ERR_NEW(ERR_IO, "Failed to start stream pipeline stage %zu", started);
+    }
+    for (size_t i = 0; i < started; i++) {
+        stage_join(&stages[i]);
+    }
+    if (ERR_FAILED(err)) {
+        goto exit_pipeline;
+    }
+
+    // Report the root cause: a failing stage aborts the rings, which stops
+    // the stages upstream of it cleanly, except that a failed read (a reset
+    // or a timeout) looks like a truncated response to the framer
+    if (ERR_FAILED(p->writer_err)) {
+        err = p->writer_err;
+    } else if (ERR_FAILED(p->reader_err)) {
+        err = p->reader_err;
+    } else if (ERR_FAILED(p->framer_err)) {
+        err = p->framer_err;
+    }
+
+exit_pipeline:
+    ring_destroy(p->wire);
+    ring_destroy(p->output);
+    p->wire = NULL;
+    p->output = NULL;
+
+    return err;
+}
+
+// Socket -> wire ring
+static void stage_reader(StreamPipeline *p) {
+    TRACE_BEGIN("stream", "reader", "fd", p->sock->handle);
+    for (;;) {
+        char *dst = NULL;
+        size_t space = ring_wait_write(p->wire, &dst);
+        if (space == 0) {
+            break; // framer is done with this response
+        }
+
+        size_t n = 0;
+        uint32_t phase_ms = p->timing->first_byte_ns == 0 ? p->timeouts.ttfb_ms : p->timeouts.idle_ms;
+        Error err = net_recv_timed(p->sock, dst, space, &n, http_timeout_ms(phase_ms, p->deadline_ns));
+        if (ERR_FAILED(err)) {
+            p->reader_err = ERR_PROPAGATE(err, "Failed to receive HTTP response");
+            break;
+        }
+        if (n == 0) {
+            break;
+        }
+        if (p->timing->first_byte_ns == 0) {
+            HTTP_TIMING_MARK(p->timing, first_byte_ns);
+        }
+        ring_commit_write(p->wire, n);
+    }
+    HTTP_TIMING_MARK(p->timing, last_byte_ns);
+    ring_close(p->wire);
+    TRACE_END("stream", "reader", "error", p->reader_err.code);
+}
+
+// Wire ring -> header parse / de-chunk -> output ring
+static void stage_framer(StreamPipeline *p) {
+    Framer f = { .state = FRAME_HEAD };
+    Error err = ERR_OK();
+    const char *src = NULL;
+    size_t pending = 0;     // bytes of an incomplete token left in the ring
+    size_t n;
+    PerfMark mark;
+
+    TRACE_BEGIN("stream", "framer", NULL, 0);
+    // Spans are linear, so a token cut short by the network just stays in the
+    // ring until more bytes arrive behind it; nothing is copied aside
+    while ((n = ring_wait_read(p->wire, pending, &src)) > pending) {
+        size_t used = 0;
+        p->head->bytes_received += n - pending;
+        perf_begin(&mark);
+        err = framer_feed(p, &f, src, n, &used);
+        perf_end(PERF_DECODE, &mark);
+        ring_commit_read(p->wire, used);
+        pending = n - used;
+        if (ERR_FAILED(err)) {
+            break;
+        }
+        if (f.state == FRAME_DISCARD) {
+            // Nothing after the message is of interest; the shutdown wakes a reader still
+            // waiting on the peer, so a redirect's next hop need not wait for the old body
+            ring_abort(p->wire);
+            net_shutdown(p->sock);
+        }
+    }
+
+    if (!ERR_FAILED(err)) {
+        err = framer_finish(&f);
+    }
+    if (ERR_FAILED(err)) {
+        p->framer_err = err;
+        ring_abort(p->wire);
+    }
+    ring_close(p->output);
+    TRACE_END("stream", "framer", "error", err.code);
+}
+
+// Output ring -> sink
+static void stage_writer(StreamPipeline *p) {
+    const char *src = NULL;
+    size_t n;
+    PerfMark mark;
+
+    TRACE_BEGIN("stream", "writer", NULL, 0);
+    while ((n = ring_wait_read(p->output, 0, &src)) > 0) {
+        TRACE_BEGIN("stream", "sink_write", "bytes", n);
+        perf_begin(&mark);
+        Error err = p->sink.write(p->sink.ctx, src, n);
+        perf_end(PERF_OUTPUT, &mark);
+        TRACE_END("stream", "sink_write", "error", err.code);
+        ring_commit_read(p->output, n);
+        if (ERR_FAILED(err)) {
+            p->writer_err = ERR_PROPAGATE(err, "Failed to write streamed response");
+            ring_abort(p->output);
+            break;
+        }
+        p->delivered = true;
+    }
+    TRACE_END("stream", "writer", "error", p->writer_err.code);
+}
+
+// Consume as much of a linear span as forms complete tokens; *used reports how far
+static Error framer_feed(StreamPipeline *p, Framer *f, const char *data, size_t len, size_t *used) {
+    Error err = ERR_OK();
+    size_t pos = 0;
+
+    while (pos < len) {
+        const char *at = data + pos;
+        size_t avail = len - pos;
+        size_t take = avail;
+        // Raw mode forwards body bytes untouched, framing included
+        bool emit = p->mode == HTTP_STREAM_RAW && f->state != FRAME_HEAD && f->state != FRAME_DISCARD;
+
+        switch (f->state) {
+            case FRAME_HEAD: {
+                const char *end = find_header_end(at, avail, f->scanned);
+                if (!end) {
+                    if (avail >= HTTP_MAX_RESPONSE - 1) {
+                        return ERR_NEW(ERR_BAD_RESPONSE, "HTTP header section exceeds %d bytes", HTTP_MAX_RESPONSE - 1);
+                    }
+                    f->scanned = avail >= 3 ? avail - 3 : 0;
+                    goto incomplete;
+                }
+
+                take = (size_t)(end - at);
+                if (take >= HTTP_MAX_RESPONSE) {
+                    return ERR_NEW(ERR_BAD_RESPONSE, "HTTP header section exceeds %d bytes", HTTP_MAX_RESPONSE - 1);
+                }
+                memcpy(p->head->raw, at, take);
+                p->head->raw[take] = '\0';
+                f->head_len = take;
+
+                err = framer_on_head(p, f);
+                break;
+            }
+
+            case FRAME_IDENTITY:
+                if (f->length_known) {
+                    if (take > f->remaining) {
+                        take = (size_t)f->remaining;
+                    }
+                    f->remaining -= take;
+                }
+                if (!emit) {
+                    err = ring_write_all(p->output, at, take);
+                }
+                if (f->length_known && f->remaining == 0) {
+                    f->state = FRAME_DISCARD;
+                }
+                break;
+
+            case FRAME_CHUNK_SIZE:
+            case FRAME_TRAILER: {
+                const char *nl = memchr(at, '\n', avail);
+                if (!nl) {
+                    if (avail >= FRAME_MAX_LINE) {
+                        return ERR_NEW(ERR_BAD_RESPONSE, "Chunked encoding line exceeds %d bytes", FRAME_MAX_LINE);
+                    }
+                    goto incomplete;
+                }
+                take = (size_t)(nl - at) + 1;
+
+                if (f->state == FRAME_CHUNK_SIZE) {
+                    err = framer_on_chunk_size(f, at, take);
+                } else if (at[0] == '\r' || at[0] == '\n') {
+                    f->state = FRAME_DISCARD; // empty line ends the trailer section
+                }
+                break;
+            }
+
+            case FRAME_CHUNK_DATA:
+                if (take > f->remaining) {
+                    take = (size_t)f->remaining;
+                }
+                f->remaining -= take;
+                if (!emit) {
+                    err = ring_write_all(p->output, at, take);
+                }
+                if (f->remaining == 0) {
+                    f->state = FRAME_CHUNK_CRLF;
+                }
+                break;
+
+            case FRAME_CHUNK_CRLF: {
+                const char *nl = memchr(at, '\n', avail);
+                take = nl ? (size_t)(nl - at) + 1 : avail;
+                if (nl) {
+                    f->state = FRAME_CHUNK_SIZE;
+                }
+                break;
+            }
+
+            case FRAME_DISCARD:
+                break;
+        }
+
+        if (!ERR_FAILED(err) && emit) {
+            err = ring_write_all(p->output, at, take);
+        }
+        if (ERR_FAILED(err)) {
+            return err;
+        }
+        pos += take;
+    }
+
+incomplete:
+    *used = pos;
+    return ERR_OK();
+}
+
+// Check that the stream did not end inside the message
+static Error framer_finish(Framer *f) {
+    switch (f->state) {
+        case FRAME_HEAD:
+            return ERR_NEW(ERR_BAD_RESPONSE, "Connection closed before end of HTTP headers");
+        case FRAME_IDENTITY:
+            if (f->length_known && f->remaining > 0) {
+                return ERR_NEW(ERR_BAD_RESPONSE, "HTTP response body truncated (%llu bytes missing)", (unsigned long long)f->remaining);
+            }
+            return ERR_OK();
+        case FRAME_CHUNK_SIZE:
+        case FRAME_CHUNK_DATA:
+        case FRAME_CHUNK_CRLF:
+            return ERR_NEW(ERR_BAD_RESPONSE, "Chunked HTTP response body truncated");
+        default:
+            return ERR_OK();
+    }
+}
+
+// Header section complete: pick the body framing and emit the output prefix
+static Error framer_on_head(StreamPipeline *p, Framer *f) {
+    HttpResponse *head = p->head;
+    const char *value = NULL;
+    size_t value_len = 0;
+
+    Error err = http_parse_status(head->raw, &head->status_code);
+    if (ERR_FAILED(err)) {
+        return err;
+    }
+    flight_record(FLIGHT_STATUS, (int)p->sock->handle, 0, head->status_code);
+
+    if (p->follow_redirects && http_is_redirect(head->status_code)) {
+        p->redirect = true;
+        f->state = FRAME_DISCARD;
+        return ERR_OK();
+    }
+
+    f->length_known = false;
+    f->state = FRAME_IDENTITY;
+    if (http_find_header(head->raw, "Transfer-Encoding", &value, &value_len) &&
+        value_len >= 7 && strncasecmp(value + value_len - 7, "chunked", 7) == 0) {
+        f->state = FRAME_CHUNK_SIZE;
+    } else if (http_find_header(head->raw, "Content-Length", &value, &value_len)) {
+        f->length_known = true;
+        f->remaining = strtoull(value, NULL, 10);
+    }
+    if (head->status_code == HTTP_NO_CONTENT || head->status_code == HTTP_NOT_MODIFIED) {
+        f->length_known = true;
+        f->remaining = 0;
+        f->state = FRAME_DISCARD;
+    }
+
+    switch (p->mode) {
+        case HTTP_STREAM_RAW:
+            return ring_write_all(p->output, head->raw, f->head_len);
+
+        case HTTP_STREAM_FORMATTED: {
+            int status_code = 0;
+            char status_text[64] = {0};
+            char prefix[192];
+            int written;
+
+            const char *status_line = strstr(head->raw, "HTTP");
+            if (!status_line || sscanf(status_line, "HTTP/%*s %d %63[^\r\n]", &status_code, status_text) < 1) {
+                return ERR_NEW(ERR_BAD_RESPONSE, "Failed to parse HTTP status line");
+            }
+
+            if (f->length_known) {
+                written = snprintf(prefix, sizeof(prefix), "Status Code: %d\nStatus Description: %s\nContent Length: %llu\n\n", status_code, status_text, (unsigned long long)f->remaining);
+            } else {
+                written = snprintf(prefix, sizeof(prefix), "Status Code: %d\nStatus Description: %s\n\n", status_code, status_text);
+            }
+            if (written < 0 || (size_t)written >= sizeof(prefix)) {
+                return ERR_NEW(ERR_IO, "Failed to write HTTP response header");
+            }
+            return ring_write_all(p->output, prefix, (size_t)written);
+        }
+
+        default:
+            return ERR_OK();
+    }
+}
+
+static Error framer_on_chunk_size(Framer *f, const char *line, size_t len) {
+    // The line ends in '\n', which stops strtoull inside the span
+    char *end = NULL;
+    unsigned long long size = strtoull(line, &end, 16);
+    if (end == line || (size_t)(end - line) >= len) {
+        return ERR_NEW(ERR_BAD_RESPONSE, "Malformed chunk size line");
+    }
+
+    // Chunk extensions (";name=value") are ignored
+    if (size == 0) {
+        f->state = FRAME_TRAILER;
+    } else {
+        f->remaining = size;
+        f->state = FRAME_CHUNK_DATA;
+    }
+    return ERR_OK();
+}
+
+// Locate the end of the header section (just past CRLFCRLF) in a span without a terminator
+static const char *find_header_end(const char *data, size_t len, size_t from) {
+    for (size_t i = from; i + 4 <= len; i++) {
+        const char *cr = memchr(data + i, '\r', len - i - 3);
+        if (!cr) {
+            return NULL;
+        }
+        i = (size_t)(cr - data);
+        if (memcmp(cr, "\r\n\r\n", 4) == 0) {
+            return cr + 4;
+        }
+    }
+    return NULL;
+}
+
+#ifndef _WIN32
+static void *stage_main(void *arg) {
+    StreamStage *stage = (StreamStage *)arg;
+    stage->run(stage->pipeline);
+    return NULL;
+}
+
+static bool stage_start(StreamStage *stage) {
+    return pthread_create(&stage->thread, NULL, stage_main, stage) == 0;
+}
+
+static void stage_join(StreamStage *stage) {
+    pthread_join(stage->thread, NULL);
+}
+#else
+static DWORD WINAPI stage_main(LPVOID arg) {
+    StreamStage *stage = (StreamStage *)arg;
+    stage->run(stage->pipeline);
+    return 0;
+}
+
+static bool stage_start(StreamStage *stage) {
+    stage->thread = CreateThread(NULL, 0, stage_main, stage, 0, NULL);
+    return stage->thread != NULL;
+}
+
+static void stage_join(StreamStage *stage) {
+    WaitForSingleObject(stage->thread, INFINITE);
+    CloseHandle(stage->thread);
+}
+#endif
@@ -0,0 +1,55 @@
+/*
+    File: src/http/http_stream.h
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference:
+        - HTTP/1.1 (RFC 7230): https://datatracker.ietf.org/doc/html/rfc7230
+    Description:
+        Streaming HTTP download pipeline for Torilate.
+        Large responses are not buffered: a socket reader, a framing /
+        de-chunking stage and an output writer run on their own threads,
+        connected by lock-free single-producer/single-consumer rings, so
+        network receive, decoding and disk writes overlap.
+*/
+
+#ifndef TORILATE_HTTP_STREAM_H
+#define TORILATE_HTTP_STREAM_H
+
+#include <stddef.h>
+#include "http/http.h"
+#include "error/error.h"
+
+/* Capacity of each inter-stage ring */
+#define HTTP_STREAM_RING_SIZE (1u << 20)
+
+/* Output produced by the pipeline (mirrors the modes of parse_http_response) */
+typedef enum {
+    HTTP_STREAM_FORMATTED,  // status summary followed by the decoded body
+    HTTP_STREAM_RAW,        // response bytes exactly as received
+    HTTP_STREAM_CONTENT,    // decoded body only
+} HttpStreamMode;
+
+/* Output writer; called from the writer stage thread */
+typedef Error (*HttpSinkFn)(void *ctx, const char *data, size_t len);
+
+typedef struct HttpStreamSink {
+    HttpSinkFn write;
+    void *ctx;
+} HttpStreamSink;
+
+
+/*
+ * Perform an HTTP exchange and stream the final response into a sink.
+ * Redirects are followed like http_perform; only the final response is written.
+ *
+ *  @param request  request description
+ *  @param mode     output mode
+ *  @param sink     output writer
+ *  @param head     receives the final status code and header section;
+ *                  bytes_received counts every byte read for the final response
+ *
+ *  @return ERR_OK on success and an Error struct on failure
+ */
+Error http_stream(const HttpRequest *request, HttpStreamMode mode, HttpStreamSink sink, HttpResponse *head);
+
+#endif
@@ -14,13 +14,22 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include "error/error.h"
 
 #define INVALID_SOCKET (NetSocket){ .handle = -1 } // Invalid socket representation, handle is -1
 
+/*
+ * An address of the form "unix:/path" names a Unix domain socket instead of
+ * an IPv4 address (the port is ignored), e.g. Tor's "SocksPort unix:/path".
+ * Not supported on Windows.
+ */
+#define NET_UNIX_PREFIX     "unix:"
+
 /* Opaque socket handle */
 typedef struct NetSocket {
     int handle;
+    bool quickack;  // re-arm TCP_QUICKACK after every read (set by the connect)
 } NetSocket;
 
 /* Host address type */
@@ -30,19 +39,124 @@ typedef enum {
     DOMAIN
 } NetAddrType;
 
+/* Readiness events for net_poll() */
+typedef enum {
+    NET_POLL_IN  = 1 << 0,  // readable (or peer closed)
+    NET_POLL_OUT = 1 << 1,  // writable (or non-blocking connect finished)
+    NET_POLL_ERR = 1 << 2   // error or hang-up reported by the OS
+} NetPollEvents;
+
+/* Socket interest entry for net_poll() */
+typedef struct NetPollFd {
+    NetSocket sock;
+    int events;   // requested NetPollEvents
+    int revents;  // returned NetPollEvents
+} NetPollFd;
+
+/*
+ * Socket tuning applied by every connect (socket_opts.c). All connections go
+ * to the local Tor SOCKS port, so these shape the hop between the client and
+ * tor: small request writes against bulk response reads.
+ *
+ * Options that do not apply to the address family (the TCP ones on a Unix
+ * domain socket) are skipped. An option the OS refuses does not fail the
+ * connect; it is listed by net_sockopts_describe() instead.
+ */
+typedef struct NetSockOpts {
+    bool nodelay;       // TCP_NODELAY: send small writes (SOCKS request, HTTP head) without waiting for an ACK
+    bool quickack;      // TCP_QUICKACK: ACK at once instead of delaying (Linux; re-armed after reads)
+    int rcvbuf;         // SO_RCVBUF in bytes, 0 = OS default (a fixed size turns off Linux autotuning)
+    int sndbuf;         // SO_SNDBUF in bytes, 0 = OS default
+    int keepalive_s;    // SO_KEEPALIVE, probing after this many idle seconds, 0 = off
+    int busy_poll_us;   // SO_BUSY_POLL in microseconds, 0 = off (Linux; above net.core.busy_poll needs CAP_NET_ADMIN)
+} NetSockOpts;
+
+/* Options in NetSockOpts, as bits for net_sockopts_refused() */
+typedef enum {
+    NET_SOCKOPT_NODELAY   = 1 << 0,
+    NET_SOCKOPT_QUICKACK  = 1 << 1,
+    NET_SOCKOPT_RCVBUF    = 1 << 2,
+    NET_SOCKOPT_SNDBUF    = 1 << 3,
+    NET_SOCKOPT_KEEPALIVE = 1 << 4,
+    NET_SOCKOPT_BUSY_POLL = 1 << 5,
+} NetSockOptBits;
+
+#define NET_SOCKOPTS_BUF_MAX    (64 * 1024 * 1024)  // largest rcvbuf / sndbuf accepted
+#define NET_SOCKOPTS_DESC_MAX   192                 // net_sockopts_describe() output
+
 
 /* Lifecycle */
 Error net_init(void);
 void net_cleanup(void);
 void net_close(NetSocket *sock);
 
-/* Connection */
+/* End both directions without closing: wakes a thread blocked receiving on sock */
+void net_shutdown(NetSocket *sock);
+
+/* Connection (ip is an IPv4 address or a NET_UNIX_PREFIX path) */
 Error net_connect(NetSocket *sock, const char *ip, uint16_t port);
 
+/*
+ * Non-blocking connection.
+ * net_connect_start() creates a non-blocking socket and begins the connect.
+ * If *in_progress is set, wait for NET_POLL_OUT and call net_connect_finish().
+ */
+Error net_connect_start(NetSocket *sock, const char *ip, uint16_t port, bool *in_progress);
+Error net_connect_finish(NetSocket *sock);
+Error net_set_nonblocking(NetSocket *sock, bool enabled);
+
 /* I/O */
 Error net_send_all(NetSocket *sock, const void *buf, size_t len);
 Error net_recv(NetSocket *sock, void *buf, size_t len, size_t *bytes_received);
 
+/*
+ * Non-blocking I/O.
+ * Both report a would-block condition instead of failing: net_send_some()
+ * sets *sent to 0, net_recv_some() sets *would_block. A zero-byte receive
+ * without *would_block means the peer closed the connection.
+ */
+Error net_send_some(NetSocket *sock, const void *buf, size_t len, size_t *sent);
+Error net_recv_some(NetSocket *sock, void *buf, size_t len, size_t *bytes_received, bool *would_block);
+
+/* Readiness polling; *ready receives the number of entries with revents set */
+Error net_poll(NetPollFd *fds, size_t count, int timeout_ms, int *ready);
+
+/*
+ * Timed I/O (socket_timed.c), built on the non-blocking calls and net_poll().
+ * timeout_ms bounds every wait for readiness (-1 waits forever), so a peer
+ * that keeps making progress is never cut off; the caller passes what is left
+ * of its own deadline. Expiry fails with ERR_TIMEOUT.
+ *
+ * The socket must be non-blocking, as net_connect_timed() leaves it: on a
+ * blocking socket the send and receive still work but cannot time out.
+ */
+Error net_connect_timed(NetSocket *sock, const char *ip, uint16_t port, int timeout_ms);
+Error net_send_all_timed(NetSocket *sock, const void *buf, size_t len, int timeout_ms);
+Error net_recv_timed(NetSocket *sock, void *buf, size_t len, size_t *bytes_received, int timeout_ms);
+
+/*
+ * Socket tuning (socket_opts.c).
+ *
+ * net_sockopts_parse() reads "<profile>[,<option>=<value>...]" or just options
+ * on top of the OS defaults. Profiles:
+ *   os           nothing set (the default)
+ *   interactive  nodelay, quickack: request/response latency
+ *   bulk         nodelay, rcvbuf=1m, keepalive=60: long downloads
+ * Options: nodelay=on|off, quickack=on|off, rcvbuf=<bytes>[k|m],
+ * sndbuf=<bytes>[k|m], keepalive=<seconds>|off, busy-poll=<usec>|off.
+ *
+ * net_set_sockopts() is not thread-safe: call it before connecting.
+ */
+Error net_sockopts_parse(const char *spec, NetSockOpts *out);
+void net_set_sockopts(const NetSockOpts *opts);
+NetSockOpts net_get_sockopts(void);
+
+/* Settings in effect and those the OS refused, e.g. "nodelay quickack (refused: busy-poll)" */
+void net_sockopts_describe(char *out, size_t cap);
+
+/* Record options a backend could not set (NetSockOptBits) */
+void net_sockopts_refused(int bits);
+
 /* Utils */
 uint16_t net_htons(uint16_t value);
 uint32_t net_htonl(uint32_t value);
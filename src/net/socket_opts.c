@@ -0,0 +1,209 @@
+/*
+    File: src/net/socket_opts.c
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference:
+        - tcp(7): https://man7.org/linux/man-pages/man7/tcp.7.html
+        - socket(7): https://man7.org/linux/man-pages/man7/socket.7.html
+    Description:
+        Profiles, parsing and bookkeeping of the socket tuning that the
+        platform backends apply in net_connect() and net_connect_start().
+        Portable: the setsockopt() calls themselves live in
+        socket_posix.c and socket_win32.c.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "net/socket.h"
+
+typedef struct SockProfile {
+    const char *name;
+    NetSockOpts opts;
+} SockProfile;
+
+static const SockProfile profiles[] = {
+    { "os",          { 0 } },
+    { "interactive", { .nodelay = true, .quickack = true } },
+    { "bulk",        { .nodelay = true, .rcvbuf = 1024 * 1024, .keepalive_s = 60 } },
+};
+
+static NetSockOpts sockopts;            // applied by every connect
+static atomic_int sockopts_refused;     // NetSockOptBits the OS would not set
+
+/* Function Prototypes */
+static Error sockopts_set(NetSockOpts *opts, const char *key, const char *value);
+static bool sockopts_switch(const char *value, bool *out);
+static bool sockopts_number(const char *value, bool sizes, long max, int *out);
+
+Error net_sockopts_parse(const char *spec, NetSockOpts *out) {
+    memset(out, 0, sizeof(*out));
+    if (!spec || !spec[0]) {
+        return ERR_OK();
+    }
+
+    char buf[256];
+    if (strlen(spec) >= sizeof(buf)) {
+        return ERR_NEW(ERR_INVALID_ARGS, "Socket options too long: %s", spec);
+    }
+    snprintf(buf, sizeof(buf), "%s", spec);
+
+    char *next = buf;
+    for (bool first = true; next; first = false) {
+        char *item = next;
+        next = strchr(item, ',');
+        if (next) {
+            *next++ = '\0';
+        }
+        if (!item[0]) {
+            continue;
+        }
+
+        char *eq = strchr(item, '=');
+        if (!eq) {
+            // A bare word is a profile, and only as the first item (options override it)
+            size_t i = 0;
+            for (; first && i < sizeof(profiles) / sizeof(profiles[0]); i++) {
+                if (strcmp(item, profiles[i].name) == 0) {
+                    *out = profiles[i].opts;
+                    break;
+                }
+            }
+            if (!first || i == sizeof(profiles) / sizeof(profiles[0])) {
+                return ERR_NEW(ERR_INVALID_ARGS, "Unknown socket profile '%s' (os, interactive or bulk, first)", item);
+            }
+            continue;
+        }
+
+        *eq = '\0';
+        Error err = sockopts_set(out, item, eq + 1);
+        if (ERR_FAILED(err)) {
+            return err;
+        }
+    }
+    return ERR_OK();
+}
+
+void net_set_sockopts(const NetSockOpts *opts) {
+    if (opts) {
+        sockopts = *opts;
+    } else {
+        memset(&sockopts, 0, sizeof(sockopts));
+    }
+    atomic_store(&sockopts_refused, 0);
+}
+
+NetSockOpts net_get_sockopts(void) {
+    return sockopts;
+}
+
+void net_sockopts_refused(int bits) {
+    atomic_fetch_or_explicit(&sockopts_refused, bits, memory_order_relaxed);
+}
+
+void net_sockopts_describe(char *out, size_t cap) {
+    const NetSockOpts *o = &sockopts;
+    size_t len = 0;
+    out[0] = '\0';
+
+#define DESCRIBE(...) \
+    do { \
+        if (len < cap) { \
+            int n = snprintf(out + len, cap - len, "%s", len > 0 ? " " : ""); \
+            len += n > 0 ? (size_t)n : 0; \
+        } \
+        if (len < cap) { \
+            int n = snprintf(out + len, cap - len, __VA_ARGS__); \
+            len += n > 0 ? (size_t)n : 0; \
+        } \
+    } while (0)
+
+    if (o->nodelay)          DESCRIBE("nodelay");
+    if (o->quickack)         DESCRIBE("quickack");
+    if (o->rcvbuf > 0)       DESCRIBE("rcvbuf=%d", o->rcvbuf);
+    if (o->sndbuf > 0)       DESCRIBE("sndbuf=%d", o->sndbuf);
+    if (o->keepalive_s > 0)  DESCRIBE("keepalive=%ds", o->keepalive_s);
+    if (o->busy_poll_us > 0) DESCRIBE("busy-poll=%dus", o->busy_poll_us);
+    if (len == 0)            DESCRIBE("OS defaults");
+
+    int refused = atomic_load_explicit(&sockopts_refused, memory_order_relaxed);
+    if (refused) {
+        static const char *names[] = { "nodelay", "quickack", "rcvbuf", "sndbuf", "keepalive", "busy-poll" };
+        DESCRIBE("(refused:");
+        for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+            if (refused & (1 << i)) {
+                DESCRIBE("%s", names[i]);
+            }
+        }
+        if (len < cap) {
+            snprintf(out + len, cap - len, ")");
+        }
+    }
+#undef DESCRIBE
+}
+
+/* Internal helper functions */
+
+// Apply one "key=value" item
+static Error sockopts_set(NetSockOpts *opts, const char *key, const char *value) {
+    bool ok = false;
+    if (strcmp(key, "nodelay") == 0) {
+        ok = sockopts_switch(value, &opts->nodelay);
+    } else if (strcmp(key, "quickack") == 0) {
+        ok = sockopts_switch(value, &opts->quickack);
+    } else if (strcmp(key, "rcvbuf") == 0) {
+        ok = sockopts_number(value, true, NET_SOCKOPTS_BUF_MAX, &opts->rcvbuf);
+    } else if (strcmp(key, "sndbuf") == 0) {
+        ok = sockopts_number(value, true, NET_SOCKOPTS_BUF_MAX, &opts->sndbuf);
+    } else if (strcmp(key, "keepalive") == 0) {
+        ok = sockopts_number(value, false, 86400, &opts->keepalive_s);
+    } else if (strcmp(key, "busy-poll") == 0) {
+        ok = sockopts_number(value, false, 1000000, &opts->busy_poll_us);
+    } else {
+        return ERR_NEW(ERR_INVALID_ARGS, "Unknown socket option '%s' (nodelay, quickack, rcvbuf, sndbuf, keepalive, busy-poll)", key);
+    }
+
+    if (!ok) {
+        return ERR_NEW(ERR_INVALID_ARGS, "Invalid value '%s' for socket option %s", value, key);
+    }
+    return ERR_OK();
+}
+
+static bool sockopts_switch(const char *value, bool *out) {
+    if (strcmp(value, "on") == 0 || strcmp(value, "1") == 0) {
+        *out = true;
+        return true;
+    }
+    if (strcmp(value, "off") == 0 || strcmp(value, "0") == 0) {
+        *out = false;
+        return true;
+    }
+    return false;
+}
+
+// Non-negative number up to max, "off" for 0; sizes take a k or m suffix
+static bool sockopts_number(const char *value, bool sizes, long max, int *out) {
+    if (strcmp(value, "off") == 0) {
+        *out = 0;
+        return true;
+    }
+
+    char *end = NULL;
+    long n = strtol(value, &end, 10);
+    if (end == value || n < 0) {
+        return false;
+    }
+    if (sizes && (*end == 'k' || *end == 'K')) {
+        n = n > max / 1024 ? max + 1 : n * 1024;
+        end++;
+    } else if (sizes && (*end == 'm' || *end == 'M')) {
+        n = n > max / (1024 * 1024) ? max + 1 : n * 1024 * 1024;
+        end++;
+    }
+    if (*end != '\0' || n > max) {
+        return false;
+    }
+    *out = (int)n;
+    return true;
+}
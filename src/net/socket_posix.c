@@ -6,16 +6,47 @@
         - POSIX socket API: https://man7.org/linux/man-pages/man2/socket.2.html
     Description:
         POSIX-compliant implementation of the Torilate socket
-        abstraction for Linux and Unix-like systems.
+        abstraction for Linux and Unix-like systems. Connects go to an
+        IPv4 address or, for "unix:/path", to a Unix domain socket, which
+        skips the loopback TCP stack (no handshake, no TIME_WAIT). New
+        sockets get the net_set_sockopts() tuning before they connect.
 */
 
 #ifndef _WIN32
 
+#include <poll.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include "net/socket.h"
+#include "diag/trace.h"
+#include "diag/flight.h"
+#include <string.h>
 #include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <sys/socket.h>
+#include <sys/un.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/* Address of a connect: IPv4 or Unix domain */
+typedef struct NetAddr {
+    union {
+        struct sockaddr_in in;
+        struct sockaddr_un un;
+    } sa;
+    socklen_t len;
+    int family;
+} NetAddr;
+
+/* Function Prototypes */
+static Error net_resolve(const char *ip, uint16_t port, NetAddr *out);
+static bool net_tune(int s, int family);
+static void net_quickack(NetSocket *sock);
 
 Error net_init(void) {
     return ERR_OK(); /* no-op */
@@ -27,33 +58,111 @@ void net_cleanup(void) {
 
 void net_close(NetSocket *sock) {
     if (sock->handle >= 0) {
+        TRACE_INSTANT("net", "close", "fd", sock->handle);
+        flight_record(FLIGHT_CLOSE, (int)sock->handle, 0, 0);
         close(sock->handle);
         sock->handle = -1;
     }
 }
 
+void net_shutdown(NetSocket *sock) {
+    if (sock->handle >= 0) {
+        shutdown(sock->handle, SHUT_RDWR);
+    }
+}
+
 Error net_connect(NetSocket *sock, const char *ip, uint16_t port) {
-    int s = socket(AF_INET, SOCK_STREAM, 0);
+    NetAddr addr;
+    Error err = net_resolve(ip, port, &addr);
+    if (ERR_FAILED(err)) {
+        return err;
+    }
+
+    int s = socket(addr.family, SOCK_STREAM, 0);
     if (s < 0) {
         return ERR_NEW(ERR_SOCKET_CREATION_FAILED, "socket() creation failed with error %d", errno);
     }
+    bool quickack = net_tune(s, addr.family);
 
-    struct sockaddr_in addr;
-    addr.sin_family = AF_INET;
-    addr.sin_port   = htons(port);
-
-    if (inet_pton(AF_INET, ip, &addr.sin_addr) != 1) {
+    TRACE_BEGIN("net", "connect", "fd", s);
+    if (connect(s, (struct sockaddr*)&addr.sa, addr.len) < 0) {
+        int err = errno;
+        TRACE_END("net", "connect", "errno", err);
+        flight_record(FLIGHT_CONNECT, (int)s, 0, err);
         close(s);
-        return ERR_NEW(ERR_INVALID_ADDRESS, "Failed to parse IP address '%s'", ip);
+        return ERR_NEW(ERR_CONNECTION_FAILED, "Failed to connect to %s:%d with error %d", ip, port, err);
+    }
+    TRACE_END("net", "connect", "fd", s);
+    flight_record(FLIGHT_CONNECT, (int)s, 0, 0);
+
+    sock->handle = s;
+    sock->quickack = quickack;
+    return ERR_OK();
+}
+
+Error net_set_nonblocking(NetSocket *sock, bool enabled) {
+    int flags = fcntl(sock->handle, F_GETFL, 0);
+    if (flags < 0) {
+        return ERR_NEW(ERR_NETWORK_IO, "fcntl(F_GETFL) failed with error %d", errno);
+    }
+
+    flags = enabled ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+    if (fcntl(sock->handle, F_SETFL, flags) < 0) {
+        return ERR_NEW(ERR_NETWORK_IO, "fcntl(F_SETFL) failed with error %d", errno);
+    }
+    return ERR_OK();
+}
+
+Error net_connect_start(NetSocket *sock, const char *ip, uint16_t port, bool *in_progress) {
+    *in_progress = false;
+
+    NetAddr addr;
+    Error err = net_resolve(ip, port, &addr);
+    if (ERR_FAILED(err)) {
+        return err;
     }
 
-    if (connect(s, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+    int s = socket(addr.family, SOCK_STREAM, 0);
+    if (s < 0) {
+        return ERR_NEW(ERR_SOCKET_CREATION_FAILED, "socket() creation failed with error %d", errno);
+    }
+    sock->handle = s;
+    sock->quickack = net_tune(s, addr.family);
+
+    err = net_set_nonblocking(sock, true);
+    if (ERR_FAILED(err)) {
+        net_close(sock);
+        return err;
+    }
+
+    TRACE_INSTANT("net", "connect_start", "fd", s);
+    flight_record(FLIGHT_CONNECT_START, (int)s, 0, 0);
+    if (connect(s, (struct sockaddr*)&addr.sa, addr.len) < 0) {
         int err = errno;
-        close(s);
+        if (err == EINPROGRESS) {
+            *in_progress = true;
+            return ERR_OK();
+        }
+        // A Unix domain connect does not wait: EAGAIN there is a full backlog, failed like a refusal
+        net_close(sock);
         return ERR_NEW(ERR_CONNECTION_FAILED, "Failed to connect to %s:%d with error %d", ip, port, err);
     }
 
-    sock->handle = s;
+    return ERR_OK();
+}
+
+Error net_connect_finish(NetSocket *sock) {
+    int so_error = 0;
+    socklen_t len = sizeof(so_error);
+
+    if (getsockopt(sock->handle, SOL_SOCKET, SO_ERROR, &so_error, &len) < 0) {
+        return ERR_NEW(ERR_CONNECTION_FAILED, "getsockopt(SO_ERROR) failed with error %d", errno);
+    }
+    TRACE_INSTANT("net", "connect_finish", "errno", so_error);
+    flight_record(FLIGHT_CONNECT, (int)sock->handle, 0, so_error);
+    if (so_error != 0) {
+        return ERR_NEW(ERR_CONNECTION_FAILED, "Non-blocking connect failed with error %d", so_error);
+    }
     return ERR_OK();
 }
 
@@ -61,22 +170,33 @@ Error net_send_all(NetSocket *sock, const void *buf, size_t len) {
     size_t sent = 0;
     const char *p = (const char*)buf;
 
+    TRACE_BEGIN("net", "send_all", "bytes", len);
     while (sent < len) {
         ssize_t n = send(sock->handle, p + sent, len - sent, 0);
         int err = errno;
-        if (n < 0)
+        if (n < 0) {
+            TRACE_END("net", "send_all", "errno", err);
             return ERR_NEW(ERR_NETWORK_IO, "send() failed after %zu/%zu bytes (error %d)", sent, len, err);
+        }
         sent += n;
     }
+    TRACE_END("net", "send_all", "bytes", sent);
+    flight_record(FLIGHT_SEND, (int)sock->handle, sent, 0);
     return ERR_OK();
 }
 
 Error net_recv(NetSocket *sock, void *buf, size_t len, size_t *bytes_received) {
+    TRACE_BEGIN("net", "recv", "fd", sock->handle);
     ssize_t n = recv(sock->handle, buf, len, 0);
     int err = errno;
+    TRACE_END("net", "recv", "bytes", n);
+    if (n >= 0) {
+        flight_record(n == 0 ? FLIGHT_EOF : FLIGHT_RECV, (int)sock->handle, (uint64_t)n, 0);
+    }
     if (n < 0) {
         return ERR_NEW(ERR_NETWORK_IO, "recv() failed with error %d", err);
     }
+    net_quickack(sock);
     if (bytes_received) {
         *bytes_received = n;
     }
@@ -84,6 +204,92 @@ Error net_recv(NetSocket *sock, void *buf, size_t len, size_t *bytes_received) {
     return ERR_OK();
 }
 
+Error net_send_some(NetSocket *sock, const void *buf, size_t len, size_t *sent) {
+    *sent = 0;
+    ssize_t n = send(sock->handle, buf, len, MSG_NOSIGNAL);
+    if (n < 0) {
+        int err = errno;
+        if (err == EAGAIN || err == EWOULDBLOCK || err == EINTR) {
+            return ERR_OK();
+        }
+        return ERR_NEW(ERR_NETWORK_IO, "send() failed with error %d", err);
+    }
+
+    TRACE_INSTANT("net", "send_some", "bytes", n);
+    flight_record(FLIGHT_SEND, (int)sock->handle, (uint64_t)n, 0);
+    *sent = (size_t)n;
+    return ERR_OK();
+}
+
+Error net_recv_some(NetSocket *sock, void *buf, size_t len, size_t *bytes_received, bool *would_block) {
+    *bytes_received = 0;
+    *would_block = false;
+
+    ssize_t n = recv(sock->handle, buf, len, 0);
+    if (n < 0) {
+        int err = errno;
+        if (err == EAGAIN || err == EWOULDBLOCK || err == EINTR) {
+            *would_block = true;
+            return ERR_OK();
+        }
+        return ERR_NEW(ERR_NETWORK_IO, "recv() failed with error %d", err);
+    }
+
+    TRACE_INSTANT("net", "recv_some", "bytes", n);
+    flight_record(n == 0 ? FLIGHT_EOF : FLIGHT_RECV, (int)sock->handle, (uint64_t)n, 0);
+    net_quickack(sock);
+    *bytes_received = (size_t)n;
+    return ERR_OK();
+}
+
+Error net_poll(NetPollFd *fds, size_t count, int timeout_ms, int *ready) {
+    struct pollfd stack_fds[64];
+    struct pollfd *pfds = stack_fds;
+
+    if (count > sizeof(stack_fds) / sizeof(stack_fds[0])) {
+        pfds = malloc(count * sizeof(struct pollfd));
+        if (!pfds) {
+            return ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate %zu poll entries", count);
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        pfds[i].fd      = fds[i].sock.handle;
+        pfds[i].events  = (short)(((fds[i].events & NET_POLL_IN) ? POLLIN : 0) |
+                                  ((fds[i].events & NET_POLL_OUT) ? POLLOUT : 0));
+        pfds[i].revents = 0;
+    }
+
+    int n;
+    TRACE_BEGIN("net", "poll", "fds", count);
+    do {
+        n = poll(pfds, (nfds_t)count, timeout_ms);
+    } while (n < 0 && errno == EINTR);
+    TRACE_END("net", "poll", "ready", n);
+
+    Error err = ERR_OK();
+    if (n < 0) {
+        err = ERR_NEW(ERR_NETWORK_IO, "poll() failed with error %d", errno);
+        goto exit_poll;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        short re = pfds[i].revents;
+        fds[i].revents = ((re & (POLLIN | POLLHUP)) ? NET_POLL_IN : 0) |
+                         ((re & POLLOUT) ? NET_POLL_OUT : 0) |
+                         ((re & (POLLERR | POLLNVAL)) ? NET_POLL_ERR : 0);
+    }
+    if (ready) {
+        *ready = n;
+    }
+
+exit_poll:
+    if (pfds != stack_fds) {
+        free(pfds);
+    }
+    return err;
+}
+
 uint16_t net_htons(uint16_t value) {
     return htons(value);
 }
@@ -128,4 +334,106 @@ Error net_parse_ipv4(const char *ip, uint32_t *out) {
     return ERR_OK();
 }
 
+/* Internal helper functions */
+
+// Build the socket address of "a.b.c.d" + port or of "unix:/path"
+static Error net_resolve(const char *ip, uint16_t port, NetAddr *out) {
+    memset(out, 0, sizeof(*out));
+
+    size_t prefix = strlen(NET_UNIX_PREFIX);
+    if (strncmp(ip, NET_UNIX_PREFIX, prefix) == 0) {
+        const char *path = ip + prefix;
+        size_t len = strlen(path);
+        if (len == 0 || len >= sizeof(out->sa.un.sun_path)) {
+            return ERR_NEW(ERR_INVALID_ADDRESS, "Invalid Unix socket path '%s' (1 to %zu bytes)", path, sizeof(out->sa.un.sun_path) - 1);
+        }
+        out->sa.un.sun_family = AF_UNIX;
+        memcpy(out->sa.un.sun_path, path, len + 1);
+        out->len = (socklen_t)(offsetof(struct sockaddr_un, sun_path) + len + 1);
+        out->family = AF_UNIX;
+        return ERR_OK();
+    }
+
+    out->sa.in.sin_family = AF_INET;
+    out->sa.in.sin_port   = htons(port);
+    if (inet_pton(AF_INET, ip, &out->sa.in.sin_addr) != 1) {
+        return ERR_NEW(ERR_INVALID_ADDRESS, "Failed to parse IP address '%s'", ip);
+    }
+    out->len = sizeof(out->sa.in);
+    out->family = AF_INET;
+    return ERR_OK();
+}
+
+/*
+ * Apply net_set_sockopts() to a new socket, before its connect: the receive
+ * buffer size decides the window scale offered in the SYN. Returns whether
+ * reads re-arm TCP_QUICKACK, which Linux drops again once it sees traffic
+ * that looks interactive.
+ */
+static bool net_tune(int s, int family) {
+    NetSockOpts o = net_get_sockopts();
+    int refused = 0;
+    bool quickack = false;
+    int one = 1;
+
+    if (o.rcvbuf > 0 && setsockopt(s, SOL_SOCKET, SO_RCVBUF, &o.rcvbuf, sizeof(o.rcvbuf)) < 0) {
+        refused |= NET_SOCKOPT_RCVBUF;
+    }
+    if (o.sndbuf > 0 && setsockopt(s, SOL_SOCKET, SO_SNDBUF, &o.sndbuf, sizeof(o.sndbuf)) < 0) {
+        refused |= NET_SOCKOPT_SNDBUF;
+    }
+    if (family != AF_INET) {
+        goto exit_tune;     // the rest is TCP (or NIC polling), nothing to a Unix domain socket
+    }
+
+    if (o.nodelay && setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) < 0) {
+        refused |= NET_SOCKOPT_NODELAY;
+    }
+    if (o.quickack) {
+#ifdef TCP_QUICKACK
+        quickack = setsockopt(s, IPPROTO_TCP, TCP_QUICKACK, &one, sizeof(one)) == 0;
+#endif
+        refused |= quickack ? 0 : NET_SOCKOPT_QUICKACK;
+    }
+    if (o.keepalive_s > 0) {
+        bool ok = setsockopt(s, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one)) == 0;
+#if defined(TCP_KEEPIDLE)
+        ok = ok && setsockopt(s, IPPROTO_TCP, TCP_KEEPIDLE, &o.keepalive_s, sizeof(o.keepalive_s)) == 0;
+#elif defined(TCP_KEEPALIVE)
+        ok = ok && setsockopt(s, IPPROTO_TCP, TCP_KEEPALIVE, &o.keepalive_s, sizeof(o.keepalive_s)) == 0;   // macOS
+#endif
+#if defined(TCP_KEEPINTVL) && defined(TCP_KEEPCNT)
+        int interval = o.keepalive_s / 3 > 0 ? o.keepalive_s / 3 : 1;
+        int probes = 3;
+        ok = ok && setsockopt(s, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval)) == 0;
+        ok = ok && setsockopt(s, IPPROTO_TCP, TCP_KEEPCNT, &probes, sizeof(probes)) == 0;
+#endif
+        refused |= ok ? 0 : NET_SOCKOPT_KEEPALIVE;
+    }
+    if (o.busy_poll_us > 0) {
+        bool ok = false;
+#ifdef SO_BUSY_POLL
+        ok = setsockopt(s, SOL_SOCKET, SO_BUSY_POLL, &o.busy_poll_us, sizeof(o.busy_poll_us)) == 0;
+#endif
+        refused |= ok ? 0 : NET_SOCKOPT_BUSY_POLL;
+    }
+
+exit_tune:
+    if (refused) {
+        net_sockopts_refused(refused);
+    }
+    return quickack;
+}
+
+static void net_quickack(NetSocket *sock) {
+#ifdef TCP_QUICKACK
+    if (sock->quickack) {
+        int one = 1;
+        setsockopt(sock->handle, IPPROTO_TCP, TCP_QUICKACK, &one, sizeof(one));
+    }
+#else
+    (void)sock;
+#endif
+}
+
 #endif
@@ -0,0 +1,88 @@
+/*
+    File: src/net/socket_timed.c
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference:
+        - poll(2): https://man7.org/linux/man-pages/man2/poll.2.html
+    Description:
+        Timed connect, send and receive for the blocking clients.
+        Every call tries the non-blocking operation first and only waits
+        in net_poll() when it would block, so timeouts are plain poll
+        timers: no signals or per-thread alarms, which keeps them usable
+        from any number of threads. Portable: uses only the platform
+        socket API declared in socket.h.
+*/
+
+#include "net/socket.h"
+
+/* Function Prototypes */
+static Error net_wait(NetSocket *sock, int events, int timeout_ms);
+
+Error net_connect_timed(NetSocket *sock, const char *ip, uint16_t port, int timeout_ms) {
+    bool in_progress = false;
+    Error err = net_connect_start(sock, ip, port, &in_progress);
+    if (ERR_FAILED(err) || !in_progress) {
+        return err;
+    }
+
+    err = net_wait(sock, NET_POLL_OUT, timeout_ms);
+    if (!ERR_FAILED(err)) {
+        err = net_connect_finish(sock);
+    }
+    if (ERR_FAILED(err)) {
+        net_close(sock);
+        return ERR_PROPAGATE(err, "Failed to connect to %s:%d", ip, port);
+    }
+    return ERR_OK();
+}
+
+Error net_send_all_timed(NetSocket *sock, const void *buf, size_t len, int timeout_ms) {
+    const char *p = (const char *)buf;
+    size_t sent = 0;
+
+    while (sent < len) {
+        size_t n = 0;
+        Error err = net_send_some(sock, p + sent, len - sent, &n);
+        if (ERR_FAILED(err)) {
+            return err;
+        }
+        if (n == 0) {
+            err = net_wait(sock, NET_POLL_OUT, timeout_ms);
+            if (ERR_FAILED(err)) {
+                return ERR_PROPAGATE(err, "send() stalled after %zu/%zu bytes", sent, len);
+            }
+        }
+        sent += n;
+    }
+    return ERR_OK();
+}
+
+Error net_recv_timed(NetSocket *sock, void *buf, size_t len, size_t *bytes_received, int timeout_ms) {
+    for (;;) {
+        bool would_block = false;
+        Error err = net_recv_some(sock, buf, len, bytes_received, &would_block);
+        if (ERR_FAILED(err) || !would_block) {
+            return err;
+        }
+        err = net_wait(sock, NET_POLL_IN, timeout_ms);
+        if (ERR_FAILED(err)) {
+            return err;
+        }
+    }
+}
+
+/* Internal helper functions */
+
+static Error net_wait(NetSocket *sock, int events, int timeout_ms) {
+    NetPollFd fd = { .sock = *sock, .events = events, .revents = 0 };
+    int ready = 0;
+
+    Error err = net_poll(&fd, 1, timeout_ms, &ready);
+    if (ERR_FAILED(err)) {
+        return err;
+    }
+    if (ready == 0) {
+        return ERR_NEW(ERR_TIMEOUT, "Socket not %s within %d ms", (events & NET_POLL_OUT) ? "writable" : "readable", timeout_ms);
+    }
+    return ERR_OK();
+}
@@ -6,15 +6,23 @@
         - Winsock 2 API: https://learn.microsoft.com/en-us/windows/win32/winsock/
     Description:
         Windows-specific implementation of the Torilate socket
-        abstraction using Winsock2.
+        abstraction using Winsock2. Of the net_set_sockopts() tuning,
+        TCP_QUICKACK and SO_BUSY_POLL have no Winsock equivalent and are
+        reported as refused.
 */
 
 #ifdef _WIN32
 
+#include <stdlib.h>
+#include <string.h>
 #include "net/socket.h"
+#include "diag/trace.h"
+#include "diag/flight.h"
 #include <winsock2.h>
 #include <ws2tcpip.h>
 
+/* Function Prototypes */
+static void net_tune(SOCKET s);
 
 Error net_init(void) {
     WSADATA wsa;
@@ -43,17 +51,30 @@ void net_cleanup(void) {
 
 void net_close(NetSocket *sock) {
     if ((SOCKET)sock->handle != INVALID_SOCKET) {
+        TRACE_INSTANT("net", "close", "fd", sock->handle);
+        flight_record(FLIGHT_CLOSE, (int)sock->handle, 0, 0);
         closesocket((SOCKET)sock->handle);
         sock->handle = -1;
     }
 }
 
+void net_shutdown(NetSocket *sock) {
+    if ((SOCKET)sock->handle != INVALID_SOCKET) {
+        shutdown((SOCKET)sock->handle, SD_BOTH);
+    }
+}
+
 Error net_connect(NetSocket *sock, const char *ip, uint16_t port) {
+    if (strncmp(ip, NET_UNIX_PREFIX, strlen(NET_UNIX_PREFIX)) == 0) {
+        return ERR_NEW(ERR_INVALID_ADDRESS, "Unix domain sockets are not supported on Windows: %s", ip);
+    }
+
     SOCKET s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
     if (s == INVALID_SOCKET) {
         int wsa_err = WSAGetLastError();
         return ERR_NEW(ERR_SOCKET_CREATION_FAILED, "socket() creation failed with WSA error %d", wsa_err);
     }
+    net_tune(s);
 
     struct sockaddr_in addr;
     addr.sin_family = AF_INET;
@@ -64,13 +85,85 @@ Error net_connect(NetSocket *sock, const char *ip, uint16_t port) {
         return ERR_NEW(ERR_INVALID_ADDRESS, "Failed to parse IP address: %s", ip);
     }
 
+    TRACE_BEGIN("net", "connect", "fd", s);
     if (connect(s, (struct sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
         int wsa_err = WSAGetLastError();
+        TRACE_END("net", "connect", "errno", wsa_err);
+        flight_record(FLIGHT_CONNECT, (int)s, 0, wsa_err);
         closesocket(s);
         return ERR_NEW(ERR_CONNECTION_FAILED, "connect() failed to %s:%d with WSA error %d", ip, port, wsa_err);
     }
+    TRACE_END("net", "connect", "fd", s);
+    flight_record(FLIGHT_CONNECT, (int)s, 0, 0);
+
+    sock->handle = (int)s;
+    return ERR_OK();
+}
+
+Error net_set_nonblocking(NetSocket *sock, bool enabled) {
+    u_long mode = enabled ? 1 : 0;
+    if (ioctlsocket((SOCKET)sock->handle, FIONBIO, &mode) == SOCKET_ERROR) {
+        return ERR_NEW(ERR_NETWORK_IO, "ioctlsocket(FIONBIO) failed with WSA error %d", WSAGetLastError());
+    }
+    return ERR_OK();
+}
+
+Error net_connect_start(NetSocket *sock, const char *ip, uint16_t port, bool *in_progress) {
+    *in_progress = false;
+    if (strncmp(ip, NET_UNIX_PREFIX, strlen(NET_UNIX_PREFIX)) == 0) {
+        return ERR_NEW(ERR_INVALID_ADDRESS, "Unix domain sockets are not supported on Windows: %s", ip);
+    }
 
+    SOCKET s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (s == INVALID_SOCKET) {
+        int wsa_err = WSAGetLastError();
+        return ERR_NEW(ERR_SOCKET_CREATION_FAILED, "socket() creation failed with WSA error %d", wsa_err);
+    }
     sock->handle = (int)s;
+    net_tune(s);
+
+    Error err = net_set_nonblocking(sock, true);
+    if (ERR_FAILED(err)) {
+        net_close(sock);
+        return err;
+    }
+
+    struct sockaddr_in addr;
+    addr.sin_family = AF_INET;
+    addr.sin_port   = htons(port);
+
+    if (inet_pton(AF_INET, ip, &addr.sin_addr) != 1) {
+        net_close(sock);
+        return ERR_NEW(ERR_INVALID_ADDRESS, "Failed to parse IP address: %s", ip);
+    }
+
+    TRACE_INSTANT("net", "connect_start", "fd", s);
+    flight_record(FLIGHT_CONNECT_START, (int)s, 0, 0);
+    if (connect(s, (struct sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
+        int wsa_err = WSAGetLastError();
+        if (wsa_err == WSAEWOULDBLOCK) {
+            *in_progress = true;
+            return ERR_OK();
+        }
+        net_close(sock);
+        return ERR_NEW(ERR_CONNECTION_FAILED, "connect() failed to %s:%d with WSA error %d", ip, port, wsa_err);
+    }
+
+    return ERR_OK();
+}
+
+Error net_connect_finish(NetSocket *sock) {
+    int so_error = 0;
+    int len = sizeof(so_error);
+
+    if (getsockopt((SOCKET)sock->handle, SOL_SOCKET, SO_ERROR, (char*)&so_error, &len) == SOCKET_ERROR) {
+        return ERR_NEW(ERR_CONNECTION_FAILED, "getsockopt(SO_ERROR) failed with WSA error %d", WSAGetLastError());
+    }
+    TRACE_INSTANT("net", "connect_finish", "errno", so_error);
+    flight_record(FLIGHT_CONNECT, (int)sock->handle, 0, so_error);
+    if (so_error != 0) {
+        return ERR_NEW(ERR_CONNECTION_FAILED, "Non-blocking connect failed with WSA error %d", so_error);
+    }
     return ERR_OK();
 }
 
@@ -79,20 +172,29 @@ Error net_send_all(NetSocket *sock, const void *buf, size_t len) {
     SOCKET s = (SOCKET)sock->handle;
     const char *p = (const char*)buf;
 
+    TRACE_BEGIN("net", "send_all", "bytes", len);
     while (sent < len) {
         int n = send(s, p + sent, (int)(len - sent), 0);
         int wsa_err = WSAGetLastError();
         if (n < 0) {
+            TRACE_END("net", "send_all", "errno", wsa_err);
             return ERR_NEW(ERR_NETWORK_IO, "send() failed after %zu/%zu bytes (WSA error %d)", sent, len, wsa_err);
         }
         sent += n;
     }
+    TRACE_END("net", "send_all", "bytes", sent);
+    flight_record(FLIGHT_SEND, (int)sock->handle, sent, 0);
     return ERR_OK();
 }
 
 Error net_recv(NetSocket *sock, void *buf, size_t len, size_t *bytes_received) {
+    TRACE_BEGIN("net", "recv", "fd", sock->handle);
     int n = recv((SOCKET)sock->handle, (char*)buf, (int)len, 0);
     int wsa_err = WSAGetLastError();
+    TRACE_END("net", "recv", "bytes", n);
+    if (n >= 0) {
+        flight_record(n == 0 ? FLIGHT_EOF : FLIGHT_RECV, (int)sock->handle, (uint64_t)n, 0);
+    }
     if (n < 0) {
         return ERR_NEW(ERR_NET_RECV_FAILED, "recv() failed with WSA error %d", wsa_err);
     }
@@ -103,6 +205,80 @@ Error net_recv(NetSocket *sock, void *buf, size_t len, size_t *bytes_received) {
     return ERR_OK();
 }
 
+Error net_send_some(NetSocket *sock, const void *buf, size_t len, size_t *sent) {
+    *sent = 0;
+    int n = send((SOCKET)sock->handle, (const char*)buf, (int)len, 0);
+    if (n == SOCKET_ERROR) {
+        int wsa_err = WSAGetLastError();
+        if (wsa_err == WSAEWOULDBLOCK) {
+            return ERR_OK();
+        }
+        return ERR_NEW(ERR_NETWORK_IO, "send() failed with WSA error %d", wsa_err);
+    }
+
+    TRACE_INSTANT("net", "send_some", "bytes", n);
+    flight_record(FLIGHT_SEND, (int)sock->handle, (uint64_t)n, 0);
+    *sent = (size_t)n;
+    return ERR_OK();
+}
+
+Error net_recv_some(NetSocket *sock, void *buf, size_t len, size_t *bytes_received, bool *would_block) {
+    *bytes_received = 0;
+    *would_block = false;
+
+    int n = recv((SOCKET)sock->handle, (char*)buf, (int)len, 0);
+    if (n == SOCKET_ERROR) {
+        int wsa_err = WSAGetLastError();
+        if (wsa_err == WSAEWOULDBLOCK) {
+            *would_block = true;
+            return ERR_OK();
+        }
+        return ERR_NEW(ERR_NET_RECV_FAILED, "recv() failed with WSA error %d", wsa_err);
+    }
+
+    TRACE_INSTANT("net", "recv_some", "bytes", n);
+    flight_record(n == 0 ? FLIGHT_EOF : FLIGHT_RECV, (int)sock->handle, (uint64_t)n, 0);
+    *bytes_received = (size_t)n;
+    return ERR_OK();
+}
+
+Error net_poll(NetPollFd *fds, size_t count, int timeout_ms, int *ready) {
+    WSAPOLLFD *pfds = malloc(count * sizeof(WSAPOLLFD));
+    if (!pfds && count > 0) {
+        return ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate %zu poll entries", count);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        pfds[i].fd      = (SOCKET)fds[i].sock.handle;
+        pfds[i].events  = (SHORT)(((fds[i].events & NET_POLL_IN) ? POLLRDNORM : 0) |
+                                  ((fds[i].events & NET_POLL_OUT) ? POLLWRNORM : 0));
+        pfds[i].revents = 0;
+    }
+
+    Error err = ERR_OK();
+    TRACE_BEGIN("net", "poll", "fds", count);
+    int n = WSAPoll(pfds, (ULONG)count, timeout_ms);
+    TRACE_END("net", "poll", "ready", n);
+    if (n == SOCKET_ERROR) {
+        err = ERR_NEW(ERR_NETWORK_IO, "WSAPoll() failed with WSA error %d", WSAGetLastError());
+        goto exit_poll;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        SHORT re = pfds[i].revents;
+        fds[i].revents = ((re & (POLLRDNORM | POLLHUP)) ? NET_POLL_IN : 0) |
+                         ((re & POLLWRNORM) ? NET_POLL_OUT : 0) |
+                         ((re & (POLLERR | POLLNVAL)) ? NET_POLL_ERR : 0);
+    }
+    if (ready) {
+        *ready = n;
+    }
+
+exit_poll:
+    free(pfds);
+    return err;
+}
+
 /* Utility functions */
 
 uint16_t net_htons(uint16_t value) {
@@ -150,4 +326,37 @@ Error net_parse_ipv4(const char *ip, uint32_t *out) {
     return ERR_OK();
 }
 
+/* Internal helper functions */
+
+// Apply net_set_sockopts() to a new socket, before its connect
+static void net_tune(SOCKET s) {
+    NetSockOpts o = net_get_sockopts();
+    int refused = 0;
+    BOOL on = TRUE;
+
+    if (o.rcvbuf > 0 && setsockopt(s, SOL_SOCKET, SO_RCVBUF, (const char*)&o.rcvbuf, sizeof(o.rcvbuf)) == SOCKET_ERROR) {
+        refused |= NET_SOCKOPT_RCVBUF;
+    }
+    if (o.sndbuf > 0 && setsockopt(s, SOL_SOCKET, SO_SNDBUF, (const char*)&o.sndbuf, sizeof(o.sndbuf)) == SOCKET_ERROR) {
+        refused |= NET_SOCKOPT_SNDBUF;
+    }
+    if (o.nodelay && setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&on, sizeof(on)) == SOCKET_ERROR) {
+        refused |= NET_SOCKOPT_NODELAY;
+    }
+    if (o.keepalive_s > 0) {
+        bool ok = setsockopt(s, SOL_SOCKET, SO_KEEPALIVE, (const char*)&on, sizeof(on)) != SOCKET_ERROR;
+#ifdef TCP_KEEPIDLE
+        DWORD idle = (DWORD)o.keepalive_s;
+        ok = ok && setsockopt(s, IPPROTO_TCP, TCP_KEEPIDLE, (const char*)&idle, sizeof(idle)) != SOCKET_ERROR;
+#endif
+        refused |= ok ? 0 : NET_SOCKOPT_KEEPALIVE;
+    }
+    refused |= o.quickack ? NET_SOCKOPT_QUICKACK : 0;
+    refused |= o.busy_poll_us > 0 ? NET_SOCKOPT_BUSY_POLL : 0;
+
+    if (refused) {
+        net_sockopts_refused(refused);
+    }
+}
+
 #endif
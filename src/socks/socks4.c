@@ -5,30 +5,117 @@
     Reference:
         - SOCKS4 Protocol: https://www.openssh.org/txt/socks4.protocol
         - SOCKS4a Extension: https://www.openssh.org/txt/socks4a.protocol
+        - Tor SOCKS extensions: https://spec.torproject.org/socks-extensions.html
     Description:
-        Implementation of the SOCKS4 client-side CONNECT command.
+        Implementation of the SOCKS4 client-side CONNECT command and of
+        Tor's RESOLVE extension, which shares the SOCKS4a request layout.
 */
 
 #include <string.h>
 #include "socks/socks4.h"
+#include "diag/trace.h"
+#include "diag/flight.h"
 
 /* Internal constants */
 #define SOCKS4_VERSION      0x04
 #define SOCKS4_CMD_CONNECT  0x01
 #define SOCKS4_CMD_BIND     0x02
+#define SOCKS4_CMD_RESOLVE  0xF0    // Tor extension
 
-Error socks4_connect(NetSocket *sock, const char *dst_ip, uint16_t dst_port, const char *user_id, NetAddrType addr_type) {
-    uint32_t ip_n;
+/* Function Prototypes */
+static Error socks4_build(uint8_t *buf, size_t cap, uint8_t cmd, const char *dst_ip, uint16_t dst_port, const char *user_id, NetAddrType addr_type, size_t *out_len);
+static Error socks4_exchange(NetSocket *sock, const uint8_t *request, size_t len, uint8_t *reply, size_t *reply_len, int timeout_ms);
+
+Error socks4_build_connect(uint8_t *buf, size_t cap, const char *dst_ip, uint16_t dst_port, const char *user_id, NetAddrType addr_type, size_t *out_len) {
+    return socks4_build(buf, cap, SOCKS4_CMD_CONNECT, dst_ip, dst_port, user_id, addr_type, out_len);
+}
+
+Error socks4_build_resolve(uint8_t *buf, size_t cap, const char *host, const char *user_id, size_t *out_len) {
+    return socks4_build(buf, cap, SOCKS4_CMD_RESOLVE, host, 0, user_id, DOMAIN, out_len);
+}
+
+Error socks4_parse_reply(const uint8_t *reply, size_t len, const char *dst_ip, uint16_t dst_port) {
+    TRACE_INSTANT("socks", "reply", "code", len == SOCKS4_REPLY_LEN ? reply[1] : -1);
+    flight_record(FLIGHT_SOCKS_REPLY, -1, len, len == SOCKS4_REPLY_LEN ? reply[1] : -1);
+    if (len != SOCKS4_REPLY_LEN) {
+        return ERR_NEW(ERR_NET_RECV_FAILED, "Expected %d bytes in SOCKS4 response but received %zu", SOCKS4_REPLY_LEN, len);
+    }
+
+    if (reply[0] != 0x00 || reply[1] != SOCKS4_OK) {
+        return ERR_NEW(ERR_CONNECTION_FAILED, "SOCKS4 request rejected (VN=%d, CD=%d) for %s:%d", reply[0], reply[1], dst_ip, dst_port);
+    }
+
+    return ERR_OK();
+}
+
+Error socks4_connect(NetSocket *sock, const char *dst_ip, uint16_t dst_port, const char *user_id, NetAddrType addr_type, int timeout_ms) {
     size_t  offset = 0;
-    uint8_t response[8];
+    uint8_t response[SOCKS4_REPLY_LEN];
+    uint8_t request[512];
+    Error err = ERR_OK();
+
+    err = socks4_build_connect(request, sizeof(request), dst_ip, dst_port, user_id, addr_type, &offset);
+    if (ERR_FAILED(err))
+        return err;
+    
+    TRACE_BEGIN("socks", "handshake", "port", dst_port);
+    size_t bytes_received = 0;
+    err = socks4_exchange(sock, request, offset, response, &bytes_received, timeout_ms);
+    if (ERR_FAILED(err)) {
+        TRACE_END("socks", "handshake", "error", err.code);
+        return err;
+    }
+
+    err = socks4_parse_reply(response, bytes_received, dst_ip, dst_port);
+    TRACE_END("socks", "handshake", "error", err.code);
+    return err;
+}
+
+Error socks4_resolve(NetSocket *sock, const char *host, const char *user_id, int timeout_ms, uint32_t *addr) {
+    size_t  len = 0;
+    uint8_t response[SOCKS4_REPLY_LEN];
     uint8_t request[512];
+
+    Error err = socks4_build_resolve(request, sizeof(request), host, user_id, &len);
+    if (ERR_FAILED(err))
+        return err;
+
+    TRACE_BEGIN("socks", "resolve", "bytes", len);
+    size_t bytes_received = 0;
+    err = socks4_exchange(sock, request, len, response, &bytes_received, timeout_ms);
+    if (!ERR_FAILED(err)) {
+        err = socks4_parse_reply(response, bytes_received, host, 0);
+    }
+    TRACE_END("socks", "resolve", "error", err.code);
+    if (ERR_FAILED(err)) {
+        return ERR_PROPAGATE(err, "SOCKS4 RESOLVE of %s failed", host);
+    }
+
+    // The address comes back in DSTIP, already in network byte order
+    memcpy(addr, &response[4], sizeof(*addr));
+    return ERR_OK();
+}
+
+/* Internal helper functions */
+
+// Lay out a SOCKS4 request (SOCKS4a when addr_type is DOMAIN) for any command
+static Error socks4_build(uint8_t *buf, size_t cap, uint8_t cmd, const char *dst_ip, uint16_t dst_port, const char *user_id, NetAddrType addr_type, size_t *out_len) {
+    uint32_t ip_n;
+    size_t offset = 0;
+    size_t user_len = (user_id && user_id[0]) ? strlen(user_id) : 0;
+    size_t host_len = (addr_type == DOMAIN) ? strlen(dst_ip) : 0;
     Error err = ERR_OK();
 
-    request[offset++] = SOCKS4_VERSION;
-    request[offset++] = SOCKS4_CMD_CONNECT;
+    // VN + CD + DSTPORT + DSTIP + USERID + NUL + [HOST + NUL]
+    if (8 + user_len + 1 + host_len + 1 > cap) {
+        return ERR_NEW(ERR_INVALID_ADDRESS, "SOCKS4 request for '%s' exceeds %zu bytes", dst_ip, cap);
+    }
+
+    buf[offset++] = SOCKS4_VERSION;
+    buf[offset++] = cmd;
 
     uint16_t port_n = net_htons(dst_port);
-    memcpy(&request[offset], &port_n, sizeof(port_n));
+    memcpy(&buf[offset], &port_n, sizeof(port_n));
     offset += sizeof(port_n);
 
     if (addr_type == DOMAIN) {
@@ -41,41 +128,46 @@ Error socks4_connect(NetSocket *sock, const char *dst_ip, uint16_t dst_port, con
             return ERR_PROPAGATE(err, "SOCKS4 IP resolution failed");
     }
 
-    memcpy(&request[offset], &ip_n, sizeof(ip_n));
+    memcpy(&buf[offset], &ip_n, sizeof(ip_n));
     offset += sizeof(ip_n);
 
-    if (user_id && user_id[0]) {
-        size_t len = strlen(user_id);
-        memcpy(&request[offset], user_id, len);
-        offset += len;
+    if (user_len > 0) {
+        memcpy(&buf[offset], user_id, user_len);
+        offset += user_len;
     }
-    request[offset++] = '\0';
+    buf[offset++] = '\0';
 
     if (addr_type == DOMAIN) {
-        size_t host_len = strlen(dst_ip);
-        memcpy(&request[offset], dst_ip, host_len);
+        memcpy(&buf[offset], dst_ip, host_len);
         offset += host_len;
+        buf[offset++] = '\0';
     }
-    request[offset++] = '\0';
-    
-    err = net_send_all(sock, request, offset);
-    if (ERR_FAILED(err))
-        // Preserves: bytes sent, WSA error, etc.
-        return ERR_PROPAGATE(err, "Failed to send SOCKS4 CONNECT request (%zu bytes)", offset);
 
-    size_t bytes_received;
-    err = net_recv(sock, response, sizeof(response), &bytes_received);
+    *out_len = offset;
+    return err;
+}
+
+// Send a request and read the fixed-size reply; a short reply leaves *reply_len below SOCKS4_REPLY_LEN
+static Error socks4_exchange(NetSocket *sock, const uint8_t *request, size_t len, uint8_t *reply, size_t *reply_len, int timeout_ms) {
+    Error err = net_send_all_timed(sock, request, len, timeout_ms);
     if (ERR_FAILED(err)) {
-        return ERR_PROPAGATE(err, "Failed to receive SOCKS4 response");
-    }
-    
-    if (bytes_received != sizeof(response)) {
-        return ERR_NEW(ERR_NET_RECV_FAILED, "Expected 8 bytes in SOCKS4 response but received %zu", bytes_received);
+        // Preserves: bytes sent, WSA error, etc.
+        return ERR_PROPAGATE(err, "Failed to send SOCKS4 request (%zu bytes)", len);
     }
 
-    if (response[0] != 0x00 || response[1] != SOCKS4_OK) {
-        return ERR_NEW(ERR_CONNECTION_FAILED, "SOCKS4 request rejected (VN=%d, CD=%d) for %s:%d", response[0], response[1], dst_ip, dst_port);
+    size_t bytes_received = 0;
+    while (bytes_received < SOCKS4_REPLY_LEN) {
+        size_t n = 0;
+        err = net_recv_timed(sock, reply + bytes_received, SOCKS4_REPLY_LEN - bytes_received, &n, timeout_ms);
+        if (ERR_FAILED(err)) {
+            return ERR_PROPAGATE(err, "Failed to receive SOCKS4 response");
+        }
+        if (n == 0) {
+            break; // short reply: rejected by socks4_parse_reply
+        }
+        bytes_received += n;
     }
 
-    return err;
+    *reply_len = bytes_received;
+    return ERR_OK();
 }
@@ -5,15 +5,18 @@
     Reference:
         - SOCKS4 Protocol: https://www.openssh.org/txt/socks4.protocol
         - SOCKS4a Extension: https://www.openssh.org/txt/socks4a.protocol
+        - Tor SOCKS extensions: https://spec.torproject.org/socks-extensions.html
     Description:
         SOCKS4 client-side protocol implementation.
         Provides functionality to establish TCP connections
-        through a SOCKS4 proxy over an existing network socket.
+        through a SOCKS4 proxy over an existing network socket,
+        and to resolve hostnames with Tor's RESOLVE extension.
 */
 
 #ifndef TORILATE_SOCKS4_H
 #define TORILATE_SOCKS4_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include "net/socket.h"
 #include "error/error.h"
@@ -26,6 +29,9 @@ typedef enum {
     SOCKS4_IDENTD_MISMATCH   = 93
 } Socks4Status;
 
+/* Size of a SOCKS4 reply packet (VN, CD, DSTPORT, DSTIP) */
+#define SOCKS4_REPLY_LEN 8
+
 
 /*
  * Establish a SOCKS4 CONNECT tunnel.
@@ -35,6 +41,8 @@ typedef enum {
  *   dst_ip   - destination IPv4 address (dotted-decimal)
  *   dst_port - destination port (host byte order)
  *   user_id  - user ID string (may be NULL or empty)
+ *   timeout_ms - longest wait for the proxy, e.g. for the circuit to be
+ *                built before the reply (-1 = no limit; ERR_TIMEOUT on expiry)
  *
  * Returns:
  *   0 on success
@@ -44,6 +52,81 @@ Error socks4_connect(NetSocket *sock,
                    const char *dst_ip,
                    uint16_t dst_port,
                    const char *user_id,
-                   NetAddrType addr_type);
+                   NetAddrType addr_type,
+                   int timeout_ms);
+
+/*
+ * Build a SOCKS4/SOCKS4a CONNECT request without sending it.
+ * Used by callers that drive the handshake themselves (e.g. non-blocking I/O).
+ *
+ * Parameters:
+ *   buf       - output buffer
+ *   cap       - capacity of buf in bytes
+ *   dst_ip    - destination IPv4 address or hostname (SOCKS4a)
+ *   dst_port  - destination port (host byte order)
+ *   user_id   - user ID string (may be NULL or empty)
+ *   addr_type - address type of dst_ip
+ *   out_len   - receives the request length
+ *
+ * Returns:
+ *   ERR_OK on success, an Error if the request does not fit or dst_ip is invalid
+ */
+Error socks4_build_connect(uint8_t *buf,
+                           size_t cap,
+                           const char *dst_ip,
+                           uint16_t dst_port,
+                           const char *user_id,
+                           NetAddrType addr_type,
+                           size_t *out_len);
+
+/*
+ * Validate a SOCKS4 reply packet.
+ *
+ * Parameters:
+ *   reply    - reply bytes received from the proxy
+ *   len      - number of bytes in reply (must be SOCKS4_REPLY_LEN)
+ *   dst_ip   - destination used in the request (for error context)
+ *   dst_port - destination port used in the request (for error context)
+ *
+ * Returns:
+ *   ERR_OK if the proxy granted the request, ERR_CONNECTION_FAILED if rejected
+ */
+Error socks4_parse_reply(const uint8_t *reply,
+                         size_t len,
+                         const char *dst_ip,
+                         uint16_t dst_port);
+
+/*
+ * Build a Tor RESOLVE (command 0xF0) request: a SOCKS4a request for host
+ * whose reply carries the IPv4 address the exit resolved in DSTIP.
+ *
+ * Returns:
+ *   ERR_OK on success, an Error if the request does not fit
+ */
+Error socks4_build_resolve(uint8_t *buf,
+                           size_t cap,
+                           const char *host,
+                           const char *user_id,
+                           size_t *out_len);
+
+/*
+ * Resolve a hostname through Tor (RESOLVE). The proxy closes the
+ * connection after the reply, so sock is used up either way.
+ *
+ * Parameters:
+ *   sock       - connected socket to the Tor SOCKS port
+ *   host       - hostname to resolve at the exit
+ *   user_id    - user ID string (circuit isolation, may be NULL)
+ *   timeout_ms - longest wait for the proxy (-1 = no limit)
+ *   addr       - receives the IPv4 address in network byte order
+ *
+ * Returns:
+ *   ERR_OK on success, ERR_CONNECTION_FAILED if Tor could not resolve host
+ */
+Error socks4_resolve(NetSocket *sock,
+                     const char *host,
+                     const char *user_id,
+                     int timeout_ms,
+                     uint32_t *addr);
 
 #endif /* TORILATE_SOCKS4_H */
@@ -0,0 +1,471 @@
+/*
+    File: src/tor/control.c
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference:
+        - Tor control protocol: https://spec.torproject.org/control-spec/
+    Description:
+        Tor ControlPort client.
+
+        Replies are CRLF-terminated lines "NNN<sep>text": '-' continues
+        the reply, '+' starts a data block ending with a lone ".", and ' '
+        ends it. Status 650 marks an asynchronous event, which may arrive
+        between any two lines: events are parsed into a ring as they are
+        met, so a command never sees them and tor_control_next_event()
+        never misses one. All reads go through one line buffer with a
+        poll timeout, so a silent ControlPort fails with ERR_TIMEOUT
+        instead of hanging the caller.
+
+        SAFECOOKIE (HMAC challenge) is not implemented; Tor offers plain
+        COOKIE alongside it whenever CookieAuthentication is on.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include "tor/control.h"
+
+#define CONTROL_LINE_MAX    4096    // longer lines are cut (the rest is skipped)
+#define CONTROL_COOKIE_LEN  32
+
+struct TorControl {
+    NetSocket sock;
+    char buf[CONTROL_LINE_MAX];     // received, not yet consumed bytes
+    size_t buf_len;
+    TorEvent events[TOR_CONTROL_EVENTS_MAX];
+    size_t event_head;
+    size_t event_count;
+};
+
+/* Function Prototypes */
+static Error control_send(TorControl *ctl, const char *line);
+static Error control_read_line(TorControl *ctl, char *line, size_t cap, int timeout_ms);
+static Error control_read_reply(TorControl *ctl, TorControlReply *reply);
+static void reply_append(TorControlReply *reply, const char *text);
+static void event_push(TorControl *ctl, const char *line);
+static Error control_authenticate(TorControl *ctl, const char *password);
+static bool auth_offers(const char *methods, const char *method);
+static Error read_cookie(const char *path, char *hex, size_t cap);
+static void quote_string(const char *in, char *out, size_t cap);
+
+Error tor_control_parse_address(const char *spec, char *ip, size_t ip_cap, uint16_t *port) {
+    snprintf(ip, ip_cap, "%s", TOR_CONTROL_IP);
+    *port = TOR_CONTROL_PORT;
+    if (!spec || !spec[0]) {
+        return ERR_OK();
+    }
+
+    if (strncmp(spec, NET_UNIX_PREFIX, strlen(NET_UNIX_PREFIX)) == 0) {
+        // ControlPort unix:/path
+        if (!spec[strlen(NET_UNIX_PREFIX)] || strlen(spec) >= ip_cap) {
+            return ERR_NEW(ERR_INVALID_ADDRESS, "Invalid Unix socket ControlPort '%s'", spec);
+        }
+        snprintf(ip, ip_cap, "%s", spec);
+        *port = 0;
+        return ERR_OK();
+    }
+
+    const char *colon = strrchr(spec, ':');
+    const char *port_str = colon ? colon + 1 : spec;
+    if (!colon && strspn(spec, "0123456789") != strlen(spec)) {
+        snprintf(ip, ip_cap, "%s", spec);   // host only
+        return ERR_OK();
+    }
+    if (colon) {
+        size_t host_len = (size_t)(colon - spec);
+        if (host_len >= ip_cap) {
+            return ERR_NEW(ERR_INVALID_ADDRESS, "ControlPort host too long: %s", spec);
+        }
+        if (host_len > 0) {
+            memcpy(ip, spec, host_len);
+            ip[host_len] = '\0';
+        }
+    }
+
+    char *end = NULL;
+    long value = strtol(port_str, &end, 10);
+    if (end == port_str || *end != '\0' || value < 1 || value > 65535) {
+        return ERR_NEW(ERR_INVALID_ADDRESS, "Invalid ControlPort port in '%s'", spec);
+    }
+    *port = (uint16_t)value;
+    return ERR_OK();
+}
+
+Error tor_control_open(const char *ip, uint16_t port, const char *password, TorControl **out) {
+    TorControl *ctl = calloc(1, sizeof(TorControl));
+    if (!ctl) {
+        return ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate ControlPort connection");
+    }
+    ctl->sock = INVALID_SOCKET;
+
+    Error err = net_connect_timed(&ctl->sock, ip, port, TOR_CONTROL_TIMEOUT_MS);
+    if (ERR_FAILED(err)) {
+        free(ctl);
+        return ERR_PROPAGATE(err, "Cannot connect to the Tor ControlPort at %s:%d", ip, port);
+    }
+
+    err = control_authenticate(ctl, password);
+    if (ERR_FAILED(err)) {
+        tor_control_close(ctl);
+        return ERR_PROPAGATE(err, "Tor ControlPort authentication at %s:%d failed", ip, port);
+    }
+
+    *out = ctl;
+    return ERR_OK();
+}
+
+void tor_control_close(TorControl *ctl) {
+    if (!ctl) {
+        return;
+    }
+    if (is_valid_socket(&ctl->sock)) {
+        control_send(ctl, "QUIT");  // best effort: Tor closes the connection after it
+    }
+    net_close(&ctl->sock);
+    free(ctl);
+}
+
+Error tor_control_command(TorControl *ctl, TorControlReply *reply, const char *fmt, ...) {
+    char line[CONTROL_LINE_MAX];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    if (n < 0 || (size_t)n >= sizeof(line)) {
+        return ERR_NEW(ERR_INVALID_ARGS, "ControlPort command too long");
+    }
+
+    Error err = control_send(ctl, line);
+    if (!ERR_FAILED(err)) {
+        err = control_read_reply(ctl, reply);
+    }
+    if (ERR_FAILED(err)) {
+        return ERR_PROPAGATE(err, "ControlPort command '%.32s' failed", line);
+    }
+    if (reply->status != 250) {
+        return ERR_NEW(ERR_TOR_CONTROL_FAILED, "'%.32s' refused: %d %.200s", line, reply->status, reply->text);
+    }
+    return ERR_OK();
+}
+
+Error tor_control_getinfo(TorControl *ctl, const char *key, char *out, size_t cap) {
+    TorControlReply *reply = malloc(sizeof(TorControlReply));
+    if (!reply) {
+        return ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate ControlPort reply");
+    }
+    Error err = tor_control_command(ctl, reply, "GETINFO %s", key);
+    if (ERR_FAILED(err)) {
+        free(reply);
+        return err;
+    }
+
+    // "key=value" on the first line, or "key=" and a data block; the reply ends with "OK"
+    if (reply->len >= 3 && strcmp(reply->text + reply->len - 3, "\nOK") == 0) {
+        reply->len -= 3;
+        reply->text[reply->len] = '\0';
+    }
+    size_t key_len = strlen(key);
+    const char *value = reply->text;
+    if (strncmp(value, key, key_len) == 0 && value[key_len] == '=') {
+        value += key_len + 1;
+        if (*value == '\n') {
+            value++;
+        }
+    }
+    size_t len = strlen(value);
+    if (len >= cap) {
+        len = cap > 0 ? cap - 1 : 0;
+    }
+    if (cap > 0) {
+        memcpy(out, value, len);
+        out[len] = '\0';
+    }
+    free(reply);
+    return ERR_OK();
+}
+
+Error tor_control_newnym(TorControl *ctl) {
+    TorControlReply reply;
+    return tor_control_command(ctl, &reply, "SIGNAL NEWNYM");
+}
+
+Error tor_control_subscribe(TorControl *ctl, const char *events) {
+    TorControlReply reply;
+    return tor_control_command(ctl, &reply, "SETEVENTS %s", events);
+}
+
+Error tor_control_next_event(TorControl *ctl, int timeout_ms, TorEvent *out, bool *got) {
+    *got = false;
+    while (ctl->event_count == 0) {
+        char line[CONTROL_LINE_MAX];
+        Error err = control_read_line(ctl, line, sizeof(line), timeout_ms);
+        if (err.code == ERR_TIMEOUT) {
+            return ERR_OK();
+        }
+        if (ERR_FAILED(err)) {
+            return err;
+        }
+        if (strncmp(line, "650", 3) != 0) {
+            continue;   // stray reply line, no command is waiting for it
+        }
+        event_push(ctl, line);
+    }
+
+    *out = ctl->events[ctl->event_head];
+    ctl->event_head = (ctl->event_head + 1) % TOR_CONTROL_EVENTS_MAX;
+    ctl->event_count--;
+    *got = true;
+    return ERR_OK();
+}
+
+Error tor_control_attach_stream(TorControl *ctl, uint32_t stream, uint32_t circuit) {
+    TorControlReply reply;
+    return tor_control_command(ctl, &reply, "ATTACHSTREAM %u %u", stream, circuit);
+}
+
+Error tor_control_circuits(TorControl *ctl, TorCircuitCounts *out) {
+    memset(out, 0, sizeof(*out));
+    char *status = malloc(TOR_CONTROL_REPLY_MAX);
+    if (!status) {
+        return ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate circuit status");
+    }
+    Error err = tor_control_getinfo(ctl, "circuit-status", status, TOR_CONTROL_REPLY_MAX);
+    if (ERR_FAILED(err)) {
+        free(status);
+        return err;
+    }
+
+    // One circuit per line: "<id> <status> [<path>] [<key>=<value> ...]"
+    for (char *line = status; line && *line; ) {
+        char *next = strchr(line, '\n');
+        if (next) {
+            *next++ = '\0';
+        }
+        char state[24] = {0};
+        if (sscanf(line, "%*u %23s", state) == 1) {
+            if (strcmp(state, "BUILT") == 0) {
+                out->built++;
+            } else if (strcmp(state, "FAILED") == 0) {
+                out->failed++;
+            } else if (strcmp(state, "CLOSED") == 0) {
+                out->closed++;
+            } else {
+                out->launched++;
+            }
+        }
+        line = next;
+    }
+    free(status);
+    return ERR_OK();
+}
+
+/* Internal helper functions */
+
+static Error control_send(TorControl *ctl, const char *line) {
+    char msg[CONTROL_LINE_MAX + 2];
+    int n = snprintf(msg, sizeof(msg), "%s\r\n", line);
+    if (n < 0 || (size_t)n >= sizeof(msg)) {
+        return ERR_NEW(ERR_INVALID_ARGS, "ControlPort command too long");
+    }
+    return net_send_all_timed(&ctl->sock, msg, (size_t)n, TOR_CONTROL_TIMEOUT_MS);
+}
+
+// Next line without its CRLF; ERR_TIMEOUT when none is complete within timeout_ms
+static Error control_read_line(TorControl *ctl, char *line, size_t cap, int timeout_ms) {
+    for (;;) {
+        char *eol = memchr(ctl->buf, '\n', ctl->buf_len);
+        if (eol || ctl->buf_len == sizeof(ctl->buf)) {
+            size_t used = eol ? (size_t)(eol - ctl->buf) + 1 : ctl->buf_len;
+            size_t len = eol ? (size_t)(eol - ctl->buf) : ctl->buf_len;
+            if (len > 0 && ctl->buf[len - 1] == '\r') {
+                len--;
+            }
+            if (len >= cap) {
+                len = cap - 1;
+            }
+            memcpy(line, ctl->buf, len);
+            line[len] = '\0';
+            memmove(ctl->buf, ctl->buf + used, ctl->buf_len - used);
+            ctl->buf_len -= used;
+            return ERR_OK();
+        }
+
+        size_t n = 0;
+        Error err = net_recv_timed(&ctl->sock, ctl->buf + ctl->buf_len, sizeof(ctl->buf) - ctl->buf_len, &n, timeout_ms);
+        if (ERR_FAILED(err)) {
+            return err;
+        }
+        if (n == 0) {
+            return ERR_NEW(ERR_NET_RECV_FAILED, "ControlPort closed the connection");
+        }
+        ctl->buf_len += n;
+    }
+}
+
+static Error control_read_reply(TorControl *ctl, TorControlReply *reply) {
+    reply->status = 0;
+    reply->len = 0;
+    reply->text[0] = '\0';
+
+    char line[CONTROL_LINE_MAX];
+    for (;;) {
+        Error err = control_read_line(ctl, line, sizeof(line), TOR_CONTROL_TIMEOUT_MS);
+        if (ERR_FAILED(err)) {
+            return err;
+        }
+        if (strlen(line) < 4 || strspn(line, "0123456789") < 3) {
+            return ERR_NEW(ERR_BAD_RESPONSE, "Malformed ControlPort line: %.64s", line);
+        }
+        if (strncmp(line, "650", 3) == 0) {
+            event_push(ctl, line);   // asynchronous; multi-line events keep their first line only
+            continue;
+        }
+
+        reply->status = atoi(line);
+        reply_append(reply, line + 4);
+        if (line[3] == '+') {
+            // Data block up to a lone "."; a leading ".." stands for "."
+            for (;;) {
+                err = control_read_line(ctl, line, sizeof(line), TOR_CONTROL_TIMEOUT_MS);
+                if (ERR_FAILED(err)) {
+                    return err;
+                }
+                if (strcmp(line, ".") == 0) {
+                    break;
+                }
+                reply_append(reply, line[0] == '.' ? line + 1 : line);
+            }
+        } else if (line[3] == ' ') {
+            return ERR_OK();
+        }
+    }
+}
+
+static void reply_append(TorControlReply *reply, const char *text) {
+    int n = snprintf(reply->text + reply->len, sizeof(reply->text) - reply->len, "%s%s", reply->len > 0 ? "\n" : "", text);
+    if (n > 0) {
+        reply->len += (size_t)n;
+        if (reply->len >= sizeof(reply->text)) {
+            reply->len = sizeof(reply->text) - 1;   // cut
+        }
+    }
+}
+
+// Parse "650 CIRC <id> <status> ..." / "650 STREAM <id> <status> <circuit> <target> ..." into the ring
+static void event_push(TorControl *ctl, const char *line) {
+    if (ctl->event_count == TOR_CONTROL_EVENTS_MAX) {
+        ctl->event_head = (ctl->event_head + 1) % TOR_CONTROL_EVENTS_MAX;   // drop the oldest
+        ctl->event_count--;
+    }
+    TorEvent *ev = &ctl->events[(ctl->event_head + ctl->event_count) % TOR_CONTROL_EVENTS_MAX];
+    ctl->event_count++;
+
+    memset(ev, 0, sizeof(*ev));
+    snprintf(ev->line, sizeof(ev->line), "%s", line + 4);
+    ev->type = TOR_EVENT_OTHER;
+
+    unsigned int id = 0, circuit = 0;
+    if (sscanf(ev->line, "CIRC %u %23s", &id, ev->status) == 2) {
+        ev->type = TOR_EVENT_CIRC;
+        ev->id = id;
+    } else if (sscanf(ev->line, "STREAM %u %23s %u %255s", &id, ev->status, &circuit, ev->target) >= 3) {
+        ev->type = TOR_EVENT_STREAM;
+        ev->id = id;
+        ev->circuit = circuit;
+    }
+}
+
+static Error control_authenticate(TorControl *ctl, const char *password) {
+    TorControlReply *reply = malloc(sizeof(TorControlReply));
+    if (!reply) {
+        return ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate ControlPort reply");
+    }
+
+    Error err = tor_control_command(ctl, reply, "PROTOCOLINFO 1");
+    if (ERR_FAILED(err)) {
+        goto exit_auth;
+    }
+
+    // AUTH METHODS=COOKIE,SAFECOOKIE,HASHEDPASSWORD COOKIEFILE="/run/tor/control.authcookie"
+    char methods[128] = {0};
+    char cookie_file[512] = {0};
+    const char *auth = strstr(reply->text, "AUTH METHODS=");
+    if (auth) {
+        sscanf(auth, "AUTH METHODS=%127s", methods);
+        const char *cookie = strstr(auth, "COOKIEFILE=\"");
+        if (cookie) {
+            sscanf(cookie, "COOKIEFILE=\"%511[^\"]\"", cookie_file);
+        }
+    }
+
+    if (auth_offers(methods, "NULL")) {
+        err = tor_control_command(ctl, reply, "AUTHENTICATE");
+    } else if (password && auth_offers(methods, "HASHEDPASSWORD")) {
+        char quoted[512];
+        quote_string(password, quoted, sizeof(quoted));
+        err = tor_control_command(ctl, reply, "AUTHENTICATE %s", quoted);
+    } else if (auth_offers(methods, "COOKIE") && cookie_file[0]) {
+        char hex[CONTROL_COOKIE_LEN * 2 + 1];
+        err = read_cookie(cookie_file, hex, sizeof(hex));
+        if (!ERR_FAILED(err)) {
+            err = tor_control_command(ctl, reply, "AUTHENTICATE %s", hex);
+        }
+    } else {
+        err = ERR_NEW(ERR_TOR_CONTROL_FAILED, "No usable authentication method (offered: %s%s)",
+                      methods[0] ? methods : "none",
+                      auth_offers(methods, "HASHEDPASSWORD") && !password ? "; set TORILATE_CONTROL_PASSWORD" : "");
+    }
+
+exit_auth:
+    free(reply);
+    return err;
+}
+
+// Whether a comma-separated METHODS list contains method
+static bool auth_offers(const char *methods, const char *method) {
+    size_t len = strlen(method);
+    for (const char *p = methods; *p; ) {
+        const char *comma = strchr(p, ',');
+        size_t item = comma ? (size_t)(comma - p) : strlen(p);
+        if (item == len && strncmp(p, method, len) == 0) {
+            return true;
+        }
+        if (!comma) {
+            break;
+        }
+        p = comma + 1;
+    }
+    return false;
+}
+
+static Error read_cookie(const char *path, char *hex, size_t cap) {
+    unsigned char cookie[CONTROL_COOKIE_LEN];
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return ERR_NEW(ERR_FILE_NOT_FOUND, "Cannot read the Tor auth cookie %s", path);
+    }
+    size_t n = fread(cookie, 1, sizeof(cookie), file);
+    fclose(file);
+    if (n != sizeof(cookie) || cap < sizeof(cookie) * 2 + 1) {
+        return ERR_NEW(ERR_IO, "Tor auth cookie %s is not %d bytes", path, CONTROL_COOKIE_LEN);
+    }
+    for (size_t i = 0; i < n; i++) {
+        snprintf(hex + i * 2, 3, "%02x", cookie[i]);
+    }
+    return ERR_OK();
+}
+
+// Control protocol QuotedString: "..." with backslash escapes
+static void quote_string(const char *in, char *out, size_t cap) {
+    size_t o = 0;
+    out[o++] = '"';
+    for (; *in && o + 3 < cap; in++) {
+        if (*in == '"' || *in == '\\') {
+            out[o++] = '\\';
+        }
+        out[o++] = *in;
+    }
+    out[o++] = '"';
+    out[o] = '\0';
+}
@@ -0,0 +1,122 @@
+/*
+    File: src/tor/control.h
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference:
+        - Tor control protocol: https://spec.torproject.org/control-spec/
+    Description:
+        Client side of the Tor control protocol (ControlPort).
+        Authenticates with whatever PROTOCOLINFO offers that the client
+        can do (no auth, HASHEDPASSWORD, COOKIE), then sends commands
+        and reads their replies: GETINFO, SIGNAL NEWNYM, SETEVENTS and
+        ATTACHSTREAM. Asynchronous CIRC and STREAM events that arrive
+        while a reply is awaited are queued for tor_control_next_event().
+
+        A handle is not thread-safe; one thread drives it.
+*/
+
+#ifndef TORILATE_TOR_CONTROL_H
+#define TORILATE_TOR_CONTROL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "net/socket.h"
+#include "error/error.h"
+
+#define TOR_CONTROL_IP          "127.0.0.1"
+#define TOR_CONTROL_PORT        9051
+#define TOR_CONTROL_TIMEOUT_MS  10000   // longest wait for a reply
+#define TOR_CONTROL_REPLY_MAX   16384   // reply text kept, longer replies are cut
+#define TOR_CONTROL_EVENTS_MAX  64      // queued events, the oldest are dropped
+
+/* Opaque control connection */
+typedef struct TorControl TorControl;
+
+/* Reply to a command: the lines without their status prefixes, joined by '\n' */
+typedef struct TorControlReply {
+    int status;                         // 250 on success
+    char text[TOR_CONTROL_REPLY_MAX];
+    size_t len;
+} TorControlReply;
+
+typedef enum {
+    TOR_EVENT_CIRC,     // circuit status change: id = circuit, status e.g. LAUNCHED, BUILT, FAILED, CLOSED
+    TOR_EVENT_STREAM,   // stream status change: id = stream, circuit = attached circuit (0 = none)
+    TOR_EVENT_OTHER,
+} TorEventType;
+
+/* Asynchronous (650) event */
+typedef struct TorEvent {
+    TorEventType type;
+    uint32_t id;
+    uint32_t circuit;
+    char status[24];
+    char target[256];   // STREAM: host:port
+    char line[512];     // the event line as received
+} TorEvent;
+
+/* Circuits by status, from GETINFO circuit-status */
+typedef struct TorCircuitCounts {
+    size_t launched;    // being built (LAUNCHED, EXTENDED, GUARD_WAIT)
+    size_t built;
+    size_t failed;
+    size_t closed;
+} TorCircuitCounts;
+
+
+/*
+ * Parse "host:port", "port" or "host" (defaults TOR_CONTROL_IP and TOR_CONTROL_PORT),
+ * or "unix:/path" (*port set to 0).
+ *
+ *  @return ERR_INVALID_ADDRESS when the port is not a number in 1..65535
+ */
+Error tor_control_parse_address(const char *spec, char *ip, size_t ip_cap, uint16_t *port);
+
+/*
+ * Connect to a ControlPort and authenticate.
+ *
+ *  @param ip        ControlPort address
+ *  @param port      ControlPort port
+ *  @param password  password for HASHEDPASSWORD auth (may be NULL)
+ *  @param out       receives the handle
+ *
+ *  @return ERR_OK, ERR_TOR_CONTROL_FAILED when no offered method works,
+ *          or a network error
+ */
+Error tor_control_open(const char *ip, uint16_t port, const char *password, TorControl **out);
+
+/* Close the connection (NULL is ignored) */
+void tor_control_close(TorControl *ctl);
+
+/*
+ * Send a command (without the trailing CRLF) and read its reply.
+ *
+ *  @return ERR_TOR_CONTROL_FAILED when the reply status is not 250 (reply is still filled)
+ */
+Error tor_control_command(TorControl *ctl, TorControlReply *reply, const char *fmt, ...);
+
+/* GETINFO key: copy the value (a multi-line value keeps its newlines) into out */
+Error tor_control_getinfo(TorControl *ctl, const char *key, char *out, size_t cap);
+
+/* SIGNAL NEWNYM: new streams get new circuits (Tor rate-limits it to once per 10 s) */
+Error tor_control_newnym(TorControl *ctl);
+
+/* SETEVENTS: subscribe to events, e.g. "CIRC STREAM" ("" unsubscribes) */
+Error tor_control_subscribe(TorControl *ctl, const char *events);
+
+/*
+ * Next queued or incoming event.
+ *
+ *  @param timeout_ms  longest wait (0 = only what is already buffered, -1 = no limit)
+ *  @param got         set to false when none arrived in time
+ */
+Error tor_control_next_event(TorControl *ctl, int timeout_ms, TorEvent *out, bool *got);
+
+/* ATTACHSTREAM: put a stream Tor left unattached (__LeaveStreamsUnattached) on a circuit */
+Error tor_control_attach_stream(TorControl *ctl, uint32_t stream, uint32_t circuit);
+
+/* Count circuits by status (GETINFO circuit-status) */
+Error tor_control_circuits(TorControl *ctl, TorCircuitCounts *out);
+
+#endif
@@ -15,18 +15,36 @@
 #include "cli/cli.h"
 #include "util/util.h"
 #include "http/http.h"
+#include "http/http_stream.h"
+#include "http/http_cache.h"
+#include "http/http_retry.h"
+#include "http/http_proxy.h"
 #include "net/socket.h"
 #include "error/error.h"
 #include "socks/socks4.h"
+#include "batch/batch.h"
+#include "bench/bench.h"
+#include "diag/trace.h"
+#include "diag/flight.h"
+#include "diag/perf.h"
 
 #include <stdbool.h>
 
+/* Function Prototypes */
+static HttpRequest cli_request(const CliArgsInfo *args, HttpMethod method, const char *body);
+static Error stream_response(const CliArgsInfo *args, HttpMethod method, const char *body, HttpResponse *resp);
+static Error stream_to_file(void *ctx, const char *data, size_t len);
+static void report_timing(const CliArgsInfo *args, const HttpResponse *resp);
+static void write_stdout(const char *data, size_t len);
 
 int main(int argc, char *argv[]) {
     // Variable Declarations (initialized to default values or NULL)
     Error error = {0};
     CliArgsInfo args = {0};
 
+    TRACE_INIT(); // no-op unless built with TORILATE_TRACE
+    perf_init();  // no-op unless TORILATE_PERF is set
+
     // Argument validation (temporary)
     if (argc == 2 && (strcmp(argv[1], "help") == 0)) {
         get_help();
@@ -40,14 +58,39 @@ int main(int argc, char *argv[]) {
     
     // Extract flags and values for easier access
     bool raw = args.flags[FLAG_RAW] == true;
-    bool follow = args.flags[FLAG_FOLLOW] == true;
     bool content_only = args.flags[FLAG_CONTENT_ONLY] == true;
     
-    int max_redirects = args.values[VAL_MAX_REDIRECTS];
-    
     net_init(); // Initialize networking subsystem
 
+    if (args.options[OPTION_SOCKET]) {
+        NetSockOpts sockopts;
+        error = net_sockopts_parse(args.options[OPTION_SOCKET], &sockopts);
+        if (ERR_FAILED(error)) {
+            goto cleanUp;
+        }
+        net_set_sockopts(&sockopts);
+    }
+
+    if (args.multi_options[MULTI_OPTION_PROXIES].count > 0) {
+        error = http_set_proxies(args.multi_options[MULTI_OPTION_PROXIES].values, args.multi_options[MULTI_OPTION_PROXIES].count);
+        if (ERR_FAILED(error)) {
+            goto cleanUp;
+        }
+        if (http_proxy_count() > 1) {
+            http_proxy_check(); // start without the endpoints that are down
+        }
+    }
+
+    if (args.options[OPTION_CACHE_DIR]) {
+        error = http_cache_open(args.options[OPTION_CACHE_DIR]);
+        if (ERR_FAILED(error)) {
+            error = ERR_PROPAGATE(error, "Failed to open response cache %s", args.options[OPTION_CACHE_DIR]);
+            goto cleanUp;
+        }
+    }
+
     // Send HTTP request based on command
+    HttpRequest req;
     HttpResponse resp;
     size_t resp_size = 0;
     char *body_owned = NULL; // owns memory (if allocated)
@@ -56,7 +99,17 @@ int main(int argc, char *argv[]) {
 
     switch (args.cmd) {
         case CMD_GET:
-            error = http_get(args.uri, args.multi_options[MULTI_OPTION_HEADERS].values, args.multi_options[MULTI_OPTION_HEADERS].count, follow, max_redirects, &resp);
+            if (args.flags[FLAG_STREAM]) {
+                error = stream_response(&args, HTTP_METHOD_GET, NULL, &resp);
+                if (ERR_FAILED(error)) {
+                    error = ERR_PROPAGATE(error, "HTTP GET request to URL '%s' failed", args.uri);
+                    goto cleanUp;
+                }
+                break;
+            }
+
+            req = cli_request(&args, HTTP_METHOD_GET, NULL);
+            error = http_perform(&req, &resp);
             if (ERR_FAILED(error)) {
                 error = ERR_PROPAGATE(error, "HTTP GET request to URL '%s' failed", args.uri);
                 goto cleanUp;
@@ -79,7 +132,7 @@ int main(int argc, char *argv[]) {
                 printf("%s: Response written to %s\n", PROG_NAME, args.options[OPTION_OUTPUT_FILE]);
                 break;
             } else {
-                fwrite(parsed_response, 1, resp_size, stdout);
+                write_stdout(parsed_response, resp_size);
             }
             break;
 
@@ -96,13 +149,25 @@ int main(int argc, char *argv[]) {
                 body = args.options[OPTION_BODY];
             }
 
-            error = http_post(args.uri, body, args.multi_options[MULTI_OPTION_HEADERS].values, args.multi_options[MULTI_OPTION_HEADERS].count, follow, max_redirects, &resp);
+            if (args.flags[FLAG_STREAM]) {
+                error = stream_response(&args, HTTP_METHOD_POST, body, &resp);
+                ut_free(body_owned);
+                if (ERR_FAILED(error)) {
+                    error = ERR_PROPAGATE(error, "HTTP POST request to URL '%s' failed", args.uri);
+                    error.code = ERR_HTTP_REQUEST_FAILED;
+                    goto cleanUp;
+                }
+                break;
+            }
+
+            req = cli_request(&args, HTTP_METHOD_POST, body);
+            error = http_perform(&req, &resp);
             if (ERR_FAILED(error)) {
                 error = ERR_PROPAGATE(error, "HTTP POST request to URL '%s' failed", args.uri);
                 error.code = ERR_HTTP_REQUEST_FAILED;
                 goto cleanUp;
             }
-            free(body_owned); // free if allocated
+            ut_free(body_owned); // free if allocated
 
             // Parse response
             error = parse_http_response(&resp, parsed_response, sizeof(parsed_response), &resp_size, raw, content_only);
@@ -121,10 +186,20 @@ int main(int argc, char *argv[]) {
                 printf("%s: Response written to %s\n", PROG_NAME, args.options[OPTION_OUTPUT_FILE]);
                 break;
             } else {
-                fwrite(parsed_response, 1, resp_size, stdout);
+                write_stdout(parsed_response, resp_size);
             }
             break;
 
+        case CMD_BATCH:
+            flight_install_signal(); // `kill -USR1` dumps the flight recorder mid-run
+            error = batch_run(&args);
+            goto cleanUp;
+
+        case CMD_BENCH:
+            flight_install_signal();
+            error = bench_run(&args);
+            goto cleanUp;
+
         default:
             error = ERR_NEW(ERR_INVALID_COMMAND, "Unsupported command");
             goto cleanUp;
@@ -134,14 +209,29 @@ int main(int argc, char *argv[]) {
         printf("\n");
         printf("%s: Request to URL '%s' completed successfully\n", PROG_NAME, args.uri);
         printf("%s: Status Code: %d, Bytes Received: %llu\n", PROG_NAME, resp.status_code, resp.bytes_received);
+        print_timing_breakdown(&resp);
+
+        HttpRetryStats retries;
+        http_retry_stats(&retries);
+        if (retries.retries > 0) {
+            printf("%s: Retried %llu time(s) on a new circuit\n", PROG_NAME, (unsigned long long)retries.retries);
+        }
     }
+    report_timing(&args, &resp);
     
 cleanUp:
+    http_cache_close();
     net_cleanup();
+    // Read before cleanup_args() zeroes the arguments
+    bool verbose = args.flags[FLAG_VERBOSE];
+    bool memory_report = verbose && args.cmd != CMD_BENCH;    // bench prints its own
     cleanup_args(&args);
+    if (memory_report && error.code == SUCCESS) {
+        // Live bytes here are leaks: everything tracked has been released
+        print_memory_report();
+    }
 
     // Print error message
-    bool verbose = args.flags[FLAG_VERBOSE];
     if (error.code >= ERR_NO_ARGS && error.code <= ERR_INVALID_COMMAND) {
         // CLI errors: always print full message (verbose or not)
         verbose = true;
@@ -149,6 +239,105 @@ cleanUp:
     if (error.code != SUCCESS) {
         printf("%s\n", get_err_msg(&error, verbose));
     }
+    if (error.code > ERR_INVALID_COMMAND) {
+        // Runtime failure: replay the events that led to it
+        fflush(stdout);
+        flight_dump();
+    }
 
     return error.code;
-}
\ No newline at end of file
+}
+
+/* Internal helper functions */
+
+// Describe the GET/POST given on the command line
+static HttpRequest cli_request(const CliArgsInfo *args, HttpMethod method, const char *body) {
+    HttpRequest req = {
+        .method           = method,
+        .uri              = args->uri,
+        .body             = body,
+        .headers          = args->multi_options[MULTI_OPTION_HEADERS].values,
+        .headers_count    = args->multi_options[MULTI_OPTION_HEADERS].count,
+        .follow_redirects = args->flags[FLAG_FOLLOW],
+        .max_redirects    = args->values[VAL_MAX_REDIRECTS],
+        .max_retries      = args->values[VAL_RETRIES],
+        .timeouts         = get_timeouts(args),
+    };
+    return req;
+}
+
+// Stream the response of a GET/POST straight to the output file or stdout
+static Error stream_response(const CliArgsInfo *args, HttpMethod method, const char *body, HttpResponse *resp) {
+    Error err = ERR_OK();
+    FILE *out = stdout;
+    const char *output_file = args->options[OPTION_OUTPUT_FILE];
+
+    HttpRequest req = cli_request(args, method, body);
+
+    HttpStreamMode mode = HTTP_STREAM_FORMATTED;
+    if (args->flags[FLAG_RAW]) {
+        mode = HTTP_STREAM_RAW;
+    } else if (args->flags[FLAG_CONTENT_ONLY]) {
+        mode = HTTP_STREAM_CONTENT;
+    }
+
+    if (output_file) {
+        err = open_for_write(output_file, &out);
+        if (ERR_FAILED(err)) {
+            return ERR_PROPAGATE(err, "Failed to open output file %s", output_file);
+        }
+    }
+
+    HttpStreamSink sink = { .write = stream_to_file, .ctx = out };
+    err = http_stream(&req, mode, sink, resp);
+
+    if (output_file) {
+        if (fclose(out) != 0 && !ERR_FAILED(err)) {
+            err = ERR_NEW(ERR_IO, "Failed to write response to file %s", output_file);
+        }
+        if (!ERR_FAILED(err)) {
+            printf("%s: Response written to %s\n", PROG_NAME, output_file);
+        }
+    } else {
+        fflush(stdout);
+    }
+
+    return err;
+}
+
+static Error stream_to_file(void *ctx, const char *data, size_t len) {
+    if (fwrite(data, 1, len, (FILE *)ctx) != len) {
+        return ERR_NEW(ERR_IO, "Short write while streaming response");
+    }
+    return ERR_OK();
+}
+
+// Print the --write-out template for a completed GET/POST
+static void report_timing(const CliArgsInfo *args, const HttpResponse *resp) {
+    const char *tmpl = args->options[OPTION_WRITE_OUT];
+    if (!tmpl) {
+        return;
+    }
+
+    // Body bytes: everything received after the header section
+    uint64_t size_download = resp->bytes_received;
+    const char *header_end = strstr(resp->raw, "\r\n\r\n");
+    if (header_end) {
+        uint64_t header_len = (uint64_t)(header_end - resp->raw) + 4;
+        size_download = size_download > header_len ? size_download - header_len : 0;
+    }
+
+    char out[4096];
+    WriteOutInfo info = { .url = args->uri, .response = resp, .size_download = size_download };
+    size_t len = format_write_out(tmpl, &info, out, sizeof(out));
+    fwrite(out, 1, len, stdout);
+    fflush(stdout);
+}
+
+// Response body to stdout, charged to the output phase of the perf counters
+static void write_stdout(const char *data, size_t len) {
+    PerfMark mark;
+    perf_begin(&mark);
+    fwrite(data, 1, len, stdout);
+    perf_end(PERF_OUTPUT, &mark);
+}
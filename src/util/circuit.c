@@ -0,0 +1,514 @@
+/*
+    File: src/util/circuit.c
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference:
+        - Tor IsolateSOCKSAuth: https://2019.www.torproject.org/docs/tor-manual.html.en#SocksPort
+        - Exponentially weighted moving average: https://en.wikipedia.org/wiki/Moving_average
+    Description:
+        Pool of circuits, scored by a background prober.
+
+        Tor puts streams with different SOCKS usernames on different
+        circuits, so each slot of the pool is an isolation token standing
+        for one circuit. Every CIRCUIT_PROBE_INTERVAL_MS a prober thread
+        fetches the probe URL over all tokens at once (on a private multi
+        handle) and folds two measurements into an EWMA per slot: the
+        SOCKS reply time (circuit build and stream attach) and the
+        transfer time (request written to last byte). Their sum is the
+        slot's score.
+
+        circuit_pool_acquire() leases the slot with the lowest expected
+        cost, score * (outstanding leases + 1), so the fastest circuits
+        get most requests without all of them piling onto one. Unprobed
+        slots are expected to score the pool median.
+
+        A slot is retired, i.e. given a new token so that Tor builds a new
+        circuit for it, after CIRCUIT_RETIRE_STREAK probe rounds scoring
+        more than CIRCUIT_RETIRE_FACTOR times the median, or after
+        CIRCUIT_RETIRE_FAILURES consecutive failures (probes or requests
+        that failed on the circuit). When the whole pool degrades (the
+        median stays above CIRCUIT_NEWNYM_FACTOR times the best median
+        seen for CIRCUIT_RETIRE_STREAK rounds) every slot is retired.
+
+        With a ControlPort connection (circuit_pool_control) the prober
+        also reads Tor's circuit-build state after each round and sends
+        SIGNAL NEWNYM along with a pool-wide rotation. The connection is
+        only used from the prober thread; if it fails it is dropped and
+        probing goes on without it. On Windows there is no prober and
+        leases only balance the outstanding requests.
+*/
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L     // clock_gettime, pthread_cond_timedwait
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util/util.h"
+#include "http/http_multi.h"
+#include "diag/trace.h"
+#include "tor/control.h"
+
+#ifndef _WIN32
+#include <time.h>
+#include <pthread.h>
+#define CIRCUIT_LOCK(pool)      pthread_mutex_lock(&(pool)->lock)
+#define CIRCUIT_UNLOCK(pool)    pthread_mutex_unlock(&(pool)->lock)
+#else
+#define CIRCUIT_LOCK(pool)      ((void)0)
+#define CIRCUIT_UNLOCK(pool)    ((void)0)
+#endif
+
+#define CIRCUIT_PROBE_INTERVAL_MS   5000    // pause between probe rounds
+#define CIRCUIT_PROBE_POLL_MS       100     // how often a probe round checks for shutdown
+#define CIRCUIT_PROBE_TIMEOUT_MS    15000   // a probe taking longer counts as failed
+#define CIRCUIT_EWMA_WEIGHT         0.3     // weight of the newest probe
+#define CIRCUIT_RETIRE_FACTOR       2.0     // slower than this times the median is slow
+#define CIRCUIT_RETIRE_STREAK       3       // slow probe rounds in a row before retiring
+#define CIRCUIT_RETIRE_FAILURES     2       // failures in a row before retiring
+#define CIRCUIT_NEWNYM_FACTOR       3.0     // pool median this far above its best rotates every slot
+
+typedef struct CircuitSlot {
+    CircuitStats stats;
+    uint32_t generation;        // bumped on every retirement
+    int slow_streak;
+    int fail_streak;
+} CircuitSlot;
+
+/* One probe of a round */
+typedef struct CircuitProbe {
+    CircuitPool *pool;
+    size_t slot;
+    uint32_t generation;
+} CircuitProbe;
+
+struct CircuitPool {
+    CircuitSlot *slots;
+    size_t count;
+    size_t cursor;              // rotates the start of the search, so ties spread
+    char *probe_url;
+    uint64_t best_median_ns;    // lowest pool median since the last rotation
+    int degraded_rounds;
+    uint64_t rotations;         // pool-wide rotations
+    TorControl *control;        // NULL without a ControlPort (or after it failed)
+    bool control_used;
+    TorCircuitCounts tor_circuits;
+    Error control_err;          // why the ControlPort was dropped
+#ifndef _WIN32
+    pthread_mutex_t lock;
+    pthread_cond_t wake;        // signalled on shutdown
+    pthread_t prober;
+    bool prober_started;
+#endif
+    bool shutdown;
+};
+
+/* Function Prototypes */
+static void slot_renew(CircuitPool *pool, size_t i);
+static void slot_fail(CircuitPool *pool, size_t i);
+static uint64_t pool_median(const CircuitPool *pool);
+static uint64_t ewma(uint64_t avg, uint64_t sample);
+static int cmp_u64(const void *a, const void *b);
+#ifndef _WIN32
+static void *prober_main(void *arg);
+static void prober_round(CircuitPool *pool);
+static void prober_done(void *userdata, Error err, const HttpResponse *response);
+static void prober_retire_slow(CircuitPool *pool);
+static void prober_control(CircuitPool *pool, bool rotate);
+static bool prober_sleep(CircuitPool *pool, int ms);
+#endif
+
+Error circuit_pool_create(size_t circuits, const char *probe_url, CircuitPool **out) {
+    if (circuits == 0 || circuits > CIRCUIT_MAX) {
+        return ERR_NEW(ERR_INVALID_ARGS, "Circuit pool size must be between 1 and %d", CIRCUIT_MAX);
+    }
+
+    CircuitPool *pool = ut_calloc(MEM_TAG_RUNTIME, 1, sizeof(CircuitPool));
+    if (!pool) {
+        return ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate circuit pool");
+    }
+    pool->slots = ut_calloc(MEM_TAG_RUNTIME, circuits, sizeof(CircuitSlot));
+    pool->probe_url = probe_url ? ut_strdup(probe_url) : NULL;
+    if (!pool->slots || (probe_url && !pool->probe_url)) {
+        ut_free(pool->slots);
+        ut_free(pool->probe_url);
+        ut_free(pool);
+        return ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate %zu circuit slots", circuits);
+    }
+    pool->count = circuits;
+    for (size_t i = 0; i < circuits; i++) {
+        slot_renew(pool, i);
+    }
+
+#ifndef _WIN32
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    if (pool->probe_url) {
+        if (pthread_create(&pool->prober, NULL, prober_main, pool) != 0) {
+            circuit_pool_destroy(pool);
+            return ERR_NEW(ERR_IO, "Failed to start the circuit prober");
+        }
+        pool->prober_started = true;
+    }
+#endif
+
+    *out = pool;
+    return ERR_OK();
+}
+
+void circuit_pool_destroy(CircuitPool *pool) {
+    if (!pool) {
+        return;
+    }
+#ifndef _WIN32
+    CIRCUIT_LOCK(pool);
+    pool->shutdown = true;
+    pthread_cond_signal(&pool->wake);
+    CIRCUIT_UNLOCK(pool);
+    if (pool->prober_started) {
+        pthread_join(pool->prober, NULL);
+    }
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->lock);
+#endif
+    tor_control_close(pool->control);
+    ut_free(pool->slots);
+    ut_free(pool->probe_url);
+    ut_free(pool);
+}
+
+Error circuit_pool_control(CircuitPool *pool, const char *address, const char *password) {
+    char ip[128];   // address or unix:/path
+    uint16_t port = 0;
+    Error err = tor_control_parse_address(address, ip, sizeof(ip), &port);
+    if (ERR_FAILED(err)) {
+        return err;
+    }
+
+    TorControl *control = NULL;
+    err = tor_control_open(ip, port, password, &control);
+    if (ERR_FAILED(err)) {
+        return err;
+    }
+
+    CIRCUIT_LOCK(pool);
+    tor_control_close(pool->control);
+    pool->control = control;
+    pool->control_used = true;
+    CIRCUIT_UNLOCK(pool);
+    return ERR_OK();
+}
+
+void circuit_pool_acquire(CircuitPool *pool, CircuitLease *lease) {
+    CIRCUIT_LOCK(pool);
+    uint64_t median = pool_median(pool);
+    uint64_t fallback = median > 0 ? median : 1;
+
+    size_t best = pool->cursor % pool->count;
+    double best_cost = -1;
+    for (size_t n = 0; n < pool->count; n++) {
+        size_t i = (pool->cursor + n) % pool->count;
+        const CircuitStats *s = &pool->slots[i].stats;
+        uint64_t expected = s->score_ns > 0 ? s->score_ns : fallback;
+        double cost = (double)expected * (double)(s->outstanding + 1);
+        if (best_cost < 0 || cost < best_cost) {
+            best = i;
+            best_cost = cost;
+        }
+    }
+    pool->cursor++;
+
+    CircuitSlot *slot = &pool->slots[best];
+    slot->stats.outstanding++;
+    slot->stats.leases++;
+    lease->pool = pool;
+    lease->slot = best;
+    lease->generation = slot->generation;
+    memcpy(lease->token, slot->stats.token, sizeof(lease->token));
+    CIRCUIT_UNLOCK(pool);
+}
+
+void circuit_pool_release(CircuitLease *lease, bool circuit_failed) {
+    CircuitPool *pool = lease->pool;
+    if (!pool) {
+        return;
+    }
+    lease->pool = NULL;
+
+    CIRCUIT_LOCK(pool);
+    CircuitSlot *slot = &pool->slots[lease->slot];
+    slot->stats.outstanding--;
+    // A lease on a retired token says nothing about the slot's new circuit
+    if (lease->generation == slot->generation) {
+        if (circuit_failed) {
+            slot->stats.failures++;
+            slot_fail(pool, lease->slot);
+        } else {
+            slot->fail_streak = 0;
+        }
+    }
+    CIRCUIT_UNLOCK(pool);
+}
+
+size_t circuit_pool_stats(CircuitPool *pool, CircuitStats *out, size_t cap) {
+    CIRCUIT_LOCK(pool);
+    size_t n = pool->count < cap ? pool->count : cap;
+    for (size_t i = 0; i < n; i++) {
+        out[i] = pool->slots[i].stats;
+    }
+    CIRCUIT_UNLOCK(pool);
+    return pool->count;
+}
+
+void print_circuit_stats(CircuitPool *pool) {
+    CircuitStats stats[CIRCUIT_MAX];
+    size_t n = circuit_pool_stats(pool, stats, CIRCUIT_MAX);
+
+    CIRCUIT_LOCK(pool);
+    bool control_used = pool->control_used;
+    bool control_lost = pool->control_used && !pool->control;
+    TorCircuitCounts tor = pool->tor_circuits;
+    Error control_err = pool->control_err;
+    uint64_t rotations = pool->rotations;
+    CIRCUIT_UNLOCK(pool);
+
+    printf("%s: circuits (probe: %s), %llu pool-wide rotations\n", PROG_NAME, pool->probe_url ? pool->probe_url : "off",
+           (unsigned long long)rotations);
+    if (control_lost) {
+        printf("%s: ControlPort dropped: %s\n", PROG_NAME, get_err_msg(&control_err, false));
+    } else if (control_used) {
+        printf("%s: ControlPort: %zu circuits built, %zu building, %zu failed, %zu closed\n", PROG_NAME,
+               tor.built, tor.launched, tor.failed, tor.closed);
+    }
+    printf("  %-28s %8s %8s %8s %8s %10s %10s %10s\n", "token", "leases", "failed", "probes", "retired", "socks", "transfer", "score (ms)");
+    for (size_t i = 0; i < n; i++) {
+        const CircuitStats *s = &stats[i];
+        printf("  %-28s %8llu %8llu %8llu %8u %10.3f %10.3f %10.3f\n", s->token,
+               (unsigned long long)s->leases, (unsigned long long)s->failures,
+               (unsigned long long)s->probes, s->retired,
+               (double)s->socks_ns / 1e6, (double)s->transfer_ns / 1e6, (double)s->score_ns / 1e6);
+    }
+}
+
+/* Internal helper functions */
+
+// Give slot i a new token: Tor builds a new circuit for the next stream on it
+static void slot_renew(CircuitPool *pool, size_t i) {
+    CircuitSlot *slot = &pool->slots[i];
+    if (slot->stats.token[0]) {
+        slot->generation++;
+        slot->stats.retired++;
+        TRACE_INSTANT("circuit", "retire", "slot", (int64_t)i);
+    }
+    snprintf(slot->stats.token, sizeof(slot->stats.token), "%s-circuit-%zu-%u", PROG_NAME, i, slot->generation);
+    slot->stats.score_ns = 0;
+    slot->stats.socks_ns = 0;
+    slot->stats.transfer_ns = 0;
+    slot->slow_streak = 0;
+    slot->fail_streak = 0;
+}
+
+static void slot_fail(CircuitPool *pool, size_t i) {
+    if (++pool->slots[i].fail_streak >= CIRCUIT_RETIRE_FAILURES) {
+        slot_renew(pool, i);
+    }
+}
+
+// Median score of the probed slots, 0 when none is
+static uint64_t pool_median(const CircuitPool *pool) {
+    uint64_t scores[CIRCUIT_MAX];
+    size_t n = 0;
+    for (size_t i = 0; i < pool->count; i++) {
+        if (pool->slots[i].stats.score_ns > 0) {
+            scores[n++] = pool->slots[i].stats.score_ns;
+        }
+    }
+    if (n == 0) {
+        return 0;
+    }
+    qsort(scores, n, sizeof(scores[0]), cmp_u64);
+    return scores[n / 2];
+}
+
+static uint64_t ewma(uint64_t avg, uint64_t sample) {
+    if (avg == 0) {
+        return sample > 0 ? sample : 1;
+    }
+    return (uint64_t)(CIRCUIT_EWMA_WEIGHT * (double)sample + (1.0 - CIRCUIT_EWMA_WEIGHT) * (double)avg);
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+#ifndef _WIN32
+
+static void *prober_main(void *arg) {
+    CircuitPool *pool = (CircuitPool *)arg;
+    do {
+        prober_round(pool);
+        CIRCUIT_LOCK(pool);
+        prober_retire_slow(pool);
+        bool rotate = false;
+        uint64_t median = pool_median(pool);
+        if (median > 0) {
+            if (pool->best_median_ns == 0 || median < pool->best_median_ns) {
+                pool->best_median_ns = median;
+            }
+            if ((double)median <= CIRCUIT_NEWNYM_FACTOR * (double)pool->best_median_ns) {
+                pool->degraded_rounds = 0;
+            } else if (++pool->degraded_rounds >= CIRCUIT_RETIRE_STREAK) {
+                rotate = true;
+            }
+        }
+        if (rotate) {
+            for (size_t i = 0; i < pool->count; i++) {
+                slot_renew(pool, i);
+            }
+            pool->rotations++;
+            pool->best_median_ns = 0;
+            pool->degraded_rounds = 0;
+        }
+        CIRCUIT_UNLOCK(pool);
+        prober_control(pool, rotate);
+    } while (prober_sleep(pool, CIRCUIT_PROBE_INTERVAL_MS));
+    return NULL;
+}
+
+// Probe every slot once, concurrently; abandoned (without results) on shutdown
+static void prober_round(CircuitPool *pool) {
+    HttpMulti *multi = NULL;
+    CircuitProbe *probes = ut_calloc(MEM_TAG_RUNTIME, pool->count, sizeof(CircuitProbe));
+    if (!probes || ERR_FAILED(http_multi_create(0, &multi))) {
+        ut_free(probes);
+        return;
+    }
+
+    for (size_t i = 0; i < pool->count; i++) {
+        char token[CIRCUIT_TOKEN_MAX];
+        CIRCUIT_LOCK(pool);
+        memcpy(token, pool->slots[i].stats.token, sizeof(token));
+        probes[i] = (CircuitProbe){ .pool = pool, .slot = i, .generation = pool->slots[i].generation };
+        CIRCUIT_UNLOCK(pool);
+
+        HttpRequest req = {
+            .method      = HTTP_METHOD_GET,
+            .uri         = pool->probe_url,
+            .isolation   = token,
+            .timeouts    = { .total_ms = CIRCUIT_PROBE_TIMEOUT_MS },
+        };
+        Error err = http_multi_add(multi, &req, NULL, prober_done, &probes[i]);
+        if (ERR_FAILED(err)) {
+            prober_done(&probes[i], err, NULL);
+        }
+    }
+
+    size_t running = 1;
+    while (running > 0) {
+        if (ERR_FAILED(http_multi_poll(multi, CIRCUIT_PROBE_POLL_MS, &running))) {
+            break;
+        }
+        CIRCUIT_LOCK(pool);
+        bool stop = pool->shutdown;
+        CIRCUIT_UNLOCK(pool);
+        if (stop) {
+            break;
+        }
+    }
+
+    http_multi_destroy(multi);
+    ut_free(probes);
+}
+
+static void prober_done(void *userdata, Error err, const HttpResponse *response) {
+    CircuitProbe *probe = (CircuitProbe *)userdata;
+    CircuitPool *pool = probe->pool;
+
+    CIRCUIT_LOCK(pool);
+    CircuitSlot *slot = &pool->slots[probe->slot];
+    if (probe->generation == slot->generation) {
+        slot->stats.probes++;
+        if (ERR_FAILED(err) || !response || response->hops == 0) {
+            slot->stats.probe_failures++;
+            slot_fail(pool, probe->slot);
+        } else {
+            const HttpTiming *t = &response->timing[0];
+            slot->stats.socks_ns = ewma(slot->stats.socks_ns, t->socks_reply_ns - t->socks_sent_ns);
+            slot->stats.transfer_ns = ewma(slot->stats.transfer_ns, t->last_byte_ns - t->socks_reply_ns);
+            slot->stats.score_ns = slot->stats.socks_ns + slot->stats.transfer_ns;
+            slot->fail_streak = 0;
+        }
+    }
+    CIRCUIT_UNLOCK(pool);
+}
+
+// Retire slots that keep scoring far above the median (caller holds the lock)
+static void prober_retire_slow(CircuitPool *pool) {
+    uint64_t median = pool_median(pool);
+    if (median == 0) {
+        return;
+    }
+    for (size_t i = 0; i < pool->count; i++) {
+        CircuitSlot *slot = &pool->slots[i];
+        if ((double)slot->stats.score_ns <= CIRCUIT_RETIRE_FACTOR * (double)median) {
+            slot->slow_streak = 0;
+        } else if (++slot->slow_streak >= CIRCUIT_RETIRE_STREAK) {
+            slot_renew(pool, i);
+        }
+    }
+}
+
+// Read Tor's circuit-build state, and send NEWNYM with a pool-wide rotation (outside the lock: blocking I/O)
+static void prober_control(CircuitPool *pool, bool rotate) {
+    CIRCUIT_LOCK(pool);
+    TorControl *control = pool->control;
+    CIRCUIT_UNLOCK(pool);
+    if (!control) {
+        return;
+    }
+
+    TorCircuitCounts counts;
+    Error err = tor_control_circuits(control, &counts);
+    if (!ERR_FAILED(err) && rotate) {
+        err = tor_control_newnym(control);
+    }
+
+    CIRCUIT_LOCK(pool);
+    if (ERR_FAILED(err)) {
+        pool->control_err = err;
+        pool->control = NULL;
+    } else {
+        pool->tor_circuits = counts;
+    }
+    CIRCUIT_UNLOCK(pool);
+    if (ERR_FAILED(err)) {
+        tor_control_close(control);
+    }
+}
+
+// Wait ms or until shutdown; false on shutdown
+static bool prober_sleep(CircuitPool *pool, int ms) {
+    struct timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += ms / 1000;
+    until.tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (until.tv_nsec >= 1000000000L) {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000L;
+    }
+
+    CIRCUIT_LOCK(pool);
+    while (!pool->shutdown) {
+        if (pthread_cond_timedwait(&pool->wake, &pool->lock, &until) != 0) {
+            break;  // timed out
+        }
+    }
+    bool running = !pool->shutdown;
+    CIRCUIT_UNLOCK(pool);
+    return running;
+}
+
+#endif
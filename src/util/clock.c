@@ -0,0 +1,48 @@
+/*
+    File: src/util/clock.c
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference:
+        - clock_gettime(2): https://man7.org/linux/man-pages/man2/clock_gettime.2.html
+    Description:
+        Monotonic clock used for latency measurements. Unlike wall-clock
+        time it never jumps with NTP adjustments, so differences between
+        two readings are always valid durations.
+*/
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#include <time.h>
+#include <errno.h>
+#else
+#include <windows.h>
+#endif
+
+#include "util/util.h"
+
+uint64_t ut_now_ns(void) {
+#ifndef _WIN32
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#else
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    if (freq.QuadPart == 0) {
+        QueryPerformanceFrequency(&freq);
+    }
+    QueryPerformanceCounter(&now);
+    return (uint64_t)((double)now.QuadPart * 1e9 / (double)freq.QuadPart);
+#endif
+}
+
+void ut_sleep_ns(uint64_t ns) {
+#ifndef _WIN32
+    struct timespec ts = { .tv_sec = (time_t)(ns / 1000000000ULL), .tv_nsec = (long)(ns % 1000000000ULL) };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+        // interrupted by a signal: sleep for the remainder
+    }
+#else
+    Sleep((DWORD)((ns + 999999) / 1000000));
+#endif
+}
@@ -12,11 +12,13 @@
 */
 
 #include "util/util.h"
+#include "diag/trace.h"
+#include "diag/perf.h"
 
 
-Error write_to(const char *file_name, const char *data, size_t len) {
-    Error err = ERR_OK();
+Error open_for_write(const char *file_name, FILE **out) {
     FILE *file = fopen(file_name, "wb");
+    TRACE_INSTANT("file", "open_for_write", "ok", file != NULL);
     if (!file) {
         int err = errno;
         switch (err) {
@@ -27,8 +29,24 @@ Error write_to(const char *file_name, const char *data, size_t len) {
         }
     }
 
+    *out = file;
+    return ERR_OK();
+}
+
+Error write_to(const char *file_name, const char *data, size_t len) {
+    FILE *file = NULL;
+    Error err = open_for_write(file_name, &file);
+    if (ERR_FAILED(err)) {
+        return err;
+    }
+
+    PerfMark mark;
+    perf_begin(&mark);
+    TRACE_BEGIN("file", "write_to", "bytes", len);
     size_t written = fwrite(data, 1, len, file);
     int flush_status = fflush(file);
+    perf_end(PERF_OUTPUT, &mark);
+    TRACE_END("file", "write_to", "bytes", written);
     if (written != len || flush_status != 0) {
         err = ERR_NEW(ERR_IO, "Failed to write to file '%s'", file_name);
         goto exit_write;
@@ -63,12 +81,14 @@ Error read_from(const char *file_name, char **buffer, size_t *out_len) {
     }
     rewind(file);
 
-    char *data = (char *)malloc(size + 1);
+    char *data = (char *)ut_malloc(MEM_TAG_FILE, size + 1);
     if (!data) {
         err = ERR_NEW(ERR_OUTOFMEMORY, "Out of memory while allocating buffer for file '%s'", file_name);
         goto exit_read;
     }
+    TRACE_BEGIN("file", "read_from", "bytes", size);
     size_t read_size = fread(data, 1, size, file);
+    TRACE_END("file", "read_from", "bytes", read_size);
     if (read_size != (size_t)size) {
         err = ERR_NEW(ERR_IO, "Failed to read file '%s'", file_name);
         goto exit_read;
@@ -81,7 +101,7 @@ Error read_from(const char *file_name, char **buffer, size_t *out_len) {
 
 exit_read:
     if (data) {
-        free(data);
+        ut_free(data);
     }
     fclose(file);
 
@@ -0,0 +1,151 @@
+/*
+    File: src/util/hist.c
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference:
+        - HdrHistogram: http://hdrhistogram.org/
+        - Gil Tene, "How NOT to Measure Latency": https://www.infoq.com/presentations/latency-response-time/
+    Description:
+        Log-linear latency histogram in the style of HdrHistogram.
+        Values are split into power-of-two buckets, each divided into
+        HIST_SUB_BUCKETS linear sub-buckets, so every recorded value
+        keeps a relative precision of 1/HIST_SUB_BUCKETS (~0.1%) from
+        one nanosecond up to HIST_MAX_VALUE with a fixed, small table.
+        Recording is O(1) and allocation-free; histograms of the same
+        layout can be merged.
+*/
+
+#include "util/util.h"
+
+/* 2 * half sub-buckets per bucket: 11 bits of precision */
+#define HIST_SUB_BUCKET_HALF_MAGNITUDE 10
+#define HIST_SUB_BUCKETS (1u << (HIST_SUB_BUCKET_HALF_MAGNITUDE + 1))
+#define HIST_SUB_BUCKET_HALF (HIST_SUB_BUCKETS / 2)
+#define HIST_SUB_BUCKET_MASK ((uint64_t)HIST_SUB_BUCKETS - 1)
+
+/* Largest trackable value; larger values are clamped */
+#define HIST_MAX_MAGNITUDE 44
+#define HIST_MAX_VALUE ((UINT64_C(1) << HIST_MAX_MAGNITUDE) - 1)
+#define HIST_BUCKETS (HIST_MAX_MAGNITUDE - HIST_SUB_BUCKET_HALF_MAGNITUDE)
+#define HIST_COUNTS ((HIST_BUCKETS + 1) * HIST_SUB_BUCKET_HALF)
+
+struct Histogram {
+    uint64_t total;             // number of recorded values
+    uint64_t min;
+    uint64_t max;
+    double sum;                 // for the mean
+    uint64_t counts[HIST_COUNTS];
+};
+
+/* Function Prototypes */
+static int hist_bit_length(uint64_t v);
+static size_t hist_index(uint64_t value);
+static uint64_t hist_highest_equivalent(size_t index);
+
+Error hist_create(Histogram **out) {
+    Histogram *h = ut_calloc(MEM_TAG_RUNTIME, 1, sizeof(Histogram));
+    if (!h) {
+        return ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate histogram");
+    }
+    h->min = UINT64_MAX;
+    *out = h;
+    return ERR_OK();
+}
+
+void hist_destroy(Histogram *hist) {
+    ut_free(hist);
+}
+
+void hist_record(Histogram *hist, uint64_t value) {
+    if (value > HIST_MAX_VALUE) {
+        value = HIST_MAX_VALUE;
+    }
+    hist->counts[hist_index(value)]++;
+    hist->total++;
+    hist->sum += (double)value;
+    if (value < hist->min) {
+        hist->min = value;
+    }
+    if (value > hist->max) {
+        hist->max = value;
+    }
+}
+
+void hist_merge(Histogram *dst, const Histogram *src) {
+    for (size_t i = 0; i < HIST_COUNTS; i++) {
+        dst->counts[i] += src->counts[i];
+    }
+    dst->total += src->total;
+    dst->sum += src->sum;
+    if (src->min < dst->min) {
+        dst->min = src->min;
+    }
+    if (src->max > dst->max) {
+        dst->max = src->max;
+    }
+}
+
+uint64_t hist_count(const Histogram *hist) {
+    return hist->total;
+}
+
+uint64_t hist_max(const Histogram *hist) {
+    return hist->max;
+}
+
+double hist_mean(const Histogram *hist) {
+    return hist->total ? hist->sum / (double)hist->total : 0.0;
+}
+
+uint64_t hist_percentile(const Histogram *hist, double percentile) {
+    if (hist->total == 0) {
+        return 0;
+    }
+    if (percentile > 100.0) {
+        percentile = 100.0;
+    }
+
+    // Smallest value such that at least percentile% of the samples are <= it
+    uint64_t wanted = (uint64_t)((percentile / 100.0) * (double)hist->total + 0.5);
+    if (wanted == 0) {
+        wanted = 1;
+    }
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < HIST_COUNTS; i++) {
+        seen += hist->counts[i];
+        if (seen >= wanted) {
+            uint64_t value = hist_highest_equivalent(i);
+            return value < hist->max ? value : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+/* Internal helper functions */
+
+static int hist_bit_length(uint64_t v) {
+    int n = 0;
+    while (v) {
+        n++;
+        v >>= 1;
+    }
+    return n;
+}
+
+// Bucket b holds [2^(b+10), 2^(b+11)) in steps of 2^b; bucket 0 also covers [0, 2^10)
+static size_t hist_index(uint64_t value) {
+    int bucket = hist_bit_length(value | HIST_SUB_BUCKET_MASK) - (HIST_SUB_BUCKET_HALF_MAGNITUDE + 1);
+    size_t sub = (size_t)(value >> bucket);
+    return ((size_t)(bucket + 1) << HIST_SUB_BUCKET_HALF_MAGNITUDE) + sub - HIST_SUB_BUCKET_HALF;
+}
+
+static uint64_t hist_highest_equivalent(size_t index) {
+    int bucket = (int)(index >> HIST_SUB_BUCKET_HALF_MAGNITUDE) - 1;
+    size_t sub = (index & (HIST_SUB_BUCKET_HALF - 1)) + HIST_SUB_BUCKET_HALF;
+    if (bucket < 0) {
+        bucket = 0;
+        sub -= HIST_SUB_BUCKET_HALF;
+    }
+    return ((uint64_t)sub << bucket) + ((UINT64_C(1) << bucket) - 1);
+}
@@ -0,0 +1,161 @@
+/*
+    File: src/util/limit.c
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference:
+        - Jacobson, "Congestion Avoidance and Control" (AIMD, slow start)
+        - Netflix concurrency-limits: https://github.com/Netflix/concurrency-limits
+    Description:
+        Adaptive concurrency limiter. Latency samples are grouped into
+        windows of about one limit's worth of completions (one "round
+        trip" of the in-flight set). At the end of each window the p90
+        of the window is compared with a baseline, the lowest p90 seen
+        so far drifting slowly towards recent values:
+
+            p90 > baseline * LIMIT_TOLERANCE or
+            overloads > window / LIMIT_OVERLOAD_SHARE    ->  limit *= 3/4
+            otherwise, if the limit was the bottleneck    ->  limit += 1
+
+        Until the first decrease the limit doubles per window instead
+        (slow start). Overload samples (SOCKS rejects, failed proxy
+        connects) count towards the window without a latency, so a
+        destination that is always refused costs a share of the window
+        instead of collapsing the limit on every reject. The limit only
+        grows while requests actually queued behind it, so an idle phase
+        cannot inflate it.
+*/
+
+#include "util/util.h"
+
+#define LIMIT_WINDOW_MIN    8       // fewer samples make p90 meaningless
+#define LIMIT_WINDOW_MAX    256
+#define LIMIT_TOLERANCE     2.0     // p90 may double before the limit backs off
+#define LIMIT_BASELINE_GAIN 16      // baseline moves 1/16 of the way up per window
+#define LIMIT_OVERLOAD_SHARE 10     // more than 1 in 10 samples overloaded backs off
+
+struct ConcLimiter {
+    size_t limit;
+    size_t max;
+    bool slow_start;
+    bool saturated;                 // in-flight reached the limit during this window
+    uint64_t window[LIMIT_WINDOW_MAX];
+    size_t window_len;              // latency samples
+    size_t window_overloads;        // samples without a latency
+    LimiterStats stats;
+};
+
+/* Function Prototypes */
+static void limiter_close_window(ConcLimiter *lim);
+static uint64_t window_p90(ConcLimiter *lim);
+static int cmp_u64(const void *a, const void *b);
+
+Error limiter_create(size_t initial, size_t max, ConcLimiter **out) {
+    ConcLimiter *lim = ut_calloc(MEM_TAG_RUNTIME, 1, sizeof(ConcLimiter));
+    if (!lim) {
+        return ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate concurrency limiter");
+    }
+    lim->max = max > 0 ? max : 1;
+    lim->limit = initial < 1 ? 1 : initial > lim->max ? lim->max : initial;
+    lim->slow_start = true;
+    lim->stats.limit = lim->limit;
+    lim->stats.lowest = lim->limit;
+    lim->stats.highest = lim->limit;
+    *out = lim;
+    return ERR_OK();
+}
+
+void limiter_destroy(ConcLimiter *lim) {
+    ut_free(lim);
+}
+
+size_t limiter_limit(const ConcLimiter *lim) {
+    return lim->limit;
+}
+
+void limiter_sample(ConcLimiter *lim, uint64_t latency_ns, bool overload, size_t in_flight) {
+    if (in_flight >= lim->limit) {
+        lim->saturated = true;
+    }
+    if (overload) {
+        lim->stats.overloads++;
+        lim->window_overloads++;
+    } else {
+        lim->window[lim->window_len++] = latency_ns;
+    }
+
+    size_t target = lim->limit < LIMIT_WINDOW_MIN ? LIMIT_WINDOW_MIN : lim->limit > LIMIT_WINDOW_MAX ? LIMIT_WINDOW_MAX : lim->limit;
+    if (lim->window_len + lim->window_overloads >= target) {
+        limiter_close_window(lim);
+    }
+}
+
+void limiter_stats(const ConcLimiter *lim, LimiterStats *out) {
+    *out = lim->stats;
+}
+
+void print_limiter_stats(const LimiterStats *stats) {
+    printf("%s: adaptive concurrency: limit %zu (range %zu-%zu), %llu increases, %llu decreases, %llu overloads\n",
+           PROG_NAME, stats->limit, stats->lowest, stats->highest,
+           (unsigned long long)stats->increases, (unsigned long long)stats->decreases,
+           (unsigned long long)stats->overloads);
+    printf("%s: adaptive concurrency: p90 %.3f ms last window, %.3f ms baseline\n",
+           PROG_NAME, (double)stats->last_p90_ns / 1e6, (double)stats->baseline_ns / 1e6);
+}
+
+/* Internal helper functions */
+
+static void limiter_close_window(ConcLimiter *lim) {
+    LimiterStats *s = &lim->stats;
+    bool congested = lim->window_overloads * LIMIT_OVERLOAD_SHARE > lim->window_len + lim->window_overloads;
+
+    if (lim->window_len > 0) {
+        uint64_t p90 = window_p90(lim);
+        s->last_p90_ns = p90;
+        if (s->baseline_ns == 0 || p90 < s->baseline_ns) {
+            s->baseline_ns = p90;
+        } else {
+            // Drift up slowly so a permanently slower route does not pin the limit low
+            s->baseline_ns += (p90 - s->baseline_ns) / LIMIT_BASELINE_GAIN;
+        }
+        congested = congested || (double)p90 > (double)s->baseline_ns * LIMIT_TOLERANCE;
+    }
+
+    if (congested) {
+        size_t next = lim->limit * 3 / 4;
+        if (next >= lim->limit) {
+            next = lim->limit - 1;
+        }
+        lim->limit = next < 1 ? 1 : next;
+        lim->slow_start = false;
+        s->decreases++;
+        if (s->decreases == 1 || lim->limit < s->lowest) {
+            s->lowest = lim->limit;
+        }
+    } else if (lim->saturated && lim->limit < lim->max) {
+        lim->limit = lim->slow_start ? lim->limit * 2 : lim->limit + 1;
+        if (lim->limit > lim->max) {
+            lim->limit = lim->max;
+        }
+        s->increases++;
+    }
+
+    if (lim->limit > s->highest) {
+        s->highest = lim->limit;
+    }
+    s->limit = lim->limit;
+    lim->window_len = 0;
+    lim->window_overloads = 0;
+    lim->saturated = false;
+}
+
+static uint64_t window_p90(ConcLimiter *lim) {
+    qsort(lim->window, lim->window_len, sizeof(uint64_t), cmp_u64);
+    size_t idx = (lim->window_len * 9) / 10;
+    return lim->window[idx < lim->window_len ? idx : lim->window_len - 1];
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
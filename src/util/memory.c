@@ -5,18 +5,159 @@
     Reference: None
     Description:
         Memory utility function implementations for Torilate.
+
+        Allocations made through ut_malloc and friends carry a header with
+        their size and subsystem tag, so every subsystem has counters for
+        calls, bytes requested, live bytes and peak live bytes. The
+        counters are relaxed atomics updated on each call; peaks are a
+        CAS max. print_memory_report shows them after a verbose request
+        and at the end of a benchmark. The net layer sits below util and
+        the diag recorders must stay async-signal-safe, so neither is
+        tracked.
 */
 
+#include <stddef.h>
+#include <stdatomic.h>
 #include "cli/cli.h"
 #include "util/util.h"
 
+/* Prefix of every tracked allocation; the union keeps the payload max-aligned */
+typedef union MemHeader {
+    struct {
+        size_t size;
+        MemTag tag;
+    } info;
+    max_align_t align;
+} MemHeader;
+
+typedef struct MemCounters {
+    atomic_uint_fast64_t calls;
+    atomic_uint_fast64_t bytes;
+    atomic_uint_fast64_t live;
+    atomic_uint_fast64_t peak;
+} MemCounters;
+
+static const char *mem_tag_names[MEM_TAG_COUNT] = {
+    [MEM_TAG_STRING]  = "string",
+    [MEM_TAG_CLI]     = "cli",
+    [MEM_TAG_HTTP]    = "http",
+    [MEM_TAG_MULTI]   = "multi",
+    [MEM_TAG_CACHE]   = "cache",
+    [MEM_TAG_FILE]    = "file",
+    [MEM_TAG_BATCH]   = "batch",
+    [MEM_TAG_BENCH]   = "bench",
+    [MEM_TAG_RUNTIME] = "runtime",
+};
+
+static MemCounters mem_counters[MEM_TAG_COUNT];
+static MemCounters mem_total;   // calls/bytes unused: live and peak across all tags
+
+/* Function Prototypes */
+static void mem_charge(MemTag tag, size_t size);
+static void mem_release(MemTag tag, size_t size);
+static void mem_raise_peak(atomic_uint_fast64_t *peak, uint64_t live);
+static void mem_load(const MemCounters *c, MemStats *out);
+
+void *ut_malloc(MemTag tag, size_t size) {
+    if (size > SIZE_MAX - sizeof(MemHeader)) {
+        return NULL;
+    }
+    MemHeader *h = malloc(sizeof(MemHeader) + size);
+    if (!h) {
+        return NULL;
+    }
+    h->info.size = size;
+    h->info.tag = tag;
+    mem_charge(tag, size);
+    return h + 1;
+}
+
+void *ut_calloc(MemTag tag, size_t count, size_t size) {
+    if (size != 0 && count > (SIZE_MAX - sizeof(MemHeader)) / size) {
+        return NULL;
+    }
+    MemHeader *h = calloc(1, sizeof(MemHeader) + count * size);
+    if (!h) {
+        return NULL;
+    }
+    h->info.size = count * size;
+    h->info.tag = tag;
+    mem_charge(tag, count * size);
+    return h + 1;
+}
+
+void *ut_realloc(MemTag tag, void *ptr, size_t size) {
+    if (!ptr) {
+        return ut_malloc(tag, size);
+    }
+    if (size > SIZE_MAX - sizeof(MemHeader)) {
+        return NULL;
+    }
+
+    MemHeader *old = (MemHeader *)ptr - 1;
+    size_t old_size = old->info.size;
+    MemTag old_tag = old->info.tag;     // a block stays charged to the subsystem that created it
+    MemHeader *h = realloc(old, sizeof(MemHeader) + size);
+    if (!h) {
+        return NULL;
+    }
+    h->info.size = size;
+    mem_release(old_tag, old_size);
+    mem_charge(old_tag, size);
+    return h + 1;
+}
+
+void ut_free(void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    MemHeader *h = (MemHeader *)ptr - 1;
+    mem_release(h->info.tag, h->info.size);
+    free(h);
+}
+
+void ut_mem_stats(MemTag tag, MemStats *out) {
+    if (tag >= MEM_TAG_COUNT) {
+        memset(out, 0, sizeof(*out));
+        for (int t = 0; t < MEM_TAG_COUNT; t++) {
+            out->calls += atomic_load(&mem_counters[t].calls);
+            out->bytes += atomic_load(&mem_counters[t].bytes);
+        }
+        out->live = atomic_load(&mem_total.live);
+        out->peak = atomic_load(&mem_total.peak);
+        return;
+    }
+    mem_load(&mem_counters[tag], out);
+}
+
+void print_memory_report(void) {
+    printf("\n%s: heap by subsystem (tracked allocations, bytes)\n", PROG_NAME);
+    printf("  %-10s %10s %14s %12s %12s\n", "subsystem", "calls", "bytes", "live", "peak");
+    for (int t = 0; t < MEM_TAG_COUNT; t++) {
+        MemStats s;
+        mem_load(&mem_counters[t], &s);
+        if (s.calls == 0) {
+            continue;
+        }
+        printf("  %-10s %10llu %14llu %12llu %12llu\n", mem_tag_names[t],
+               (unsigned long long)s.calls, (unsigned long long)s.bytes,
+               (unsigned long long)s.live, (unsigned long long)s.peak);
+    }
+
+    MemStats all;
+    ut_mem_stats(MEM_TAG_COUNT, &all);
+    printf("  %-10s %10llu %14llu %12llu %12llu\n", "total",
+           (unsigned long long)all.calls, (unsigned long long)all.bytes,
+           (unsigned long long)all.live, (unsigned long long)all.peak);
+}
+
 void cleanup_uri(URI *uri) {
     if (uri->host) {
-        free((void*) uri->host);
+        ut_free((void*) uri->host);
         uri->host = NULL;
     }
     if (uri->path) {
-        free((void*) uri->path);
+        ut_free((void*) uri->path);
         uri->path = NULL;
     }
 
@@ -25,11 +166,10 @@ void cleanup_uri(URI *uri) {
 
 char *ut_strdup(const char *s) {
     size_t size = strlen(s) + 1;
-    char *p = malloc(size);
+    char *p = ut_malloc(MEM_TAG_STRING, size);
     if (p != NULL) {
         memcpy(p, s, size);
     }
-    p[size - 1] = '\0';
     return p;
 }
 
@@ -39,7 +179,7 @@ char *ut_strndup(const char *s, size_t n) {
 
     for (n1 = 0; n1 < n && s[n1] != '\0'; n1++)
         continue;
-    p = malloc(n + 1);
+    p = ut_malloc(MEM_TAG_STRING, n1 + 1);
     if (p != NULL) {
         memcpy(p, s, n1);
         p[n1] = '\0';
@@ -55,12 +195,43 @@ void cleanup_args(CliArgsInfo *args_info) {
     for (int i=0; i < MULTI_OPTION_COUNT; i++) {
         if (args_info->multi_options[i].values) {
             for (int j = 0; j < args_info->multi_options[i].count; j++) {
-                free((void*)args_info->multi_options[i].values[j]);
+                ut_free((void*)args_info->multi_options[i].values[j]);
             }
-            free((void*)args_info->multi_options[i].values);
+            ut_free((void*)args_info->multi_options[i].values);
         }
     }
     
     // Zero out the structure
     memset(args_info, 0, sizeof(CliArgsInfo));
-}
\ No newline at end of file
+}
+
+/* Internal helper functions */
+
+static void mem_charge(MemTag tag, size_t size) {
+    MemCounters *c = &mem_counters[tag];
+    atomic_fetch_add_explicit(&c->calls, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&c->bytes, size, memory_order_relaxed);
+    uint64_t live = atomic_fetch_add_explicit(&c->live, size, memory_order_relaxed) + size;
+    mem_raise_peak(&c->peak, live);
+    uint64_t total = atomic_fetch_add_explicit(&mem_total.live, size, memory_order_relaxed) + size;
+    mem_raise_peak(&mem_total.peak, total);
+}
+
+static void mem_release(MemTag tag, size_t size) {
+    atomic_fetch_sub_explicit(&mem_counters[tag].live, size, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&mem_total.live, size, memory_order_relaxed);
+}
+
+static void mem_raise_peak(atomic_uint_fast64_t *peak, uint64_t live) {
+    uint_fast64_t seen = atomic_load_explicit(peak, memory_order_relaxed);
+    while (live > seen && !atomic_compare_exchange_weak_explicit(peak, &seen, live, memory_order_relaxed, memory_order_relaxed)) {
+        // seen now holds the current peak: retry while ours is higher
+    }
+}
+
+static void mem_load(const MemCounters *c, MemStats *out) {
+    out->calls = atomic_load((atomic_uint_fast64_t *)&c->calls);
+    out->bytes = atomic_load((atomic_uint_fast64_t *)&c->bytes);
+    out->live = atomic_load((atomic_uint_fast64_t *)&c->live);
+    out->peak = atomic_load((atomic_uint_fast64_t *)&c->peak);
+}
@@ -10,6 +10,10 @@
 
 #include "util/util.h"
 #include "error/error.h"
+#include "diag/perf.h"
+
+/* Function Prototypes */
+static Error format_http_response(HttpResponse *response, char *out, size_t out_size, size_t *resp_size, bool raw, bool content_only);
 
 
 Error parse_uri(const char *uri, URI *out) {
@@ -129,6 +133,16 @@ Error validate_header(char *header) {
 }
 
 Error parse_http_response(HttpResponse *response, char *out, size_t out_size, size_t *resp_size, bool raw, bool content_only) {
+    PerfMark mark;
+    perf_begin(&mark);
+    Error err = format_http_response(response, out, out_size, resp_size, raw, content_only);
+    perf_end(PERF_PARSE, &mark);
+    return err;
+}
+
+/* Internal helper functions */
+
+static Error format_http_response(HttpResponse *response, char *out, size_t out_size, size_t *resp_size, bool raw, bool content_only) {
     int status_code = 0;
     char status_text[64] = {0};
     int content_length = -1;
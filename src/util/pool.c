@@ -0,0 +1,339 @@
+/*
+    File: src/util/pool.c
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference:
+        - Blumofe & Leiserson, "Scheduling Multithreaded Computations by Work Stealing" (1999)
+        - POSIX threads: https://man7.org/linux/man-pages/man7/pthreads.7.html
+    Description:
+        Work-stealing thread pool for CPU-side post-processing.
+        Every worker owns a deque: it pushes and pops its own tasks at the
+        bottom (LIFO, cache-warm) while idle workers steal from the top of
+        other deques (FIFO, oldest first). Tasks submitted from outside the
+        pool (e.g. the network I/O loop) are spread round-robin across the
+        deques. On Windows the pool degrades to running tasks inline.
+*/
+
+#include "util/util.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+typedef struct PoolTask {
+    PoolTaskFn fn;
+    void *arg;
+} PoolTask;
+
+/* Growable ring deque; top = head (thieves), bottom = tail (owner) */
+typedef struct WorkerDeque {
+    pthread_mutex_t lock;
+    PoolTask *tasks;
+    size_t cap;
+    size_t head;
+    size_t count;
+} WorkerDeque;
+
+typedef struct PoolWorker {
+    pthread_t thread;
+    size_t index;
+    unsigned int seed;           // victim selection
+    struct ThreadPool *pool;
+    WorkerDeque deque;
+} PoolWorker;
+
+struct ThreadPool {
+    PoolWorker *workers;
+    size_t worker_count;
+    atomic_size_t next_worker;   // round-robin target for external submissions
+
+    atomic_size_t queued;        // tasks sitting in deques
+    atomic_size_t pending;       // tasks submitted but not finished
+    atomic_bool shutdown;
+
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle_cond;    // signalled when work is queued
+    pthread_mutex_t done_lock;
+    pthread_cond_t done_cond;    // signalled when pending reaches zero
+};
+
+/* Worker identity of the calling thread (NULL outside the pool) */
+static _Thread_local PoolWorker *current_worker = NULL;
+
+/* Function Prototypes */
+static bool deque_push(WorkerDeque *dq, PoolTask task);
+static bool deque_pop_bottom(WorkerDeque *dq, PoolTask *out);
+static bool deque_steal_top(WorkerDeque *dq, PoolTask *out);
+static bool pool_find_task(PoolWorker *self, PoolTask *out);
+static void *pool_worker_main(void *arg);
+
+Error pool_create(size_t workers, ThreadPool **out) {
+    if (workers == 0) {
+        workers = pool_cpu_count();
+    }
+
+    ThreadPool *pool = ut_calloc(MEM_TAG_RUNTIME, 1, sizeof(ThreadPool));
+    if (!pool) {
+        return ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate thread pool");
+    }
+    pool->workers = ut_calloc(MEM_TAG_RUNTIME, workers, sizeof(PoolWorker));
+    if (!pool->workers) {
+        ut_free(pool);
+        return ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate %zu pool workers", workers);
+    }
+
+    atomic_init(&pool->next_worker, 0);
+    atomic_init(&pool->queued, 0);
+    atomic_init(&pool->pending, 0);
+    atomic_init(&pool->shutdown, false);
+    pthread_mutex_init(&pool->idle_lock, NULL);
+    pthread_cond_init(&pool->idle_cond, NULL);
+    pthread_mutex_init(&pool->done_lock, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+
+    for (size_t i = 0; i < workers; i++) {
+        PoolWorker *w = &pool->workers[i];
+        w->index = i;
+        w->seed  = (unsigned int)(i * 2654435761u + 1);
+        w->pool  = pool;
+        pthread_mutex_init(&w->deque.lock, NULL);
+    }
+
+    for (size_t i = 0; i < workers; i++) {
+        int rc = pthread_create(&pool->workers[i].thread, NULL, pool_worker_main, &pool->workers[i]);
+        if (rc != 0) {
+            pool->worker_count = i;
+            pool_destroy(pool);
+            return ERR_NEW(ERR_IO, "Failed to start pool worker %zu (error %d)", i, rc);
+        }
+        pool->worker_count = i + 1;
+    }
+
+    *out = pool;
+    return ERR_OK();
+}
+
+Error pool_submit(ThreadPool *pool, PoolTaskFn fn, void *arg) {
+    PoolTask task = { .fn = fn, .arg = arg };
+
+    // Workers keep subtasks local; external threads spread work round-robin
+    PoolWorker *target = current_worker;
+    if (!target || target->pool != pool) {
+        size_t idx = atomic_fetch_add(&pool->next_worker, 1) % pool->worker_count;
+        target = &pool->workers[idx];
+    }
+
+    atomic_fetch_add(&pool->pending, 1);
+    if (!deque_push(&target->deque, task)) {
+        atomic_fetch_sub(&pool->pending, 1);
+        return ERR_NEW(ERR_OUTOFMEMORY, "Failed to grow task deque of worker %zu", target->index);
+    }
+    atomic_fetch_add(&pool->queued, 1);
+
+    pthread_mutex_lock(&pool->idle_lock);
+    pthread_cond_signal(&pool->idle_cond);
+    pthread_mutex_unlock(&pool->idle_lock);
+
+    return ERR_OK();
+}
+
+void pool_wait(ThreadPool *pool) {
+    pthread_mutex_lock(&pool->done_lock);
+    while (atomic_load(&pool->pending) > 0) {
+        pthread_cond_wait(&pool->done_cond, &pool->done_lock);
+    }
+    pthread_mutex_unlock(&pool->done_lock);
+}
+
+void pool_destroy(ThreadPool *pool) {
+    if (!pool) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->idle_lock);
+    atomic_store(&pool->shutdown, true);
+    pthread_cond_broadcast(&pool->idle_cond);
+    pthread_mutex_unlock(&pool->idle_lock);
+
+    for (size_t i = 0; i < pool->worker_count; i++) {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+
+    for (size_t i = 0; i < pool->worker_count; i++) {
+        pthread_mutex_destroy(&pool->workers[i].deque.lock);
+        ut_free(pool->workers[i].deque.tasks);
+    }
+    pthread_mutex_destroy(&pool->idle_lock);
+    pthread_cond_destroy(&pool->idle_cond);
+    pthread_mutex_destroy(&pool->done_lock);
+    pthread_cond_destroy(&pool->done_cond);
+
+    ut_free(pool->workers);
+    ut_free(pool);
+}
+
+size_t pool_worker_count(const ThreadPool *pool) {
+    return pool->worker_count;
+}
+
+size_t pool_cpu_count(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (size_t)n : 1;
+}
+
+/* Internal helper functions */
+static bool deque_push(WorkerDeque *dq, PoolTask task) {
+    pthread_mutex_lock(&dq->lock);
+
+    if (dq->count == dq->cap) {
+        size_t cap = dq->cap ? dq->cap * 2 : 64;
+        PoolTask *grown = ut_malloc(MEM_TAG_RUNTIME, cap * sizeof(PoolTask));
+        if (!grown) {
+            pthread_mutex_unlock(&dq->lock);
+            return false;
+        }
+        for (size_t i = 0; i < dq->count; i++) {
+            grown[i] = dq->tasks[(dq->head + i) % dq->cap];
+        }
+        ut_free(dq->tasks);
+        dq->tasks = grown;
+        dq->cap = cap;
+        dq->head = 0;
+    }
+
+    dq->tasks[(dq->head + dq->count) % dq->cap] = task;
+    dq->count++;
+
+    pthread_mutex_unlock(&dq->lock);
+    return true;
+}
+
+static bool deque_pop_bottom(WorkerDeque *dq, PoolTask *out) {
+    bool found = false;
+    pthread_mutex_lock(&dq->lock);
+    if (dq->count > 0) {
+        dq->count--;
+        *out = dq->tasks[(dq->head + dq->count) % dq->cap];
+        found = true;
+    }
+    pthread_mutex_unlock(&dq->lock);
+    return found;
+}
+
+static bool deque_steal_top(WorkerDeque *dq, PoolTask *out) {
+    bool found = false;
+    if (pthread_mutex_trylock(&dq->lock) != 0) {
+        return false; // contended: try another victim rather than queue up
+    }
+    if (dq->count > 0) {
+        *out = dq->tasks[dq->head];
+        dq->head = (dq->head + 1) % dq->cap;
+        dq->count--;
+        found = true;
+    }
+    pthread_mutex_unlock(&dq->lock);
+    return found;
+}
+
+static bool pool_find_task(PoolWorker *self, PoolTask *out) {
+    ThreadPool *pool = self->pool;
+
+    if (deque_pop_bottom(&self->deque, out)) {
+        return true;
+    }
+
+    // Steal, starting from a random victim to spread contention
+    size_t n = pool->worker_count;
+    self->seed ^= self->seed << 13;  // xorshift32
+    self->seed ^= self->seed >> 17;
+    self->seed ^= self->seed << 5;
+    size_t start = (size_t)self->seed % n;
+    for (size_t i = 0; i < n; i++) {
+        PoolWorker *victim = &pool->workers[(start + i) % n];
+        if (victim != self && deque_steal_top(&victim->deque, out)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void *pool_worker_main(void *arg) {
+    PoolWorker *self = (PoolWorker *)arg;
+    ThreadPool *pool = self->pool;
+    current_worker = self;
+
+    for (;;) {
+        PoolTask task;
+        if (atomic_load(&pool->queued) > 0 && pool_find_task(self, &task)) {
+            atomic_fetch_sub(&pool->queued, 1);
+            task.fn(task.arg);
+
+            if (atomic_fetch_sub(&pool->pending, 1) == 1) {
+                pthread_mutex_lock(&pool->done_lock);
+                pthread_cond_broadcast(&pool->done_cond);
+                pthread_mutex_unlock(&pool->done_lock);
+            }
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->idle_lock);
+        while (atomic_load(&pool->queued) == 0 && !atomic_load(&pool->shutdown)) {
+            pthread_cond_wait(&pool->idle_cond, &pool->idle_lock);
+        }
+        bool stop = atomic_load(&pool->shutdown) && atomic_load(&pool->queued) == 0;
+        pthread_mutex_unlock(&pool->idle_lock);
+
+        if (stop) {
+            break;
+        }
+    }
+
+    current_worker = NULL;
+    return NULL;
+}
+
+#else /* _WIN32: run tasks inline on the submitting thread */
+
+#include <windows.h>
+
+struct ThreadPool {
+    size_t worker_count;
+};
+
+Error pool_create(size_t workers, ThreadPool **out) {
+    (void)workers;
+    ThreadPool *pool = ut_calloc(MEM_TAG_RUNTIME, 1, sizeof(ThreadPool));
+    if (!pool) {
+        return ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate thread pool");
+    }
+    pool->worker_count = 0;
+    *out = pool;
+    return ERR_OK();
+}
+
+Error pool_submit(ThreadPool *pool, PoolTaskFn fn, void *arg) {
+    (void)pool;
+    fn(arg);
+    return ERR_OK();
+}
+
+void pool_wait(ThreadPool *pool) {
+    (void)pool;
+}
+
+void pool_destroy(ThreadPool *pool) {
+    ut_free(pool);
+}
+
+size_t pool_worker_count(const ThreadPool *pool) {
+    return pool->worker_count;
+}
+
+size_t pool_cpu_count(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (size_t)info.dwNumberOfProcessors : 1;
+}
+
+#endif
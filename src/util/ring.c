@@ -0,0 +1,259 @@
+/*
+    File: src/util/ring.c
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference:
+        - Lamport, "Specifying Concurrent Program Modules" (1983), single-producer/single-consumer queue
+        - cppreference, atomic memory order: https://en.cppreference.com/w/c/atomic/memory_order
+        - memfd_create(2): https://man7.org/linux/man-pages/man2/memfd_create.2.html
+    Description:
+        Lock-free single-producer/single-consumer byte ring.
+        The producer only advances head and the consumer only advances
+        tail, so neither side ever takes a lock; release/acquire ordering
+        on the indices publishes the bytes in between. Waiting for data
+        or space spins briefly, then yields, then sleeps.
+
+        On Linux the buffer is a memfd mapped twice at adjacent addresses:
+        byte cap+i aliases byte i, so any span starting anywhere in the
+        first mapping can run past the end without wrapping. Elsewhere a
+        plain buffer is used and the producer copies the first
+        RING_LINEAR_MIN bytes of each lap into a slack area behind the
+        buffer, which keeps shorter tokens linear for the consumer.
+*/
+
+#if defined(__linux__)
+#define _GNU_SOURCE
+#include <sys/mman.h>
+#include <unistd.h>
+#elif !defined(_WIN32)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#ifndef _WIN32
+#include <time.h>
+#include <sched.h>
+#else
+#include <windows.h>
+#endif
+
+#include <stdatomic.h>
+#include "util/util.h"
+
+struct ByteRing {
+    char *buf;
+    size_t cap;                 // power of two
+    atomic_size_t head;         // total bytes produced (written by producer only)
+    atomic_size_t tail;         // total bytes consumed (written by consumer only)
+    atomic_bool closed;         // producer finished
+    atomic_bool aborted;        // consumer gave up
+    bool mirrored;              // buf is followed by a second mapping of itself
+};
+
+/* Function Prototypes */
+static bool ring_map_mirrored(ByteRing *ring);
+static void ring_backoff(unsigned int *spins);
+
+Error ring_create(size_t capacity, ByteRing **out) {
+    size_t cap = 4096;
+    while (cap < capacity) {
+        cap <<= 1;
+    }
+
+    ByteRing *r = ut_calloc(MEM_TAG_RUNTIME, 1, sizeof(ByteRing));
+    if (!r) {
+        return ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate ring buffer");
+    }
+    r->cap = cap;
+    if (!ring_map_mirrored(r)) {
+        r->buf = ut_malloc(MEM_TAG_RUNTIME, r->cap + RING_LINEAR_MIN);
+        if (!r->buf) {
+            ut_free(r);
+            return ERR_NEW(ERR_OUTOFMEMORY, "Failed to allocate %zu byte ring buffer", cap);
+        }
+    }
+
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    atomic_init(&r->closed, false);
+    atomic_init(&r->aborted, false);
+
+    *out = r;
+    return ERR_OK();
+}
+
+void ring_destroy(ByteRing *ring) {
+    if (!ring) {
+        return;
+    }
+#if defined(__linux__)
+    if (ring->mirrored) {
+        munmap(ring->buf, 2 * ring->cap);
+        ut_free(ring);
+        return;
+    }
+#endif
+    ut_free(ring->buf);
+    ut_free(ring);
+}
+
+size_t ring_write_span(ByteRing *ring, char **ptr) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    size_t space = ring->cap - (head - tail);
+    size_t offset = head & (ring->cap - 1);
+    size_t contiguous = ring->mirrored ? space : ring->cap - offset;
+
+    *ptr = ring->buf + offset;
+    return space < contiguous ? space : contiguous;
+}
+
+void ring_commit_write(ByteRing *ring, size_t len) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t offset = head & (ring->cap - 1);
+
+    // Plain buffer: mirror the start of the lap into the slack before publishing it
+    if (!ring->mirrored && offset < RING_LINEAR_MIN) {
+        size_t n = RING_LINEAR_MIN - offset;
+        memcpy(ring->buf + ring->cap + offset, ring->buf + offset, len < n ? len : n);
+    }
+    atomic_store_explicit(&ring->head, head + len, memory_order_release);
+}
+
+size_t ring_read_span(ByteRing *ring, const char **ptr) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t used = head - tail;
+    size_t offset = tail & (ring->cap - 1);
+    size_t contiguous = ring->mirrored ? used : ring->cap - offset + RING_LINEAR_MIN;
+
+    *ptr = ring->buf + offset;
+    return used < contiguous ? used : contiguous;
+}
+
+void ring_commit_read(ByteRing *ring, size_t len) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, tail + len, memory_order_release);
+}
+
+size_t ring_wait_write(ByteRing *ring, char **ptr) {
+    unsigned int spins = 0;
+    for (;;) {
+        size_t n = ring_write_span(ring, ptr);
+        if (n > 0) {
+            return n;
+        }
+        if (atomic_load_explicit(&ring->aborted, memory_order_acquire)) {
+            return 0;
+        }
+        ring_backoff(&spins);
+    }
+}
+
+size_t ring_wait_read(ByteRing *ring, size_t after, const char **ptr) {
+    unsigned int spins = 0;
+    for (;;) {
+        size_t n = ring_read_span(ring, ptr);
+        if (n > after) {
+            return n;
+        }
+        if (atomic_load_explicit(&ring->closed, memory_order_acquire)) {
+            // Re-check: bytes committed before close must still be delivered
+            return ring_read_span(ring, ptr);
+        }
+        ring_backoff(&spins);
+    }
+}
+
+Error ring_write_all(ByteRing *ring, const char *data, size_t len) {
+    while (len > 0) {
+        char *dst = NULL;
+        size_t n = ring_wait_write(ring, &dst);
+        if (n == 0) {
+            return ERR_NEW(ERR_IO, "Ring consumer stopped with %zu bytes unwritten", len);
+        }
+        if (n > len) {
+            n = len;
+        }
+        memcpy(dst, data, n);
+        ring_commit_write(ring, n);
+        data += n;
+        len -= n;
+    }
+    return ERR_OK();
+}
+
+void ring_close(ByteRing *ring) {
+    atomic_store_explicit(&ring->closed, true, memory_order_release);
+}
+
+void ring_abort(ByteRing *ring) {
+    atomic_store_explicit(&ring->aborted, true, memory_order_release);
+}
+
+bool ring_is_aborted(ByteRing *ring) {
+    return atomic_load_explicit(&ring->aborted, memory_order_acquire);
+}
+
+bool ring_is_mirrored(const ByteRing *ring) {
+    return ring->mirrored;
+}
+
+/* Internal helper functions */
+
+// Map one memfd twice back to back; false leaves the ring for the plain-buffer fallback
+static bool ring_map_mirrored(ByteRing *ring) {
+#if defined(__linux__)
+    long page = sysconf(_SC_PAGESIZE);
+    if (page > 0 && ring->cap < (size_t)page) {
+        ring->cap = (size_t)page; // both are powers of two
+    }
+    size_t cap = ring->cap;
+
+    int fd = memfd_create("torilate-ring", MFD_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    if (ftruncate(fd, (off_t)cap) != 0) {
+        close(fd);
+        return false;
+    }
+
+    // Reserve the whole window first so nothing else can land between the halves
+    char *base = mmap(NULL, 2 * cap, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+    if (mmap(base, cap, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+        mmap(base + cap, cap, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(base, 2 * cap);
+        close(fd);
+        return false;
+    }
+    close(fd); // the mappings keep the memory alive
+
+    ring->buf = base;
+    ring->mirrored = true;
+    return true;
+#else
+    (void)ring;
+    return false;
+#endif
+}
+
+static void ring_backoff(unsigned int *spins) {
+    unsigned int n = (*spins)++;
+    if (n < 64) {
+        return; // busy spin: the other side is usually mid-copy
+    }
+#ifndef _WIN32
+    if (n < 128) {
+        sched_yield();
+        return;
+    }
+    struct timespec ts = { .tv_sec = 0, .tv_nsec = n < 1024 ? 50000 : 1000000 };
+    nanosleep(&ts, NULL);
+#else
+    Sleep(n < 128 ? 0 : 1);
+#endif
+}
@@ -17,6 +17,80 @@
 
 // Forward declarations
 typedef struct CliArgsInfo CliArgsInfo;
+typedef struct ThreadPool ThreadPool;
+typedef struct ByteRing ByteRing;
+typedef struct Histogram Histogram;
+typedef struct ConcLimiter ConcLimiter;
+typedef struct CircuitPool CircuitPool;
+
+#define CIRCUIT_MAX         64      // largest circuit pool
+#define CIRCUIT_TOKEN_MAX   48      // longest isolation token of a pooled circuit
+
+// Thread pool task entry point
+typedef void (*PoolTaskFn)(void *arg);
+
+// Values available to a --write-out template
+typedef struct WriteOutInfo {
+    const char *url;                // URL as requested
+    const HttpResponse *response;   // final response with per-hop timings
+    uint64_t size_download;         // body bytes delivered
+} WriteOutInfo;
+
+// Snapshot of an adaptive concurrency limiter
+typedef struct LimiterStats {
+    size_t limit;               // current limit
+    size_t lowest;              // smallest limit since slow start ended
+    size_t highest;             // largest limit reached
+    uint64_t increases;
+    uint64_t decreases;
+    uint64_t overloads;         // samples flagged as overload (SOCKS rejects, failed connects)
+    uint64_t baseline_ns;       // p90 latency the limiter considers uncongested
+    uint64_t last_p90_ns;       // p90 latency of the last completed window
+} LimiterStats;
+
+// A request's claim on a pooled circuit (see circuit_pool_acquire)
+typedef struct CircuitLease {
+    CircuitPool *pool;              // NULL once released
+    size_t slot;
+    uint32_t generation;            // token generation of the slot when leased
+    char token[CIRCUIT_TOKEN_MAX];  // SOCKS isolation token to send
+} CircuitLease;
+
+// Snapshot of one pooled circuit
+typedef struct CircuitStats {
+    char token[CIRCUIT_TOKEN_MAX];  // current isolation token
+    uint64_t score_ns;              // socks_ns + transfer_ns, 0 until probed
+    uint64_t socks_ns;              // EWMA of the probe SOCKS reply time
+    uint64_t transfer_ns;           // EWMA of the probe request-to-last-byte time
+    uint64_t probes;
+    uint64_t probe_failures;
+    uint64_t leases;                // requests routed to the slot
+    uint64_t failures;              // routed requests that failed on the circuit
+    size_t outstanding;             // leases not yet released
+    uint32_t retired;               // tokens replaced because slow or failing
+} CircuitStats;
+
+// Subsystem an allocation is charged to (see print_memory_report)
+typedef enum {
+    MEM_TAG_STRING,     // ut_strdup/ut_strndup: URI parts, header and option copies
+    MEM_TAG_CLI,
+    MEM_TAG_HTTP,       // request builder, redirects
+    MEM_TAG_MULTI,      // concurrent transfers and their request copies
+    MEM_TAG_CACHE,
+    MEM_TAG_FILE,       // read_from buffers
+    MEM_TAG_BATCH,
+    MEM_TAG_BENCH,
+    MEM_TAG_RUNTIME,    // thread pool, byte rings, histograms
+    MEM_TAG_COUNT
+} MemTag;
+
+// Allocation counters of one subsystem
+typedef struct MemStats {
+    uint64_t calls;     // malloc/calloc/realloc calls
+    uint64_t bytes;     // bytes requested over the run
+    uint64_t live;      // bytes currently allocated
+    uint64_t peak;      // highest value of live
+} MemStats;
 
 typedef struct URI {
     int port;
@@ -27,6 +101,14 @@ typedef struct URI {
 } URI;
 
 // Memory management utilities
+// Everything from ut_malloc/ut_calloc/ut_realloc/ut_strdup/ut_strndup (and read_from)
+// carries a small header and must be released with ut_free, never free
+void *ut_malloc(MemTag tag, size_t size);
+void *ut_calloc(MemTag tag, size_t count, size_t size);
+void *ut_realloc(MemTag tag, void *ptr, size_t size);   // tag applies when ptr is NULL
+void ut_free(void *ptr);
+void ut_mem_stats(MemTag tag, MemStats *out);           // MEM_TAG_COUNT: all subsystems
+void print_memory_report(void);
 void cleanup_uri(URI *uri);
 char *ut_strdup(const char *s);
 char *ut_strndup(const char *s, size_t n);
@@ -41,5 +123,71 @@ Error parse_http_response(HttpResponse *response, char *out, size_t out_size, si
 // File handling utilities
 Error write_to(const char *file_name, const char *data, size_t len);
 Error read_from(const char *file_name, char **buffer, size_t *out_len);
+Error open_for_write(const char *file_name, FILE **out);
+
+// Thread pool utilities (work-stealing; workers == 0 sizes the pool to the core count)
+Error pool_create(size_t workers, ThreadPool **out);
+Error pool_submit(ThreadPool *pool, PoolTaskFn fn, void *arg);
+void pool_wait(ThreadPool *pool);
+void pool_destroy(ThreadPool *pool);
+size_t pool_worker_count(const ThreadPool *pool);
+size_t pool_cpu_count(void);
+
+// Monotonic clock (nanoseconds from an arbitrary origin)
+uint64_t ut_now_ns(void);
+void ut_sleep_ns(uint64_t ns);
+
+// Log-linear (HDR-style) histogram of values in [0, 2^44), ~0.1% relative precision
+Error hist_create(Histogram **out);
+void hist_destroy(Histogram *hist);
+void hist_record(Histogram *hist, uint64_t value);
+void hist_merge(Histogram *dst, const Histogram *src);
+uint64_t hist_count(const Histogram *hist);
+uint64_t hist_max(const Histogram *hist);
+double hist_mean(const Histogram *hist);
+uint64_t hist_percentile(const Histogram *hist, double percentile);  // percentile in [0, 100]
+
+// Timing output: expand a --write-out template (%{var}, \n, \t) into out (always terminated)
+size_t format_write_out(const char *tmpl, const WriteOutInfo *info, char *out, size_t out_size);
+void print_timing_breakdown(const HttpResponse *response);
+
+// Lock-free single-producer/single-consumer byte ring
+// The buffer is mapped twice back to back where the OS allows it, so every span covers
+// all readable (or writable) bytes; otherwise read spans stay linear for RING_LINEAR_MIN bytes.
+#define RING_LINEAR_MIN 8192
+Error ring_create(size_t capacity, ByteRing **out);
+void ring_destroy(ByteRing *ring);
+size_t ring_write_span(ByteRing *ring, char **ptr);
+void ring_commit_write(ByteRing *ring, size_t len);
+size_t ring_read_span(ByteRing *ring, const char **ptr);
+void ring_commit_read(ByteRing *ring, size_t len);
+size_t ring_wait_write(ByteRing *ring, char **ptr);       // 0 once the consumer aborted
+size_t ring_wait_read(ByteRing *ring, size_t after, const char **ptr);  // waits for more than 'after' bytes; less once closed
+Error ring_write_all(ByteRing *ring, const char *data, size_t len);
+void ring_close(ByteRing *ring);
+void ring_abort(ByteRing *ring);
+bool ring_is_aborted(ByteRing *ring);
+bool ring_is_mirrored(const ByteRing *ring);
+
+// AIMD concurrency limiter driven by latency samples (single-threaded)
+// The limit grows while windowed p90 latency stays near its baseline and shrinks
+// multiplicatively when it rises or a sample reports overload.
+Error limiter_create(size_t initial, size_t max, ConcLimiter **out);
+void limiter_destroy(ConcLimiter *lim);
+size_t limiter_limit(const ConcLimiter *lim);
+void limiter_sample(ConcLimiter *lim, uint64_t latency_ns, bool overload, size_t in_flight);
+void limiter_stats(const ConcLimiter *lim, LimiterStats *out);
+void print_limiter_stats(const LimiterStats *stats);
+
+// Pool of isolation tokens (circuits) scored by a background prober of probe_url
+// (NULL = no probing); requests lease the fastest, least loaded circuit
+Error circuit_pool_create(size_t circuits, const char *probe_url, CircuitPool **out);
+void circuit_pool_destroy(CircuitPool *pool);
+// Let the prober read circuit state from, and send NEWNYM through, a Tor ControlPort ("[host:]port")
+Error circuit_pool_control(CircuitPool *pool, const char *address, const char *password);
+void circuit_pool_acquire(CircuitPool *pool, CircuitLease *lease);
+void circuit_pool_release(CircuitLease *lease, bool circuit_failed);   // no-op on a released lease
+size_t circuit_pool_stats(CircuitPool *pool, CircuitStats *out, size_t cap);
+void print_circuit_stats(CircuitPool *pool);
 
 #endif
\ No newline at end of file
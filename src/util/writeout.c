@@ -0,0 +1,188 @@
+/*
+    File: src/util/writeout.c
+    Author: Trident Apollo
+    Date: 17-10-2026
+    Reference:
+        - curl --write-out: https://curl.se/docs/manpage.html#-w
+    Description:
+        Formatting of the per-phase timings recorded in an HttpResponse.
+        A --write-out template expands %{variable} references into
+        status, size and cumulative timing values (seconds, curl style);
+        %{json} emits every hop with its phase durations so dashboards
+        can attribute latency to connect, SOCKS/circuit setup, server
+        wait or transfer.
+*/
+
+#include <stdarg.h>
+#include "util/util.h"
+
+/* Output buffer with truncation (len keeps counting past the end) */
+typedef struct WriteOutBuf {
+    char *data;
+    size_t size;
+    size_t len;
+} WriteOutBuf;
+
+/* Function Prototypes */
+static void wo_append(WriteOutBuf *buf, const char *fmt, ...);
+static void wo_variable(WriteOutBuf *buf, const char *name, size_t name_len, const WriteOutInfo *info);
+static void wo_json(WriteOutBuf *buf, const WriteOutInfo *info);
+static double wo_seconds(uint64_t ns);
+static uint64_t wo_phase(uint64_t from, uint64_t to);
+static uint64_t wo_cumulative(const HttpResponse *response, uint64_t phase_ns);
+
+size_t format_write_out(const char *tmpl, const WriteOutInfo *info, char *out, size_t out_size) {
+    WriteOutBuf buf = { .data = out, .size = out_size, .len = 0 };
+    if (out_size > 0) {
+        out[0] = '\0';
+    }
+
+    for (const char *p = tmpl; *p; p++) {
+        if (p[0] == '%' && p[1] == '{') {
+            const char *end = strchr(p + 2, '}');
+            if (end) {
+                wo_variable(&buf, p + 2, (size_t)(end - p - 2), info);
+                p = end;
+                continue;
+            }
+        } else if (p[0] == '%' && p[1] == '%') {
+            p++;
+        } else if (p[0] == '\\' && (p[1] == 'n' || p[1] == 't' || p[1] == 'r' || p[1] == '\\')) {
+            p++;
+            wo_append(&buf, "%c", *p == 'n' ? '\n' : *p == 't' ? '\t' : *p == 'r' ? '\r' : '\\');
+            continue;
+        }
+        wo_append(&buf, "%c", *p);
+    }
+
+    return buf.len < out_size ? buf.len : (out_size > 0 ? out_size - 1 : 0);
+}
+
+void print_timing_breakdown(const HttpResponse *response) {
+    int hops = response->hops < HTTP_MAX_TIMED_HOPS ? response->hops : HTTP_MAX_TIMED_HOPS;
+    if (hops == 0) {
+        printf("%s: Served from cache (no network exchange)\n", PROG_NAME);
+        return;
+    }
+
+    for (int i = 0; i < hops; i++) {
+        const HttpTiming *t = &response->timing[i];
+        printf("%s: Hop %d: connect %.3f ms, socks send %.3f ms, socks reply %.3f ms, request %.3f ms, "
+               "first byte %.3f ms, transfer %.3f ms, total %.3f ms\n",
+               PROG_NAME, i + 1,
+               wo_seconds(t->connect_ns) * 1e3,
+               wo_seconds(wo_phase(t->connect_ns, t->socks_sent_ns)) * 1e3,
+               wo_seconds(wo_phase(t->socks_sent_ns, t->socks_reply_ns)) * 1e3,
+               wo_seconds(wo_phase(t->socks_reply_ns, t->request_sent_ns)) * 1e3,
+               wo_seconds(wo_phase(t->request_sent_ns, t->first_byte_ns)) * 1e3,
+               wo_seconds(wo_phase(t->first_byte_ns, t->last_byte_ns)) * 1e3,
+               wo_seconds(t->last_byte_ns) * 1e3);
+    }
+    if (response->hops > HTTP_MAX_TIMED_HOPS) {
+        printf("%s: (%d hops, only the first %d and the last are timed separately)\n", PROG_NAME, response->hops, HTTP_MAX_TIMED_HOPS - 1);
+    }
+}
+
+/* Internal helper functions */
+
+static void wo_append(WriteOutBuf *buf, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    size_t room = buf->len < buf->size ? buf->size - buf->len : 0;
+    int n = vsnprintf(room ? buf->data + buf->len : NULL, room, fmt, ap);
+    va_end(ap);
+    if (n > 0) {
+        buf->len += (size_t)n;
+    }
+}
+
+static void wo_variable(WriteOutBuf *buf, const char *name, size_t name_len, const WriteOutInfo *info) {
+    const HttpResponse *r = info->response;
+    const HttpTiming *last = r->hops > 0 ? &r->timing[(r->hops < HTTP_MAX_TIMED_HOPS ? r->hops : HTTP_MAX_TIMED_HOPS) - 1] : NULL;
+
+    #define WO_IS(s) (name_len == sizeof(s) - 1 && strncmp(name, s, name_len) == 0)
+    if (WO_IS("http_code")) {
+        wo_append(buf, "%03d", (int)r->status_code);
+    } else if (WO_IS("size_download")) {
+        wo_append(buf, "%llu", (unsigned long long)info->size_download);
+    } else if (WO_IS("num_redirects")) {
+        wo_append(buf, "%d", r->hops > 0 ? r->hops - 1 : 0);
+    } else if (WO_IS("url")) {
+        wo_append(buf, "%s", info->url ? info->url : "");
+    } else if (WO_IS("json")) {
+        wo_json(buf, info);
+    } else if (WO_IS("time_redirect")) {
+        wo_append(buf, "%.6f", wo_seconds(wo_cumulative(r, 0)));
+    } else if (WO_IS("time_connect")) {
+        wo_append(buf, "%.6f", wo_seconds(last ? wo_cumulative(r, last->connect_ns) : 0));
+    } else if (WO_IS("time_socks_sent")) {
+        wo_append(buf, "%.6f", wo_seconds(last ? wo_cumulative(r, last->socks_sent_ns) : 0));
+    } else if (WO_IS("time_socks_reply")) {
+        wo_append(buf, "%.6f", wo_seconds(last ? wo_cumulative(r, last->socks_reply_ns) : 0));
+    } else if (WO_IS("time_request_sent")) {
+        wo_append(buf, "%.6f", wo_seconds(last ? wo_cumulative(r, last->request_sent_ns) : 0));
+    } else if (WO_IS("time_starttransfer")) {
+        wo_append(buf, "%.6f", wo_seconds(last ? wo_cumulative(r, last->first_byte_ns) : 0));
+    } else if (WO_IS("time_total")) {
+        wo_append(buf, "%.6f", wo_seconds(last ? wo_cumulative(r, last->last_byte_ns) : 0));
+    } else {
+        // Unknown variables are kept verbatim so typos are visible
+        wo_append(buf, "%%{%.*s}", (int)name_len, name);
+    }
+    #undef WO_IS
+}
+
+// {"url":..., "http_code":..., "hops":[{phase durations in seconds}, ...], "time_total":...}
+static void wo_json(WriteOutBuf *buf, const WriteOutInfo *info) {
+    const HttpResponse *r = info->response;
+    int hops = r->hops < HTTP_MAX_TIMED_HOPS ? r->hops : HTTP_MAX_TIMED_HOPS;
+
+    wo_append(buf, "{\"url\":\"");
+    for (const char *c = info->url ? info->url : ""; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            wo_append(buf, "\\%c", *c);
+        } else if ((unsigned char)*c < 0x20) {
+            wo_append(buf, "\\u%04x", (unsigned)(unsigned char)*c);
+        } else {
+            wo_append(buf, "%c", *c);
+        }
+    }
+    wo_append(buf, "\",\"http_code\":%d,\"size_download\":%llu,\"num_redirects\":%d,\"cached\":%s,\"hops\":[",
+              (int)r->status_code, (unsigned long long)info->size_download,
+              r->hops > 0 ? r->hops - 1 : 0, r->hops == 0 ? "true" : "false");
+
+    for (int i = 0; i < hops; i++) {
+        const HttpTiming *t = &r->timing[i];
+        wo_append(buf, "%s{\"connect\":%.6f,\"socks_send\":%.6f,\"socks_reply\":%.6f,\"request_send\":%.6f,"
+                       "\"wait\":%.6f,\"transfer\":%.6f,\"total\":%.6f}",
+                  i ? "," : "",
+                  wo_seconds(t->connect_ns),
+                  wo_seconds(wo_phase(t->connect_ns, t->socks_sent_ns)),
+                  wo_seconds(wo_phase(t->socks_sent_ns, t->socks_reply_ns)),
+                  wo_seconds(wo_phase(t->socks_reply_ns, t->request_sent_ns)),
+                  wo_seconds(wo_phase(t->request_sent_ns, t->first_byte_ns)),
+                  wo_seconds(wo_phase(t->first_byte_ns, t->last_byte_ns)),
+                  wo_seconds(t->last_byte_ns));
+    }
+
+    uint64_t total = hops > 0 ? wo_cumulative(r, r->timing[hops - 1].last_byte_ns) : 0;
+    wo_append(buf, "],\"time_redirect\":%.6f,\"time_total\":%.6f}", wo_seconds(wo_cumulative(r, 0)), wo_seconds(total));
+}
+
+static double wo_seconds(uint64_t ns) {
+    return (double)ns / 1e9;
+}
+
+// Duration between two boundaries of a hop; 0 if either was not reached
+static uint64_t wo_phase(uint64_t from, uint64_t to) {
+    return (from && to && to > from) ? to - from : 0;
+}
+
+// Boundary of the final hop measured from the start of the first hop (redirect hops included)
+static uint64_t wo_cumulative(const HttpResponse *response, uint64_t phase_ns) {
+    if (response->hops == 0) {
+        return 0;
+    }
+    int last = (response->hops < HTTP_MAX_TIMED_HOPS ? response->hops : HTTP_MAX_TIMED_HOPS) - 1;
+    return response->timing[last].start_ns - response->timing[0].start_ns + phase_ns;
+}